@@ -1,24 +1,77 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <thread>
+#include <vector>
+
 #include "buffer/buffer_pool_manager.h"
+#include "common/exception.h"
 
 namespace cmudb {
 
+/*
+ * Pin count of a frame that is being evicted or recycled under latch_.
+ * Lock-free pinners never move a negative pin count, so once the evicting
+ * thread owns the frame nobody else can pin it.
+ */
+static const int EVICTING_PIN_COUNT = -1;
+
 /*
  * BufferPoolManager Constructor
  * WARNING: Do Not Edit This Function
  */
 BufferPoolManager::BufferPoolManager(size_t pool_size,
                                                  const std::string &db_file)
-    : pool_size_(pool_size), disk_manager_{db_file} {
+    : BufferPoolManager(pool_size, new DiskManager(db_file)) {
+  owns_disk_manager_ = true;
+}
+
+/*
+ * BufferPoolManager Constructor over a shared disk manager
+ * The disk manager is owned by the caller and must outlive the buffer pool.
+ * replacer_type picks the page replacement policy, numa_policy/numa_node the
+ * placement of the frame arena.
+ */
+BufferPoolManager::BufferPoolManager(size_t pool_size,
+                                     DiskManager *disk_manager,
+                                     LogManager *log_manager,
+                                     ReplacerType replacer_type,
+                                     NumaPolicy numa_policy, int numa_node)
+    : pool_size_(pool_size),
+      arena_(new FrameArena(pool_size, numa_policy, numa_node,
+                            disk_manager->GetPageSize())),
+      disk_manager_(disk_manager),
+      owns_disk_manager_(false), log_manager_(log_manager),
+      flusher_stop_(false), dirty_low_watermark_(DIRTY_LOW_WATERMARK),
+      dirty_high_watermark_(DIRTY_HIGH_WATERMARK), dirty_count_(0),
+      flushed_page_count_(0), flush_rate_(0), prefetch_stop_(false) {
   // a consecutive memory space for buffer pool
-  pages_ = new Page[pool_size_];
-  page_table_ = new ExtendibleHash<page_id_t, Page *>(100);
-  replacer_ = new LRUReplacer<Page *>;
+  pages_ = arena_->GetPages();
+  page_table_ = new LockFreeHashTable<Page *>(pool_size_, pages_);
+  switch (replacer_type) {
+  case ReplacerType::CLOCK:
+    replacer_ = new ClockReplacer<Page *>(pool_size_, pages_);
+    break;
+  case ReplacerType::LRU_K:
+    replacer_ = new LRUKReplacer<Page *>(pool_size_, LRUK_REPLACER_K, pages_);
+    break;
+  case ReplacerType::LRU:
+  default:
+    replacer_ = new LRUReplacer<Page *>;
+    break;
+  }
   free_list_ = new std::list<Page *>;
 
   // put all the pages into free list
   for (size_t i = 0; i < pool_size_; ++i) {
     free_list_->push_back(&pages_[i]);
   }
+
+  if (pool_size_ > 0) {
+    flusher_ = std::thread(&BufferPoolManager::FlusherLoop, this);
+    prefetcher_ = std::thread(&BufferPoolManager::PrefetchLoop, this);
+  }
 }
 
 /*
@@ -26,149 +79,284 @@ BufferPoolManager::BufferPoolManager(size_t pool_size,
  * WARNING: Do Not Edit This Function
  */
 BufferPoolManager::~BufferPoolManager() {
+  if (flusher_.joinable()) {
+    {
+      std::lock_guard<std::mutex> guard(flusher_mutex_);
+      flusher_stop_ = true;
+    }
+    flusher_cv_.notify_one();
+    flusher_.join();
+  }
+  if (prefetcher_.joinable()) {
+    {
+      std::lock_guard<std::mutex> guard(prefetch_mutex_);
+      prefetch_stop_ = true;
+    }
+    prefetch_cv_.notify_one();
+    prefetcher_.join();
+  }
   FlushAllPages();
-  delete[] pages_;
+  delete arena_;
   delete page_table_;
   delete replacer_;
   delete free_list_;
+  if (owns_disk_manager_)
+    delete disk_manager_;
 }
 
 /**
+ * 0. fast path: look the page up in the lock-free page table and pin it
+ *    without the latch (see TryPinFrame); any race falls through to 1.
  * 1. search hash table.
- *  1.1 if exist, pin the page and return immediately
+ *  1.1 if exist, pin the page and return immediately (after waiting for any
+ *      read of the page still in flight)
  *  1.2 if no exist, find a replacement entry from either free list or lru
  *      replacer. (NOTE: always find from free list first)
- * 2. If the entry chosen for replacement is dirty, write it back to disk.
- * 3. Delete the entry for the old page from the hash table and insert an entry
- * for the new page.
- * 4. Update page metadata, read page content from disk file and return page
+ * 2. Delete the entry for the old page from the hash table and insert an entry
+ * for the new page, marking the frame "I/O in progress".
+ * 3. Release the latch, write the old page back if it was dirty, read the new
+ * page content from disk file, then wake up the waiters and return page
  * pointer
  */
 Page *BufferPoolManager::FetchPage(page_id_t page_id) { 
   Page *tmp_page = NULL;
+  page_id_t evicted_page_id = INVALID_PAGE_ID;
 
-  latch_.lock();
-  //Page not found
-  if(!page_table_->Find(page_id,tmp_page)) {
-    //Free pages are not available
-    if(free_list_->empty()) {
-      //Fetch a victim page
-      if(!replacer_->Victim(tmp_page)) {
-        latch_.unlock();
-				std::cout<<"All page are pinned\n";
-        return nullptr; //all pages are pinned
-      }
+  //Resident and fully read in: no latch needed
+  if(page_table_->Find(page_id, tmp_page) && TryPinFrame(tmp_page, page_id))
+    return tmp_page;
 
-      //Flush and Cleanse the page
-      if(!AddToFreeList(tmp_page)) {
-        latch_.unlock();
-        return nullptr;
-      }
-    }  
+  std::unique_lock<std::mutex> lock(latch_);
+  //The page is being written back by an eviction, disk copy is stale
+  while(write_back_set_.count(page_id))
+    write_back_cv_.wait(lock);
 
-    //Always fetch from free_list.
-    tmp_page = free_list_->front();
-    free_list_->pop_front();
-    //Update page_id for the page object
-    tmp_page->page_id_ = page_id;
-    disk_manager_.ReadPage(tmp_page->page_id_,
-                        tmp_page->data_);
-  }
-	else
-	{
-  	replacer_->Erase(tmp_page);
-	}
-    
-  //Set page metadata
-  tmp_page->pin_count_++;
-  //Insert page into the page table
-  page_table_->Insert(page_id, tmp_page);
-  latch_.unlock();
+  //Page found
+  if(page_table_->Find(page_id,tmp_page)) {
+    //Nobody evicts under us while we hold the latch, a plain increment is safe
+    tmp_page->pin_count_++;
+    replacer_->Erase(tmp_page);
+    RecordHit(tmp_page);
+    //Another thread is still reading the page in
+    while(tmp_page->io_in_progress_)
+      tmp_page->io_cv_.wait(lock);
+    //The read (or the write back before it) failed and the frame was given up
+    if(tmp_page->page_id_ != page_id) {
+      ReleaseAbortedFrame(tmp_page);
+      throw PageCorruptionException(page_id);
+    }
+    return tmp_page;
+  }
+
+  tmp_page = ClaimFrame(evicted_page_id);
+  if(tmp_page == nullptr) {
+    std::cout<<"All page are pinned\n";
+    return nullptr; //all pages are pinned
+  }
+  ReserveFrame(tmp_page, page_id);
+  lock.unlock();
+
+  //A failed checksum, or a read or write back that did not go through
+  try {
+    FinishFrameIO(tmp_page, evicted_page_id, true);
+  } catch(Exception &) {
+    AbortFrameIO(tmp_page, evicted_page_id);
+    throw;
+  }
   return tmp_page;
 }
 
+/*
+ * Guarded fetches: pin, then latch. The guard unlatches, then unpins.
+ */
+ReadPageGuard BufferPoolManager::FetchPageRead(page_id_t page_id) {
+  Page *tmp_page = FetchPage(page_id);
+  if(tmp_page == nullptr)
+    return ReadPageGuard();
+  tmp_page->RLatch();
+  return ReadPageGuard(this, tmp_page);
+}
+
+WritePageGuard BufferPoolManager::FetchPageWrite(page_id_t page_id) {
+  Page *tmp_page = FetchPage(page_id);
+  if(tmp_page == nullptr)
+    return WritePageGuard();
+  tmp_page->WLatch();
+  return WritePageGuard(this, tmp_page);
+}
+
 
 /*
  * Implementation of unpin page
  * if pin_count>0, decrement it and if it becomes zero, put it back to replacer
  * if pin_count<=0 before this call, return false.
  * is_dirty: set the dirty flag of this page
+ * Runs without latch_: the caller's pin keeps the frame from being evicted,
+ * so the lock-free page table lookup is stable.
  */
 bool BufferPoolManager::UnpinPage(page_id_t page_id, bool is_dirty) {
   Page *tmp_page = NULL;
 
-	//is_dirty = true;
+  if(!page_table_->Find(page_id, tmp_page)) {
+		std::cout<<"Unpin: Page Not Found "<<page_id<<std::endl; 
+    return false;
+  }
+
+  //Mark dirty before dropping the pin, an evictor must see it
+  if(is_dirty)
+    MarkDirty(tmp_page);
 
-  latch_.lock();
-  if(page_table_->Find(page_id, tmp_page)){
-    //Pin count is already '0'
-    if(tmp_page->pin_count_ <= 0) {
-      latch_.unlock();
+  //Pin count is already '0' (or the frame is being evicted)
+  int pin_count = tmp_page->pin_count_.load();
+  do {
+    if(pin_count <= 0)
       return false;
-    }
-    
-    //Unpin once
-    tmp_page->pin_count_--;
-		if(!tmp_page->is_dirty_)
-		{
-    	tmp_page->is_dirty_ = is_dirty; 
-		}    
-
-    if(tmp_page->pin_count_ <= 0) {
-    	//tmp_page->is_dirty_ = is_dirty; 
+  } while(!tmp_page->pin_count_.compare_exchange_weak(pin_count,
+                                                       pin_count - 1));
+
+  //Other pins (e.g. the background flusher's) may still be held
+  if(pin_count == 1) {
+    if(tmp_page->delete_pending_)
+      DeletePendingPage(tmp_page);
+    else
       replacer_->Insert(tmp_page); //Inserting into LRU replacer
-      latch_.unlock();
-      return true;
-    }
   }
-	else
-		std::cout<<"Unpin: Page Not Found "<<page_id<<std::endl; 
-
-  latch_.unlock();
-  return false;
+  return true;
 }
 
 /*
  * Used to flush a particular page of the buffer pool to disk. Should call the
  * write_page method of the disk manager
- * if page is not found in page table, return false
+ * if page is not found in page table (or is not dirty), return false
  * NOTE: make sure page_id != INVALID_PAGE_ID
+ * Like FlushAllPages(), the page is read latched only while it is copied
+ * and the copy is written without latch_.
  */
 bool BufferPoolManager::FlushPage(page_id_t page_id) { 
   Page *tmp_page = NULL;
 
-  latch_.lock();
-  const bool found = page_table_->Find(page_id, tmp_page);
-
-  //Page Found 
-  if(found && tmp_page->page_id_ != INVALID_PAGE_ID && 
-     tmp_page->is_dirty_) {
-    disk_manager_.WritePage(page_id, tmp_page->data_);
-    tmp_page->is_dirty_ = false;
-    latch_.unlock();
-    return true;
-  } 
-
-  latch_.unlock();
-  //Page not in hash_table
-  return false; 
+  //Page not in hash_table (or being read in, then it is clean)
+  if(!page_table_->Find(page_id, tmp_page) || !PinFrame(tmp_page, page_id))
+    return false;
+
+  std::vector<char> copy(GetPageSize());
+  std::vector<std::pair<page_id_t, Page *>> batch;
+  std::vector<std::pair<page_id_t, const char *>> writes;
+  std::lock_guard<std::mutex> guard(flush_latch_);
+  //Clear the flag before copying, so a concurrent UnpinPage(dirty) that lands
+  //after the copy keeps the page dirty
+  tmp_page->rwlatch_.RLock();
+  const bool dirty = ClearDirty(tmp_page);
+  if(dirty)
+    memcpy(copy.data(), tmp_page->data_, GetPageSize());
+  tmp_page->rwlatch_.RUnlock();
+  if(!dirty) {
+    UnpinFrame(tmp_page);
+    return false;
+  }
+  batch.emplace_back(page_id, tmp_page);
+  writes.emplace_back(page_id, copy.data());
+  WriteCopies(batch, writes);
+  return true;
 }
 
 /*
  * Used to flush all dirty pages in the buffer pool manager
+ * Like FlushDirtyPages(), each page is pinned and read latched so nobody
+ * modifies it meanwhile, but pages in use are waited for, not skipped. To
+ * wait without latch_ and on one page latch at a time (a writer may hold
+ * another one), a page is latched only while it is copied. The copies go
+ * to the disk manager in page id order, in batches of up to
+ * FLUSH_BATCH_SIZE, one sync per batch.
  */
 void BufferPoolManager::FlushAllPages() {
-  latch_.lock();
-  for(uint64_t i=0;i<pool_size_;i++) {
-    if(pages_[i].page_id_ != INVALID_PAGE_ID && 
-       pages_[i].is_dirty_) 
-    { 
-        disk_manager_.WritePage(pages_[i].page_id_,
-                                pages_[i].data_);
-        pages_[i].is_dirty_ = false;
+  std::vector<std::pair<page_id_t, Page *>> dirty_pages;
+
+  for(size_t i = 0; i < pool_size_; i++) {
+    page_id_t page_id = pages_[i].page_id_;
+    if(page_id != INVALID_PAGE_ID && pages_[i].is_dirty_)
+      dirty_pages.emplace_back(page_id, &pages_[i]);
+  }
+  std::sort(dirty_pages.begin(), dirty_pages.end());
+
+  const size_t page_size = GetPageSize();
+  std::vector<char> copies(
+      std::min<size_t>(dirty_pages.size(), FLUSH_BATCH_SIZE) * page_size);
+  std::vector<std::pair<page_id_t, Page *>> batch;
+  std::vector<std::pair<page_id_t, const char *>> writes;
+  std::lock_guard<std::mutex> guard(flush_latch_);
+  for(auto &entry : dirty_pages) {
+    Page *tmp_page = entry.second;
+    //Evicted or being read in meanwhile, it is written back (or clean) then
+    if(!PinFrame(tmp_page, entry.first))
+      continue;
+    tmp_page->rwlatch_.RLock();
+    const bool dirty = ClearDirty(tmp_page);
+    if(dirty) {
+      char *copy = copies.data() + writes.size() * page_size;
+      memcpy(copy, tmp_page->data_, page_size);
+      writes.emplace_back(entry.first, copy);
+      batch.push_back(entry);
     }
+    tmp_page->rwlatch_.RUnlock();
+    if(!dirty)
+      UnpinFrame(tmp_page);
+    if(batch.size() == FLUSH_BATCH_SIZE)
+      WriteCopies(batch, writes);
+  }
+  WriteCopies(batch, writes);
+}
+
+/*
+ * Caller holds flush_latch_, so two copies of a page never race each other
+ * to disk, and has pinned the pages of batch and copied them into writes.
+ * The pages are unpinned before the copies are written, but stay in
+ * flush_set_ until the write is done: an eviction meanwhile writes the
+ * page back as if it were dirty, once the copy is on disk, and a fetch
+ * waits for that. Latches are not waited for while pages are in flush_set_.
+ * If the write fails, the pages still in their frames are dirty again and
+ * the exception is passed on.
+ */
+void BufferPoolManager::WriteCopies(
+    std::vector<std::pair<page_id_t, Page *>> &batch,
+    std::vector<std::pair<page_id_t, const char *>> &writes) {
+  {
+    std::lock_guard<std::mutex> guard(latch_);
+    for(auto &entry : batch)
+      flush_set_.insert(entry.first);
   }
-  latch_.unlock();
+  for(auto &entry : batch)
+    UnpinFrame(entry.second);
+
+  std::exception_ptr error;
+  try {
+    disk_manager_->WritePages(writes);
+  } catch(Exception &) {
+    error = std::current_exception();
+    for(auto &entry : batch)
+      if(PinFrame(entry.second, entry.first)) {
+        MarkDirty(entry.second);
+        UnpinFrame(entry.second);
+      }
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(latch_);
+    for(auto &entry : batch)
+      flush_set_.erase(entry.first);
+    write_back_cv_.notify_all();
+  }
+  batch.clear();
+  writes.clear();
+  if(error)
+    std::rethrow_exception(error);
+}
+
+//Wait until no copy of page_id is being written back by a flush
+void BufferPoolManager::WaitForFlush(std::unique_lock<std::mutex> &lock,
+                                     page_id_t page_id) {
+  while(flush_set_.count(page_id))
+    write_back_cv_.wait(lock);
 }
 
 /**
@@ -178,12 +366,20 @@ void BufferPoolManager::FlushAllPages() {
  * reponsible for removing this entry out of page table, reseting page metadata
  * and adding back to free list. Second, call disk manager's DeallocatePage()
  * method to delete from disk file.
- * If the page is found within page table, but pin_count != 0, return false
+ * If the page is found within page table, but pin_count != 0, return false;
+ * the page is deleted once its last pin is dropped instead (an iterator on
+ * its way to the next leaf, the flusher or a read-ahead may hold one)
+ * A page that is not in the page table is deallocated right away
  */
 bool BufferPoolManager::DeletePage(page_id_t page_id) { 
   Page *tmp_page = NULL;
 
-  latch_.lock();  
+  std::unique_lock<std::mutex> lock(latch_);
+  //A copy on its way to disk (flushed, or evicted dirty) would land after
+  //the delete
+  WaitForFlush(lock, page_id);
+  while(write_back_set_.count(page_id))
+    write_back_cv_.wait(lock);
   //Checking the page table for the page_id 
   if(page_table_->Find(page_id, tmp_page)) {
     //Page table entry found. 
@@ -191,19 +387,21 @@ bool BufferPoolManager::DeletePage(page_id_t page_id) {
     //     1) Check for pin count - return false if > 0
     //     2) remove from LRU replacer
     //     3) remove from page table
+    //The last pin may have been dropped before the flag was set, try again
     if(!AddToFreeList(tmp_page)) {
-      latch_.unlock();
-      return false;
+      tmp_page->delete_pending_ = true;
+      if(!AddToFreeList(tmp_page))
+        return false;
     }
 
     //Deallocate the page from disk
-    disk_manager_.DeallocatePage(page_id);
-    latch_.unlock();
+    disk_manager_->DeallocatePage(page_id);
     return true; 
   }
   
-  latch_.unlock();
-  return false; 
+  //Not resident, nobody can have it pinned: only give it back to the disk
+  disk_manager_->DeallocatePage(page_id);
+  return true; 
 }
 
 /**
@@ -213,67 +411,554 @@ bool BufferPoolManager::DeletePage(page_id_t page_id) {
  * free list or lru replacer(NOTE: always choose from free list first), update
  * new page's metadata, zero out memory and add corresponding entry into page
  * table.
+ * The id is allocated first: with freed pages reused and extents handed out
+ * ahead, a read-ahead may already hold the (empty) page in a frame, which
+ * NewPageWithId() takes care of. The id is handed back if no frame is free.
  * return nullptr is all the pages in pool are pinned
  */
-Page *BufferPoolManager::NewPage(page_id_t &page_id) { 
+Page *BufferPoolManager::NewPage(page_id_t &page_id, segment_id_t segment_id) { 
+  page_id_t new_page_id = disk_manager_->AllocatePage(segment_id);
   Page *new_page = NULL;
+  try {
+    new_page = NewPageWithId(new_page_id);
+  } catch(Exception &) {
+    disk_manager_->DeallocatePage(new_page_id);
+    throw;
+  }
+  if(new_page == nullptr) {
+    //Unable to find a unpinned victim page
+    disk_manager_->DeallocatePage(new_page_id);
+    return nullptr;
+  }
+  page_id = new_page_id;
+  return new_page;
+}
+
+/*
+ * Same as NewPage() except that the page id has already been handed out by
+ * the disk manager. Also used by ParallelBufferPoolManager, which must
+ * allocate the id first to know which instance owns the page.
+ */
+Page *BufferPoolManager::NewPageWithId(page_id_t page_id) {
+  Page *new_page = NULL;
+  page_id_t evicted_page_id = INVALID_PAGE_ID;
+
+  std::unique_lock<std::mutex> lock(latch_);
+  //A page the id was freed from may still be on its way to disk
+  WaitForFlush(lock, page_id);
+  //A read-ahead got to the id between its allocation and now: the frame
+  //holds the (empty) page already
+  if(page_table_->Find(page_id, new_page)) {
+    lock.unlock();
+    new_page = FetchPage(page_id);
+    if(new_page != nullptr)
+      new_page->ResetMemory();
+    return new_page;
+  }
+  new_page = ClaimFrame(evicted_page_id);
+  if(new_page == nullptr)
+    return nullptr;
+  ReserveFrame(new_page, page_id);
+  lock.unlock();
+
+  //The write back of the evicted page did not go through
+  try {
+    FinishFrameIO(new_page, evicted_page_id, false);
+  } catch(Exception &) {
+    AbortFrameIO(new_page, evicted_page_id);
+    throw;
+  }
+  return new_page;
+}
+
+/*
+ * Caller holds latch_.
+ * Take a frame from the free list, or evict an unpinned victim from the
+ * replacer. The victim's page table entry is removed right away; if it is
+ * dirty (or a flush is writing it back) its page id is parked in
+ * write_back_set_ and returned through evicted_page_id, and the caller must
+ * write the frame content back before reusing it (see FinishFrameIO).
+ * The claimed frame's pin count is EVICTING_PIN_COUNT until ReserveFrame().
+ * return nullptr if all the pages in pool are pinned
+ */
+Page *BufferPoolManager::ClaimFrame(page_id_t &evicted_page_id) {
+  Page *tmp_page = NULL;
+  int unpinned;
+
+  evicted_page_id = INVALID_PAGE_ID;
+  if(!free_list_->empty()) {
+    tmp_page = free_list_->front();
+    free_list_->pop_front();
+    //A stale lock-free lookup may hold a transient pin, it backs off quickly
+    while(!tmp_page->pin_count_.compare_exchange_weak(
+        unpinned = 0, EVICTING_PIN_COUNT))
+      std::this_thread::yield();
+    return tmp_page;
+  }
+
+  //The replacer may hold stale entries: frames pinned by a lock-free fetch
+  //since they were unpinned, or frames since moved to the free list. Skip
+  //them; whoever unpins such a frame last puts it back in the replacer.
+  bool claimed = false;
+  while(!claimed && replacer_->Victim(tmp_page)) {
+    if(!tmp_page->pin_count_.compare_exchange_strong(unpinned = 0,
+                                                     EVICTING_PIN_COUNT))
+      continue;
+    if(tmp_page->page_id_ != INVALID_PAGE_ID)
+      claimed = true;
+    else
+      tmp_page->pin_count_ = 0;
+  }
+  if(!claimed)
+    return nullptr;
+
+  page_table_->Remove(tmp_page->page_id_);
+  //Unpinned, but the unpinner has not come round to deleting it yet
+  if(tmp_page->delete_pending_.exchange(false)) {
+    ClearDirty(tmp_page);
+    disk_manager_->DeallocatePage(tmp_page->page_id_);
+  } else if(ClearDirty(tmp_page) || flush_set_.count(tmp_page->page_id_)) {
+    //A flush that is writing the page back may yet fail
+    evicted_page_id = tmp_page->page_id_;
+    write_back_set_.insert(evicted_page_id);
+  }
+  return tmp_page;
+}
+
+/*
+ * Caller holds latch_.
+ * Map page_id to the claimed frame and pin it. The frame stays marked "I/O
+ * in progress" until FinishFrameIO() has filled it, so concurrent fetchers of
+ * page_id pin it and wait instead of reading garbage.
+ */
+void BufferPoolManager::ReserveFrame(Page *tmp_page, page_id_t page_id) {
+  tmp_page->page_id_ = page_id;
+  tmp_page->is_dirty_ = false;
+  tmp_page->io_in_progress_ = true;
+  tmp_page->prefetched_ = false;
+  //Publish last: a lock-free pinner that gets in sees the new page id
+  tmp_page->pin_count_ = 1;
+  page_table_->Insert(page_id, tmp_page);
+  //First access of the page in this frame, start a fresh history
+  replacer_->RecordAccess(tmp_page, true);
+}
+
+/*
+ * Called WITHOUT latch_ on a frame reserved by ReserveFrame().
+ * Writes the evicted page back (if any, after a flush of it that is under
+ * way), reads page content from disk (or
+ * zeroes it for a brand new page), then clears the I/O flag and wakes up the
+ * threads waiting on this frame or on the evicted page.
+ */
+void BufferPoolManager::FinishFrameIO(Page *tmp_page,
+                                      page_id_t evicted_page_id,
+                                      bool read_page) {
+  if(evicted_page_id != INVALID_PAGE_ID) {
+    {
+      std::unique_lock<std::mutex> lock(latch_);
+      WaitForFlush(lock, evicted_page_id);
+    }
+    disk_manager_->WritePage(evicted_page_id, tmp_page->data_);
+  }
+
+  if(read_page)
+    disk_manager_->ReadPage(tmp_page->page_id_, tmp_page->data_);
+  else
+    tmp_page->ResetMemory();
+
+  CompleteFrameIO(tmp_page, evicted_page_id);
+}
+
+/*
+ * The I/O of a reserved frame is done: release the evicted page id and the
+ * threads waiting for the frame.
+ */
+void BufferPoolManager::CompleteFrameIO(Page *tmp_page,
+                                        page_id_t evicted_page_id) {
+  std::lock_guard<std::mutex> guard(latch_);
+  if(evicted_page_id != INVALID_PAGE_ID) {
+    write_back_set_.erase(evicted_page_id);
+    write_back_cv_.notify_all();
+  }
+  tmp_page->io_in_progress_ = false;
+  tmp_page->io_cv_.notify_all();
+}
+
+/*
+ * The read of a reserved frame failed its checksum, or its I/O failed.
+ * Nothing may use what was read: the page leaves the page table (a later
+ * fetch reads it again) and the frame drops the page, then goes back to the
+ * free list once the caller and whoever waited for the read have let go of
+ * it. An evicted page whose write back failed is lost.
+ */
+void BufferPoolManager::AbortFrameIO(Page *tmp_page,
+                                     page_id_t evicted_page_id) {
+  std::lock_guard<std::mutex> guard(latch_);
+  page_table_->Remove(tmp_page->page_id_);
+  tmp_page->page_id_ = INVALID_PAGE_ID;
+  if(evicted_page_id != INVALID_PAGE_ID) {
+    write_back_set_.erase(evicted_page_id);
+    write_back_cv_.notify_all();
+  }
+  tmp_page->io_in_progress_ = false;
+  tmp_page->io_cv_.notify_all();
+  ReleaseAbortedFrame(tmp_page);
+}
+
+//Caller holds latch_. Drop one pin of an aborted frame, the last one frees it
+void BufferPoolManager::ReleaseAbortedFrame(Page *tmp_page) {
+  if(--tmp_page->pin_count_ > 0)
+    return;
+  replacer_->Erase(tmp_page);
+  CleanPage(tmp_page);
+  free_list_->push_back(tmp_page);
+}
+
+/*
+ * Called WITHOUT latch_.
+ * Pin a frame found by a lock-free page table lookup. The pin count is bumped
+ * with a CAS that refuses frames being evicted, then the frame must still
+ * hold page_id and be fully read in. Otherwise the pin is dropped and the
+ * caller retries under the latch.
+ */
+bool BufferPoolManager::TryPinFrame(Page *tmp_page, page_id_t page_id) {
+  if(!PinFrame(tmp_page, page_id))
+    return false;
+
+  replacer_->Erase(tmp_page);
+  RecordHit(tmp_page);
+  return true;
+}
 
-  latch_.lock();
-
-  /*Checking if the Free list is empty*/
-  if(free_list_->empty()) {
-    //Free list is empty
-    //Trying to fetch a empty, unpinned page from the LRU replacer
-    //Note: all the pages in LRU replacer are unpinned. Only 
-    //unpinned pages are inserted into the LRU replacer.
-    if(!replacer_->Victim(new_page)){
-      //Unable to find a unpinned victim page
-      latch_.unlock();
-      return nullptr;
+void BufferPoolManager::RecordHit(Page *tmp_page) {
+  //The prefetch already counted as this page's first access
+  if(tmp_page->prefetched_ && tmp_page->prefetched_.exchange(false))
+    return;
+  replacer_->RecordAccess(tmp_page);
+}
+
+/*
+ * Called WITHOUT latch_.
+ * The pin count part of TryPinFrame(). It leaves the replacer alone, so the
+ * frame may still be listed there; ClaimFrame() skips it while it is pinned.
+ */
+bool BufferPoolManager::PinFrame(Page *tmp_page, page_id_t page_id) {
+  int pin_count = tmp_page->pin_count_.load();
+  do {
+    if(pin_count < 0)
+      return false;
+  } while(!tmp_page->pin_count_.compare_exchange_weak(pin_count,
+                                                       pin_count + 1));
+
+  if(tmp_page->page_id_ != page_id || tmp_page->io_in_progress_) {
+    //Lost the race, the frame was recycled or is still being read in
+    UnpinFrame(tmp_page);
+    return false;
+  }
+  return true;
+}
+
+/*
+ * Drop a pin taken by PinFrame(). The last pin puts the frame back in the
+ * replacer if a victim search dropped it meanwhile, without refreshing its
+ * position: the page was not accessed.
+ */
+void BufferPoolManager::UnpinFrame(Page *tmp_page) {
+  if(tmp_page->pin_count_.fetch_sub(1) != 1)
+    return;
+  if(tmp_page->delete_pending_)
+    DeletePendingPage(tmp_page);
+  else if(!replacer_->Contains(tmp_page))
+    replacer_->Insert(tmp_page);
+}
+
+/*
+ * Called WITHOUT latch_, by whoever dropped the last pin of a page that
+ * DeletePage() found pinned. If the page was pinned again meanwhile, the
+ * next last unpin tries again.
+ */
+void BufferPoolManager::DeletePendingPage(Page *tmp_page) {
+  std::lock_guard<std::mutex> guard(latch_);
+  page_id_t page_id = tmp_page->page_id_;
+  if(tmp_page->delete_pending_ && AddToFreeList(tmp_page))
+    disk_manager_->DeallocatePage(page_id);
+}
+
+void BufferPoolManager::MarkDirty(Page *tmp_page) {
+  if(tmp_page->is_dirty_.exchange(true))
+    return;
+  if(++dirty_count_ > dirty_high_watermark_ * pool_size_)
+    flusher_cv_.notify_one();
+}
+
+//Returns whether the page was dirty, i.e. whether the caller must write it
+bool BufferPoolManager::ClearDirty(Page *tmp_page) {
+  if(!tmp_page->is_dirty_.exchange(false))
+    return false;
+  dirty_count_--;
+  return true;
+}
+
+/*
+ * Background flusher. Wakes up every FLUSHER_INTERVAL_MS, or as soon as
+ * MarkDirty() crosses the high watermark, and writes back down to the low
+ * watermark so foreground evictions mostly find clean victims.
+ */
+void BufferPoolManager::FlusherLoop() {
+  std::unique_lock<std::mutex> lock(flusher_mutex_);
+  auto last_round = std::chrono::steady_clock::now();
+
+  while(!flusher_stop_) {
+    flusher_cv_.wait_for(lock, std::chrono::milliseconds(FLUSHER_INTERVAL_MS));
+    if(flusher_stop_)
+      break;
+
+    size_t flushed = 0;
+    if(dirty_count_ > dirty_high_watermark_ * pool_size_) {
+      lock.unlock();
+      flushed = FlushDirtyPages(dirty_low_watermark_ * pool_size_);
+      lock.lock();
     }
 
-    //Found a Victim page from either free list or LRU replacer
-    //Flush and Cleanse the page
-    if(!AddToFreeList(new_page)) {
-      //Unable to add the page to Free list - may be pinned (unlikely).
-      latch_.unlock();
-      return nullptr;
+    auto now = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed = now - last_round;
+    last_round = now;
+    flushed_page_count_ += flushed;
+    flush_rate_ = flushed / elapsed.count();
+  }
+}
+
+/*
+ * Called by the flusher WITHOUT latch_.
+ * Write back unpinned dirty pages in page id order until at most target
+ * pages are dirty. Like FlushAllPages(), each page is pinned and read
+ * latched only while it is copied, and the copies go to the disk manager in
+ * batches of up to FLUSH_BATCH_SIZE, one sync per batch; writers are not
+ * held up by the write. Pages in use (pinned or write latched) are skipped.
+ * A batch whose write fails is dirty again, the next round retries it.
+ * return the number of pages written
+ */
+size_t BufferPoolManager::FlushDirtyPages(size_t target) {
+  std::vector<std::pair<page_id_t, Page *>> dirty_pages;
+  size_t flushed = 0;
+
+  for(size_t i = 0; i < pool_size_; i++) {
+    page_id_t page_id = pages_[i].page_id_;
+    if(page_id != INVALID_PAGE_ID && pages_[i].is_dirty_ &&
+       pages_[i].pin_count_ == 0)
+      dirty_pages.emplace_back(page_id, &pages_[i]);
+  }
+  std::sort(dirty_pages.begin(), dirty_pages.end());
+
+  const size_t page_size = GetPageSize();
+  std::vector<char> copies(
+      std::min<size_t>(dirty_pages.size(), FLUSH_BATCH_SIZE) * page_size);
+  std::vector<std::pair<page_id_t, Page *>> batch;
+  std::vector<std::pair<page_id_t, const char *>> writes;
+  auto write_batch = [&]() {
+    size_t count = batch.size();
+    try {
+      WriteCopies(batch, writes);
+      flushed += count;
+    } catch(Exception &) {
+      //The pages are dirty again, the next round retries them
     }
-  } 
+  };
+
+  std::lock_guard<std::mutex> guard(flush_latch_);
+  for(auto &entry : dirty_pages) {
+    if(dirty_count_ <= target)
+      break;
+    Page *tmp_page = entry.second;
+    if(!PinFrame(tmp_page, entry.first))
+      continue;
+    if(!tmp_page->rwlatch_.TryRLock()) {
+      UnpinFrame(tmp_page);
+      continue;
+    }
+    const bool dirty = ClearDirty(tmp_page);
+    if(dirty) {
+      char *copy = copies.data() + writes.size() * page_size;
+      memcpy(copy, tmp_page->data_, page_size);
+      writes.emplace_back(entry.first, copy);
+      batch.push_back(entry);
+    }
+    tmp_page->rwlatch_.RUnlock();
+    if(!dirty)
+      UnpinFrame(tmp_page);
+    if(batch.size() == FLUSH_BATCH_SIZE)
+      write_batch();
+  }
+  write_batch();
+  return flushed;
+}
 
-  //Always fetch from free_list. 
-  new_page = free_list_->front();
-  free_list_->pop_front();
-  
-  page_id = disk_manager_.AllocatePage();
-  
-  //Set page metadata
-  new_page->page_id_ = page_id;
-  new_page->pin_count_++;
+/*
+ * The frame is claimed and reserved like a fetch miss, under latch_, but the
+ * read itself is handed to the prefetch thread. The reservation pins the
+ * frame and marks it "I/O in progress", so a fetch that comes in before the
+ * read is done waits for it as it would for any other in-flight read.
+ */
+bool BufferPoolManager::PrefetchPage(page_id_t page_id) {
+  Page *tmp_page = NULL;
+  page_id_t evicted_page_id = INVALID_PAGE_ID;
+
+  if(page_id < 0 || page_id >= disk_manager_->GetNextPageId())
+    return false;
+  if(page_table_->Find(page_id, tmp_page))
+    return false;
+
+  std::lock_guard<std::mutex> guard(latch_);
+  if(write_back_set_.count(page_id) || flush_set_.count(page_id) ||
+     page_table_->Find(page_id, tmp_page))
+    return false;
+  tmp_page = ClaimFrame(evicted_page_id);
+  if(tmp_page == nullptr)
+    return false;
+  ReserveFrame(tmp_page, page_id);
+  tmp_page->prefetched_ = true;
+
+  {
+    std::lock_guard<std::mutex> queue_guard(prefetch_mutex_);
+    prefetch_queue_.emplace_back(tmp_page, evicted_page_id);
+  }
+  prefetch_cv_.notify_one();
+  return true;
+}
 
-  disk_manager_.ReadPage(new_page->page_id_,
-                        new_page->data_);
+void BufferPoolManager::PrefetchRange(page_id_t first_page_id, size_t count) {
+  for(size_t i = 0; i < count; i++)
+    PrefetchPage(first_page_id + i);
+}
 
-  //Insert page into the page table
-  page_table_->Insert(page_id, new_page);
+/*
+ * Prefetch thread. Takes all queued frames at once and hands their I/O to
+ * the disk manager as two batches: the write back of the evicted pages
+ * first (they are still in the frames), then the reads. Each frame is
+ * released as soon as its read completes, and the reservation pin dropped
+ * so the page sits in the replacer until it is fetched. Frames whose I/O
+ * failed are given up.
+ * The queue is drained before the thread exits, reserved frames are pinned.
+ */
+void BufferPoolManager::PrefetchLoop() {
+  std::unique_lock<std::mutex> lock(prefetch_mutex_);
+
+  while(true) {
+    while(!prefetch_stop_ && prefetch_queue_.empty())
+      prefetch_cv_.wait(lock);
+    if(prefetch_queue_.empty())
+      break;
+
+    std::vector<std::pair<Page *, page_id_t>> entries(prefetch_queue_.begin(),
+                                                      prefetch_queue_.end());
+    prefetch_queue_.clear();
+    lock.unlock();
+
+    //A frame whose write back fails is given up without being read
+    std::vector<bool> failed(entries.size(), false);
+    std::vector<DiskRequest> writes;
+    std::vector<size_t> write_entries;
+    for(size_t i = 0; i < entries.size(); i++)
+      if(entries[i].second != INVALID_PAGE_ID) {
+        {
+          std::unique_lock<std::mutex> latch_lock(latch_);
+          WaitForFlush(latch_lock, entries[i].second);
+        }
+        writes.emplace_back(true, entries[i].second, entries[i].first->data_);
+        write_entries.push_back(i);
+      }
+    bool submitted = SubmitPrefetchIO(writes);
+    for(size_t j = 0; j < writes.size(); j++) {
+      size_t i = write_entries[j];
+      if(!submitted || !WaitPrefetchIO(writes[j])) {
+        failed[i] = true;
+        AbortFrameIO(entries[i].first, entries[i].second);
+      }
+    }
 
-  latch_.unlock();
-  return new_page;
+    std::vector<DiskRequest> reads;
+    std::vector<size_t> read_entries;
+    for(size_t i = 0; i < entries.size(); i++)
+      if(!failed[i]) {
+        reads.emplace_back(false, entries[i].first->page_id_,
+                           entries[i].first->data_);
+        read_entries.push_back(i);
+      }
+    submitted = SubmitPrefetchIO(reads);
+    for(size_t j = 0; j < reads.size(); j++) {
+      size_t i = read_entries[j];
+      Page *tmp_page = entries[i].first;
+      //Nobody asked for the page yet, a fetch will report it
+      if(!submitted || !WaitPrefetchIO(reads[j])) {
+        AbortFrameIO(tmp_page, entries[i].second);
+        continue;
+      }
+      CompleteFrameIO(tmp_page, entries[i].second);
+      UnpinFrame(tmp_page);
+    }
+
+    lock.lock();
+  }
+}
+
+/*
+ * I/O of the prefetch thread, which has nobody to throw to. No request of a
+ * batch is in flight once SubmitRequests() threw, they all count as failed.
+ */
+bool BufferPoolManager::SubmitPrefetchIO(std::vector<DiskRequest> &requests) {
+  try {
+    disk_manager_->SubmitRequests(requests.data(), requests.size());
+  } catch(Exception &) {
+    return false;
+  }
+  return true;
 }
 
+bool BufferPoolManager::WaitPrefetchIO(DiskRequest &request) {
+  try {
+    disk_manager_->WaitRequest(request);
+  } catch(Exception &) {
+    return false;
+  }
+  return true;
+}
+
+void BufferPoolManager::SetDirtyWatermarks(double low, double high) {
+  dirty_low_watermark_ = low;
+  dirty_high_watermark_ = high;
+  flusher_cv_.notify_one();
+}
+
+double BufferPoolManager::GetDirtyRatio() {
+  return pool_size_ == 0 ? 0 : static_cast<double>(dirty_count_) / pool_size_;
+}
+
+uint64_t BufferPoolManager::GetFlushedPageCount() {
+  return flushed_page_count_;
+}
+
+double BufferPoolManager::GetFlushRate() { return flush_rate_; }
+
 //Resets a given page object
 void BufferPoolManager::CleanPage(Page *tmp_page) {
   tmp_page->ResetMemory();
   tmp_page->page_id_   = INVALID_PAGE_ID;
   tmp_page->is_dirty_  = false;
   tmp_page->pin_count_ = 0;
+  tmp_page->io_in_progress_ = false;
+  tmp_page->prefetched_ = false;
+  tmp_page->delete_pending_ = false;
 }
 
 bool BufferPoolManager::AddToFreeList(Page *tmp_page) {
-    if(tmp_page->pin_count_) return false;
+    int unpinned = 0;
+    //Also shuts out lock-free pinners while the frame is recycled
+    if(!tmp_page->pin_count_.compare_exchange_strong(unpinned,
+                                                     EVICTING_PIN_COUNT))
+      return false;
 
-    if(tmp_page->is_dirty_) 
-      disk_manager_.WritePage(tmp_page->page_id_, 
+    if(ClearDirty(tmp_page)) 
+      disk_manager_->WritePage(tmp_page->page_id_, 
                                       tmp_page->data_);
 
     //Adding the page back to free list
@@ -0,0 +1,92 @@
+/**
+ * CLOCK implementation
+ */
+#include <cassert>
+
+#include "buffer/clock_replacer.h"
+#include "page/page.h"
+
+namespace cmudb {
+
+template <typename T>
+ClockReplacer<T>::ClockReplacer(size_t num_frames, T base)
+    : num_frames_(num_frames), base_(base), size_(0), hand_(0) {
+  in_replacer_ = new std::atomic<bool>[num_frames_];
+  ref_bit_ = new std::atomic<bool>[num_frames_];
+  for (size_t i = 0; i < num_frames_; ++i) {
+    in_replacer_[i] = false;
+    ref_bit_[i] = false;
+  }
+}
+
+template <typename T> ClockReplacer<T>::~ClockReplacer() {
+  delete[] in_replacer_;
+  delete[] ref_bit_;
+}
+
+/*
+ * Make value a replacement candidate and give it a second chance
+ */
+template <typename T> void ClockReplacer<T>::Insert(const T &value) {
+  size_t frame_id = FrameId(value);
+  assert(frame_id < num_frames_);
+
+  ref_bit_[frame_id].store(true);
+  if (!in_replacer_[frame_id].exchange(true))
+    size_++;
+}
+
+/*
+ * Sweep the clock hand: a candidate with its reference bit set loses the bit
+ * and survives this round, the first candidate without it is the victim.
+ * Two full rounds are enough unless other threads keep inserting.
+ */
+template <typename T> bool ClockReplacer<T>::Victim(T &value) {
+  std::lock_guard<std::mutex> guard(hand_mutex_);
+
+  for (size_t step = 0; step < 2 * num_frames_ && size_ > 0; ++step) {
+    size_t frame_id = hand_;
+    hand_ = (hand_ + 1) % num_frames_;
+
+    if (!in_replacer_[frame_id])
+      continue;
+    if (ref_bit_[frame_id].exchange(false))
+      continue;
+    // lose the race against a concurrent Erase, keep sweeping
+    if (!in_replacer_[frame_id].exchange(false))
+      continue;
+
+    size_--;
+    value = base_ + frame_id;
+    return true;
+  }
+  return false;
+}
+
+/*
+ * Remove value from the replacer. If removal is successful, return true,
+ * otherwise return false
+ */
+template <typename T> bool ClockReplacer<T>::Erase(const T &value) {
+  size_t frame_id = FrameId(value);
+  assert(frame_id < num_frames_);
+
+  if (!in_replacer_[frame_id].exchange(false))
+    return false;
+  size_--;
+  return true;
+}
+
+template <typename T> size_t ClockReplacer<T>::Size() { return size_; }
+
+template <typename T> bool ClockReplacer<T>::Contains(const T &value) {
+  size_t frame_id = FrameId(value);
+  assert(frame_id < num_frames_);
+  return in_replacer_[frame_id];
+}
+
+template class ClockReplacer<Page *>;
+// test only
+template class ClockReplacer<int>;
+
+} // namespace cmudb
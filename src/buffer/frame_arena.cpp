@@ -0,0 +1,146 @@
+/**
+ * frame_arena.cpp
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <string>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "buffer/frame_arena.h"
+
+namespace cmudb {
+
+// mempolicy modes of the mbind syscall (linux/mempolicy.h)
+static const int MPOL_MODE_BIND = 2;
+static const int MPOL_MODE_INTERLEAVE = 3;
+
+static size_t RoundUp(size_t size, size_t alignment) {
+  return (size + alignment - 1) / alignment * alignment;
+}
+
+/*
+ * FrameArena Constructor
+ * Map the data of all frames, huge pages first, then lay out the frame
+ * descriptors in a mapping of their own and point each one at its frame.
+ * Anonymous mappings are zero filled, so frames start out reset.
+ */
+FrameArena::FrameArena(size_t frame_count, NumaPolicy numa_policy,
+                       int numa_node, size_t page_size)
+    : frame_count_(frame_count), page_size_(page_size), pages_(nullptr), pages_size_(0),
+      data_(nullptr), data_size_(0), huge_pages_(false),
+      numa_applied_(numa_policy == NumaPolicy::NONE) {
+  if (frame_count_ == 0)
+    return;
+
+  data_size_ = RoundUp(frame_count_ * page_size_, HUGE_PAGE_SIZE);
+  void *data = mmap(nullptr, data_size_, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (data != MAP_FAILED) {
+    huge_pages_ = true;
+  } else {
+    // no huge pages reserved, ask for transparent ones instead
+    data = mmap(nullptr, data_size_, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data == MAP_FAILED)
+      throw std::bad_alloc();
+    madvise(data, data_size_, MADV_HUGEPAGE);
+  }
+  data_ = static_cast<char *>(data);
+
+  // the policy has to be in place before the first touch of a frame
+  if (numa_policy != NumaPolicy::NONE)
+    numa_applied_ = ApplyNumaPolicy(numa_policy, numa_node);
+
+  // page aligned, which keeps every cache line aligned Page in its own lines
+  pages_size_ = RoundUp(frame_count_ * sizeof(Page),
+                        static_cast<size_t>(sysconf(_SC_PAGESIZE)));
+  void *pages = mmap(nullptr, pages_size_, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (pages == MAP_FAILED) {
+    munmap(data_, data_size_);
+    throw std::bad_alloc();
+  }
+  pages_ = static_cast<Page *>(pages);
+  for (size_t i = 0; i < frame_count_; ++i) {
+    new (&pages_[i]) Page();
+    pages_[i].data_ = data_ + i * page_size_;
+    pages_[i].page_size_ = page_size_;
+  }
+}
+
+/*
+ * FrameArena Deconstructor
+ * The buffer pool must have written back its dirty frames already.
+ */
+FrameArena::~FrameArena() {
+  if (frame_count_ == 0)
+    return;
+  for (size_t i = 0; i < frame_count_; ++i)
+    pages_[i].~Page();
+  munmap(pages_, pages_size_);
+  munmap(data_, data_size_);
+}
+
+/*
+ * Set the NUMA policy of the data mapping with the raw mbind syscall, so
+ * there is no dependency on libnuma. Only a hint: returns false when the
+ * kernel has no NUMA support or refuses the node mask.
+ */
+bool FrameArena::ApplyNumaPolicy(NumaPolicy numa_policy, int numa_node) {
+#ifdef SYS_mbind
+  const int node_count = GetNumaNodeCount();
+  const int max_nodes = static_cast<int>(sizeof(unsigned long) * 8);
+  unsigned long node_mask = 0;
+  int mode;
+  if (numa_policy == NumaPolicy::INTERLEAVE) {
+    mode = MPOL_MODE_INTERLEAVE;
+    for (int node = 0; node < node_count && node < max_nodes; ++node)
+      node_mask |= 1UL << node;
+  } else {
+    if (numa_node < 0 || numa_node >= node_count || numa_node >= max_nodes)
+      return false;
+    mode = MPOL_MODE_BIND;
+    node_mask = 1UL << numa_node;
+  }
+  return syscall(SYS_mbind, data_, data_size_, mode, &node_mask,
+                 static_cast<unsigned long>(max_nodes), 0) == 0;
+#else
+  return false;
+#endif
+}
+
+/*
+ * Parse the online node list of sysfs, e.g. "0" or "0-3" or "0,2-3", and
+ * return the highest node id plus one.
+ */
+int FrameArena::GetNumaNodeCount() {
+  static const int node_count = []() {
+    std::ifstream online("/sys/devices/system/node/online");
+    std::string list;
+    if (!online || !std::getline(online, list))
+      return 1;
+    int count = 1;
+    std::stringstream ranges(list);
+    std::string range;
+    while (std::getline(ranges, range, ',')) {
+      size_t dash = range.find('-');
+      std::string last = dash == std::string::npos ? range
+                                                   : range.substr(dash + 1);
+      try {
+        count = std::max(count, std::stoi(last) + 1);
+      } catch (const std::exception &) {
+        return 1;
+      }
+    }
+    return count;
+  }();
+  return node_count;
+}
+
+} // namespace cmudb
@@ -0,0 +1,141 @@
+/**
+ * LRU-K implementation
+ */
+#include <cassert>
+
+#include "buffer/lru_k_replacer.h"
+#include "page/page.h"
+
+namespace cmudb {
+
+template <typename T>
+LRUKReplacer<T>::LRUKReplacer(size_t num_frames, size_t k, T base)
+    : num_frames_(num_frames), k_(k), base_(base), current_timestamp_(0),
+      size_(0) {
+  assert(k_ > 0);
+  history_ = new uint64_t[num_frames_ * k_];
+  history_count_ = new size_t[num_frames_];
+  history_head_ = new size_t[num_frames_];
+  evictable_ = new bool[num_frames_];
+  for (size_t i = 0; i < num_frames_; ++i) {
+    history_count_[i] = 0;
+    history_head_[i] = 0;
+    evictable_[i] = false;
+  }
+}
+
+template <typename T> LRUKReplacer<T>::~LRUKReplacer() {
+  delete[] history_;
+  delete[] history_count_;
+  delete[] history_head_;
+  delete[] evictable_;
+}
+
+/*
+ * Append the current timestamp to the frame's history, dropping the oldest
+ * one once k are kept
+ */
+template <typename T>
+void LRUKReplacer<T>::RecordAccess(const T &value, bool reset) {
+  size_t frame_id = FrameId(value);
+  assert(frame_id < num_frames_);
+  std::lock_guard<std::mutex> guard(latch_);
+
+  if (reset) {
+    history_count_[frame_id] = 0;
+    history_head_[frame_id] = 0;
+  }
+  history_[frame_id * k_ + history_head_[frame_id]] = current_timestamp_++;
+  history_head_[frame_id] = (history_head_[frame_id] + 1) % k_;
+  if (history_count_[frame_id] < k_)
+    history_count_[frame_id]++;
+}
+
+/*
+ * Make value a replacement candidate (its pin count dropped to zero)
+ */
+template <typename T> void LRUKReplacer<T>::Insert(const T &value) {
+  size_t frame_id = FrameId(value);
+  assert(frame_id < num_frames_);
+  std::lock_guard<std::mutex> guard(latch_);
+
+  if (!evictable_[frame_id]) {
+    evictable_[frame_id] = true;
+    size_++;
+  }
+}
+
+/*
+ * Evict the candidate with the largest backward k-distance. Candidates with
+ * less than k accesses (infinite distance) come first; ties are broken by
+ * the oldest remembered access, which also orders the finite distances.
+ * The victim's history is dropped.
+ */
+template <typename T> bool LRUKReplacer<T>::Victim(T &value) {
+  std::lock_guard<std::mutex> guard(latch_);
+  bool found = false;
+  bool victim_infinite = false;
+  uint64_t victim_timestamp = 0;
+  size_t victim_id = 0;
+
+  for (size_t i = 0; i < num_frames_; ++i) {
+    if (!evictable_[i])
+      continue;
+    bool infinite = history_count_[i] < k_;
+    // oldest remembered access: slot 0 until the ring wraps, then the head
+    uint64_t timestamp = 0;
+    if (history_count_[i] > 0)
+      timestamp = history_[i * k_ + (infinite ? 0 : history_head_[i])];
+
+    if (!found || (infinite && !victim_infinite) ||
+        (infinite == victim_infinite && timestamp < victim_timestamp)) {
+      found = true;
+      victim_infinite = infinite;
+      victim_timestamp = timestamp;
+      victim_id = i;
+    }
+  }
+  if (!found)
+    return false;
+
+  evictable_[victim_id] = false;
+  history_count_[victim_id] = 0;
+  history_head_[victim_id] = 0;
+  size_--;
+  value = base_ + victim_id;
+  return true;
+}
+
+/*
+ * Remove value from the candidates (it got pinned). The access history is
+ * kept. If removal is successful, return true, otherwise return false
+ */
+template <typename T> bool LRUKReplacer<T>::Erase(const T &value) {
+  size_t frame_id = FrameId(value);
+  assert(frame_id < num_frames_);
+  std::lock_guard<std::mutex> guard(latch_);
+
+  if (!evictable_[frame_id])
+    return false;
+  evictable_[frame_id] = false;
+  size_--;
+  return true;
+}
+
+template <typename T> size_t LRUKReplacer<T>::Size() {
+  std::lock_guard<std::mutex> guard(latch_);
+  return size_;
+}
+
+template <typename T> bool LRUKReplacer<T>::Contains(const T &value) {
+  size_t frame_id = FrameId(value);
+  assert(frame_id < num_frames_);
+  std::lock_guard<std::mutex> guard(latch_);
+  return evictable_[frame_id];
+}
+
+template class LRUKReplacer<Page *>;
+// test only
+template class LRUKReplacer<int>;
+
+} // namespace cmudb
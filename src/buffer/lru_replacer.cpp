@@ -101,6 +101,19 @@ template <typename T> size_t LRUReplacer<T>::Size() {
   return node_count;
 }
 
+/*
+ * Return true if value is in the LRU
+ */
+template <typename T> bool LRUReplacer<T>::Contains(const T &value) {
+  typename std::list<T>::iterator lst_it;
+
+  list_mutex.lock();
+    const bool result = exthash->Find(value, lst_it);
+  list_mutex.unlock();
+
+  return result;
+}
+
 template class LRUReplacer<Page *>;
 // test only
 template class LRUReplacer<int>;
@@ -0,0 +1,126 @@
+/**
+ * mmap_buffer_pool_manager.cpp
+ */
+
+#include <cstdlib>
+#include <new>
+
+#include "buffer/mmap_buffer_pool_manager.h"
+
+namespace cmudb {
+
+/*
+ * MmapBufferPoolManager Constructor
+ * A pool of no frames: the base class starts no flusher or prefetcher.
+ */
+MmapBufferPoolManager::MmapBufferPoolManager(MmapDiskManager *disk_manager)
+    : BufferPoolManager(0, disk_manager), mmap_disk_manager_(disk_manager),
+      page_count_(disk_manager->GetPageCount()),
+      chunk_count_((page_count_ + PAGES_PER_CHUNK - 1) / PAGES_PER_CHUNK),
+      chunks_(new std::atomic<Page *>[chunk_count_]) {
+  for (size_t i = 0; i < chunk_count_; ++i)
+    chunks_[i] = nullptr;
+}
+
+MmapBufferPoolManager::~MmapBufferPoolManager() {
+  for (size_t i = 0; i < chunk_count_; ++i) {
+    Page *chunk = chunks_[i].load();
+    if (chunk == nullptr)
+      continue;
+    for (page_id_t j = 0; j < PAGES_PER_CHUNK; ++j)
+      chunk[j].~Page();
+    free(chunk);
+  }
+  delete[] chunks_;
+}
+
+/*
+ * The first fetch of a page checks its checksum (see MmapDiskManager), and
+ * throws before anything is pinned if it does not match.
+ */
+Page *MmapBufferPoolManager::FetchPage(page_id_t page_id) {
+  if (page_id < 0 || page_id >= page_count_)
+    return nullptr;
+  mmap_disk_manager_->GetPageData(page_id);
+  Page *page = GetDescriptor(page_id);
+  page->pin_count_.fetch_add(1);
+  return page;
+}
+
+bool MmapBufferPoolManager::UnpinPage(page_id_t page_id, bool is_dirty) {
+  if (page_id < 0 || page_id >= page_count_)
+    return false;
+  Page *page = GetDescriptor(page_id);
+  int pin_count = page->pin_count_.load();
+  do {
+    if (pin_count <= 0)
+      return false;
+  } while (!page->pin_count_.compare_exchange_weak(pin_count, pin_count - 1));
+  return true;
+}
+
+bool MmapBufferPoolManager::FlushPage(page_id_t page_id) { return false; }
+
+void MmapBufferPoolManager::FlushAllPages() {}
+
+Page *MmapBufferPoolManager::NewPage(page_id_t &page_id,
+                                     segment_id_t segment_id) {
+  page_id = INVALID_PAGE_ID;
+  return nullptr;
+}
+
+bool MmapBufferPoolManager::DeletePage(page_id_t page_id) { return false; }
+
+bool MmapBufferPoolManager::PrefetchPage(page_id_t page_id) {
+  if (page_id < 0 || page_id >= page_count_)
+    return false;
+  mmap_disk_manager_->WillNeed(page_id, 1);
+  return true;
+}
+
+/*
+ * One hint for the whole window rather than one per page
+ */
+void MmapBufferPoolManager::PrefetchRange(page_id_t first_page_id,
+                                          size_t count) {
+  mmap_disk_manager_->WillNeed(first_page_id, count);
+}
+
+/*
+ * Chunks are published with a compare and swap, a thread that loses the
+ * race drops the chunk it built and uses the winner's.
+ */
+Page *MmapBufferPoolManager::GetDescriptor(page_id_t page_id) {
+  std::atomic<Page *> &slot = chunks_[page_id / PAGES_PER_CHUNK];
+  Page *chunk = slot.load(std::memory_order_acquire);
+  if (chunk == nullptr) {
+    void *memory = nullptr;
+    if (posix_memalign(&memory, CACHELINE_SIZE,
+                       PAGES_PER_CHUNK * sizeof(Page)) != 0)
+      throw std::bad_alloc();
+    Page *new_chunk = static_cast<Page *>(memory);
+    const page_id_t first_page_id =
+        page_id / PAGES_PER_CHUNK * PAGES_PER_CHUNK;
+    const size_t page_size = GetPageSize();
+    char *mapping = const_cast<char *>(mmap_disk_manager_->GetMapping());
+    for (page_id_t i = 0; i < PAGES_PER_CHUNK; ++i) {
+      new (&new_chunk[i]) Page();
+      new_chunk[i].page_id_ = first_page_id + i;
+      new_chunk[i].page_size_ = page_size;
+      // pages past the end of the file are never handed out
+      if (first_page_id + i < page_count_)
+        new_chunk[i].data_ = mapping + (first_page_id + i) * page_size;
+    }
+    if (slot.compare_exchange_strong(chunk, new_chunk,
+                                     std::memory_order_acq_rel)) {
+      chunk = new_chunk;
+    } else {
+      for (page_id_t i = 0; i < PAGES_PER_CHUNK; ++i)
+        new_chunk[i].~Page();
+      free(new_chunk);
+    }
+  }
+  return &chunk[page_id % PAGES_PER_CHUNK];
+}
+
+} // namespace cmudb
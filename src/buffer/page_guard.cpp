@@ -0,0 +1,61 @@
+/**
+ * page_guard.cpp
+ */
+
+#include "buffer/page_guard.h"
+#include "buffer/buffer_pool_manager.h"
+
+namespace cmudb {
+
+ReadPageGuard::ReadPageGuard(ReadPageGuard &&that)
+    : buffer_pool_manager_(that.buffer_pool_manager_), page_(that.page_) {
+  that.page_ = nullptr;
+}
+
+ReadPageGuard &ReadPageGuard::operator=(ReadPageGuard &&that) {
+  if (this != &that) {
+    Drop();
+    buffer_pool_manager_ = that.buffer_pool_manager_;
+    page_ = that.page_;
+    that.page_ = nullptr;
+  }
+  return *this;
+}
+
+void ReadPageGuard::Drop() {
+  if (page_ == nullptr)
+    return;
+  page_->RUnlatch();
+  buffer_pool_manager_->UnpinPage(page_->GetPageId(), false);
+  page_ = nullptr;
+}
+
+WritePageGuard::WritePageGuard(WritePageGuard &&that)
+    : buffer_pool_manager_(that.buffer_pool_manager_), page_(that.page_),
+      is_dirty_(that.is_dirty_) {
+  that.page_ = nullptr;
+  that.is_dirty_ = false;
+}
+
+WritePageGuard &WritePageGuard::operator=(WritePageGuard &&that) {
+  if (this != &that) {
+    Drop();
+    buffer_pool_manager_ = that.buffer_pool_manager_;
+    page_ = that.page_;
+    is_dirty_ = that.is_dirty_;
+    that.page_ = nullptr;
+    that.is_dirty_ = false;
+  }
+  return *this;
+}
+
+void WritePageGuard::Drop() {
+  if (page_ == nullptr)
+    return;
+  page_->WUnlatch();
+  buffer_pool_manager_->UnpinPage(page_->GetPageId(), is_dirty_);
+  page_ = nullptr;
+  is_dirty_ = false;
+}
+
+} // namespace cmudb
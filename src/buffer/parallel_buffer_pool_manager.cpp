@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <cassert>
+
+#include "buffer/parallel_buffer_pool_manager.h"
+#include "common/exception.h"
+
+namespace cmudb {
+
+/*
+ * ParallelBufferPoolManager Constructor
+ * The base buffer pool is created empty; all frames live in the instances.
+ * All instances share one disk manager, so page ids stay globally unique.
+ * With NumaPolicy::BIND the instances are bound round robin to the NUMA
+ * nodes, instance i to node i % nodes.
+ */
+ParallelBufferPoolManager::ParallelBufferPoolManager(size_t num_instances,
+                                                     size_t pool_size,
+                                                     DiskManager *disk_manager,
+                                                     LogManager *log_manager,
+                                                     ReplacerType replacer_type,
+                                                     NumaPolicy numa_policy)
+    : BufferPoolManager(0, disk_manager, log_manager),
+      instance_pool_size_(pool_size) {
+  assert(num_instances > 0);
+  const int node_count = FrameArena::GetNumaNodeCount();
+  for (size_t i = 0; i < num_instances; ++i) {
+    instances_.push_back(
+        new BufferPoolManager(pool_size, disk_manager, log_manager,
+                              replacer_type, numa_policy,
+                              static_cast<int>(i % node_count)));
+  }
+}
+
+/*
+ * ParallelBufferPoolManager Deconstructor
+ * Every instance flushes its own dirty pages when deleted.
+ */
+ParallelBufferPoolManager::~ParallelBufferPoolManager() {
+  for (auto instance : instances_)
+    delete instance;
+}
+
+BufferPoolManager *ParallelBufferPoolManager::GetInstance(page_id_t page_id) {
+  return instances_[static_cast<size_t>(page_id) % instances_.size()];
+}
+
+Page *ParallelBufferPoolManager::FetchPage(page_id_t page_id) {
+  return GetInstance(page_id)->FetchPage(page_id);
+}
+
+bool ParallelBufferPoolManager::UnpinPage(page_id_t page_id, bool is_dirty) {
+  return GetInstance(page_id)->UnpinPage(page_id, is_dirty);
+}
+
+bool ParallelBufferPoolManager::FlushPage(page_id_t page_id) {
+  return GetInstance(page_id)->FlushPage(page_id);
+}
+
+void ParallelBufferPoolManager::FlushAllPages() {
+  for (auto instance : instances_)
+    instance->FlushAllPages();
+}
+
+/*
+ * The page id decides which instance holds the page, so allocate it first
+ * and then claim a frame in that instance. If every frame of the instance is
+ * pinned, try the next id the disk manager hands out, up to as many ids as
+ * there are instances. The ids that found no frame are held meanwhile (a
+ * freed id may be handed out again at once) and given back after.
+ * return nullptr if none found a frame
+ */
+Page *ParallelBufferPoolManager::NewPage(page_id_t &page_id,
+                                         segment_id_t segment_id) {
+  // ids allocated but not (yet) holding a page, and the full instances
+  std::vector<page_id_t> spare_ids;
+  std::vector<BufferPoolManager *> full_instances;
+  Page *new_page = nullptr;
+  try {
+    while (new_page == nullptr && spare_ids.size() < instances_.size()) {
+      spare_ids.push_back(disk_manager_->AllocatePage(segment_id));
+      BufferPoolManager *instance = GetInstance(spare_ids.back());
+      if (std::find(full_instances.begin(), full_instances.end(), instance) !=
+          full_instances.end())
+        continue;
+      new_page = instance->NewPageWithId(spare_ids.back());
+      if (new_page == nullptr)
+        full_instances.push_back(instance);
+    }
+  } catch (Exception &) {
+    for (auto id : spare_ids)
+      disk_manager_->DeallocatePage(id);
+    throw;
+  }
+  if (new_page != nullptr) {
+    page_id = spare_ids.back();
+    spare_ids.pop_back();
+  }
+  for (auto id : spare_ids)
+    disk_manager_->DeallocatePage(id);
+  return new_page;
+}
+
+bool ParallelBufferPoolManager::DeletePage(page_id_t page_id) {
+  return GetInstance(page_id)->DeletePage(page_id);
+}
+
+bool ParallelBufferPoolManager::PrefetchPage(page_id_t page_id) {
+  return GetInstance(page_id)->PrefetchPage(page_id);
+}
+
+void ParallelBufferPoolManager::SetDirtyWatermarks(double low, double high) {
+  for (auto instance : instances_)
+    instance->SetDirtyWatermarks(low, high);
+}
+
+double ParallelBufferPoolManager::GetDirtyRatio() {
+  size_t dirty_count = 0;
+  for (auto instance : instances_)
+    dirty_count += instance->dirty_count_;
+  return GetPoolSize() == 0 ? 0
+                            : static_cast<double>(dirty_count) / GetPoolSize();
+}
+
+uint64_t ParallelBufferPoolManager::GetFlushedPageCount() {
+  uint64_t flushed_page_count = 0;
+  for (auto instance : instances_)
+    flushed_page_count += instance->GetFlushedPageCount();
+  return flushed_page_count;
+}
+
+double ParallelBufferPoolManager::GetFlushRate() {
+  double flush_rate = 0;
+  for (auto instance : instances_)
+    flush_rate += instance->GetFlushRate();
+  return flush_rate;
+}
+
+} // namespace cmudb
@@ -0,0 +1,34 @@
+/**
+ * read_ahead.cpp
+ */
+
+#include <algorithm>
+
+#include "buffer/read_ahead.h"
+
+namespace cmudb {
+
+ReadAhead::ReadAhead(BufferPoolManager *buffer_pool_manager, size_t window)
+    : buffer_pool_manager_(buffer_pool_manager),
+      window_(static_cast<page_id_t>(window)), last_page_id_(INVALID_PAGE_ID),
+      prefetched_until_(INVALID_PAGE_ID) {}
+
+void ReadAhead::Access(page_id_t page_id) {
+  const bool sequential =
+      last_page_id_ != INVALID_PAGE_ID && page_id == last_page_id_ + 1;
+  last_page_id_ = page_id;
+  if (!sequential || window_ == 0) {
+    prefetched_until_ = page_id;
+    return;
+  }
+
+  // top the window up once the scan has consumed half of it
+  if (prefetched_until_ - page_id > window_ / 2)
+    return;
+  page_id_t first_page_id = std::max(prefetched_until_, page_id) + 1;
+  prefetched_until_ = page_id + window_;
+  buffer_pool_manager_->PrefetchRange(first_page_id,
+                                      prefetched_until_ - first_page_id + 1);
+}
+
+} // namespace cmudb
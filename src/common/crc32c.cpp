@@ -0,0 +1,60 @@
+/**
+ * crc32c.cpp
+ */
+#include <cstring>
+
+#ifdef __SSE4_2__
+#include <nmmintrin.h>
+#endif
+
+#include "common/crc32c.h"
+
+namespace cmudb {
+
+#ifdef __SSE4_2__
+
+uint32_t Crc32c(const char *data, size_t size) {
+  uint64_t crc = 0xffffffff;
+  for (; size >= 8; size -= 8, data += 8) {
+    uint64_t word;
+    memcpy(&word, data, sizeof(word));
+    crc = _mm_crc32_u64(crc, word);
+  }
+  uint32_t crc32 = static_cast<uint32_t>(crc);
+  for (; size > 0; --size, ++data)
+    crc32 = _mm_crc32_u8(crc32, static_cast<uint8_t>(*data));
+  return ~crc32;
+}
+
+bool Crc32cIsHardware() { return true; }
+
+#else
+
+// reflected polynomial 0x1EDC6F41
+static const uint32_t CRC32C_POLY = 0x82f63b78;
+
+struct Crc32cTable {
+  Crc32cTable() {
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t crc = i;
+      for (int bit = 0; bit < 8; ++bit)
+        crc = (crc >> 1) ^ (crc & 1 ? CRC32C_POLY : 0);
+      entries[i] = crc;
+    }
+  }
+  uint32_t entries[256];
+};
+
+uint32_t Crc32c(const char *data, size_t size) {
+  static const Crc32cTable table;
+  uint32_t crc = 0xffffffff;
+  for (; size > 0; --size, ++data)
+    crc = table.entries[(crc ^ static_cast<uint8_t>(*data)) & 0xff] ^ (crc >> 8);
+  return ~crc;
+}
+
+bool Crc32cIsHardware() { return false; }
+
+#endif
+
+} // namespace cmudb
@@ -0,0 +1,83 @@
+/**
+ * latency_histogram.cpp
+ */
+#include <chrono>
+
+#include "common/latency_histogram.h"
+
+namespace cmudb {
+
+LatencyHistogram::LatencyHistogram() { Reset(); }
+
+void LatencyHistogram::Record(uint64_t value) {
+  buckets_[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value, std::memory_order_relaxed);
+  uint64_t max = max_.load(std::memory_order_relaxed);
+  while (value > max &&
+         !max_.compare_exchange_weak(max, value, std::memory_order_relaxed))
+    ;
+}
+
+/**
+ * Not atomic as a whole: values recorded during a reset may be partly kept
+ */
+void LatencyHistogram::Reset() {
+  for (size_t i = 0; i < BUCKET_COUNT; ++i)
+    buckets_[i].store(0, std::memory_order_relaxed);
+  count_ = 0;
+  sum_ = 0;
+  max_ = 0;
+}
+
+uint64_t LatencyHistogram::GetPercentile(double percentile) const {
+  uint64_t count = 0;
+  for (size_t i = 0; i < BUCKET_COUNT; ++i)
+    count += buckets_[i].load(std::memory_order_relaxed);
+  if (count == 0)
+    return 0;
+  // rank of the value asked for, at least the first one
+  uint64_t rank = static_cast<uint64_t>(percentile * count + 0.5);
+  if (rank == 0)
+    rank = 1;
+  uint64_t seen = 0;
+  for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+    seen += buckets_[i].load(std::memory_order_relaxed);
+    if (seen >= rank) {
+      uint64_t bound = BucketUpperBound(i);
+      uint64_t max = max_.load(std::memory_order_relaxed);
+      return bound < max ? bound : max;
+    }
+  }
+  return max_.load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::NowNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/**
+ * Values below SUB_BUCKETS map to themselves. Larger ones are placed by
+ * their highest set bit and the SUB_BUCKET_BITS bits below it.
+ */
+size_t LatencyHistogram::BucketIndex(uint64_t value) {
+  if (value < SUB_BUCKETS)
+    return static_cast<size_t>(value);
+  int msb = 63 - __builtin_clzll(value);
+  int shift = msb - SUB_BUCKET_BITS;
+  uint64_t sub_bucket = (value >> shift) & (SUB_BUCKETS - 1);
+  return static_cast<size_t>((shift + 1) * SUB_BUCKETS + sub_bucket);
+}
+
+uint64_t LatencyHistogram::BucketUpperBound(size_t index) {
+  if (index < SUB_BUCKETS)
+    return index;
+  int shift = static_cast<int>(index / SUB_BUCKETS) - 1;
+  uint64_t sub_bucket = index % SUB_BUCKETS;
+  uint64_t lower = (SUB_BUCKETS + sub_bucket) << shift;
+  return lower + ((uint64_t(1) << shift) - 1);
+}
+
+} // namespace cmudb
@@ -0,0 +1,182 @@
+/**
+ * lz4.cpp
+ */
+#include <cstring>
+
+#include "common/lz4.h"
+
+namespace cmudb {
+
+static const size_t MIN_MATCH = 4;
+// a match starts at least this far before the end of the block, and the
+// last LAST_LITERALS bytes are always literals
+static const size_t MATCH_FIND_LIMIT = 12;
+static const size_t LAST_LITERALS = 5;
+static const size_t MAX_OFFSET = 65535;
+static const int HASH_LOG = 12;
+// misses in a row before the search starts skipping ahead, so input that
+// does not compress is given up on quickly
+static const int SKIP_TRIGGER = 6;
+
+static inline uint32_t Read32(const uint8_t *p) {
+  uint32_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+static inline uint32_t Hash(uint32_t sequence) {
+  return (sequence * 2654435761U) >> (32 - HASH_LOG);
+}
+
+// bytes a length of at least 15 takes after its token
+static inline size_t LengthBytes(size_t length) {
+  return length < 15 ? 0 : (length - 15) / 255 + 1;
+}
+
+static inline uint8_t *WriteLength(uint8_t *out, size_t length) {
+  for (length -= 15; length >= 255; length -= 255)
+    *out++ = 255;
+  *out++ = static_cast<uint8_t>(length);
+  return out;
+}
+
+/**
+ * Greedy: each position is looked up in a hash table of the last position
+ * a 4 byte sequence was seen at, and a match is taken as soon as found.
+ */
+size_t Lz4Compress(const char *src, size_t size, char *dst, size_t capacity) {
+  const uint8_t *in = reinterpret_cast<const uint8_t *>(src);
+  uint8_t *out = reinterpret_cast<uint8_t *>(dst);
+  const uint8_t *out_end = out + capacity;
+  size_t anchor = 0;
+
+  if (size > MATCH_FIND_LIMIT) {
+    uint32_t table[1 << HASH_LOG];
+    memset(table, 0xff, sizeof(table));
+    const size_t match_start_limit = size - MATCH_FIND_LIMIT;
+    const size_t match_end_limit = size - LAST_LITERALS;
+    size_t pos = 0;
+    unsigned misses = 0;
+    while (pos <= match_start_limit) {
+      uint32_t sequence = Read32(in + pos);
+      uint32_t &entry = table[Hash(sequence)];
+      size_t candidate = entry;
+      entry = static_cast<uint32_t>(pos);
+      if (candidate == 0xffffffff || pos - candidate > MAX_OFFSET ||
+          Read32(in + candidate) != sequence) {
+        pos += 1 + (misses++ >> SKIP_TRIGGER);
+        continue;
+      }
+      misses = 0;
+
+      size_t match_length = MIN_MATCH;
+      while (pos + match_length < match_end_limit &&
+             in[candidate + match_length] == in[pos + match_length])
+        ++match_length;
+
+      size_t literals = pos - anchor;
+      size_t length = match_length - MIN_MATCH;
+      if (out + 1 + LengthBytes(literals) + literals + 2 +
+              LengthBytes(length) >
+          out_end)
+        return 0;
+      uint8_t *token = out++;
+      *token = static_cast<uint8_t>((literals < 15 ? literals : 15) << 4 |
+                                    (length < 15 ? length : 15));
+      if (literals >= 15)
+        out = WriteLength(out, literals);
+      memcpy(out, in + anchor, literals);
+      out += literals;
+      size_t offset = pos - candidate;
+      *out++ = static_cast<uint8_t>(offset);
+      *out++ = static_cast<uint8_t>(offset >> 8);
+      if (length >= 15)
+        out = WriteLength(out, length);
+
+      pos += match_length;
+      anchor = pos;
+    }
+  }
+
+  // the rest goes out as literals
+  size_t literals = size - anchor;
+  if (out + 1 + LengthBytes(literals) + literals > out_end)
+    return 0;
+  *out++ = static_cast<uint8_t>((literals < 15 ? literals : 15) << 4);
+  if (literals >= 15)
+    out = WriteLength(out, literals);
+  if (literals > 0)
+    memcpy(out, in + anchor, literals);
+  out += literals;
+  return out - reinterpret_cast<uint8_t *>(dst);
+}
+
+/**
+ * Every length and offset is checked against what is left of the input
+ * and the output, so a damaged block fails rather than reading or writing
+ * out of bounds.
+ */
+int64_t Lz4Decompress(const char *src, size_t length, char *dst,
+                      size_t capacity) {
+  const uint8_t *in = reinterpret_cast<const uint8_t *>(src);
+  const uint8_t *in_end = in + length;
+  uint8_t *out = reinterpret_cast<uint8_t *>(dst);
+  uint8_t *out_begin = out;
+  uint8_t *out_end = out + capacity;
+
+  while (in < in_end) {
+    uint8_t token = *in++;
+    size_t literals = token >> 4;
+    if (literals == 15) {
+      uint8_t byte;
+      do {
+        if (in == in_end)
+          return -1;
+        byte = *in++;
+        literals += byte;
+      } while (byte == 255);
+    }
+    if (literals > static_cast<size_t>(in_end - in) ||
+        literals > static_cast<size_t>(out_end - out))
+      return -1;
+    memcpy(out, in, literals);
+    in += literals;
+    out += literals;
+    // the last sequence ends the block after its literals
+    if (in == in_end)
+      return out - out_begin;
+
+    if (in_end - in < 2)
+      return -1;
+    size_t offset = in[0] | static_cast<size_t>(in[1]) << 8;
+    in += 2;
+    if (offset == 0 || offset > static_cast<size_t>(out - out_begin))
+      return -1;
+    size_t match_length = token & 15;
+    if (match_length == 15) {
+      uint8_t byte;
+      do {
+        if (in == in_end)
+          return -1;
+        byte = *in++;
+        match_length += byte;
+      } while (byte == 255);
+    }
+    match_length += MIN_MATCH;
+    if (match_length > static_cast<size_t>(out_end - out))
+      return -1;
+    // the match may overlap what it writes (a run), copy forwards
+    const uint8_t *match = out - offset;
+    if (offset >= match_length) {
+      memcpy(out, match, match_length);
+      out += match_length;
+    } else {
+      for (size_t i = 0; i < match_length; ++i)
+        *out++ = *match++;
+    }
+  }
+  // an empty input is not a block, a block ends with literals
+  return -1;
+}
+
+} // namespace cmudb
@@ -0,0 +1,379 @@
+/**
+ * compressed_disk_manager.cpp
+ */
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "common/exception.h"
+#include "common/logger.h"
+#include "common/lz4.h"
+#include "disk/compressed_disk_manager.h"
+
+namespace cmudb {
+
+static const uint32_t PIM_MAGIC = 0x314d4950; // "PIM1"
+static const off_t PIM_HEADER_SIZE = 16;
+
+struct PageIndirectionMapHeader {
+  uint32_t magic;
+  uint32_t page_size;
+};
+
+static bool WriteFully(int fd, const void *data, size_t size, off_t offset) {
+  const char *buf = static_cast<const char *>(data);
+  size_t written = 0;
+  while (written < size) {
+    ssize_t ret = pwrite(fd, buf + written, size - written, offset + written);
+    if (ret < 0 && errno == EINTR)
+      continue;
+    if (ret <= 0)
+      return false;
+    written += ret;
+  }
+  return true;
+}
+
+static size_t ReadFully(int fd, void *data, size_t size, off_t offset) {
+  char *buf = static_cast<char *>(data);
+  size_t read_count = 0;
+  while (read_count < size) {
+    ssize_t ret = pread(fd, buf + read_count, size - read_count,
+                        offset + read_count);
+    if (ret < 0 && errno == EINTR)
+      continue;
+    if (ret <= 0)
+      break;
+    read_count += ret;
+  }
+  return read_count;
+}
+
+/**
+ * Constructor: DiskManager opens the files, settles the page size and
+ * refuses a plain database, then the db file is opened once more for the
+ * slots and the map is loaded
+ */
+CompressedDiskManager::CompressedDiskManager(const std::string &db_file,
+                                             size_t page_size)
+    : DiskManager(db_file, page_size, false, DB_FORMAT_COMPRESSED),
+      db_fd_(-1), map_fd_(-1),
+      slot_unit_(std::max<size_t>(GetPageSize() / COMPRESSION_SIZE_CLASSES,
+                                  1)),
+      free_slots_((GetPageSize() + slot_unit_ - 1) / slot_unit_ + 1),
+      file_end_(DB_FILE_HEADER_SIZE) {
+  db_fd_ = open(db_file.c_str(), O_RDWR);
+  if (db_fd_ < 0) {
+    LOG_DEBUG("can not open db file for compressed pages");
+  }
+  std::string::size_type n = db_file.find(".");
+  std::string map_name = db_file.substr(0, n) + ".pim";
+  map_fd_ = open(map_name.c_str(), O_RDWR | O_CREAT, 0644);
+  if (map_fd_ < 0) {
+    LOG_DEBUG("can not open page indirection map file");
+  }
+  if (!LoadMap()) {
+    close(db_fd_);
+    close(map_fd_);
+    throw Exception(EXCEPTION_TYPE_IO,
+                    map_name + " does not match the pages of " + db_file);
+  }
+}
+
+CompressedDiskManager::~CompressedDiskManager() {
+  if (db_fd_ >= 0)
+    close(db_fd_);
+  if (map_fd_ >= 0)
+    close(map_fd_);
+}
+
+/**
+ * Pick up the slots of an existing database, and work out which parts of
+ * the db file between them are free. A new db file (nothing behind its
+ * header) starts with an empty map. Without the map the pages of an
+ * existing one can not be found: false if it is missing or of another
+ * database, rather than starting over with an empty one.
+ */
+bool CompressedDiskManager::LoadMap() {
+  if (map_fd_ < 0 || db_fd_ < 0)
+    return true;
+  PageIndirectionMapHeader header;
+  bool has_pages = lseek(db_fd_, 0, SEEK_END) > DB_FILE_HEADER_SIZE;
+  bool valid = ReadFully(map_fd_, &header, sizeof(header), 0) ==
+                   sizeof(header) &&
+               header.magic == PIM_MAGIC && header.page_size == GetPageSize();
+  if (has_pages && !valid)
+    return false;
+  if (!has_pages) {
+    if (ftruncate(map_fd_, 0) != 0) {
+      LOG_DEBUG("can not reset page indirection map file");
+    }
+    header.magic = PIM_MAGIC;
+    header.page_size = static_cast<uint32_t>(GetPageSize());
+    if (!WriteFully(map_fd_, &header, sizeof(header), 0)) {
+      LOG_DEBUG("I/O error while writing page indirection map");
+    }
+    return true;
+  }
+
+  Slot slot;
+  while (ReadFully(map_fd_, &slot, sizeof(slot),
+                   PIM_HEADER_SIZE + slots_.size() * sizeof(Slot)) ==
+         sizeof(slot))
+    slots_.push_back(slot);
+
+  // the gaps between used slots are free, cut into the largest slots
+  std::vector<std::pair<int64_t, uint32_t>> used;
+  for (auto &slot : slots_)
+    if (slot.length > 0)
+      used.emplace_back(slot.offset, slot.size);
+  std::sort(used.begin(), used.end());
+  const int64_t max_size = slot_unit_ * COMPRESSION_SIZE_CLASSES;
+  for (auto &extent : used) {
+    while (extent.first - file_end_ >= static_cast<int64_t>(slot_unit_)) {
+      int64_t size = std::min(max_size, (extent.first - file_end_) /
+                                            static_cast<int64_t>(slot_unit_) *
+                                            static_cast<int64_t>(slot_unit_));
+      free_slots_[size / slot_unit_].push_back(file_end_);
+      file_end_ += size;
+    }
+    file_end_ = std::max(file_end_, extent.first + extent.second);
+  }
+  return true;
+}
+
+void CompressedDiskManager::PersistSlot(page_id_t page_id) {
+  if (map_fd_ < 0)
+    return;
+  if (!WriteFully(map_fd_, &slots_[page_id], sizeof(Slot),
+                  PIM_HEADER_SIZE + page_id * sizeof(Slot))) {
+    LOG_DEBUG("I/O error while writing page indirection map");
+  }
+}
+
+int64_t CompressedDiskManager::AllocateSlot(uint32_t size) {
+  std::vector<int64_t> &free_slots = free_slots_[size / slot_unit_];
+  if (!free_slots.empty()) {
+    int64_t offset = free_slots.back();
+    free_slots.pop_back();
+    return offset;
+  }
+  int64_t offset = file_end_;
+  file_end_ += size;
+  return offset;
+}
+
+/**
+ * A page that moved to another slot is synced right away, so the slot it
+ * left can be reused
+ */
+void CompressedDiskManager::WritePage(page_id_t page_id,
+                                      const char *page_data) {
+  if (IsReadOnly())
+    throw Exception(EXCEPTION_TYPE_IO, "write to a read only database");
+  WriteCompressed(page_id, page_data);
+  bool moved;
+  {
+    std::lock_guard<std::mutex> guard(latch_);
+    moved = !moved_slots_.empty();
+  }
+  if (moved)
+    Sync();
+}
+
+/**
+ * Until the map entry of a moved page is on disk, the map on disk may
+ * still point at the slot it left; a later write must not reuse that slot
+ * before then. Only the slots left before the sync started are freed.
+ */
+void CompressedDiskManager::Sync() {
+  std::vector<Slot> moved_slots;
+  {
+    std::lock_guard<std::mutex> guard(latch_);
+    moved_slots.swap(moved_slots_);
+  }
+  uint64_t start = LatencyHistogram::NowNanos();
+  if (fdatasync(db_fd_) != 0 || fdatasync(map_fd_) != 0) {
+    LOG_DEBUG("I/O error while syncing");
+  }
+  SyncFreeSpaceMap();
+  RecordIo(IO_SYNC, start, 0);
+  std::lock_guard<std::mutex> guard(latch_);
+  for (auto &slot : moved_slots)
+    free_slots_[slot.size / slot_unit_].push_back(slot.offset);
+}
+
+/**
+ * The checksum is taken over the uncompressed page, so it covers the
+ * compression as well; it is stamped on a copy, page_data may be read
+ * latched only. The page data goes out before the map points at it; if
+ * it cannot, the map is left alone and the write throws.
+ */
+void CompressedDiskManager::WriteCompressed(page_id_t page_id,
+                                            const char *page_data) {
+  if (page_id < 0)
+    return;
+  const size_t page_size = GetPageSize();
+  std::vector<char> page(page_data, page_data + page_size);
+  StampChecksum(page.data());
+  std::vector<char> buffer(page_size);
+  // no point in a compressed page that takes the largest slot anyway
+  uint32_t length = static_cast<uint32_t>(
+      Compress(page.data(), page_size, buffer.data(), page_size - slot_unit_));
+  const char *data = buffer.data();
+  if (length == 0) {
+    length = static_cast<uint32_t>(page_size);
+    data = page.data();
+  }
+  const uint32_t size = static_cast<uint32_t>(
+      (length + slot_unit_ - 1) / slot_unit_ * slot_unit_);
+
+  Slot old_slot = {0, 0, 0};
+  int64_t offset;
+  {
+    std::lock_guard<std::mutex> guard(latch_);
+    if (static_cast<size_t>(page_id) >= slots_.size())
+      slots_.resize(page_id + 1, Slot{0, 0, 0});
+    old_slot = slots_[page_id];
+    offset = old_slot.length > 0 && old_slot.size == size
+                 ? old_slot.offset
+                 : AllocateSlot(size);
+  }
+  const bool new_slot = old_slot.length == 0 || old_slot.offset != offset;
+  uint64_t start = LatencyHistogram::NowNanos();
+  if (db_fd_ < 0 || !WriteFully(db_fd_, data, length, offset)) {
+    LOG_DEBUG("I/O error while writing");
+    // the map keeps pointing at the old slot, the new one is not used
+    if (new_slot) {
+      std::lock_guard<std::mutex> guard(latch_);
+      free_slots_[size / slot_unit_].push_back(offset);
+    }
+    throw Exception(EXCEPTION_TYPE_IO,
+                    "I/O error while writing page " + std::to_string(page_id));
+  }
+  RecordIo(IO_PAGE_WRITE, start, length);
+
+  std::lock_guard<std::mutex> guard(latch_);
+  slots_[page_id] = Slot{offset, length, size};
+  PersistSlot(page_id);
+  if (old_slot.length > 0 && new_slot)
+    moved_slots_.push_back(old_slot);
+}
+
+/**
+ * One fdatasync for the db file and one for the map at the end of the
+ * batch, which also frees the slots pages of the batch moved out of
+ */
+void CompressedDiskManager::WritePages(
+    std::vector<std::pair<page_id_t, const char *>> &pages) {
+  if (pages.empty())
+    return;
+  if (IsReadOnly())
+    throw Exception(EXCEPTION_TYPE_IO, "write to a read only database");
+  std::sort(pages.begin(), pages.end());
+  for (auto &page : pages)
+    WriteCompressed(page.first, page.second);
+  Sync();
+}
+
+void CompressedDiskManager::ReadPage(page_id_t page_id, char *page_data) {
+  if (!ReadCompressed(page_id, page_data))
+    throw PageCorruptionException(page_id);
+  VerifyChecksum(page_id, page_data);
+}
+
+/**
+ * A page that was never written reads back as zeros, like a hole in a
+ * plain db file
+ */
+bool CompressedDiskManager::ReadCompressed(page_id_t page_id,
+                                           char *page_data) {
+  const size_t page_size = GetPageSize();
+  Slot slot = {0, 0, 0};
+  {
+    std::lock_guard<std::mutex> guard(latch_);
+    if (page_id >= 0 && static_cast<size_t>(page_id) < slots_.size())
+      slot = slots_[page_id];
+  }
+  if (slot.length == 0) {
+    memset(page_data, 0, page_size);
+    return true;
+  }
+  uint64_t start = LatencyHistogram::NowNanos();
+  if (slot.length == page_size) {
+    size_t read_count = ReadFully(db_fd_, page_data, page_size, slot.offset);
+    RecordIo(IO_PAGE_READ, start, read_count);
+    // a failed read or a torn page, the slot says it is all there
+    return read_count == page_size;
+  }
+  std::vector<char> buffer(slot.length);
+  size_t read_count =
+      ReadFully(db_fd_, buffer.data(), slot.length, slot.offset);
+  RecordIo(IO_PAGE_READ, start, read_count);
+  if (read_count != slot.length)
+    return false;
+  return Decompress(buffer.data(), slot.length, page_data, page_size);
+}
+
+/**
+ * Synchronous like the base class: every request is done when this
+ * returns, reads are checked by WaitRequest()
+ */
+void CompressedDiskManager::SubmitRequests(DiskRequest *requests,
+                                           size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    if (requests[i].is_write) {
+      WritePage(requests[i].page_id, requests[i].data);
+    } else if (!ReadCompressed(requests[i].page_id, requests[i].data)) {
+      std::lock_guard<std::mutex> guard(latch_);
+      failed_reads_.insert(&requests[i]);
+    }
+    requests[i].done = true;
+  }
+}
+
+void CompressedDiskManager::WaitRequest(DiskRequest &request) {
+  assert(request.done);
+  if (request.is_write)
+    return;
+  {
+    std::lock_guard<std::mutex> guard(latch_);
+    if (failed_reads_.erase(&request) > 0)
+      throw PageCorruptionException(request.page_id);
+  }
+  VerifyChecksum(request.page_id, request.data);
+}
+
+uint64_t CompressedDiskManager::GetStoredBytes() {
+  std::lock_guard<std::mutex> guard(latch_);
+  uint64_t bytes = 0;
+  for (auto &slot : slots_)
+    if (slot.length > 0)
+      bytes += slot.size;
+  return bytes;
+}
+
+uint64_t CompressedDiskManager::GetLogicalBytes() {
+  std::lock_guard<std::mutex> guard(latch_);
+  uint64_t pages = 0;
+  for (auto &slot : slots_)
+    if (slot.length > 0)
+      ++pages;
+  return pages * GetPageSize();
+}
+
+size_t CompressedDiskManager::Compress(const char *src, size_t size,
+                                       char *dst, size_t capacity) {
+  return Lz4Compress(src, size, dst, capacity);
+}
+
+bool CompressedDiskManager::Decompress(const char *src, size_t length,
+                                       char *dst, size_t size) {
+  return Lz4Decompress(src, length, dst, size) == static_cast<int64_t>(size);
+}
+
+} // namespace cmudb
@@ -1,12 +1,20 @@
 /**
  * disk_manager.cpp
  */
+#include <algorithm>
 #include <assert.h>
+#include <cerrno>
+#include <climits>
 #include <cstring>
+#include <fcntl.h>
 #include <iostream>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <thread>
+#include <unistd.h>
 
+#include "common/crc32c.h"
+#include "common/exception.h"
 #include "common/logger.h"
 #include "disk/disk_manager.h"
 
@@ -14,24 +22,51 @@ namespace cmudb {
 
 static char *buffer_used = nullptr;
 
+static const uint32_t DB_MAGIC = 0x31424443; // "CDB1"
+
+struct DbFileHeader {
+  uint32_t magic;
+  uint32_t page_size;
+  uint32_t format;
+};
+
 /**
  * Constructor: open/create a single database file & log file
  * @input db_file: database file name
+ * @input page_size: page size of the database, if it is a new one
+ * @input read_only: open an existing database without writing to it
+ * @input format: how the pages are stored, a database of another format is
+ * refused
  */
-DiskManager::DiskManager(const std::string &db_file)
-    : file_name_(db_file), next_page_id_(0), num_flushes_(0), flush_log_(false),
+DiskManager::DiskManager(const std::string &db_file, size_t page_size,
+                         bool read_only)
+    : DiskManager(db_file, page_size, read_only, DB_FORMAT_PLAIN) {}
+
+DiskManager::DiskManager(const std::string &db_file, size_t page_size,
+                         bool read_only, DbFormat format)
+    : db_fd_(-1), db_file_size_(0), file_name_(db_file),
+      page_size_(page_size), read_only_(read_only), format_(format),
+      free_space_map_(nullptr), next_segment_id_(0), num_flushes_(0),
+      num_syncs_(0), verify_checksums_(true), flush_log_(false),
       flush_log_f_(nullptr) {
+  ResetStats();
   std::string::size_type n = file_name_.find(".");
-  if (n == std::string::npos) {
-    LOG_DEBUG("wrong file format");
-    return;
-  }
+  if (n == std::string::npos)
+    throw Exception(EXCEPTION_TYPE_IO,
+                    "db file name has no extension: " + file_name_);
   log_name_ = file_name_.substr(0, n) + ".log";
+  if (!IsValidPageSize(page_size_))
+    throw Exception(EXCEPTION_TYPE_IO,
+                    "page size must be 4K, 8K, 16K or 32K, not " +
+                        std::to_string(page_size_));
 
-  log_io_.open(log_name_,
-               std::ios::binary | std::ios::in | std::ios::app | std::ios::out);
+  if (read_only_)
+    log_io_.open(log_name_, std::ios::binary | std::ios::in);
+  else
+    log_io_.open(log_name_, std::ios::binary | std::ios::in | std::ios::app |
+                                std::ios::out);
   // directory or file does not exist
-  if (!log_io_.is_open()) {
+  if (!log_io_.is_open() && !read_only_) {
     log_io_.clear();
     // create a new file
     log_io_.open(log_name_, std::ios::binary | std::ios::trunc | std::ios::app |
@@ -42,64 +77,303 @@ DiskManager::DiskManager(const std::string &db_file)
                                 std::ios::out);
   }
 
-  db_io_.open(db_file,
-              std::ios::binary | std::ios::in | std::ios::out | std::ios::out);
-  // directory or file does not exist
-  if (!db_io_.is_open()) {
-    db_io_.clear();
-    // create a new file
-    db_io_.open(db_file, std::ios::binary | std::ios::trunc | std::ios::out);
-    db_io_.close();
-    // reopen with original mode
-    db_io_.open(db_file, std::ios::binary | std::ios::in | std::ios::out);
+  // create the file if it does not exist, keep its content otherwise
+  db_fd_ = read_only_ ? open(db_file.c_str(), O_RDONLY)
+                      : open(db_file.c_str(), O_RDWR | O_CREAT, 0644);
+  struct stat stat_buf;
+  if (db_fd_ < 0) {
+    LOG_DEBUG("can not open db file");
+  } else if (fstat(db_fd_, &stat_buf) == 0) {
+    db_file_size_ = stat_buf.st_size;
+    LoadFileHeader();
+  }
+  // the map only knows about the pages behind the header
+  free_space_map_ = new FreeSpaceMap(
+      file_name_.substr(0, n) + ".fsm",
+      std::max<int64_t>(db_file_size_ - DB_FILE_HEADER_SIZE, 0), page_size_,
+      read_only_);
+}
+
+/**
+ * A new (empty) db file gets a header with the page size asked for. A file
+ * that is not empty must carry a valid header of this disk manager's
+ * format, its page size wins.
+ */
+void DiskManager::LoadFileHeader() {
+  char block[DB_FILE_HEADER_SIZE] = {0};
+  DbFileHeader header;
+  if (db_file_size_ == 0) {
+    if (read_only_)
+      return;
+    header.magic = DB_MAGIC;
+    header.page_size = static_cast<uint32_t>(page_size_);
+    header.format = format_;
+    memcpy(block, &header, sizeof(header));
+    size_t written = 0;
+    while (written < DB_FILE_HEADER_SIZE) {
+      ssize_t ret = pwrite(db_fd_, block + written,
+                           DB_FILE_HEADER_SIZE - written, written);
+      if (ret < 0 && errno == EINTR)
+        continue;
+      if (ret <= 0) {
+        LOG_DEBUG("I/O error while writing");
+        return;
+      }
+      written += ret;
+    }
+    if (fdatasync(db_fd_) != 0) {
+      LOG_DEBUG("I/O error while syncing");
+    }
+    db_file_size_ = DB_FILE_HEADER_SIZE;
+    return;
+  }
+
+  ssize_t ret;
+  do {
+    ret = pread(db_fd_, &header, sizeof(header), 0);
+  } while (ret < 0 && errno == EINTR);
+  if (ret != static_cast<ssize_t>(sizeof(header)) ||
+      header.magic != DB_MAGIC || !IsValidPageSize(header.page_size)) {
+    close(db_fd_);
+    db_fd_ = -1;
+    throw Exception(EXCEPTION_TYPE_IO, file_name_ + " is not a database file");
   }
+  if (header.format != static_cast<uint32_t>(format_)) {
+    close(db_fd_);
+    db_fd_ = -1;
+    throw Exception(EXCEPTION_TYPE_IO,
+                    file_name_ + (header.format == DB_FORMAT_COMPRESSED
+                                      ? " is a compressed database"
+                                      : " is not a compressed database"));
+  }
+  page_size_ = header.page_size;
 }
 
 DiskManager::~DiskManager() {
-  db_io_.close();
+  if (free_space_map_ != nullptr) {
+    for (auto &segment : segments_)
+      for (page_id_t page_id = segment.second.next_page_id;
+           page_id < segment.second.end_page_id; ++page_id)
+        free_space_map_->DeallocatePage(page_id);
+  }
+  delete free_space_map_;
+  if (db_fd_ >= 0)
+    close(db_fd_);
   log_io_.close();
 }
 
 /**
  * Write the contents of the specified page into disk file
+ * pwritev hands the data straight to the OS, there is no stream to flush.
+ * The checksum goes out from a local, the page may be read latched only.
  */
 void DiskManager::WritePage(page_id_t page_id, const char *page_data) {
-  size_t offset = page_id * PAGE_SIZE;
-  // set write cursor to offset
-  db_io_.seekp(offset);
-  db_io_.write(page_data, PAGE_SIZE);
-  // check for I/O error
-  if (db_io_.bad()) {
-    LOG_DEBUG("I/O error while writing");
+  if (read_only_)
+    throw Exception(EXCEPTION_TYPE_IO, "write to a read only database");
+  uint32_t checksum = PageChecksum(page_data);
+  struct iovec iov[2] = {{const_cast<char *>(page_data), GetPageDataSize()},
+                         {&checksum, PAGE_CHECKSUM_SIZE}};
+  off_t offset = GetPageOffset(page_id);
+  size_t written = WriteVector(iov, 2, offset);
+  if (written > 0)
+    GrowFileSize(offset + written);
+}
+
+/**
+ * Write back a batch of pages with as few system calls as possible: one
+ * pwritev per run of adjacent page ids (at most IOV_MAX / 2 pages, each
+ * page and its checksum) and a single fdatasync at the end, instead of a
+ * write and a sync per page.
+ */
+void DiskManager::WritePages(
+    std::vector<std::pair<page_id_t, const char *>> &pages) {
+  if (pages.empty())
     return;
+  if (read_only_)
+    throw Exception(EXCEPTION_TYPE_IO, "write to a read only database");
+  std::sort(pages.begin(), pages.end());
+
+  std::vector<struct iovec> iov;
+  std::vector<uint32_t> checksums;
+  size_t first = 0;
+  while (first < pages.size()) {
+    // extend the run while the next page follows on disk
+    size_t last = first + 1;
+    while (last < pages.size() && 2 * (last - first) < IOV_MAX &&
+           pages[last].first == pages[last - 1].first + 1)
+      ++last;
+
+    iov.clear();
+    checksums.resize(last - first);
+    for (size_t i = first; i < last; ++i) {
+      checksums[i - first] = PageChecksum(pages[i].second);
+      iov.push_back({const_cast<char *>(pages[i].second), GetPageDataSize()});
+      iov.push_back({&checksums[i - first], PAGE_CHECKSUM_SIZE});
+    }
+    off_t offset = GetPageOffset(pages[first].first);
+    size_t written = WriteVector(iov.data(), static_cast<int>(iov.size()),
+                                 offset);
+    GrowFileSize(offset + written);
+    first = last;
   }
-  // needs to flush to keep disk file in sync
-  db_io_.flush();
+  SyncPages();
+}
+
+void DiskManager::SyncPages() {
+  uint64_t start = LatencyHistogram::NowNanos();
+  if (fdatasync(db_fd_) != 0) {
+    LOG_DEBUG("I/O error while syncing");
+  }
+  SyncFreeSpaceMap();
+  RecordIo(IO_SYNC, start, 0);
+  ++num_syncs_;
+}
+
+/**
+ * pwritev until all of iov is written or an error, short writes skip what
+ * went out (iov is consumed) and go on from there. Returns the bytes written.
+ */
+size_t DiskManager::WriteVector(struct iovec *iov, int count, off_t offset) {
+  size_t size = 0;
+  for (int i = 0; i < count; ++i)
+    size += iov[i].iov_len;
+  size_t written = 0;
+  int index = 0;
+  while (written < size) {
+    uint64_t start = LatencyHistogram::NowNanos();
+    ssize_t ret = pwritev(db_fd_, iov + index, count - index, offset + written);
+    if (ret < 0 && errno == EINTR)
+      continue;
+    // check for I/O error
+    if (ret <= 0) {
+      LOG_DEBUG("I/O error while writing");
+      break;
+    }
+    RecordIo(IO_PAGE_WRITE, start, ret);
+    written += ret;
+    size_t left = ret;
+    while (index < count && left >= iov[index].iov_len) {
+      left -= iov[index].iov_len;
+      ++index;
+    }
+    if (index < count) {
+      iov[index].iov_base = static_cast<char *>(iov[index].iov_base) + left;
+      iov[index].iov_len -= left;
+    }
+  }
+  return written;
+}
+
+/**
+ * Grow the cached file size, concurrent writers may race ahead of us
+ */
+void DiskManager::GrowFileSize(int64_t end) {
+  int64_t size = db_file_size_;
+  while (size < end && !db_file_size_.compare_exchange_weak(size, end))
+    ;
 }
 
 /**
  * Read the contents of the specified page into the given memory area
  */
 void DiskManager::ReadPage(page_id_t page_id, char *page_data) {
-  int offset = page_id * PAGE_SIZE;
-  // check if read beyond file length
-  if (offset > GetFileSize(file_name_)) {
-    LOG_DEBUG("I/O error while reading");
-    // std::cerr << "I/O error while reading" << std::endl;
-  } else {
-    // set read cursor to offset
-    db_io_.seekp(offset);
-    db_io_.read(page_data, PAGE_SIZE);
-    // if file ends before reading PAGE_SIZE
-    int read_count = db_io_.gcount();
-    if (read_count < PAGE_SIZE) {
-      LOG_DEBUG("Read less than a page");
-      // std::cerr << "Read less than a page" << std::endl;
-      memset(page_data + read_count, 0, PAGE_SIZE - read_count);
+  ReadPageData(page_id, page_data);
+  VerifyChecksum(page_id, page_data);
+}
+
+void DiskManager::ReadPageData(page_id_t page_id, char *page_data) {
+  off_t offset = GetPageOffset(page_id);
+  // never written yet, do not hand back what the frame held before
+  if (offset >= db_file_size_) {
+    memset(page_data, 0, page_size_);
+    return;
+  }
+  size_t read_count = 0;
+  while (read_count < page_size_) {
+    uint64_t start = LatencyHistogram::NowNanos();
+    ssize_t ret = pread(db_fd_, page_data + read_count,
+                        page_size_ - read_count, offset + read_count);
+    if (ret < 0 && errno == EINTR)
+      continue;
+    // check for I/O error
+    if (ret < 0) {
+      LOG_DEBUG("I/O error while reading");
+      throw Exception(EXCEPTION_TYPE_IO, "I/O error while reading page " +
+                                             std::to_string(page_id) + ": " +
+                                             strerror(errno));
+    }
+    if (ret == 0)
+      break;
+    RecordIo(IO_PAGE_READ, start, ret);
+    read_count += ret;
+  }
+  // the file ends inside the page, a torn write
+  if (read_count < page_size_) {
+    LOG_DEBUG("Read less than a page");
+    throw PageCorruptionException(page_id);
+  }
+}
+
+uint32_t DiskManager::PageChecksum(const char *page_data) const {
+  return Crc32c(page_data, GetPageDataSize());
+}
+
+void DiskManager::StampChecksum(char *page_data) const {
+  uint32_t checksum = PageChecksum(page_data);
+  memcpy(page_data + GetPageDataSize(), &checksum, PAGE_CHECKSUM_SIZE);
+}
+
+void DiskManager::VerifyChecksum(page_id_t page_id,
+                                 const char *page_data) const {
+  if (!verify_checksums_)
+    return;
+  size_t data_size = GetPageDataSize();
+  uint32_t stored;
+  memcpy(&stored, page_data + data_size, PAGE_CHECKSUM_SIZE);
+  uint32_t computed = Crc32c(page_data, data_size);
+  if (stored == computed)
+    return;
+  // never written: beyond the end of the file or in a hole
+  if (stored == 0) {
+    size_t i = 0;
+    while (i < data_size && page_data[i] == 0)
+      ++i;
+    if (i == data_size)
+      return;
+  }
+  throw PageCorruptionException(page_id, stored, computed);
+}
+
+/**
+ * Batched page I/O. pread/pwrite are synchronous, so every
+ * request is done (and complete) by the time SubmitRequests() returns.
+ * A request that failed is reported by its WaitRequest().
+ */
+void DiskManager::SubmitRequests(DiskRequest *requests, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    try {
+      if (requests[i].is_write)
+        WritePage(requests[i].page_id, requests[i].data);
+      else
+        ReadPageData(requests[i].page_id, requests[i].data);
+    } catch (Exception &) {
+      requests[i].failed = true;
     }
+    requests[i].done = true;
   }
 }
 
+void DiskManager::WaitRequest(DiskRequest &request) {
+  assert(request.done);
+  if (request.failed)
+    throw Exception(EXCEPTION_TYPE_IO,
+                    std::string("I/O error while ") +
+                        (request.is_write ? "writing" : "reading") + " page " +
+                        std::to_string(request.page_id));
+  if (!request.is_write)
+    VerifyChecksum(request.page_id, request.data);
+}
+
 /**
  * Write the contents of the log into disk file
  * Only return when sync is done, and only perform sequence write
@@ -120,6 +394,7 @@ void DiskManager::WriteLog(char *log_data, int size) {
            std::future_status::ready);
 
   num_flushes_ += 1;
+  uint64_t start = LatencyHistogram::NowNanos();
   // sequence write
   log_io_.write(log_data, size);
 
@@ -130,6 +405,7 @@ void DiskManager::WriteLog(char *log_data, int size) {
   }
   // needs to flush to keep disk file in sync
   log_io_.flush();
+  RecordIo(IO_LOG_WRITE, start, size);
   flush_log_ = false;
 }
 
@@ -158,16 +434,67 @@ bool DiskManager::ReadLog(char *log_data, int size, int offset) {
 
 /**
  * Allocate new page (operations like create index/table)
- * For now just keep an increasing counter
+ * Reuses the lowest freed page id if there is one
+ */
+page_id_t DiskManager::AllocatePage() {
+  return free_space_map_->AllocatePage();
+}
+
+/**
+ * Allocate a run of contiguous pages, so they can be read and written
+ * sequentially
  */
-page_id_t DiskManager::AllocatePage() { return next_page_id_++; }
+page_id_t DiskManager::AllocatePages(size_t count) {
+  return free_space_map_->AllocatePages(count);
+}
 
 /**
  * Deallocate page (operations like drop index/table)
- * Need bitmap in header page for tracking pages
+ * The page id can be handed out again by AllocatePage()
+ */
+void DiskManager::DeallocatePage(page_id_t page_id) {
+  free_space_map_->DeallocatePage(page_id);
+}
+
+segment_id_t DiskManager::CreateSegment() {
+  std::lock_guard<std::mutex> guard(segment_latch_);
+  segment_id_t segment_id = next_segment_id_++;
+  segments_[segment_id] = Extent{INVALID_PAGE_ID, INVALID_PAGE_ID};
+  return segment_id;
+}
+
+/**
+ * The pages the segment has been handed stay allocated, only the unused
+ * rest of its extent is freed
+ */
+void DiskManager::DropSegment(segment_id_t segment_id) {
+  std::lock_guard<std::mutex> guard(segment_latch_);
+  auto it = segments_.find(segment_id);
+  if (it == segments_.end())
+    return;
+  for (page_id_t page_id = it->second.next_page_id;
+       page_id < it->second.end_page_id; ++page_id)
+    free_space_map_->DeallocatePage(page_id);
+  segments_.erase(it);
+}
+
+/**
+ * Allocate the next page of the segment's extent, and a new extent once it
+ * is used up
  */
-void DiskManager::DeallocatePage(__attribute__((unused)) page_id_t page_id) {
-  return;
+page_id_t DiskManager::AllocatePage(segment_id_t segment_id) {
+  if (segment_id == INVALID_SEGMENT_ID)
+    return AllocatePage();
+  std::lock_guard<std::mutex> guard(segment_latch_);
+  auto it = segments_.find(segment_id);
+  if (it == segments_.end())
+    return AllocatePage();
+  Extent &extent = it->second;
+  if (extent.next_page_id == extent.end_page_id) {
+    extent.next_page_id = free_space_map_->AllocatePages(EXTENT_SIZE);
+    extent.end_page_id = extent.next_page_id + EXTENT_SIZE;
+  }
+  return extent.next_page_id++;
 }
 
 /**
@@ -180,6 +507,38 @@ int DiskManager::GetNumFlushes() const { return num_flushes_; }
  */
 bool DiskManager::GetFlushState() const { return flush_log_; }
 
+void DiskManager::RecordIo(IoKind kind, uint64_t start_ns, uint64_t bytes) {
+  io_latency_[kind].Record(LatencyHistogram::NowNanos() - start_ns);
+  io_bytes_[kind].fetch_add(bytes, std::memory_order_relaxed);
+}
+
+/**
+ * Snapshot of the I/O counters. Taken without stopping I/O, so the
+ * figures of one op may be off by the calls that were in flight.
+ */
+DiskStats DiskManager::GetStats() const {
+  DiskStats stats;
+  DiskStats::Op *ops[IO_KINDS] = {&stats.page_reads, &stats.page_writes,
+                                  &stats.log_writes, &stats.syncs};
+  for (int kind = 0; kind < IO_KINDS; ++kind) {
+    const LatencyHistogram &latency = io_latency_[kind];
+    ops[kind]->count = latency.GetCount();
+    ops[kind]->bytes = io_bytes_[kind];
+    ops[kind]->total_ns = latency.GetSum();
+    ops[kind]->p50_ns = latency.GetPercentile(0.5);
+    ops[kind]->p99_ns = latency.GetPercentile(0.99);
+    ops[kind]->max_ns = latency.GetMax();
+  }
+  return stats;
+}
+
+void DiskManager::ResetStats() {
+  for (int kind = 0; kind < IO_KINDS; ++kind) {
+    io_latency_[kind].Reset();
+    io_bytes_[kind] = 0;
+  }
+}
+
 /**
  * Private helper function to get disk file size
  */
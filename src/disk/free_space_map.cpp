@@ -0,0 +1,254 @@
+/**
+ * free_space_map.cpp
+ */
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "common/logger.h"
+#include "disk/free_space_map.h"
+
+namespace cmudb {
+
+static const uint32_t FSM_MAGIC = 0x314d5346; // "FSM1"
+
+struct FreeSpaceMapHeader {
+  uint32_t magic;
+  page_id_t next_page_id;
+};
+
+static bool WriteFully(int fd, const void *data, size_t size, off_t offset) {
+  const char *buf = static_cast<const char *>(data);
+  size_t written = 0;
+  while (written < size) {
+    ssize_t ret = pwrite(fd, buf + written, size - written, offset + written);
+    if (ret < 0 && errno == EINTR)
+      continue;
+    if (ret <= 0)
+      return false;
+    written += ret;
+  }
+  return true;
+}
+
+static size_t ReadFully(int fd, void *data, size_t size, off_t offset) {
+  char *buf = static_cast<char *>(data);
+  size_t read_count = 0;
+  while (read_count < size) {
+    ssize_t ret = pread(fd, buf + read_count, size - read_count,
+                        offset + read_count);
+    if (ret < 0 && errno == EINTR)
+      continue;
+    if (ret <= 0)
+      break;
+    read_count += ret;
+  }
+  return read_count;
+}
+
+/**
+ * Constructor: open/create the map file and load it
+ */
+FreeSpaceMap::FreeSpaceMap(const std::string &file_name, int64_t db_file_size,
+                           size_t page_size, bool read_only)
+    : file_name_(file_name), fd_(-1), read_only_(read_only),
+      page_size_(page_size), next_page_id_(0), free_hint_(0),
+      free_page_count_(0) {
+  fd_ = read_only_ ? open(file_name_.c_str(), O_RDONLY)
+                   : open(file_name_.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd_ < 0) {
+    LOG_DEBUG("can not open free space map file");
+  }
+  Load(db_file_size);
+}
+
+FreeSpaceMap::~FreeSpaceMap() {
+  if (fd_ >= 0)
+    close(fd_);
+}
+
+/**
+ * Pick up the map as it was left. An empty db file means a new database,
+ * whatever an old map file says; pages found in the db file beyond the map
+ * (a database from before the map existed, or a map write that got lost)
+ * are taken as allocated.
+ */
+void FreeSpaceMap::Load(int64_t db_file_size) {
+  page_id_t next_page_id = 0;
+  FreeSpaceMapHeader header;
+  if (db_file_size > 0 && fd_ >= 0 &&
+      ReadFully(fd_, &header, sizeof(header), 0) == sizeof(header) &&
+      header.magic == FSM_MAGIC && header.next_page_id >= 0) {
+    next_page_id = header.next_page_id;
+    Grow(next_page_id);
+    size_t size = (next_page_id + 7) / 8;
+    size_t read_count = ReadFully(fd_, bitmap_.data(), size, MAP_BLOCK_SIZE);
+    // a torn map file, do not hand out pages it may have known about
+    if (read_count < size)
+      memset(bitmap_.data() + read_count, 0xff, size - read_count);
+  } else if (fd_ >= 0 && !read_only_ && ftruncate(fd_, 0) != 0) {
+    LOG_DEBUG("can not reset free space map file");
+  }
+
+  page_id_t file_pages =
+      static_cast<page_id_t>((db_file_size + page_size_ - 1) / page_size_);
+  page_id_t first_new = next_page_id;
+  if (file_pages > next_page_id) {
+    Grow(file_pages);
+    SetBits(next_page_id, file_pages - 1, true);
+    next_page_id = file_pages;
+  }
+  next_page_id_ = next_page_id;
+
+  free_hint_ = next_page_id;
+  for (page_id_t page_id = 0; page_id < next_page_id; ++page_id) {
+    if (!TestBit(page_id)) {
+      free_hint_ = std::min(free_hint_, page_id);
+      ++free_page_count_;
+    }
+  }
+  if (first_new < next_page_id || next_page_id == 0)
+    Persist(first_new, next_page_id - 1);
+}
+
+/**
+ * First fit, so freed pages near the start of the file are reused before
+ * the file grows
+ */
+page_id_t FreeSpaceMap::AllocatePage() {
+  std::lock_guard<std::mutex> guard(latch_);
+  page_id_t next_page_id = next_page_id_;
+  page_id_t page_id = free_hint_;
+  // skip whole bytes of allocated pages
+  while (page_id < next_page_id && bitmap_[page_id / 8] == 0xff)
+    page_id = (page_id / 8 + 1) * 8;
+  while (page_id < next_page_id && TestBit(page_id))
+    ++page_id;
+
+  if (page_id < next_page_id) {
+    --free_page_count_;
+  } else {
+    page_id = next_page_id;
+    Grow(page_id + 1);
+    next_page_id_ = page_id + 1;
+  }
+  SetBits(page_id, page_id, true);
+  free_hint_ = page_id + 1;
+  Persist(page_id, page_id);
+  return page_id;
+}
+
+/**
+ * First fit as well. A free run at the end of the file is extended rather
+ * than skipped.
+ */
+page_id_t FreeSpaceMap::AllocatePages(size_t count) {
+  if (count == 0)
+    return INVALID_PAGE_ID;
+  std::lock_guard<std::mutex> guard(latch_);
+  page_id_t next_page_id = next_page_id_;
+  page_id_t start = next_page_id;
+  size_t run = 0;
+  for (page_id_t page_id = free_hint_; page_id < next_page_id; ++page_id) {
+    if (TestBit(page_id)) {
+      run = 0;
+      continue;
+    }
+    if (run++ == 0)
+      start = page_id;
+    if (run == count)
+      break;
+  }
+  if (run == 0)
+    start = next_page_id;
+
+  page_id_t last = start + static_cast<page_id_t>(count) - 1;
+  free_page_count_ -= std::min(last + 1, next_page_id) -
+                      std::min(start, next_page_id);
+  if (last >= next_page_id) {
+    Grow(last + 1);
+    next_page_id_ = last + 1;
+  }
+  SetBits(start, last, true);
+  if (start == free_hint_)
+    free_hint_ = last + 1;
+  Persist(start, last);
+  return start;
+}
+
+void FreeSpaceMap::DeallocatePage(page_id_t page_id) {
+  std::lock_guard<std::mutex> guard(latch_);
+  if (page_id < 0 || page_id >= next_page_id_ || !TestBit(page_id))
+    return;
+  SetBits(page_id, page_id, false);
+  ++free_page_count_;
+  free_hint_ = std::min(free_hint_, page_id);
+  Persist(page_id, page_id);
+}
+
+/**
+ * Pages allocated while writing a batch must be on disk by the time the
+ * batch is, or a crash leaves them looking free and they are handed out
+ * again over live data.
+ */
+void FreeSpaceMap::Sync() {
+  if (fd_ < 0 || read_only_)
+    return;
+  if (fdatasync(fd_) != 0) {
+    LOG_DEBUG("I/O error while syncing free space map");
+  }
+}
+
+bool FreeSpaceMap::IsAllocated(page_id_t page_id) {
+  std::lock_guard<std::mutex> guard(latch_);
+  return page_id >= 0 && page_id < next_page_id_ && TestBit(page_id);
+}
+
+size_t FreeSpaceMap::GetFreePageCount() {
+  std::lock_guard<std::mutex> guard(latch_);
+  return free_page_count_;
+}
+
+void FreeSpaceMap::SetBits(page_id_t first, page_id_t last, bool allocated) {
+  for (page_id_t page_id = first; page_id <= last; ++page_id) {
+    uint8_t mask = static_cast<uint8_t>(1 << (page_id % 8));
+    if (allocated)
+      bitmap_[page_id / 8] |= mask;
+    else
+      bitmap_[page_id / 8] &= ~mask;
+  }
+}
+
+void FreeSpaceMap::Grow(page_id_t next_page_id) {
+  size_t blocks = (next_page_id + PAGES_PER_BLOCK - 1) / PAGES_PER_BLOCK;
+  if (bitmap_.size() < blocks * MAP_BLOCK_SIZE)
+    bitmap_.resize(blocks * MAP_BLOCK_SIZE, 0);
+}
+
+/**
+ * Only the bytes that changed and the header are written, so allocating
+ * a page costs two small pwrites.
+ */
+void FreeSpaceMap::Persist(page_id_t first, page_id_t last) {
+  if (fd_ < 0 || read_only_)
+    return;
+  if (first <= last) {
+    size_t first_byte = first / 8;
+    size_t size = last / 8 - first_byte + 1;
+    if (!WriteFully(fd_, bitmap_.data() + first_byte, size,
+                    MAP_BLOCK_SIZE + first_byte)) {
+      LOG_DEBUG("I/O error while writing free space map");
+    }
+  }
+  FreeSpaceMapHeader header;
+  header.magic = FSM_MAGIC;
+  header.next_page_id = next_page_id_;
+  if (!WriteFully(fd_, &header, sizeof(header), 0)) {
+    LOG_DEBUG("I/O error while writing free space map");
+  }
+}
+
+} // namespace cmudb
@@ -0,0 +1,98 @@
+/**
+ * mmap_disk_manager.cpp
+ */
+#include <algorithm>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "common/logger.h"
+#include "disk/mmap_disk_manager.h"
+
+namespace cmudb {
+
+/**
+ * Constructor: the files are opened read only by DiskManager, then the db
+ * file is mapped. Only whole pages are mapped; a torn last page is left to
+ * ReadPage() of the base class.
+ */
+MmapDiskManager::MmapDiskManager(const std::string &db_file)
+    : DiskManager(db_file, PAGE_SIZE, true), mapping_(nullptr),
+      mapping_size_(0), pages_(nullptr), page_count_(0), verified_(nullptr) {
+  int fd = open(db_file.c_str(), O_RDONLY);
+  if (fd < 0) {
+    LOG_DEBUG("can not open db file for mmap");
+    return;
+  }
+  struct stat stat_buf;
+  if (fstat(fd, &stat_buf) == 0 && stat_buf.st_size > DB_FILE_HEADER_SIZE)
+    page_count_ = static_cast<page_id_t>(
+        (stat_buf.st_size - DB_FILE_HEADER_SIZE) / GetPageSize());
+  if (page_count_ > 0) {
+    mapping_size_ = DB_FILE_HEADER_SIZE + page_count_ * GetPageSize();
+    void *mapping =
+        mmap(nullptr, mapping_size_, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+      LOG_DEBUG("can not map db file");
+      page_count_ = 0;
+      mapping_size_ = 0;
+    } else {
+      mapping_ = static_cast<char *>(mapping);
+      pages_ = mapping_ + DB_FILE_HEADER_SIZE;
+      // lookups jump around the file until a scan says otherwise
+      madvise(mapping_, mapping_size_, MADV_RANDOM);
+    }
+  }
+  close(fd);
+  verified_ = new std::atomic<bool>[page_count_];
+  for (page_id_t i = 0; i < page_count_; ++i)
+    verified_[i] = false;
+}
+
+MmapDiskManager::~MmapDiskManager() {
+  if (mapping_ != nullptr)
+    munmap(mapping_, mapping_size_);
+  delete[] verified_;
+}
+
+void MmapDiskManager::ReadPage(page_id_t page_id, char *page_data) {
+  if (page_id < 0 || page_id >= page_count_) {
+    DiskManager::ReadPage(page_id, page_data);
+    return;
+  }
+  memcpy(page_data, pages_ + page_id * GetPageSize(), GetPageSize());
+  VerifyChecksum(page_id, page_data);
+}
+
+const char *MmapDiskManager::GetPageData(page_id_t page_id) {
+  if (page_id < 0 || page_id >= page_count_)
+    return nullptr;
+  const char *page_data = pages_ + page_id * GetPageSize();
+  // the file does not change, one check per page is enough
+  if (!verified_[page_id].load(std::memory_order_acquire)) {
+    VerifyChecksum(page_id, page_data);
+    verified_[page_id].store(GetVerifyChecksums(), std::memory_order_release);
+  }
+  return page_data;
+}
+
+void MmapDiskManager::WillNeed(page_id_t first_page_id, size_t count) {
+  page_id_t first = std::max(first_page_id, 0);
+  page_id_t last = std::min(
+      static_cast<page_id_t>(first_page_id + count), page_count_);
+  if (first >= last)
+    return;
+  // madvise wants a system page aligned start
+  uintptr_t start = reinterpret_cast<uintptr_t>(pages_ +
+                                                first * GetPageSize());
+  uintptr_t end =
+      reinterpret_cast<uintptr_t>(pages_ + last * GetPageSize());
+  const uintptr_t system_page_size = sysconf(_SC_PAGESIZE);
+  start -= start % system_page_size;
+  madvise(reinterpret_cast<void *>(start), end - start, MADV_WILLNEED);
+}
+
+} // namespace cmudb
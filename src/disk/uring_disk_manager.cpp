@@ -0,0 +1,375 @@
+/**
+ * uring_disk_manager.cpp
+ */
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "common/exception.h"
+#include "common/logger.h"
+#include "disk/uring_disk_manager.h"
+
+namespace cmudb {
+
+static int IoUringSetup(unsigned entries, io_uring_params *params) {
+  return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int IoUringEnter(int ring_fd, unsigned to_submit, unsigned min_complete,
+                        unsigned flags) {
+  return static_cast<int>(syscall(__NR_io_uring_enter, ring_fd, to_submit,
+                                  min_complete, flags, nullptr, 0));
+}
+
+static bool IsAligned(const void *ptr) {
+  return reinterpret_cast<uintptr_t>(ptr) % DIRECT_IO_ALIGNMENT == 0;
+}
+
+/**
+ * Constructor: the db and log files are opened by DiskManager, then the db file
+ * is opened once more for the ring, with O_DIRECT if the page size allows it
+ * and the file system supports it.
+ */
+UringDiskManager::UringDiskManager(const std::string &db_file,
+                                   unsigned queue_depth, size_t page_size)
+    : DiskManager(db_file, page_size), db_fd_(-1), direct_io_(false), ring_fd_(-1),
+      sq_ring_(MAP_FAILED), sq_ring_size_(0), sq_tail_(nullptr),
+      sq_mask_(nullptr), sq_array_(nullptr), sq_entries_(0),
+      sqes_(static_cast<io_uring_sqe *>(MAP_FAILED)), sqes_size_(0),
+      cq_ring_(MAP_FAILED), cq_ring_size_(0), cq_head_(nullptr),
+      cq_tail_(nullptr), cq_mask_(nullptr), cqes_(nullptr), in_flight_(0),
+      reaping_(false) {
+  if (GetPageSize() % DIRECT_IO_ALIGNMENT == 0) {
+    db_fd_ = open(db_file.c_str(), O_RDWR | O_DIRECT);
+    direct_io_ = db_fd_ >= 0;
+  }
+  if (db_fd_ < 0)
+    db_fd_ = open(db_file.c_str(), O_RDWR);
+  if (db_fd_ < 0) {
+    LOG_DEBUG("can not open db file for io_uring");
+    return;
+  }
+  if (!SetupRing(queue_depth)) {
+    LOG_DEBUG("io_uring not available, using pread/pwrite");
+    TeardownRing();
+    close(db_fd_);
+    db_fd_ = -1;
+    direct_io_ = false;
+  }
+}
+
+/**
+ * All requests must have been waited for by now.
+ */
+UringDiskManager::~UringDiskManager() {
+  TeardownRing();
+  if (db_fd_ >= 0)
+    close(db_fd_);
+}
+
+/**
+ * Create the ring and map its submission queue, completion queue and
+ * submission queue entries into this process.
+ */
+bool UringDiskManager::SetupRing(unsigned queue_depth) {
+  io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  ring_fd_ = IoUringSetup(queue_depth, &params);
+  if (ring_fd_ < 0)
+    return false;
+
+  sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    sq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    cq_ring_size_ = sq_ring_size_;
+  }
+  sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+  if (sq_ring_ == MAP_FAILED)
+    return false;
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    cq_ring_ = sq_ring_;
+  } else {
+    cq_ring_ = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+    if (cq_ring_ == MAP_FAILED)
+      return false;
+  }
+  sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+  sqes_ = static_cast<io_uring_sqe *>(
+      mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+           MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES));
+  if (sqes_ == MAP_FAILED)
+    return false;
+
+  char *sq = static_cast<char *>(sq_ring_);
+  sq_tail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+  sq_mask_ = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+  sq_array_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+  sq_entries_ = params.sq_entries;
+  char *cq = static_cast<char *>(cq_ring_);
+  cq_head_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+  cq_tail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+  cq_mask_ = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+  cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+  return true;
+}
+
+void UringDiskManager::TeardownRing() {
+  if (sqes_ != MAP_FAILED)
+    munmap(sqes_, sqes_size_);
+  if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_)
+    munmap(cq_ring_, cq_ring_size_);
+  if (sq_ring_ != MAP_FAILED)
+    munmap(sq_ring_, sq_ring_size_);
+  if (ring_fd_ >= 0)
+    close(ring_fd_);
+  sqes_ = static_cast<io_uring_sqe *>(MAP_FAILED);
+  cq_ring_ = sq_ring_ = MAP_FAILED;
+  ring_fd_ = -1;
+}
+
+void UringDiskManager::WritePage(page_id_t page_id, const char *page_data) {
+  if (!IsUringEnabled())
+    return DiskManager::WritePage(page_id, page_data);
+  DiskRequest request(true, page_id, const_cast<char *>(page_data));
+  SubmitRequests(&request, 1);
+  WaitRequest(request);
+}
+
+void UringDiskManager::ReadPage(page_id_t page_id, char *page_data) {
+  if (!IsUringEnabled())
+    return DiskManager::ReadPage(page_id, page_data);
+  DiskRequest request(false, page_id, page_data);
+  SubmitRequests(&request, 1);
+  WaitRequest(request);
+}
+
+/**
+ * Instead of a pwritev per run of adjacent pages, the whole batch is
+ * queued on the ring at once and the writes complete in any order. One
+ * fdatasync once they all did; a failed write is reported after the sync,
+ * so the rest of the batch is on disk either way.
+ */
+void UringDiskManager::WritePages(
+    std::vector<std::pair<page_id_t, const char *>> &pages) {
+  if (!IsUringEnabled())
+    return DiskManager::WritePages(pages);
+  if (pages.empty())
+    return;
+  std::sort(pages.begin(), pages.end());
+  std::vector<DiskRequest> requests;
+  requests.reserve(pages.size());
+  for (auto &page : pages)
+    requests.emplace_back(true, page.first, const_cast<char *>(page.second));
+  SubmitRequests(requests.data(), requests.size());
+  {
+    std::unique_lock<std::mutex> lock(latch_);
+    for (auto &request : requests)
+      while (!request.done)
+        Reap(lock);
+  }
+  SyncPages();
+  for (auto &request : requests)
+    if (request.failed)
+      throw Exception(EXCEPTION_TYPE_IO, "I/O error while writing page " +
+                                             std::to_string(request.page_id));
+}
+
+/**
+ * Queue the requests and submit them with one io_uring_enter per ring full.
+ * Blocks only while the ring has no free slot.
+ *
+ * If io_uring_enter fails for good, the requests the kernel did not take
+ * are taken back off the ring and failed along with the ones not queued
+ * yet; the ones it did take are waited for, so no request of the batch is
+ * in flight when the exception is thrown.
+ */
+void UringDiskManager::SubmitRequests(DiskRequest *requests, size_t count) {
+  if (!IsUringEnabled())
+    return DiskManager::SubmitRequests(requests, count);
+
+  std::unique_lock<std::mutex> lock(latch_);
+  size_t submitted = 0;
+  int error = 0;
+  while (submitted < count && error == 0) {
+    while (in_flight_ == sq_entries_)
+      Reap(lock);
+    unsigned batch = 0;
+    while (submitted < count && in_flight_ < sq_entries_) {
+      QueueRequest(requests[submitted++]);
+      ++in_flight_;
+      ++batch;
+    }
+    // the kernel consumes the whole batch unless it runs out of memory,
+    // in which case the rest is picked up by the next enter
+    while (batch > 0) {
+      int ret = IoUringEnter(ring_fd_, batch, 0, 0);
+      if (ret < 0) {
+        if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+          continue;
+        error = errno;
+        break;
+      }
+      batch -= static_cast<unsigned>(ret);
+    }
+    if (error == 0)
+      continue;
+
+    // latch_ was held since they were queued, the last batch entries of
+    // the ring are ours and the kernel has not looked at them
+    LOG_DEBUG("io_uring_enter failed while submitting");
+    __atomic_store_n(sq_tail_, *sq_tail_ - batch, __ATOMIC_RELEASE);
+    in_flight_ -= batch;
+    for (size_t i = submitted - batch; i < count; ++i)
+      FailRequest(requests[i]);
+    for (size_t i = 0; i < submitted - batch; ++i)
+      while (!requests[i].done)
+        Reap(lock);
+  }
+  if (error != 0)
+    throw Exception(EXCEPTION_TYPE_IO, std::string("io_uring_enter failed: ") +
+                                           strerror(error));
+}
+
+/**
+ * Block until request is complete, reaping completions of other requests
+ * on the way. A read is checked against its checksum once complete.
+ */
+void UringDiskManager::WaitRequest(DiskRequest &request) {
+  if (!IsUringEnabled())
+    return DiskManager::WaitRequest(request);
+
+  {
+    std::unique_lock<std::mutex> lock(latch_);
+    while (!request.done)
+      Reap(lock);
+  }
+  if (request.failed)
+    throw Exception(EXCEPTION_TYPE_IO,
+                    std::string("I/O error while ") +
+                        (request.is_write ? "writing" : "reading") + " page " +
+                        std::to_string(request.page_id));
+  if (!request.is_write)
+    VerifyChecksum(request.page_id, request.data);
+}
+
+/**
+ * A write always goes through a bounce buffer, the checksum is stamped on
+ * it: the page may be read latched only and must not be written to.
+ */
+void UringDiskManager::QueueRequest(DiskRequest &request) {
+  const size_t page_size = GetPageSize();
+  if (request.is_write || (direct_io_ && !IsAligned(request.data))) {
+    void *buffer = nullptr;
+    if (posix_memalign(&buffer, DIRECT_IO_ALIGNMENT, page_size) != 0)
+      throw std::bad_alloc();
+    request.io_buffer = static_cast<char *>(buffer);
+    if (request.is_write) {
+      memcpy(request.io_buffer, request.data, page_size);
+      StampChecksum(request.io_buffer);
+    }
+  }
+
+  unsigned tail = *sq_tail_;
+  unsigned index = tail & *sq_mask_;
+  io_uring_sqe *sqe = &sqes_[index];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = request.is_write ? IORING_OP_WRITE : IORING_OP_READ;
+  sqe->fd = db_fd_;
+  sqe->addr = reinterpret_cast<uint64_t>(request.io_buffer);
+  sqe->len = page_size;
+  sqe->off = static_cast<uint64_t>(GetPageOffset(request.page_id));
+  sqe->user_data = reinterpret_cast<uint64_t>(&request);
+  request.submit_ns = LatencyHistogram::NowNanos();
+  sq_array_[index] = index;
+  // the entry must be visible to the kernel before the new tail
+  __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Called with latch_ held. Only the reaping thread waits in the kernel and
+ * drains the completion queue; it drops latch_ while it waits so requests
+ * can still be submitted. Everybody else waits for it to finish a round.
+ */
+void UringDiskManager::Reap(std::unique_lock<std::mutex> &lock) {
+  if (reaping_) {
+    reap_cv_.wait(lock);
+    return;
+  }
+  reaping_ = true;
+  lock.unlock();
+  // returns at once if a completion is already queued
+  if (IoUringEnter(ring_fd_, 0, 1, IORING_ENTER_GETEVENTS) < 0 &&
+      errno != EINTR) {
+    LOG_DEBUG("io_uring_enter failed while reaping");
+  }
+  lock.lock();
+
+  unsigned head = *cq_head_;
+  unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+  for (; head != tail; ++head) {
+    io_uring_cqe *cqe = &cqes_[head & *cq_mask_];
+    CompleteRequest(*reinterpret_cast<DiskRequest *>(cqe->user_data),
+                    cqe->res);
+    --in_flight_;
+  }
+  __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+
+  reaping_ = false;
+  reap_cv_.notify_all();
+}
+
+/**
+ * Same outcome as the pread path: a read that finds nothing (past the end
+ * of the file, the page was never written) gives a zeroed page, a read
+ * that fails or finds the file ending inside the page (a torn write) fails
+ * the request. So does a write that failed or came up short: what is on
+ * disk is a torn page now, which only rewriting the whole page repairs.
+ */
+void UringDiskManager::CompleteRequest(DiskRequest &request, int result) {
+  if (result < 0) {
+    LOG_DEBUG("I/O error while %s", request.is_write ? "writing" : "reading");
+    request.failed = true;
+    result = 0;
+  }
+  RecordIo(request.is_write ? IO_PAGE_WRITE : IO_PAGE_READ,
+           request.submit_ns, result);
+  const int page_size = static_cast<int>(GetPageSize());
+  if (!request.is_write) {
+    if (result > 0 && result < page_size) {
+      LOG_DEBUG("Read less than a page");
+      request.failed = true;
+    } else if (result == 0 && !request.failed) {
+      memset(request.io_buffer, 0, page_size);
+    }
+    if (request.io_buffer != request.data && !request.failed)
+      memcpy(request.data, request.io_buffer, page_size);
+  } else if (result < page_size) {
+    LOG_DEBUG("Short write");
+    request.failed = true;
+  }
+  if (request.io_buffer != request.data) {
+    free(request.io_buffer);
+    request.io_buffer = request.data;
+  }
+  request.done = true;
+}
+
+void UringDiskManager::FailRequest(DiskRequest &request) {
+  if (request.io_buffer != request.data) {
+    free(request.io_buffer);
+    request.io_buffer = request.data;
+  }
+  request.failed = true;
+  request.done = true;
+}
+
+} // namespace cmudb
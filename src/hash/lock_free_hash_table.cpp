@@ -0,0 +1,124 @@
+#include <cassert>
+
+#include "hash/lock_free_hash_table.h"
+#include "page/page.h"
+
+namespace cmudb {
+
+/*
+ * constructor
+ * num_entries: maximum number of keys stored at the same time
+ */
+template <typename V>
+LockFreeHashTable<V>::LockFreeHashTable(size_t num_entries, V base)
+    : capacity_(2), base_(base) {
+  // keep the load factor <= 1/2 so probe sequences stay short
+  while (capacity_ < 2 * num_entries)
+    capacity_ <<= 1;
+  slots_ = new std::atomic<uint64_t>[capacity_];
+  for (size_t i = 0; i < capacity_; ++i)
+    slots_[i].store(MakeSlot(EMPTY_KEY, 0));
+}
+
+template <typename V> LockFreeHashTable<V>::~LockFreeHashTable() {
+  delete[] slots_;
+}
+
+/*
+ * lookup function to find value associate with input key
+ * Probe from the home slot until the key or an empty slot shows up
+ */
+template <typename V>
+bool LockFreeHashTable<V>::Find(const page_id_t &key, V &value) {
+  size_t idx = HashKey(key);
+  for (size_t i = 0; i < capacity_; ++i) {
+    uint64_t slot = slots_[idx].load(std::memory_order_acquire);
+    uint32_t slot_key = SlotKey(slot);
+    if (slot_key == EMPTY_KEY)
+      return false;
+    if (slot_key == static_cast<uint32_t>(key)) {
+      value = base_ + SlotFrameId(slot);
+      return true;
+    }
+    idx = (idx + 1) & (capacity_ - 1);
+  }
+  return false;
+}
+
+/*
+ * insert <key,value> entry in hash table, overwriting the value if the key
+ * already exists. The first tombstone on the probe path is reused.
+ */
+template <typename V>
+void LockFreeHashTable<V>::Insert(const page_id_t &key, const V &value) {
+  const uint64_t new_slot =
+      MakeSlot(static_cast<uint32_t>(key), static_cast<uint32_t>(value - base_));
+  size_t idx = HashKey(key);
+  size_t target = capacity_;
+
+  for (size_t i = 0; i < capacity_; ++i) {
+    uint64_t slot = slots_[idx].load(std::memory_order_acquire);
+    uint32_t slot_key = SlotKey(slot);
+    if (slot_key == static_cast<uint32_t>(key)) {
+      slots_[idx].compare_exchange_strong(slot, new_slot,
+                                          std::memory_order_release);
+      return;
+    }
+    if (slot_key == TOMBSTONE_KEY && target == capacity_)
+      target = idx;
+    if (slot_key == EMPTY_KEY) {
+      if (target == capacity_)
+        target = idx;
+      break;
+    }
+    idx = (idx + 1) & (capacity_ - 1);
+  }
+  assert(target != capacity_); // table sized for the buffer pool, never full
+
+  uint64_t expected = slots_[target].load(std::memory_order_relaxed);
+  bool claimed = slots_[target].compare_exchange_strong(
+      expected, new_slot, std::memory_order_release);
+  assert(claimed);
+  (void)claimed;
+}
+
+/*
+ * delete <key,value> entry in hash table
+ * The slot becomes a tombstone so probes for other keys keep going. If the
+ * next slot is empty nobody probes past this one, so the tombstone and the
+ * ones right before it are turned back into empty slots.
+ */
+template <typename V> bool LockFreeHashTable<V>::Remove(const page_id_t &key) {
+  size_t idx = HashKey(key);
+  for (size_t i = 0; i < capacity_; ++i) {
+    uint64_t slot = slots_[idx].load(std::memory_order_acquire);
+    uint32_t slot_key = SlotKey(slot);
+    if (slot_key == EMPTY_KEY)
+      return false;
+    if (slot_key == static_cast<uint32_t>(key)) {
+      if (!slots_[idx].compare_exchange_strong(slot,
+                                               MakeSlot(TOMBSTONE_KEY, 0),
+                                               std::memory_order_release))
+        return false;
+
+      const uint64_t empty = MakeSlot(EMPTY_KEY, 0);
+      size_t next = (idx + 1) & (capacity_ - 1);
+      if (slots_[next].load(std::memory_order_acquire) == empty) {
+        while (SlotKey(slots_[idx].load(std::memory_order_acquire)) ==
+               TOMBSTONE_KEY) {
+          slots_[idx].store(empty, std::memory_order_release);
+          idx = (idx + capacity_ - 1) & (capacity_ - 1);
+        }
+      }
+      return true;
+    }
+    idx = (idx + 1) & (capacity_ - 1);
+  }
+  return false;
+}
+
+template class LockFreeHashTable<Page *>;
+// test only
+template class LockFreeHashTable<int>;
+
+} // namespace cmudb
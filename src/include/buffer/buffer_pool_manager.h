@@ -7,32 +7,86 @@
  */
 
 #pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <list>
 #include <mutex>
+#include <thread>
+#include <unordered_set>
 
+#include "buffer/clock_replacer.h"
+#include "buffer/frame_arena.h"
+#include "buffer/lru_k_replacer.h"
 #include "buffer/lru_replacer.h"
+#include "buffer/page_guard.h"
 #include "disk/disk_manager.h"
 #include "hash/extendible_hash.h"
+#include "hash/lock_free_hash_table.h"
 #include "page/page.h"
 
 namespace cmudb {
+class LogManager;
+
 class BufferPoolManager {
+  friend class ParallelBufferPoolManager;
+
 public:
   BufferPoolManager(size_t pool_size, const std::string &db_file);
 
-  ~BufferPoolManager();
+  // share an existing disk manager (not owned by the buffer pool)
+  BufferPoolManager(size_t pool_size, DiskManager *disk_manager,
+                    LogManager *log_manager = nullptr,
+                    ReplacerType replacer_type = ReplacerType::LRU,
+                    NumaPolicy numa_policy = NumaPolicy::NONE,
+                    int numa_node = 0);
+
+  virtual ~BufferPoolManager();
+
+  virtual Page *FetchPage(page_id_t page_id);
+
+  // FetchPage() plus the page's read/write latch, released together with
+  // the pin by the returned guard. The guard is invalid if FetchPage failed.
+  ReadPageGuard FetchPageRead(page_id_t page_id);
+  WritePageGuard FetchPageWrite(page_id_t page_id);
+
+  virtual bool UnpinPage(page_id_t page_id, bool is_dirty);
+
+  virtual bool FlushPage(page_id_t page_id);
 
-  Page *FetchPage(page_id_t page_id);
+  virtual void FlushAllPages();
 
-  bool UnpinPage(page_id_t page_id, bool is_dirty);
+  // pages of a segment are allocated out of its extents (see DiskManager)
+  virtual Page *NewPage(page_id_t &page_id,
+                        segment_id_t segment_id = INVALID_SEGMENT_ID);
+  inline segment_id_t CreateSegment() {
+    return disk_manager_->CreateSegment();
+  }
+  inline void DropSegment(segment_id_t segment_id) {
+    disk_manager_->DropSegment(segment_id);
+  }
+  // frames are as large as the pages of the database
+  inline size_t GetPageSize() const { return disk_manager_->GetPageSize(); }
 
-  bool FlushPage(page_id_t page_id);
+  virtual bool DeletePage(page_id_t page_id);
 
-  void FlushAllPages();
+  // Read-ahead: start reading page_id into a frame in the background and
+  // return at once. The page is left unpinned for a later FetchPage().
+  // return false if nothing was queued (resident, not allocated, no frame)
+  virtual bool PrefetchPage(page_id_t page_id);
+  // PrefetchPage() for [first_page_id, first_page_id + count)
+  virtual void PrefetchRange(page_id_t first_page_id, size_t count);
 
-  Page *NewPage(page_id_t &page_id);
+  // Background flusher: woken up when more than high (a fraction of the
+  // pool) of the frames are dirty, it writes unpinned dirty pages back in
+  // page id order until at most low are dirty.
+  virtual void SetDirtyWatermarks(double low, double high);
 
-  bool DeletePage(page_id_t page_id);
+  // Flusher metrics: fraction of frames holding a dirty page, pages written
+  // back by the flusher in total and per second over its last round
+  virtual double GetDirtyRatio();
+  virtual uint64_t GetFlushedPageCount();
+  virtual double GetFlushRate();
 
   //Helper functions//
  
@@ -45,12 +99,61 @@ public:
   //adds to free list
   bool AddToFreeList(Page *tmp_page); 
 
+  //Claim a frame for a page id that has already been allocated
+  //on disk and pin it. Returns nullptr if all frames are pinned.
+  Page *NewPageWithId(page_id_t page_id);
+
+  //Frame reservation: ClaimFrame/ReserveFrame run under latch_,
+  //FinishFrameIO does the disk I/O without it, then CompleteFrameIO
+  Page *ClaimFrame(page_id_t &evicted_page_id);
+  void ReserveFrame(Page *tmp_page, page_id_t page_id);
+  void FinishFrameIO(Page *tmp_page, page_id_t evicted_page_id,
+                     bool read_page);
+  void CompleteFrameIO(Page *tmp_page, page_id_t evicted_page_id);
+  //The read failed its checksum or the I/O failed, give the frame up
+  void AbortFrameIO(Page *tmp_page, page_id_t evicted_page_id);
+  void ReleaseAbortedFrame(Page *tmp_page);
+
+  //Latch-free pin of a resident page, false if it lost a race
+  bool TryPinFrame(Page *tmp_page, page_id_t page_id);
+  //Same without touching the replacer, and the matching unpin
+  bool PinFrame(Page *tmp_page, page_id_t page_id);
+  void UnpinFrame(Page *tmp_page);
+  //The delete DeletePage() left to the last unpin
+  void DeletePendingPage(Page *tmp_page);
+
+  //Dirty flag transitions, keep dirty_count_ in step
+  void MarkDirty(Page *tmp_page);
+  bool ClearDirty(Page *tmp_page);
+
+  //Flusher thread body and one write back round
+  void FlusherLoop();
+  size_t FlushDirtyPages(size_t target);
+  //Write back copies of pinned pages and unpin them, flush_latch_ held
+  void WriteCopies(std::vector<std::pair<page_id_t, Page *>> &batch,
+                   std::vector<std::pair<page_id_t, const char *>> &writes);
+  //Caller holds latch_ through lock
+  void WaitForFlush(std::unique_lock<std::mutex> &lock, page_id_t page_id);
+
+  //Prefetch thread body, runs the reads queued by PrefetchPage()
+  void PrefetchLoop();
+  //Its I/O calls, false instead of an exception if the I/O failed
+  bool SubmitPrefetchIO(std::vector<DiskRequest> &requests);
+  bool WaitPrefetchIO(DiskRequest &request);
+  //Access bookkeeping of a fetch hit
+  void RecordHit(Page *tmp_page);
+
 
 private:
   size_t pool_size_;
+  // huge page backed memory of the frames
+  FrameArena *arena_;
   // array of pages
   Page *pages_;
-  DiskManager disk_manager_;
+  DiskManager *disk_manager_;
+  // true when the disk manager was created from db_file by this pool
+  bool owns_disk_manager_;
+  LogManager *log_manager_;
   // to keep track of page id and its memory location
   HashTable<page_id_t, Page *> *page_table_;
   // to collect unpinned pages for replacement
@@ -60,5 +163,32 @@ private:
   // to protect shared data structure, you may need it for synchronization
   // between replacer and page table
   std::mutex latch_;
+  // dirty pages evicted but not yet written back; fetching one of them must
+  // wait, the copy on disk is stale until the write completes
+  std::unordered_set<page_id_t> write_back_set_;
+  std::condition_variable write_back_cv_;
+  // serializes writing back pages that stay in their frames (FlushPage(),
+  // FlushAllPages() and the flusher), from copying them to the write
+  std::mutex flush_latch_;
+  // pages whose copy is being written back by a flush, unpinned; evicting
+  // one writes it back after the flush, whether or not the flush failed
+  std::unordered_set<page_id_t> flush_set_;
+  // background flusher, not started for an empty pool
+  std::thread flusher_;
+  std::mutex flusher_mutex_;
+  std::condition_variable flusher_cv_;
+  bool flusher_stop_;
+  std::atomic<double> dirty_low_watermark_;
+  std::atomic<double> dirty_high_watermark_;
+  std::atomic<size_t> dirty_count_;
+  std::atomic<uint64_t> flushed_page_count_;
+  std::atomic<double> flush_rate_;
+  // prefetch thread and its queue of reserved frames (with the page to write
+  // back first, if any), not started for an empty pool
+  std::thread prefetcher_;
+  std::mutex prefetch_mutex_;
+  std::condition_variable prefetch_cv_;
+  std::deque<std::pair<Page *, page_id_t>> prefetch_queue_;
+  bool prefetch_stop_;
 };
 } // namespace cmudb
@@ -0,0 +1,54 @@
+/**
+ * clock_replacer.h
+ *
+ * Functionality: CLOCK (second chance) approximation of LRU. Every frame has a
+ * slot in flat arrays indexed by frame id (value - base), holding whether the
+ * frame is in the replacer and its reference bit. Insert/Erase are O(1)
+ * atomic stores with no allocation; only Victim, which moves the clock hand,
+ * takes a mutex.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+
+#include "buffer/replacer.h"
+
+namespace cmudb {
+
+template <typename T> class ClockReplacer : public Replacer<T> {
+public:
+  // values handled by the replacer must lie in [base, base + num_frames)
+  ClockReplacer(size_t num_frames, T base = T());
+
+  ~ClockReplacer();
+
+  void Insert(const T &value);
+
+  bool Victim(T &value);
+
+  bool Erase(const T &value);
+
+  size_t Size();
+
+  bool Contains(const T &value);
+
+private:
+  inline size_t FrameId(const T &value) const {
+    return static_cast<size_t>(value - base_);
+  }
+
+  size_t num_frames_;
+  T base_;
+  // is the frame currently a replacement candidate
+  std::atomic<bool> *in_replacer_;
+  // reference bit, set on every Insert and cleared by the clock hand
+  std::atomic<bool> *ref_bit_;
+  std::atomic<size_t> size_;
+  // protects the clock hand
+  std::mutex hand_mutex_;
+  size_t hand_;
+};
+
+} // namespace cmudb
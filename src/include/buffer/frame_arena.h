@@ -0,0 +1,69 @@
+/**
+ * frame_arena.h
+ *
+ * Functionality: Memory behind the frames of one buffer pool. The page data
+ * of all frames is one anonymous mapping, backed by 2MB huge pages when the
+ * kernel has them reserved (and transparent huge pages otherwise), so a scan
+ * over the pool does not thrash the TLB. Frame i starts at i * page_size
+ * from the huge page aligned base.
+ *
+ * The bookkeeping of the frames (page id, pin count, dirty flag, latch) is
+ * kept apart from the data, in an array of cache line aligned Page objects,
+ * so pinning a frame never shares a cache line with another frame or with
+ * page contents another core is reading.
+ *
+ * Optionally the data mapping is interleaved over all NUMA nodes or bound to
+ * a single node before it is first touched.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+#include "page/page.h"
+
+namespace cmudb {
+
+enum class NumaPolicy {
+  NONE = 0,   // first touch, whatever node the kernel picks
+  INTERLEAVE, // spread the frames round robin over all nodes
+  BIND        // place every frame on one node
+};
+
+class FrameArena {
+public:
+  // numa_node is only used by NumaPolicy::BIND; page_size is the size of
+  // one frame, the page size of the database the pool caches
+  FrameArena(size_t frame_count, NumaPolicy numa_policy = NumaPolicy::NONE,
+             int numa_node = 0, size_t page_size = PAGE_SIZE);
+  ~FrameArena();
+
+  // frame descriptors, frame_count consecutive Page objects
+  inline Page *GetPages() { return pages_; }
+  inline size_t GetFrameCount() const { return frame_count_; }
+  inline size_t GetPageSize() const { return page_size_; }
+  // true when the data mapping got explicit (MAP_HUGETLB) huge pages
+  inline bool IsHugePageBacked() const { return huge_pages_; }
+  // false when a NUMA policy was asked for but the kernel refused it
+  inline bool IsNumaApplied() const { return numa_applied_; }
+
+  // number of NUMA nodes online, 1 on machines without NUMA
+  static int GetNumaNodeCount();
+
+private:
+  FrameArena(const FrameArena &) = delete;
+  FrameArena &operator=(const FrameArena &) = delete;
+
+  bool ApplyNumaPolicy(NumaPolicy numa_policy, int numa_node);
+
+  size_t frame_count_;
+  size_t page_size_;
+  Page *pages_;
+  size_t pages_size_;
+  char *data_;
+  size_t data_size_;
+  bool huge_pages_;
+  bool numa_applied_;
+};
+
+} // namespace cmudb
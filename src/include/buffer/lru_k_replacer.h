@@ -0,0 +1,64 @@
+/**
+ * lru_k_replacer.h
+ *
+ * Functionality: LRU-K replacement. The replacer remembers the timestamps of
+ * the last K accesses of every frame and evicts the frame whose backward
+ * K-distance (now - timestamp of its K-th most recent access) is the largest.
+ * Frames with fewer than K accesses have an infinite distance and go first,
+ * oldest access first. A page touched once by a sequential scan therefore
+ * never pushes out pages that are accessed over and over (e.g. B+ tree
+ * internal pages).
+ *
+ * Like ClockReplacer, per-frame state lives in flat arrays indexed by frame
+ * id (value - base).
+ */
+
+#pragma once
+
+#include <mutex>
+
+#include "buffer/replacer.h"
+
+namespace cmudb {
+
+template <typename T> class LRUKReplacer : public Replacer<T> {
+public:
+  // values handled by the replacer must lie in [base, base + num_frames)
+  LRUKReplacer(size_t num_frames, size_t k, T base = T());
+
+  ~LRUKReplacer();
+
+  void Insert(const T &value);
+
+  bool Victim(T &value);
+
+  bool Erase(const T &value);
+
+  size_t Size();
+
+  bool Contains(const T &value);
+
+  void RecordAccess(const T &value, bool reset = false);
+
+private:
+  inline size_t FrameId(const T &value) const {
+    return static_cast<size_t>(value - base_);
+  }
+
+  size_t num_frames_;
+  size_t k_;
+  T base_;
+  // logical clock, incremented on every access
+  uint64_t current_timestamp_;
+  // ring of the last k access timestamps of each frame (num_frames * k)
+  uint64_t *history_;
+  // number of valid timestamps (<= k) and next ring slot of each frame
+  size_t *history_count_;
+  size_t *history_head_;
+  // is the frame currently a replacement candidate
+  bool *evictable_;
+  size_t size_;
+  std::mutex latch_;
+};
+
+} // namespace cmudb
@@ -31,6 +31,8 @@ public:
 
   size_t Size();
 
+  bool Contains(const T &value);
+
   void rd_lock();
 
   void rd_unlock();
@@ -0,0 +1,67 @@
+/**
+ * mmap_buffer_pool_manager.h
+ *
+ * Functionality: Read only buffer pool over a MmapDiskManager. FetchPage()
+ * returns a Page whose data points straight into the mapping of the db file:
+ * there is no frame to copy the page into, nothing to evict and nothing to
+ * write back, and pinning a page is only a reference count. The kernel page
+ * cache does the caching.
+ *
+ * Page descriptors are created the first time a page of their chunk is
+ * fetched and live as long as the pool, so readers can still latch pages as
+ * they would in a regular pool. The mapping is read only: writing to a page
+ * faults, and NewPage()/DeletePage() fail.
+ *
+ * Prefetching (the ReadAhead of TableIterator and IndexIterator) turns into
+ * MADV_WILLNEED hints for the pages ahead of the scan.
+ *
+ * It is a BufferPoolManager, so BPlusTree lookups and TableIterator scans
+ * work on it unchanged.
+ */
+
+#pragma once
+#include <atomic>
+
+#include "buffer/buffer_pool_manager.h"
+#include "disk/mmap_disk_manager.h"
+
+namespace cmudb {
+
+class MmapBufferPoolManager : public BufferPoolManager {
+public:
+  // the disk manager is owned by the caller and must outlive the pool
+  explicit MmapBufferPoolManager(MmapDiskManager *disk_manager);
+  ~MmapBufferPoolManager();
+
+  // nullptr for page ids outside of the file
+  Page *FetchPage(page_id_t page_id) override;
+
+  // is_dirty is ignored, nothing can have written to the page
+  bool UnpinPage(page_id_t page_id, bool is_dirty) override;
+
+  // nothing is ever dirty
+  bool FlushPage(page_id_t page_id) override;
+  void FlushAllPages() override;
+
+  // the file can not grow or shrink: nullptr / false
+  Page *NewPage(page_id_t &page_id,
+                segment_id_t segment_id = INVALID_SEGMENT_ID) override;
+  bool DeletePage(page_id_t page_id) override;
+
+  bool PrefetchPage(page_id_t page_id) override;
+  void PrefetchRange(page_id_t first_page_id, size_t count) override;
+
+private:
+  // descriptors are allocated PAGES_PER_CHUNK at a time
+  static const page_id_t PAGES_PER_CHUNK = 1024;
+
+  // descriptor of a page inside the file, its chunk created on first use
+  Page *GetDescriptor(page_id_t page_id);
+
+  MmapDiskManager *mmap_disk_manager_;
+  page_id_t page_count_;
+  size_t chunk_count_;
+  std::atomic<Page *> *chunks_;
+};
+
+} // namespace cmudb
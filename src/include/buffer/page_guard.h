@@ -0,0 +1,112 @@
+/**
+ * page_guard.h
+ *
+ * Functionality: Scoped handles on a buffer pool page, returned by
+ * BufferPoolManager::FetchPageRead/FetchPageWrite. A guard owns one pin and
+ * the page's read (resp. write) latch, and gives both back when it is
+ * destroyed or Drop()ped: unlatch first, then unpin. A WritePageGuard unpins
+ * the page dirty if it was modified through AsMut()/GetDataMut() or
+ * SetDirty().
+ *
+ * Guards are move-only, so a page can be handed over (e.g. an iterator
+ * moving to the next leaf) without ever being unpinned twice or leaked.
+ * A default-constructed or moved-from guard holds nothing (IsValid() false).
+ */
+
+#pragma once
+
+#include <type_traits>
+
+#include "page/page.h"
+
+namespace cmudb {
+
+class BufferPoolManager;
+
+/*
+ * View a page as T: table/header pages derive from Page, b+ tree pages are
+ * laid over the page data, which lives apart from the Page in the arena.
+ */
+template <typename T> inline T *PageCast(Page *page, std::true_type) {
+  return static_cast<T *>(page);
+}
+template <typename T> inline T *PageCast(Page *page, std::false_type) {
+  return reinterpret_cast<T *>(page->GetData());
+}
+template <typename T> inline T *PageCast(Page *page) {
+  return PageCast<T>(page, std::is_base_of<Page, T>());
+}
+
+class ReadPageGuard {
+public:
+  ReadPageGuard() : buffer_pool_manager_(nullptr), page_(nullptr) {}
+  // page must already be pinned and read latched by the caller
+  ReadPageGuard(BufferPoolManager *buffer_pool_manager, Page *page)
+      : buffer_pool_manager_(buffer_pool_manager), page_(page) {}
+
+  ReadPageGuard(const ReadPageGuard &) = delete;
+  ReadPageGuard &operator=(const ReadPageGuard &) = delete;
+  ReadPageGuard(ReadPageGuard &&that);
+  ReadPageGuard &operator=(ReadPageGuard &&that);
+
+  ~ReadPageGuard() { Drop(); }
+
+  // unlatch and unpin the page now
+  void Drop();
+
+  inline bool IsValid() const { return page_ != nullptr; }
+  inline page_id_t GetPageId() const { return page_->GetPageId(); }
+  inline const char *GetData() const { return page_->GetData(); }
+  // view the page as a table/tree page; it must not be modified through it
+  template <typename T> inline T *As() const {
+    return PageCast<T>(page_);
+  }
+
+private:
+  BufferPoolManager *buffer_pool_manager_;
+  Page *page_;
+};
+
+class WritePageGuard {
+public:
+  WritePageGuard()
+      : buffer_pool_manager_(nullptr), page_(nullptr), is_dirty_(false) {}
+  // page must already be pinned and write latched by the caller
+  WritePageGuard(BufferPoolManager *buffer_pool_manager, Page *page)
+      : buffer_pool_manager_(buffer_pool_manager), page_(page),
+        is_dirty_(false) {}
+
+  WritePageGuard(const WritePageGuard &) = delete;
+  WritePageGuard &operator=(const WritePageGuard &) = delete;
+  WritePageGuard(WritePageGuard &&that);
+  WritePageGuard &operator=(WritePageGuard &&that);
+
+  ~WritePageGuard() { Drop(); }
+
+  // unlatch and unpin the page now
+  void Drop();
+
+  inline bool IsValid() const { return page_ != nullptr; }
+  inline page_id_t GetPageId() const { return page_->GetPageId(); }
+  inline const char *GetData() const { return page_->GetData(); }
+  inline char *GetDataMut() {
+    is_dirty_ = true;
+    return page_->GetData();
+  }
+  template <typename T> inline T *As() const {
+    return PageCast<T>(page_);
+  }
+  template <typename T> inline T *AsMut() {
+    is_dirty_ = true;
+    return PageCast<T>(page_);
+  }
+  // for changes made through As() that turn out to modify the page
+  inline void SetDirty() { is_dirty_ = true; }
+
+private:
+  BufferPoolManager *buffer_pool_manager_;
+  Page *page_;
+  bool is_dirty_;
+};
+
+} // namespace cmudb
@@ -0,0 +1,69 @@
+/**
+ * parallel_buffer_pool_manager.h
+ *
+ * Functionality: A buffer pool made of several independent BufferPoolManager
+ * instances. Each instance has its own latch, free list, page table and
+ * replacer, and owns the pages whose id hashes to it (page_id % instances).
+ * Threads touching different instances never contend on a latch, so the pool
+ * scales with the number of cores instead of serializing on one latch_.
+ *
+ * It is a BufferPoolManager, so BPlusTree, TableHeap, etc. can use it
+ * unchanged.
+ */
+
+#pragma once
+#include <atomic>
+#include <vector>
+
+#include "buffer/buffer_pool_manager.h"
+
+namespace cmudb {
+class ParallelBufferPoolManager : public BufferPoolManager {
+public:
+  // pool_size frames per instance, num_instances * pool_size in total
+  ParallelBufferPoolManager(size_t num_instances, size_t pool_size,
+                            DiskManager *disk_manager,
+                            LogManager *log_manager = nullptr,
+                            ReplacerType replacer_type = ReplacerType::LRU,
+                            NumaPolicy numa_policy = NumaPolicy::NONE);
+
+  ~ParallelBufferPoolManager();
+
+  Page *FetchPage(page_id_t page_id) override;
+
+  bool UnpinPage(page_id_t page_id, bool is_dirty) override;
+
+  bool FlushPage(page_id_t page_id) override;
+
+  void FlushAllPages() override;
+
+  Page *NewPage(page_id_t &page_id,
+                segment_id_t segment_id = INVALID_SEGMENT_ID) override;
+
+  bool DeletePage(page_id_t page_id) override;
+
+  bool PrefetchPage(page_id_t page_id) override;
+
+  // every instance runs its own flusher; metrics are summed over them
+  void SetDirtyWatermarks(double low, double high) override;
+
+  double GetDirtyRatio() override;
+
+  uint64_t GetFlushedPageCount() override;
+
+  double GetFlushRate() override;
+
+  // total number of frames across all instances
+  inline size_t GetPoolSize() const {
+    return instances_.size() * instance_pool_size_;
+  }
+
+private:
+  // instance responsible for the given page id
+  BufferPoolManager *GetInstance(page_id_t page_id);
+
+  // frames per instance
+  size_t instance_pool_size_;
+  std::vector<BufferPoolManager *> instances_;
+};
+} // namespace cmudb
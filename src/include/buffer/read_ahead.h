@@ -0,0 +1,36 @@
+/**
+ * read_ahead.h
+ *
+ * Functionality: Sequential access detector for scans (TableIterator,
+ * IndexIterator). The scan reports every page it moves to. Once it steps
+ * from a page to the page with the next id, the following pages are
+ * prefetched through the buffer pool, and the window is topped up as the
+ * scan advances, so reads stay in flight ahead of the tuples being
+ * processed. A jump to a non adjacent page stops the read-ahead until the
+ * scan is sequential again.
+ */
+
+#pragma once
+
+#include "buffer/buffer_pool_manager.h"
+
+namespace cmudb {
+
+class ReadAhead {
+public:
+  ReadAhead(BufferPoolManager *buffer_pool_manager,
+            size_t window = PREFETCH_WINDOW);
+
+  // the scan moved to page_id
+  void Access(page_id_t page_id);
+
+private:
+  BufferPoolManager *buffer_pool_manager_;
+  // number of pages kept in flight ahead of the scan
+  page_id_t window_;
+  page_id_t last_page_id_;
+  // pages up to this id have been prefetched already
+  page_id_t prefetched_until_;
+};
+
+} // namespace cmudb
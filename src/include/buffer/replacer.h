@@ -9,6 +9,9 @@
 
 namespace cmudb {
 
+// replacement policies the buffer pool can be built with
+enum class ReplacerType { LRU = 0, CLOCK, LRU_K };
+
 template <typename T> class Replacer {
 public:
   Replacer() {}
@@ -17,6 +20,12 @@ public:
   virtual bool Victim(T &value) = 0;
   virtual bool Erase(const T &value) = 0;
   virtual size_t Size() = 0;
+  // is value currently a replacement candidate
+  virtual bool Contains(const T &value) = 0;
+  // Called by the buffer pool on every page access, for policies that need
+  // the access history. reset == true means the frame was just loaded with a
+  // different page, so the previous history no longer applies.
+  virtual void RecordAccess(const T &value, bool reset = false) {}
 };
 
 } // namespace cmudb
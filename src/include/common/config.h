@@ -10,10 +10,30 @@ namespace cmudb {
 
 #define INVALID_PAGE_ID -1 // representing an invalid page id
 #define INVALID_TXN_ID -1  // representing an invalid txn id
+#define INVALID_SEGMENT_ID -1 // pages not allocated for any segment
 #define HEADER_PAGE_ID 0   // the header page id
-//#define PAGE_SIZE 4096     // size of a data page in byte
-#define PAGE_SIZE 88     // size of a data page in byte
+#define PAGE_SIZE 4096     // default size of a data page in byte
+#define MIN_PAGE_SIZE 4096 // smallest page size a database can be created with
+#define MAX_PAGE_SIZE 32768 // largest page size a database can be created with
+#define DB_FILE_HEADER_SIZE 4096 // db file bytes in front of page 0
+#define PAGE_CHECKSUM_SIZE 4 // CRC32C trailer at the end of every page
+#define PAGE_DATA_SIZE (PAGE_SIZE - PAGE_CHECKSUM_SIZE) // usable bytes of a default page
 #define BUCKET_SIZE 50     // size of extendible hash bucket
+#define LRUK_REPLACER_K 2  // number of accesses tracked by the LRU-K replacer
+#define DIRTY_HIGH_WATERMARK 0.5 // dirty share of the pool that wakes the flusher
+#define DIRTY_LOW_WATERMARK 0.25 // dirty share the flusher writes back down to
+#define FLUSHER_INTERVAL_MS 100  // flusher wake up period in milliseconds
+#define FLUSH_BATCH_SIZE 256 // pages the flusher writes back per synced batch
+#define PREFETCH_WINDOW 8  // pages a sequential scan keeps in flight ahead
+#define CACHELINE_SIZE 64  // frame descriptors are aligned to this
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024) // frame arena mapping granularity
+#define URING_QUEUE_DEPTH 64 // io_uring submission queue entries
+#define DIRECT_IO_ALIGNMENT 4096 // buffer/offset alignment of O_DIRECT I/O
+#define EXTENT_SIZE 64     // contiguous pages a segment allocates at a time
+#define COMPRESSION_SIZE_CLASSES 8 // on disk slot sizes of a compressed page
+#define BULK_LOAD_FILL_FACTOR 0.9 // share of a B+ tree page a bulk load fills
+#define BULK_LOAD_RUN_SIZE (1 << 20) // entries a bulk load sorts in memory at a time
+#define RANGE_SCAN_BATCH_SIZE 64 // values a range scan hands back at a time
 
 //Helper defs
 #define INVALID_INDEX -1
@@ -21,5 +41,6 @@ namespace cmudb {
 
 typedef int32_t page_id_t; // page id type
 typedef int32_t txn_id_t;  // transaction id type
+typedef int32_t segment_id_t; // segment (table heap, index) id type
 
 } // namespace cmudb
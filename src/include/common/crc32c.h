@@ -0,0 +1,20 @@
+/**
+ * crc32c.h
+ *
+ * CRC32C (Castagnoli), the checksum stamped on every page written to disk.
+ * Built with SSE4.2 (-march=native on a CPU that has it) it uses the crc32
+ * instruction, 8 bytes at a time; otherwise a lookup table, a byte at a time.
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace cmudb {
+
+uint32_t Crc32c(const char *data, size_t size);
+
+// true when Crc32c() runs on the crc32 instruction
+bool Crc32cIsHardware();
+
+} // namespace cmudb
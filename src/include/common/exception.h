@@ -10,6 +10,7 @@
 #include <memory>
 #include <stdexcept>
 
+#include "common/config.h"
 #include "type/type.h"
 
 namespace cmudb {
@@ -41,6 +42,7 @@ enum ExceptionType {
   EXCEPTION_TYPE_STAT = 20,             // stat related
   EXCEPTION_TYPE_CONNECTION = 21,       // connection related
   EXCEPTION_TYPE_SYNTAX = 22,           // syntax related
+  EXCEPTION_TYPE_IO = 23,               // disk I/O related
 };
 
 class Exception : public std::runtime_error {
@@ -107,6 +109,8 @@ public:
       return "Connection";
     case EXCEPTION_TYPE_SYNTAX:
       return "Syntax";
+    case EXCEPTION_TYPE_IO:
+      return "I/O";
     default:
       return "Unknown";
     }
@@ -341,4 +345,29 @@ public:
       : Exception(EXCEPTION_TYPE_CONNECTION, msg) {}
 };
 
+// a page read from disk does not match its checksum: torn write or corruption
+class PageCorruptionException : public Exception {
+  PageCorruptionException() = delete;
+
+public:
+  PageCorruptionException(page_id_t page_id, uint32_t stored,
+                          uint32_t computed)
+      : Exception(EXCEPTION_TYPE_IO,
+                  "checksum mismatch on page " + std::to_string(page_id) +
+                      ": stored " + std::to_string(stored) + ", computed " +
+                      std::to_string(computed)),
+        page_id_(page_id) {}
+
+  // the read was done (and failed) by another thread
+  PageCorruptionException(page_id_t page_id)
+      : Exception(EXCEPTION_TYPE_IO,
+                  "checksum mismatch on page " + std::to_string(page_id)),
+        page_id_(page_id) {}
+
+  inline page_id_t GetPageId() const { return page_id_; }
+
+private:
+  page_id_t page_id_;
+};
+
 } // namespace cmudb
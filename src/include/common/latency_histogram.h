@@ -0,0 +1,52 @@
+/**
+ * latency_histogram.h
+ *
+ * Lock free latency histogram in the style of HdrHistogram: values (in
+ * nanoseconds) are counted in buckets that split every power of two into
+ * 2^SUB_BUCKET_BITS equal steps, so a percentile is off by at most 1/8th of
+ * the value whatever its magnitude, and recording is one relaxed atomic
+ * increment per counter. Many threads can record while others read.
+ */
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace cmudb {
+
+class LatencyHistogram {
+public:
+  LatencyHistogram();
+
+  void Record(uint64_t value);
+  void Reset();
+
+  inline uint64_t GetCount() const { return count_.load(); }
+  inline uint64_t GetSum() const { return sum_.load(); }
+  inline uint64_t GetMax() const { return max_.load(); }
+  // smallest bucket bound at or above the given share (0..1) of the
+  // values, 0 if nothing was recorded
+  uint64_t GetPercentile(double percentile) const;
+
+  // steady clock, for the start and end of a timed call
+  static uint64_t NowNanos();
+
+private:
+  static const int SUB_BUCKET_BITS = 3;
+  static const uint64_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+  // values below SUB_BUCKETS get a bucket each, then SUB_BUCKETS buckets
+  // per power of two up to 2^63
+  static const size_t BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+  static size_t BucketIndex(uint64_t value);
+  // largest value that falls into the bucket
+  static uint64_t BucketUpperBound(size_t index);
+
+  std::atomic<uint64_t> buckets_[BUCKET_COUNT];
+  std::atomic<uint64_t> count_;
+  std::atomic<uint64_t> sum_;
+  std::atomic<uint64_t> max_;
+};
+
+} // namespace cmudb
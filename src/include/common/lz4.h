@@ -0,0 +1,31 @@
+/**
+ * lz4.h
+ *
+ * LZ4 block compression, the codec of compressed pages. The output is a
+ * plain LZ4 block (no frame header), the format of LZ4_compress_default()
+ * and LZ4_decompress_safe() of the lz4 library, which can read and write
+ * it as well:
+ *  ---------------------------------------------------------------------
+ * | Token (1) | LiteralLength (0+) | Literals | Offset (2) | MatchLength (0+)
+ *  ---------------------------------------------------------------------
+ * repeated, the last sequence having literals only. The high 4 bits of the
+ * token are the literal length, the low 4 bits the match length minus 4;
+ * 15 means more length bytes follow, each adding up to 255. Offset is how
+ * far back the match starts in the output, little endian.
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace cmudb {
+
+// 0 if the block would not fit in capacity
+size_t Lz4Compress(const char *src, size_t size, char *dst, size_t capacity);
+
+// bytes decoded, -1 if src is not a valid block or decodes to more than
+// capacity bytes
+int64_t Lz4Decompress(const char *src, size_t length, char *dst,
+                      size_t capacity);
+
+} // namespace cmudb
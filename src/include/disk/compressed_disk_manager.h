@@ -0,0 +1,106 @@
+/**
+ * compressed_disk_manager.h
+ *
+ * Disk manager that stores pages compressed. A page is compressed when it is
+ * written and decompressed when it is read, so the buffer pool and the page
+ * layouts above it see plain pages. Table heap pages compress well: the free
+ * space between the slot array and the tuples is a run of zeros.
+ *
+ * Compressed pages vary in size, so a page no longer sits at a fixed
+ * offset. Each page gets a slot in the db file behind its header (see
+ * disk_manager.h), of one of COMPRESSION_SIZE_CLASSES sizes (multiples of
+ * page size / COMPRESSION_SIZE_CLASSES). The page indirection map maps page
+ * ids to slots. It is kept next to the db file (<db>.pim) and written through:
+ *  ----------------------------------------------------------------
+ * | Magic (4) | PageSize (4) | ... (8) | Slot 0 (16) | Slot 1 (16) | ...
+ *  ----------------------------------------------------------------
+ * A slot is {Offset (8), Length (4), Size (4)}, Length 0 for a page never
+ * written and Length == page size for a page stored as is (it did not
+ * compress). A rewritten page stays in its slot if it still fits that size,
+ * otherwise it moves and the old slot is reused by later writes, once the
+ * map is synced.
+ *
+ * A database is compressed or not for its whole life, the db file header
+ * says which. Opening a plain database here, or a compressed one with the
+ * plain DiskManager, throws, and so does a db file with pages but no map.
+ */
+
+#pragma once
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "disk/disk_manager.h"
+
+namespace cmudb {
+
+class CompressedDiskManager : public DiskManager {
+public:
+  CompressedDiskManager(const std::string &db_file,
+                        size_t page_size = PAGE_SIZE);
+  ~CompressedDiskManager();
+
+  void WritePage(page_id_t page_id, const char *page_data) override;
+  void ReadPage(page_id_t page_id, char *page_data) override;
+  void WritePages(
+      std::vector<std::pair<page_id_t, const char *>> &pages) override;
+
+  void SubmitRequests(DiskRequest *requests, size_t count) override;
+  void WaitRequest(DiskRequest &request) override;
+
+  // bytes the written pages take in the db file, and what they would take
+  // uncompressed
+  uint64_t GetStoredBytes();
+  uint64_t GetLogicalBytes();
+
+  // LZ4 blocks (common/lz4.h). Besides the free space of a page, repeated
+  // bytes across tuples and fields (equal values, zeroed padding) compress.
+  // Compress() returns 0 if the result would not fit in capacity,
+  // Decompress() false unless the input decodes to exactly size bytes.
+  static size_t Compress(const char *src, size_t size, char *dst,
+                         size_t capacity);
+  static bool Decompress(const char *src, size_t length, char *dst,
+                         size_t size);
+
+private:
+  struct Slot {
+    int64_t offset;
+    uint32_t length;
+    uint32_t size;
+  };
+
+  // false if the db file has pages the map does not describe
+  bool LoadMap();
+  // write the slot of page_id through to the map file, latch_ held
+  void PersistSlot(page_id_t page_id);
+  // a free slot of size bytes, at the end of the file if there is none
+  int64_t AllocateSlot(uint32_t size);
+  // compress and write one page, without syncing
+  void WriteCompressed(page_id_t page_id, const char *page_data);
+  // fdatasync the db, the map and the free space map file, then free the
+  // slots in moved_slots_
+  void Sync();
+  // read and decompress one page, false if it does not decompress
+  bool ReadCompressed(page_id_t page_id, char *page_data);
+
+  // own descriptors of the db and the map file
+  int db_fd_;
+  int map_fd_;
+  // slot sizes are multiples of this
+  size_t slot_unit_;
+  // protects everything below
+  std::mutex latch_;
+  // slot of every page id written so far
+  std::vector<Slot> slots_;
+  // offsets of free slots, indexed by size / slot_unit_
+  std::vector<std::vector<int64_t>> free_slots_;
+  // slots pages moved out of, free once the map is synced
+  std::vector<Slot> moved_slots_;
+  // end of the last slot in the db file
+  int64_t file_end_;
+  // batched reads that did not decompress, reported by WaitRequest()
+  std::unordered_set<DiskRequest *> failed_reads_;
+};
+
+} // namespace cmudb
@@ -11,41 +11,228 @@
 #include <atomic>
 #include <fstream>
 #include <future>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <sys/types.h>
+#include <sys/uio.h>
 
 #include "common/config.h"
+#include "common/latency_histogram.h"
+#include "disk/free_space_map.h"
 
 namespace cmudb {
 
+/*
+ * One page read or write of a batch handed to DiskManager::SubmitRequests().
+ * done is set once the I/O completed; data must stay valid until then.
+ */
+struct DiskRequest {
+  DiskRequest(bool is_write, page_id_t page_id, char *data)
+      : is_write(is_write), page_id(page_id), data(data), io_buffer(data),
+        done(false), failed(false), submit_ns(0) {}
+
+  bool is_write;
+  page_id_t page_id;
+  char *data;
+  // what the backend does the I/O on, an aligned copy of data if needed
+  char *io_buffer;
+  bool done;
+  // the I/O did not (entirely) go through, WaitRequest() throws
+  bool failed;
+  // when an asynchronous backend queued it, for its latency
+  uint64_t submit_ns;
+};
+
+/*
+ * I/O a disk manager did since it was opened or since DiskManager::
+ * ResetStats(). count is I/O calls (a pwritev of a run of pages is one
+ * page write), latencies are of those calls in nanoseconds; for io_uring
+ * from queueing a request until its completion is reaped.
+ */
+struct DiskStats {
+  struct Op {
+    uint64_t count;
+    uint64_t bytes;
+    uint64_t total_ns;
+    uint64_t p50_ns;
+    uint64_t p99_ns;
+    uint64_t max_ns;
+  };
+  Op page_reads;
+  Op page_writes;
+  Op log_writes;
+  Op syncs;
+};
+
+/*
+ * The db file starts with a header of DB_FILE_HEADER_SIZE bytes, pages
+ * follow it, page i at DB_FILE_HEADER_SIZE + i * page size:
+ *  ----------------------------------------------------------------
+ * | Magic (4) | PageSize (4) | Format (4) | ... | Page 0 | Page 1 | ...
+ *  ----------------------------------------------------------------
+ * PageSize is the page size the database was created with, Format whether
+ * its pages are stored as they are or compressed (compressed_disk_manager.h);
+ * a database is only opened by a disk manager of its format. The header is
+ * a multiple of the O_DIRECT alignment, so pages stay aligned.
+ */
 class DiskManager {
 public:
-  DiskManager(const std::string &db_file);
-  ~DiskManager();
+  // page_size is the page size of a new database, one of 4K, 8K, 16K and
+  // 32K; an existing one is opened with the page size it was created with,
+  // whatever is passed here. A read only disk manager opens the files
+  // without creating or changing them, and page writes throw. Throws if
+  // page_size is not a valid page size, or the db file is not a database.
+  DiskManager(const std::string &db_file, size_t page_size = PAGE_SIZE,
+              bool read_only = false);
+  virtual ~DiskManager();
+
+  // how the pages of a db file are stored
+  enum DbFormat { DB_FORMAT_PLAIN = 0, DB_FORMAT_COMPRESSED = 1 };
 
-  void WritePage(page_id_t page_id, const char *page_data);
-  void ReadPage(page_id_t page_id, char *page_data);
+  // a power of two between MIN_PAGE_SIZE and MAX_PAGE_SIZE
+  static inline bool IsValidPageSize(size_t page_size) {
+    return page_size >= MIN_PAGE_SIZE && page_size <= MAX_PAGE_SIZE &&
+           (page_size & (page_size - 1)) == 0;
+  }
+
+  inline bool IsReadOnly() const { return read_only_; }
+
+  // size of every page of the db file, and of the buffers handed to the
+  // page I/O calls
+  inline size_t GetPageSize() const { return page_size_; }
+  // where the page starts in the db file
+  inline off_t GetPageOffset(page_id_t page_id) const {
+    return DB_FILE_HEADER_SIZE + static_cast<off_t>(page_id) * page_size_;
+  }
+  // bytes of a page in front of its checksum
+  inline size_t GetPageDataSize() const {
+    return page_size_ - PAGE_CHECKSUM_SIZE;
+  }
+
+  // Every page carries a CRC32C of its first GetPageDataSize() bytes in its
+  // last PAGE_CHECKSUM_SIZE bytes. Writes add it on the way out and leave
+  // page_data alone (a page being written back is only read latched),
+  // reads check it and throw PageCorruptionException on a mismatch, or if
+  // the file ends inside the page; a read that fails throws Exception. A
+  // page past the end of the file was never written, it reads back as
+  // zeros and passes.
+  virtual void WritePage(page_id_t page_id, const char *page_data);
+  virtual void ReadPage(page_id_t page_id, char *page_data);
+  // Write back a batch of distinct pages and wait until they are on disk:
+  // pages are sorted by id (in place), each run of adjacent ids goes out
+  // with one pwritev, and the batch ends with one fdatasync (and one of
+  // the free space map).
+  virtual void
+  WritePages(std::vector<std::pair<page_id_t, const char *>> &pages);
+
+  // start a batch of page reads/writes, WaitRequest() for each of them
+  // before touching its data. This backend does the I/O right away.
+  // The checksum of a read is checked by WaitRequest().
+  virtual void SubmitRequests(DiskRequest *requests, size_t count);
+  virtual void WaitRequest(DiskRequest &request);
+
+  // skip checksum verification on reads (checksums are still written),
+  // e.g. to benchmark the read path without it
+  inline void SetVerifyChecksums(bool verify) { verify_checksums_ = verify; }
+  inline bool GetVerifyChecksums() const { return verify_checksums_; }
 
   void WriteLog(char *log_data, int size);
   bool ReadLog(char *log_data, int size, int offset);
 
+  // freed pages are handed out again before the file grows; which pages
+  // are in use survives a restart (see free_space_map.h)
   page_id_t AllocatePage();
+  // first page id of count contiguous pages
+  page_id_t AllocatePages(size_t count);
   void DeallocatePage(page_id_t page_id);
 
+  // A segment (one table heap or index) allocates its pages out of extents
+  // of EXTENT_SIZE contiguous pages, so its page chains stay sequential on
+  // disk. Pages of an extent not handed out yet are given back when the
+  // segment is dropped or the disk manager closes.
+  segment_id_t CreateSegment();
+  void DropSegment(segment_id_t segment_id);
+  // next page of the segment's extent, AllocatePage() for INVALID_SEGMENT_ID
+  page_id_t AllocatePage(segment_id_t segment_id);
+
+  // every page id below this one has been handed out
+  inline page_id_t GetNextPageId() const {
+    return free_space_map_->GetNextPageId();
+  }
+  inline size_t GetFreePageCount() { return free_space_map_->GetFreePageCount(); }
+
   int GetNumFlushes() const;
+  // fdatasync calls made by WritePages()
+  inline uint64_t GetNumSyncs() const { return num_syncs_; }
   bool GetFlushState() const;
+  DiskStats GetStats() const;
+  void ResetStats();
   inline void SetFlushLogFuture(std::future<void> *f) { flush_log_f_ = f; }
   inline bool HasFlushLogFuture() { return flush_log_f_ != nullptr; }
 
+protected:
+  // for disk managers that store pages in another format
+  DiskManager(const std::string &db_file, size_t page_size, bool read_only,
+              DbFormat format);
+
+  enum IoKind { IO_PAGE_READ, IO_PAGE_WRITE, IO_LOG_WRITE, IO_SYNC, IO_KINDS };
+  // account one I/O call that started at start_ns (LatencyHistogram::
+  // NowNanos()) and just finished
+  void RecordIo(IoKind kind, uint64_t start_ns, uint64_t bytes);
+  // checksum of the data part of a page
+  uint32_t PageChecksum(const char *page_data) const;
+  // fill in the checksum trailer of a private copy of a page
+  void StampChecksum(char *page_data) const;
+  // throw PageCorruptionException if the page read does not match
+  void VerifyChecksum(page_id_t page_id, const char *page_data) const;
+  // fdatasync the free space map, along with every sync of the db file
+  inline void SyncFreeSpaceMap() { free_space_map_->Sync(); }
+  // the sync that ends WritePages(): db file and free space map
+  void SyncPages();
+
 private:
+  // write the header of a new db file, check the one of an existing file
+  // and take its page size
+  void LoadFileHeader();
+  // ReadPage() without the checksum check
+  void ReadPageData(page_id_t page_id, char *page_data);
   int GetFileSize(const std::string &name);
+  void GrowFileSize(int64_t end);
+  // pwritev iov to the db file at offset, the bytes that made it
+  size_t WriteVector(struct iovec *iov, int count, off_t offset);
   // stream to write log file
   std::fstream log_io_;
   std::string log_name_;
-  // stream to write db file
-  std::fstream db_io_;
+  // db file, read and written with pread/pwrite: there is no shared file
+  // cursor, so page I/O from any number of threads needs no latch
+  int db_fd_;
+  // size of the db file, kept up to date by WritePage() so reads do not
+  // have to stat() the file
+  std::atomic<int64_t> db_file_size_;
   std::string file_name_;
-  std::atomic<page_id_t> next_page_id_;
+  size_t page_size_;
+  bool read_only_;
+  DbFormat format_;
+  // allocated pages of the db file, kept in <db>.fsm
+  FreeSpaceMap *free_space_map_;
+  // extent a segment allocates from: [next_page_id, end_page_id)
+  struct Extent {
+    page_id_t next_page_id;
+    page_id_t end_page_id;
+  };
+  std::mutex segment_latch_;
+  std::unordered_map<segment_id_t, Extent> segments_;
+  segment_id_t next_segment_id_;
   int num_flushes_;
+  std::atomic<uint64_t> num_syncs_;
+  std::atomic<bool> verify_checksums_;
+  // per IoKind
+  LatencyHistogram io_latency_[IO_KINDS];
+  std::atomic<uint64_t> io_bytes_[IO_KINDS];
   bool flush_log_;
   std::future<void> *flush_log_f_;
 };
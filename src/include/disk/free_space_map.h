@@ -0,0 +1,82 @@
+/**
+ * free_space_map.h
+ *
+ * Tracks which page ids of the database file are allocated, so that pages
+ * given back by DeallocatePage() are handed out again instead of growing the
+ * file, and so that a reopened database carries on where it left off rather
+ * than allocating (and overwriting) live pages from id 0.
+ *
+ * The map is kept in its own file next to the db file (<db>.fsm), made of
+ * MAP_BLOCK_SIZE blocks, and written through on every change:
+ *  ----------------------------------------------------------------------
+ * | Magic (4) | NextPageId (4) | ...     | Bitmap block 0 | Bitmap block 1 |
+ *  ----------------------------------------------------------------------
+ *   \_________ header block __________/
+ * Bit i of the bitmap is set when page i is allocated. NextPageId is one
+ * past the highest page id ever handed out.
+ */
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "common/config.h"
+
+namespace cmudb {
+
+class FreeSpaceMap {
+public:
+  // db_file_size is the current size of the pages of the db file, in
+  // page_size pages; a map that does not match it (missing, or left over
+  // from a removed file) is rebuilt. A read only map is loaded but never
+  // written back.
+  FreeSpaceMap(const std::string &file_name, int64_t db_file_size,
+               size_t page_size, bool read_only = false);
+  ~FreeSpaceMap();
+
+  // lowest free page id, or a new one at the end of the file
+  page_id_t AllocatePage();
+  // first id of count contiguous free pages, extending the file if needed
+  page_id_t AllocatePages(size_t count);
+  // no-op for pages that are not allocated
+  void DeallocatePage(page_id_t page_id);
+  // fdatasync the map file; changes are written through but not synced
+  void Sync();
+
+  bool IsAllocated(page_id_t page_id);
+  size_t GetFreePageCount();
+  inline page_id_t GetNextPageId() const { return next_page_id_; }
+
+private:
+  // the map file's own block size, independent of the page size
+  static const size_t MAP_BLOCK_SIZE = 4096;
+  // number of page ids one bitmap block covers
+  static const page_id_t PAGES_PER_BLOCK = MAP_BLOCK_SIZE * 8;
+
+  void Load(int64_t db_file_size);
+  inline bool TestBit(page_id_t page_id) const {
+    return (bitmap_[page_id / 8] >> (page_id % 8)) & 1;
+  }
+  void SetBits(page_id_t first, page_id_t last, bool allocated);
+  // make room for page ids below next_page_id
+  void Grow(page_id_t next_page_id);
+  // write the bitmap blocks of [first, last] and the header block
+  void Persist(page_id_t first, page_id_t last);
+
+  std::string file_name_;
+  int fd_;
+  bool read_only_;
+  size_t page_size_;
+  // protects everything but next_page_id_ reads
+  std::mutex latch_;
+  std::vector<uint8_t> bitmap_;
+  std::atomic<page_id_t> next_page_id_;
+  // no free page below this id
+  page_id_t free_hint_;
+  size_t free_page_count_;
+};
+
+} // namespace cmudb
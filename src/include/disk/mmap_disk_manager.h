@@ -0,0 +1,56 @@
+/**
+ * mmap_disk_manager.h
+ *
+ * Read only disk manager for database files that no longer change (read
+ * replicas, analytics snapshots). The db file is mapped read only once, and
+ * GetPageData() hands out pointers into the mapping, so a page is never
+ * copied into a frame; MmapBufferPoolManager builds on that. The checksum
+ * of a page is checked the first time it is handed out.
+ *
+ * ReadPage() copies out of the mapping, for a regular buffer pool on top of
+ * it. Page writes throw, as for any read only DiskManager.
+ */
+
+#pragma once
+#include <atomic>
+#include <string>
+
+#include "disk/disk_manager.h"
+
+namespace cmudb {
+
+class MmapDiskManager : public DiskManager {
+public:
+  // the page size is the one the database was created with
+  explicit MmapDiskManager(const std::string &db_file);
+  ~MmapDiskManager();
+
+  void ReadPage(page_id_t page_id, char *page_data) override;
+
+  // the page inside the mapping, nullptr beyond the end of the file.
+  // Throws PageCorruptionException if the page fails its checksum.
+  const char *GetPageData(page_id_t page_id);
+
+  // pages in the mapping, every id below is valid
+  inline page_id_t GetPageCount() const { return page_count_; }
+  // false if the file could not be mapped (or is empty)
+  inline bool IsMapped() const { return mapping_ != nullptr; }
+  // page 0 in the mapping, page i is at i * GetPageSize(); unverified
+  inline const char *GetMapping() const { return pages_; }
+
+  // have the kernel read [first_page_id, first_page_id + count) ahead;
+  // the mapping is advised for random access otherwise
+  void WillNeed(page_id_t first_page_id, size_t count);
+
+private:
+  // the whole file, header included
+  char *mapping_;
+  size_t mapping_size_;
+  // behind the header
+  char *pages_;
+  page_id_t page_count_;
+  // set once the page passed its checksum
+  std::atomic<bool> *verified_;
+};
+
+} // namespace cmudb
@@ -0,0 +1,91 @@
+/**
+ * uring_disk_manager.h
+ *
+ * Disk manager that does page I/O through an io_uring instance instead of
+ * one pread/pwrite system call per page. A batch of reads/writes handed to
+ * SubmitRequests() is queued on the submission ring and submitted with a
+ * single system call; completions are reaped as they arrive, by whichever
+ * thread waits for one, so several batches from several threads can be in
+ * flight at once.
+ *
+ * The database file is opened with O_DIRECT when pages are a multiple of
+ * DIRECT_IO_ALIGNMENT; writes, and reads into buffers that are not
+ * aligned, go through an aligned bounce buffer.
+ *
+ * The ring is set up with the raw io_uring_setup/io_uring_enter system
+ * calls. If the kernel has no io_uring (or it is blocked), the disk manager
+ * keeps using the pread/pwrite path of DiskManager.
+ */
+
+#pragma once
+#include <condition_variable>
+#include <mutex>
+
+#include <linux/io_uring.h>
+
+#include "disk/disk_manager.h"
+
+namespace cmudb {
+
+class UringDiskManager : public DiskManager {
+public:
+  UringDiskManager(const std::string &db_file,
+                   unsigned queue_depth = URING_QUEUE_DEPTH,
+                   size_t page_size = PAGE_SIZE);
+  ~UringDiskManager();
+
+  void WritePage(page_id_t page_id, const char *page_data) override;
+  void ReadPage(page_id_t page_id, char *page_data) override;
+  // the batch goes through the ring, then one fdatasync
+  void WritePages(
+      std::vector<std::pair<page_id_t, const char *>> &pages) override;
+
+  void SubmitRequests(DiskRequest *requests, size_t count) override;
+  void WaitRequest(DiskRequest &request) override;
+
+  // false when io_uring is not available and pread/pwrite are used
+  inline bool IsUringEnabled() const { return ring_fd_ >= 0; }
+  inline bool IsDirectIO() const { return direct_io_; }
+
+private:
+  bool SetupRing(unsigned queue_depth);
+  void TeardownRing();
+  // queue one request on the submission ring, latch_ held and a slot free
+  void QueueRequest(DiskRequest &request);
+  // wait for at least one completion (or for the thread reaping them)
+  void Reap(std::unique_lock<std::mutex> &lock);
+  void CompleteRequest(DiskRequest &request, int result);
+  // complete a request that never reached the kernel
+  void FailRequest(DiskRequest &request);
+
+  int db_fd_;
+  bool direct_io_;
+  int ring_fd_;
+  // submission ring
+  void *sq_ring_;
+  size_t sq_ring_size_;
+  unsigned *sq_tail_;
+  unsigned *sq_mask_;
+  unsigned *sq_array_;
+  unsigned sq_entries_;
+  io_uring_sqe *sqes_;
+  size_t sqes_size_;
+  // completion ring, shares the submission ring mapping on newer kernels
+  void *cq_ring_;
+  size_t cq_ring_size_;
+  unsigned *cq_head_;
+  unsigned *cq_tail_;
+  unsigned *cq_mask_;
+  io_uring_cqe *cqes_;
+
+  // protects the rings and the done flags of the requests
+  std::mutex latch_;
+  // requests submitted and not reaped yet, at most sq_entries_
+  unsigned in_flight_;
+  // one thread at a time waits in io_uring_enter and reaps, the others
+  // wait on reap_cv_ for it
+  bool reaping_;
+  std::condition_variable reap_cv_;
+};
+
+} // namespace cmudb
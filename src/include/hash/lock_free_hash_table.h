@@ -0,0 +1,67 @@
+/*
+ * lock_free_hash_table.h : fixed capacity, open addressing (linear probing)
+ * page table mapping page_id_t to a frame
+ *
+ * Functionality: Each slot is a single 64-bit word holding the page id (high
+ * half) and the frame index (low half), so readers always see a consistent
+ * pair. Find() never blocks and never retries (wait-free); Insert() and
+ * Remove() publish slots with CAS. The table is sized once for num_entries
+ * live keys and never grows.
+ *
+ * Values are stored as frame indexes (value - base), e.g. the offset of a
+ * Page inside the buffer pool's pages_ array.
+ *
+ * NOTE: readers may run concurrently with writers, but writers must be
+ * serialized by the caller (the buffer pool holds its latch): Remove() turns
+ * trailing tombstones back into empty slots, which is only safe when no
+ * insert is probing the same cluster.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "common/config.h"
+#include "hash/hash_table.h"
+
+namespace cmudb {
+
+template <typename V>
+class LockFreeHashTable : public HashTable<page_id_t, V> {
+public:
+  // values must lie in [base, base + 2^32)
+  LockFreeHashTable(size_t num_entries, V base = V());
+  ~LockFreeHashTable();
+  // lookup and modifier
+  bool Find(const page_id_t &key, V &value) override;
+  bool Remove(const page_id_t &key) override;
+  void Insert(const page_id_t &key, const V &value) override;
+
+  inline size_t GetCapacity() const { return capacity_; }
+
+private:
+  static const uint32_t EMPTY_KEY = 0xFFFFFFFF;     // INVALID_PAGE_ID
+  static const uint32_t TOMBSTONE_KEY = 0xFFFFFFFE; // removed entry
+
+  static inline uint64_t MakeSlot(uint32_t key, uint32_t frame_id) {
+    return (static_cast<uint64_t>(key) << 32) | frame_id;
+  }
+  static inline uint32_t SlotKey(uint64_t slot) {
+    return static_cast<uint32_t>(slot >> 32);
+  }
+  static inline uint32_t SlotFrameId(uint64_t slot) {
+    return static_cast<uint32_t>(slot);
+  }
+  // home slot of the key
+  inline size_t HashKey(page_id_t key) const {
+    return (static_cast<uint32_t>(key) * 2654435761U) & (capacity_ - 1);
+  }
+
+  // power of two, at least twice the number of live entries
+  size_t capacity_;
+  V base_;
+  std::atomic<uint64_t> *slots_;
+};
+} // namespace cmudb
@@ -7,12 +7,24 @@
  * (2) support insert & remove
  * (3) The structure should shrink and grow dynamically
  * (4) Implement index iterator for range scan
+ *
+ * Concurrency: latch crabbing. Lookups take read latches hand over hand from
+ * the root down. Inserts and removes first descend the same way and write
+ * latch only the leaf; if the leaf turns out to be unsafe, i.e. may split or
+ * underflow, they start over pessimistically: write latch the path and let
+ * go of every ancestor (and of root_latch_, which guards root_page_id_) as
+ * soon as the page below is safe. The pages still held are kept in the
+ * transaction's page set, pages to delete in its deleted page set until all
+ * latches are released.
  */
 #pragma once
 
+#include <cstdio>
+#include <functional>
 #include <queue>
 #include <vector>
 
+#include "common/rwmutex.h"
 #include "concurrency/transaction.h"
 #include "index/index_iterator.h"
 #include "page/b_plus_tree_internal_page.h"
@@ -21,6 +33,10 @@
 namespace cmudb {
 
 #define BPLUSTREE_TYPE BPlusTree<KeyType, ValueType, KeyComparator>
+
+// what a descent is for, decides which latches it takes and keeps
+enum class OpType { READ, INSERT, DELETE };
+
 // Main class providing the API for the Interactive B+ Tree.
 INDEX_TEMPLATE_ARGUMENTS
 class BPlusTree {
@@ -29,6 +45,9 @@ public:
                            BufferPoolManager *buffer_pool_manager,
                            const KeyComparator &comparator,
                            page_id_t root_page_id = INVALID_PAGE_ID);
+  // gives back the rest of the tree's segment, so it must go before the
+  // buffer pool
+  ~BPlusTree();
 
   // Returns true if this B+ tree has no keys and values.
   bool IsEmpty() const;
@@ -44,6 +63,37 @@ public:
   bool GetValue(const KeyType &key, std::vector<ValueType> &result,
                 Transaction *transaction = nullptr);
 
+  // Build this tree, which must be empty, bottom-up out of the key/value
+  // pairs next() hands out (in any order) until it returns false. Pages are
+  // filled to about fill_factor; more than run_size pairs are sorted in runs
+  // spilled to temporary files. Of pairs with the same key only one is kept.
+  bool BulkLoad(const std::function<bool(MappingType &)> &next,
+                double fill_factor = BULK_LOAD_FILL_FACTOR,
+                size_t run_size = BULK_LOAD_RUN_SIZE);
+  template <typename InputIterator>
+  bool BulkLoad(InputIterator first, InputIterator last,
+                double fill_factor = BULK_LOAD_FILL_FACTOR,
+                size_t run_size = BULK_LOAD_RUN_SIZE) {
+    return BulkLoad(
+        [&first, &last](MappingType &pair) {
+          if (first == last)
+            return false;
+          pair = *first;
+          ++first;
+          return true;
+        },
+        fill_factor, run_size);
+  }
+
+  // Hand the values of the keys from low to high (nullptr for no bound) to
+  // callback in key order, in batches of up to RANGE_SCAN_BATCH_SIZE, until
+  // limit values (0 for no limit) went out or callback returns false. The
+  // leaf being scanned stays read latched while callback runs.
+  size_t ScanRange(const KeyType *low, bool low_inclusive,
+                   const KeyType *high, bool high_inclusive, size_t limit,
+                   const std::function<bool(const std::vector<ValueType> &)>
+                       &callback);
+
   // index iterator
   INDEXITERATOR_TYPE Begin();
   INDEXITERATOR_TYPE Begin(const KeyType &key);
@@ -59,8 +109,13 @@ public:
   void RemoveFromFile(const std::string &file_name,
                       Transaction *transaction = nullptr);
   // expose for test purpose
-  B_PLUS_TREE_LEAF_PAGE_TYPE *FindLeafPage(const KeyType &key,
-                                           bool leftMost = false);
+  // READ: the leaf comes back pinned and read latched, release both.
+  // INSERT/DELETE: the leaf and the ancestors it may change stay pinned and
+  // write latched in transaction's page set, see ReleaseLatchedPages().
+  // nullptr if the tree is empty (root_latch_ still held for INSERT/DELETE).
+  Page *FindLeafPage(const KeyType &key, bool leftMost = false,
+                     OpType op = OpType::READ,
+                     Transaction *transaction = nullptr);
 
   B_PLUS_TREE_INTERNAL_PG_PGID* GetNewRoot();
 
@@ -90,19 +145,61 @@ private:
 
   template <typename N> void Redistribute(N *neighbor_node, N *node, int index);
 
-  bool AdjustRoot(BPlusTreePage *node);
+  bool AdjustRoot(BPlusTreePage *node, Transaction *transaction);
 
   void UpdateRootPageId(int insert_record = false);
 
 
+  // lmax_size/rmax_size: capacity of the node merged with its left/right
+  // sibling
   int CheckMergeSibbling(int parent_index, B_PLUS_TREE_INTERNAL_PG_PGID *parent,
-              int cur_node_size, int node_max_size, int &redistribute_idx);
+              int cur_node_size, int lmax_size, int rmax_size,
+              int &redistribute_idx, Transaction *transaction);
+
+  // key prefix compression: the prefix the keys of parent's children
+  // lo_index up to hi_index share, and keeping a node's prefix in line
+  // with its key range after a split, merge or redistribution
+  int RangePrefixSize(B_PLUS_TREE_INTERNAL_PG_PGID *parent, int lo_index,
+                      int hi_index, KeyType &key);
+  void GrowKeyPrefix(BPlusTreePage *node,
+                     B_PLUS_TREE_INTERNAL_PG_PGID *parent_pg);
+  template <typename N>
+  void ShrinkKeyPrefix(N *node, B_PLUS_TREE_INTERNAL_PG_PGID *parent,
+                       int lo_index);
+
+  // descent of an insert/delete that read latches the inner pages and write
+  // latches the leaf; nullptr if the tree is empty or the leaf is not safe
+  Page *FindLeafPageOptimistic(const KeyType &key, bool leftMost, OpType op,
+                               Transaction *transaction);
+  // bulk load: sort a run and drop duplicate keys
+  void SortRun(std::vector<MappingType> &run);
+  // bulk load: sort a run and move it out to a temp file
+  std::FILE *SpillRun(std::vector<MappingType> &run);
+  // bulk load: merge sorted runs into one temp file of count unique pairs
+  std::FILE *MergeRuns(std::vector<std::FILE *> &runs, size_t &count);
+  // bulk load: number of pages count entries are spread over, filled to
+  // fill_factor of their capacity once their keys share a prefix
+  int BulkLoadPageCount(size_t count, int max_size, int prefixed_max_size,
+                        double fill_factor);
+  // bulk load: set the key prefix of the children of an internal page
+  void SetChildKeyPrefixes(B_PLUS_TREE_INTERNAL_PG_PGID *parent);
+
+  // true if an insert/delete below node can not change node's parent
+  bool IsSafe(BPlusTreePage *node, OpType op);
+  // unlatch and unpin the pages in the transaction's page set (nullptr
+  // stands for root_latch_), then delete the pages of its deleted page set
+  void ReleaseLatchedPages(Transaction *transaction, bool is_dirty);
 
   // member variable
   std::string index_name_;
   page_id_t root_page_id_;
+  // read latched to get from root_page_id_ to the root page, write latched
+  // while the root may change
+  RWMutex root_latch_;
   BufferPoolManager *buffer_pool_manager_;
   KeyComparator comparator_;
+  // the tree's pages are allocated out of this segment's extents
+  segment_id_t segment_id_;
 };
 
 } // namespace cmudb
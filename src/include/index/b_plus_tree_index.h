@@ -34,6 +34,14 @@ public:
   void ScanKey(const Tuple &key, std::vector<RID> &result,
                Transaction *transaction = nullptr) override;
 
+  void ScanRange(const Tuple *low, bool low_inclusive, const Tuple *high,
+                 bool high_inclusive, size_t limit,
+                 const std::function<bool(const std::vector<RID> &)> &callback,
+                 Transaction *transaction = nullptr) override;
+
+  void BulkLoad(TableHeap *table_heap, Schema *tuple_schema,
+                Transaction *transaction = nullptr) override;
+
 protected:
   // comparator for key
   KeyComparator comparator_;
@@ -9,6 +9,7 @@
  */
 #pragma once
 
+#include <algorithm>
 #include <cstring>
 
 #include "table/tuple.h"
@@ -26,7 +27,7 @@ public:
   // NOTE: for test purpose only
   inline void SetFromInteger(int64_t key) {
     memset(data, 0, KeySize);
-    memcpy(data, &key, sizeof(int64_t));
+    memcpy(data, &key, std::min(sizeof(int64_t), KeySize));
   }
 
   inline Value ToValue(Schema *schema, int column_id) const {
@@ -46,7 +47,9 @@ public:
   // NOTE: for test purpose only
   // interpret the first 8 bytes as int64_t from data vector
   inline int64_t ToString() const {
-    return *reinterpret_cast<int64_t *>(const_cast<char *>(data));
+    int64_t key = 0;
+    memcpy(&key, data, std::min(sizeof(int64_t), KeySize));
+    return key;
   }
 
   // NOTE: for test purpose only
@@ -83,6 +86,36 @@ public:
     return 0;
   }
 
+  // Number of leading key bytes that can be non zero. Past the key schema
+  // the key is padding, unless a column is stored out of line
+  inline int GetKeySize() const {
+    if (!key_schema_->IsInlined())
+      return KeySize;
+    return std::min<int>(key_schema_->GetLength(), KeySize);
+  }
+
+  // Number of leading key bytes taken by the columns lhs and rhs are equal
+  // on. Stops at the first column whose equal values may differ in bytes
+  inline int PrefixSize(const GenericKey<KeySize> &lhs,
+                        const GenericKey<KeySize> &rhs) const {
+    int column_count = key_schema_->GetColumnCount();
+    int prefix_size = 0;
+
+    for (int i = 0; i < column_count; i++) {
+      if (!key_schema_->IsInlined(i) ||
+          key_schema_->GetType(i) == TypeId::DECIMAL)
+        break;
+
+      int end = key_schema_->GetOffset(i) + key_schema_->GetLength(i);
+      if (end > static_cast<int>(KeySize) ||
+          memcmp(lhs.data + prefix_size, rhs.data + prefix_size,
+                 end - prefix_size) != 0)
+        break;
+      prefix_size = end;
+    }
+    return prefix_size;
+  }
+
   GenericComparator(const GenericComparator &other) {
     this->key_schema_ = other.key_schema_;
   }
@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
@@ -23,6 +24,7 @@ namespace cmudb {
  * mapping relation and does the conversion between tuple key and index key
  */
 class Transaction;
+class TableHeap;
 class IndexMetadata {
   IndexMetadata() = delete;
 
@@ -133,6 +135,19 @@ public:
   virtual void ScanKey(const Tuple &key, std::vector<RID> &result,
                        Transaction *transaction = nullptr) = 0;
 
+  // hand the rids of the keys from low to high (nullptr for no bound) to
+  // callback in key order and in batches, until limit rids (0 for no limit)
+  // went out or callback returns false
+  virtual void ScanRange(
+      const Tuple *low, bool low_inclusive, const Tuple *high,
+      bool high_inclusive, size_t limit,
+      const std::function<bool(const std::vector<RID> &)> &callback,
+      Transaction *transaction = nullptr) = 0;
+
+  // build an empty index out of every tuple of the table it indexes
+  virtual void BulkLoad(TableHeap *table_heap, Schema *tuple_schema,
+                        Transaction *transaction = nullptr) = 0;
+
 private:
   //===--------------------------------------------------------------------===//
   //  Data members
@@ -3,6 +3,7 @@
  * For range scan of b+ tree
  */
 #pragma once
+#include "buffer/read_ahead.h"
 #include "page/b_plus_tree_leaf_page.h"
 
 namespace cmudb {
@@ -15,8 +16,10 @@ namespace cmudb {
 INDEX_TEMPLATE_ARGUMENTS
 class IndexIterator {
 public:
-  // you may define your own constructor based on your member variables
-  IndexIterator(BufferPoolManager *bpm, page_id_t pg_id);
+  // starts at entry index of leaf, which the caller has pinned and read
+  // latched (both are taken over); nullptr for an empty tree
+  IndexIterator(BufferPoolManager *bpm, Page *leaf, int index);
+  IndexIterator(IndexIterator &&that) = default;
   ~IndexIterator();
 
   bool isEnd();
@@ -27,11 +30,21 @@ public:
   INDEXITERATOR_TYPE &operator++();
 
 private:
+  // move to the first entry at or after current_index, following the leaf
+  // chain; the end once there is none
+  void SkipToValidEntry();
+
   // add your own private member variables here
 	BufferPoolManager *buffer_pool_manager;
 	//B_PLUS_TREE_LEAF_PAGE_TYPE *current_page;
 	page_id_t current_page_id;
 	int64_t current_index; 
+	//pin + read latch on the current leaf, held until the iterator moves on
+	ReadPageGuard leaf_guard;
+	//prefetches the next leaves while they are laid out sequentially
+	ReadAhead read_ahead;
+	//the current entry, decoded out of the leaf by operator*
+	MappingType item;
 };
 
 } // namespace cmudb
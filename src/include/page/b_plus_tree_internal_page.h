@@ -8,9 +8,10 @@
  * the first key always remains invalid. That is to say, any search/lookup
  * should ignore the first key.
  *
- * Internal page format (keys are stored in increasing order):
+ * Internal page format (keys are stored in increasing order, compressed as
+ * described in b_plus_tree_page.h):
  *  --------------------------------------------------------------------------
- * | HEADER | KEY(1)+PAGE_ID(1) | KEY(2)+PAGE_ID(2) | ... | KEY(n)+PAGE_ID(n) |
+ * | HEADER | PREFIX | KEY(1)+PAGE_ID(1) | ... | KEY(n)+PAGE_ID(n) |
  *  --------------------------------------------------------------------------
  */
 
@@ -33,13 +34,20 @@ INDEX_TEMPLATE_ARGUMENTS
 class BPlusTreeInternalPage : public BPlusTreePage {
 public:
   // must call initialize method after "create" a new node
-  void Init(page_id_t page_id, page_id_t parent_id = INVALID_PAGE_ID);
+  // page_size is the page size of the database, it sets the max size
+  // key_size is the number of leading key bytes that are not padding
+  void Init(page_id_t page_id, page_id_t parent_id = INVALID_PAGE_ID,
+            size_t page_size = PAGE_SIZE, int key_size = sizeof(KeyType));
 
   KeyType KeyAt(int index) const;
   void SetKeyAt(int index, const KeyType &key);
   int ValueIndex(const ValueType &value) const;
   ValueType ValueAt(int index) const;
 
+  // keys share their first prefix_size bytes with key from now on
+  void SetKeyPrefix(const KeyType &key, int prefix_size);
+  int GetMaxSizeFor(int prefix_size) const;
+
   ValueType Lookup(const KeyType &key, const KeyComparator &comparator) const;
   void PopulateNewRoot(const ValueType &old_value, const KeyType &new_key,
                        const ValueType &new_value);
@@ -47,6 +55,9 @@ public:
                       const ValueType &new_value);
   void Remove(int index);
   ValueType RemoveAndReturnOnlyChild();
+  // bulk load: add a child (and the key leading to it) after the last one
+  void Append(const KeyType &key, const ValueType &value,
+              BufferPoolManager *buffer_pool_manager);
 
   void MoveHalfTo(BPlusTreeInternalPage *recipient,
                   BufferPoolManager *buffer_pool_manager);
@@ -73,9 +84,13 @@ public:
 																									page_id_t parent_pg_id);
 
 private:
-  void CopyHalfFrom(MappingType *items, int size,
+  void SetValueAt(int index, const ValueType &value);
+  MappingType GetItem(int index) const;
+  void SetItem(int index, const KeyType &key, const ValueType &value);
+
+  void CopyHalfFrom(BPlusTreeInternalPage *donor, int size,
                     BufferPoolManager *buffer_pool_manager);
-  void CopyAllFrom(MappingType *items, int size,
+  void CopyAllFrom(BPlusTreeInternalPage *donor, int size,
                    BufferPoolManager *buffer_pool_manager);
   void CopyLastFrom(const MappingType &pair,
                     BufferPoolManager *buffer_pool_manager);
@@ -86,7 +101,5 @@ private:
                  BufferPoolManager *buffer_pool_manager);
   void CopyLastNFrom(MappingType *items, int size,
                  BufferPoolManager *buffer_pool_manager);
-
-  MappingType array[0];
 };
 } // namespace cmudb
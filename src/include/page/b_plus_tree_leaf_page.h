@@ -5,18 +5,22 @@
  * see include/common/rid.h for detailed implementation) together within leaf
  * page. Only support unique key.
 
- * Leaf page format (keys are stored in order):
+ * Leaf page format (keys are stored in order, compressed as described in
+ * b_plus_tree_page.h):
  *  ----------------------------------------------------------------------
- * | HEADER | KEY(1) + RID(1) | KEY(2) + RID(2) | ... | KEY(n) + RID(n)
+ * | HEADER | PREFIX | KEY(1) + RID(1) | KEY(2) + RID(2) | ... | KEY(n) + RID(n)
  *  ----------------------------------------------------------------------
  *
- *  Header format (size in byte, 24 bytes in total):
+ *  Header format (size in byte, 32 bytes in total):
  *  ---------------------------------------------------------------------
  * | PageType (4) | CurrentSize (4) | MaxSize (4) | ParentPageId (4) |
  *  ---------------------------------------------------------------------
- *  ------------------------------
- * | PageId (4) | NextPageId (4)
- *  ------------------------------
+ *  ---------------------------------------------------------------------
+ * | PageId (4) | DataSize (2) | KeySize (2) | PrefixSize (2) | MinSize (2) |
+ *  ---------------------------------------------------------------------
+ *  ----------------
+ * | NextPageId (4)
+ *  ----------------
  */
 #pragma once
 #include <utility>
@@ -36,16 +40,24 @@ class BPlusTreeLeafPage : public BPlusTreePage {
 public:
   // After creating a new leaf page from buffer pool, must call initialize
   // method to set default values
-  void Init(page_id_t page_id, page_id_t parent_id = INVALID_PAGE_ID);
+  // page_size is the page size of the database, it sets the max size
+  // key_size is the number of leading key bytes that are not padding
+  void Init(page_id_t page_id, page_id_t parent_id = INVALID_PAGE_ID,
+            size_t page_size = PAGE_SIZE, int key_size = sizeof(KeyType));
 
   // helper methods
   page_id_t GetNextPageId() const;
   void SetNextPageId(page_id_t next_page_id);
   
   KeyType KeyAt(int index) const;
+  ValueType ValueAt(int index) const;
   int KeyIndex(const KeyType &key, const KeyComparator &comparator) const;
   
-  const MappingType &GetItem(int index);
+  MappingType GetItem(int index) const;
+
+  // keys share their first prefix_size bytes with key from now on
+  void SetKeyPrefix(const KeyType &key, int prefix_size);
+  int GetMaxSizeFor(int prefix_size) const;
 
   // insert and delete methods
   int Insert(const KeyType &key, const ValueType &value,
@@ -76,8 +88,10 @@ public:
   std::string ToString(bool verbose = false) const;
 
 private:
-  void CopyHalfFrom(MappingType *items, int size);
-  void CopyAllFrom(MappingType *items, int size);
+  void SetItem(int index, const KeyType &key, const ValueType &value);
+
+  void CopyHalfFrom(BPlusTreeLeafPage *donor, int size);
+  void CopyAllFrom(BPlusTreeLeafPage *donor, int size);
   void CopyLastFrom(const MappingType &item);
   void CopyFirstFrom(const MappingType &item, int parentIndex,
                      BufferPoolManager *buffer_pool_manager);
@@ -87,6 +101,5 @@ private:
   void CopyLastNFrom(MappingType *items, int size);
 
   page_id_t next_page_id_;
-  MappingType array[0];
 };
 } // namespace cmudb
@@ -6,10 +6,18 @@
  * It actually serves as a header part for each B+ tree page and
  * contains information shared by both leaf page and internal page.
  *
- * Header format (size in byte, 20 bytes in total):
+ * Header format (size in byte, 28 bytes in total):
  *  ----------------------------------------------------------------------------
  * | PageType (4) | CurrentSize (4) | MaxSize (4) | ParentPageId (4) | PageId(4)
  *  ----------------------------------------------------------------------------
+ *  ----------------------------------------------------------------
+ * | DataSize (2) | KeySize (2) | PrefixSize (2) | MinSize (2) |
+ *  ----------------------------------------------------------------
+ *
+ * Keys are stored compressed: the bytes past KeySize are dropped (they are
+ * padding of the key schema) and so are the first PrefixSize bytes, which all
+ * keys of the page's key range share and which are stored once right after
+ * the header. The key & value pairs follow them.
  */
 
 #pragma once
@@ -17,6 +25,7 @@
 #include <cassert>
 #include <climits>
 #include <cstdlib>
+#include <cstring>
 #include <string>
 
 #include "buffer/buffer_pool_manager.h"
@@ -61,13 +70,63 @@ public:
   //Returns the size of the header for leaf/internal pages
   int GetHeaderSize() const;
 
+  // key compression, see header format
+  int GetKeySize() const;
+  int GetPrefixSize() const;
+
+protected:
+  // sets up an empty page whose keys take key_size bytes at most
+  void InitKeyLayout(size_t page_size, int key_size, int value_size);
+  // capacity of the page once its keys share prefix_size bytes
+  int MaxSizeFor(int prefix_size, int value_size) const;
+  // re-encodes the pairs for a new prefix length, the bytes a longer
+  // prefix takes on come from key
+  void SetPrefixSize(const char *key, int prefix_size, int value_size);
+
+  const char *ItemData(int index, int value_size) const;
+  char *ItemData(int index, int value_size);
+  // memmove count pairs from index "from" to index "to"
+  void MoveItems(int to, int from, int count, int value_size);
+
+  template <typename KeyType> KeyType ReadKey(const char *item) const {
+    KeyType key;
+    char *data = reinterpret_cast<char *>(&key);
+    memcpy(data, GetPrefix(), prefix_size_);
+    memcpy(data + prefix_size_, item, key_size_ - prefix_size_);
+    memset(data + key_size_, 0, sizeof(KeyType) - key_size_);
+    return key;
+  }
+
+  template <typename KeyType> void WriteKey(char *item, const KeyType &key) {
+    memcpy(item, reinterpret_cast<const char *>(&key) + prefix_size_,
+           key_size_ - prefix_size_);
+  }
+
+  template <typename ValueType> ValueType ReadValue(const char *item) const {
+    ValueType value;
+    memcpy(&value, item + key_size_ - prefix_size_, sizeof(ValueType));
+    return value;
+  }
+
+  template <typename ValueType>
+  void WriteValue(char *item, const ValueType &value) {
+    memcpy(item + key_size_ - prefix_size_, &value, sizeof(ValueType));
+  }
+
 private:
+  const char *GetPrefix() const;
+  char *GetPrefix();
+
   // member variable, attributes that both internal and leaf page share
   IndexPageType page_type_;
   int size_;
   int max_size_;
   page_id_t parent_page_id_;
   page_id_t page_id_;
+  uint16_t data_size_;
+  uint16_t key_size_;
+  uint16_t prefix_size_;
+  uint16_t min_size_;
 };
 
 } // namespace cmudb
@@ -4,10 +4,16 @@
  * Wrapper around actual data page in main memory and also contains bookkeeping
  * information used by buffer pool manager like pin_count/dirty_flag/page_id.
  * Use page as a basic unit within the database system
+ *
+ * The page data itself lives in the buffer pool's FrameArena; a Page only
+ * points at it. Pages are cache line aligned so the bookkeeping of two
+ * frames never shares a line.
  */
 
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
 #include <cstring>
 #include <iostream>
 
@@ -16,14 +22,18 @@
 
 namespace cmudb {
 
-class Page {
+class alignas(CACHELINE_SIZE) Page {
   friend class BufferPoolManager;
+  friend class FrameArena;
+  friend class MmapBufferPoolManager;
 
 public:
-  Page() { ResetMemory(); }
+  Page() : data_(nullptr), page_size_(0) {}
   ~Page(){};
   // get actual data page content
   inline char *GetData() { return data_; }
+  // size of the page content, the page size of the database
+  inline size_t GetPageSize() const { return page_size_; }
   // get page id
   inline page_id_t GetPageId() { return page_id_; }
   // get page pin count
@@ -33,18 +43,34 @@ public:
   inline void WLatch() { rwlatch_.WLock(); }
   inline void RUnlatch() { rwlatch_.RUnlock(); }
   inline void RLatch() { rwlatch_.RLock(); }
+  // RLatch() unless a writer holds or waits for the latch
+  inline bool TryRLatch() { return rwlatch_.TryRLock(); }
 
   inline lsn_t GetLSN() { return *reinterpret_cast<lsn_t *>(GetData() + 4); }
   inline void SetLSN(lsn_t lsn) { memcpy(GetData() + 4, &lsn, 4); }
 
 private:
   // method used by buffer pool manager
-  inline void ResetMemory() { memset(data_, 0, PAGE_SIZE); }
+  inline void ResetMemory() { memset(data_, 0, page_size_); }
   // members
-  char data_[PAGE_SIZE]; // actual data
-  page_id_t page_id_ = INVALID_PAGE_ID;
-  int pin_count_ = 0;
-  bool is_dirty_ = false;
+  // actual data, page_size_ bytes in the frame arena; the disk manager keeps
+  // the page checksum in the last PAGE_CHECKSUM_SIZE of them
+  char *data_;
+  size_t page_size_;
+  // atomic so that buffer pool hits can pin the frame without the buffer
+  // pool latch; pin_count_ is negative while the frame is being evicted
+  std::atomic<page_id_t> page_id_{INVALID_PAGE_ID};
+  std::atomic<int> pin_count_{0};
+  std::atomic<bool> is_dirty_{false};
+  // set while the buffer pool reads/writes this frame outside its latch;
+  // fetchers of the page wait on io_cv_ (with the buffer pool latch)
+  std::atomic<bool> io_in_progress_{false};
+  // read in by PrefetchPage(); the first fetch takes over the access the
+  // prefetch recorded instead of adding a second one
+  std::atomic<bool> prefetched_{false};
+  // DeletePage() found the page pinned; the last unpin deletes it
+  std::atomic<bool> delete_pending_{false};
+  std::condition_variable io_cv_;
   RWMutex rwlatch_;
 };
 
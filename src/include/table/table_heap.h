@@ -18,7 +18,9 @@ class TableHeap {
   friend class TableIterator;
 
 public:
-  ~TableHeap() {}
+  // the heap must go before its buffer pool: the rest of its segment's
+  // extent is given back
+  ~TableHeap() { buffer_pool_manager_->DropSegment(segment_id_); }
 
   // open a table heap
   TableHeap(BufferPoolManager *buffer_pool_manager, LockManager *lock_manager,
@@ -60,6 +62,8 @@ private:
   LockManager *lock_manager_;
   LogManager *log_manager_;
   page_id_t first_page_id_;
+  // heap pages are allocated out of this segment's extents
+  segment_id_t segment_id_;
 };
 
 } // namespace cmudb
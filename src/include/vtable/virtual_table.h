@@ -15,6 +15,14 @@
 #include "type/value.h"
 
 namespace cmudb {
+/* idxNum VtabBestIndex hands to VtabFilter */
+#define INDEX_SCAN_KEY 1             // point query on every indexed column
+#define INDEX_SCAN_RANGE 2           // range query, with the bits below
+#define INDEX_SCAN_LOW 4             // argv has a low bound
+#define INDEX_SCAN_LOW_INCLUSIVE 8   // low bound is >=, not >
+#define INDEX_SCAN_HIGH 16           // argv has a high bound (after the low)
+#define INDEX_SCAN_HIGH_INCLUSIVE 32 // high bound is <=, not <
+
 /* Helpers */
 Schema *ParseCreateStatement(const std::string &sql);
 
@@ -62,11 +70,12 @@ int VtabBegin(sqlite3_vtab *pVTab);
 // storage engine
 class StorageEngine {
 public:
-  StorageEngine(std::string db_file_name) {
+  // page_size is used if the database is a new one
+  StorageEngine(std::string db_file_name, size_t page_size = PAGE_SIZE) {
     ENABLE_LOGGING = false;
 
     // storage related
-    disk_manager_ = new DiskManager(db_file_name);
+    disk_manager_ = new DiskManager(db_file_name, page_size);
 
     // log related
     log_manager_ = new LogManager(disk_manager_);
@@ -82,9 +91,10 @@ public:
   ~StorageEngine() {
     if (ENABLE_LOGGING)
       log_manager_->StopFlushThread();
-    delete disk_manager_;
+    // the buffer pool and log manager still write through the disk manager
     delete buffer_pool_manager_;
     delete log_manager_;
+    delete disk_manager_;
     delete lock_manager_;
     delete transaction_manager_;
   }
@@ -252,6 +262,18 @@ public:
     virtual_table_->index_->ScanKey(key, results);
   }
 
+  // wrapper around range scan methods, bounds are nullptr if open
+  inline void ScanRange(const Tuple *low, bool low_inclusive,
+                        const Tuple *high, bool high_inclusive) {
+    virtual_table_->index_->ScanRange(
+        low, low_inclusive, high, high_inclusive, 0,
+        [this](const std::vector<RID> &batch) {
+          results.insert(results.end(), batch.begin(), batch.end());
+          return true;
+        },
+        GetTransaction());
+  }
+
 private:
   sqlite3_vtab_cursor base_; /* Base class - must be first */
   // for index scan
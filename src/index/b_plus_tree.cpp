@@ -1,7 +1,9 @@
 /*
  * b_plus_tree.cpp
  */
+#include <algorithm>
 #include <iostream>
+#include <memory>
 #include <queue>
 #include <sstream>
 #include <string>
@@ -21,7 +23,14 @@ BPLUSTREE_TYPE::BPlusTree(const std::string &name,
                                 const KeyComparator &comparator,
                                 page_id_t root_page_id)
     : index_name_(name), root_page_id_(root_page_id),
-      buffer_pool_manager_(buffer_pool_manager), comparator_(comparator) {}
+      buffer_pool_manager_(buffer_pool_manager), comparator_(comparator),
+      segment_id_(buffer_pool_manager->CreateSegment()) {}
+
+INDEX_TEMPLATE_ARGUMENTS
+BPLUSTREE_TYPE::~BPlusTree()
+{
+  this->buffer_pool_manager_->DropSegment(this->segment_id_);
+}
 
 /*
  * Helper function to decide whether current b+tree is empty
@@ -46,35 +55,17 @@ bool BPLUSTREE_TYPE::GetValue(const KeyType &key,
                               std::vector<ValueType> &result,
                               Transaction *transaction) 
 {
-    bool res = false;
-    BPlusTreePage *page_ptr;
-
-		if(this->IsEmpty()) return false;
-
-		page_ptr = (BPlusTreePage *)this->buffer_pool_manager_->
-																FetchPage(this->root_page_id_);
-    page_id_t pg_id;
-    ValueType value;	
-
-    while(!page_ptr->IsLeafPage())
-    {
-        // value is page id here
-        pg_id = ((B_PLUS_TREE_INTERNAL_PG_PGID *)page_ptr)->Lookup
-                                                 (key, this->comparator_);
-        this->buffer_pool_manager_->UnpinPage(page_ptr->GetPageId(), false);
+    ValueType value;
+    Page *page = this->FindLeafPage(key, false, OpType::READ);
+    if(page == nullptr) return false;
 
-        page_ptr = 
-              (BPlusTreePage *)this->buffer_pool_manager_->FetchPage(pg_id);
-    }
-
-    if(((B_PLUS_TREE_LEAF_PAGE_TYPE *)page_ptr)->Lookup
-                                (key, value, this->comparator_))
-    {
+    bool res = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(page->GetData())
+                   ->Lookup(key, value, this->comparator_);
+    if(res)
         result.push_back(value);
-        res = true;
-    }
 
-    this->buffer_pool_manager_->UnpinPage(page_ptr->GetPageId(), false);
+    page->RUnlatch();
+    this->buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
     return res;
 }
 
@@ -92,13 +83,14 @@ INDEX_TEMPLATE_ARGUMENTS
 bool BPLUSTREE_TYPE::Insert(const KeyType &key, const ValueType &value,
                                                     Transaction *transaction)
 {
-    /* Current tree is empty */
-    if(this->IsEmpty())
+    /* Latched pages are kept in a transaction, make one up if need be */
+    std::unique_ptr<Transaction> local_transaction;
+    if(transaction == nullptr)
     {
-      this->StartNewTree(key, value);
-      return true;
+        local_transaction.reset(new Transaction(INVALID_TXN_ID));
+        transaction = local_transaction.get();
     }
-    
+
     return this->InsertIntoLeaf(key, value, transaction); 
 }
 
@@ -113,14 +105,17 @@ void BPLUSTREE_TYPE::StartNewTree(const KeyType &key, const ValueType &value)
 {
     page_id_t root_page_id;
 
-    B_PLUS_TREE_LEAF_PAGE_TYPE *root_page = 
-        (B_PLUS_TREE_LEAF_PAGE_TYPE *)this->buffer_pool_manager_->NewPage
-                                                                (root_page_id);
-    if(root_page == nullptr) 
+    Page *page = this->buffer_pool_manager_->NewPage(root_page_id, segment_id_);
+    if(page == nullptr) 
         throw "Out of memory!";
 
+    B_PLUS_TREE_LEAF_PAGE_TYPE *root_page = 
+                            (B_PLUS_TREE_LEAF_PAGE_TYPE *)page->GetData();
+
     this->root_page_id_ = root_page_id;
-    root_page->Init(this->root_page_id_, INVALID_PAGE_ID);
+    root_page->Init(this->root_page_id_, INVALID_PAGE_ID,
+                    this->buffer_pool_manager_->GetPageSize(),
+                    this->comparator_.GetKeySize());
 
     this->UpdateRootPageId(true);
 
@@ -144,12 +139,23 @@ bool BPLUSTREE_TYPE::InsertIntoLeaf(const KeyType &key, const ValueType &value,
 {
     KeyType tmp_key;
     ValueType tmp_value;
-    B_PLUS_TREE_LEAF_PAGE_TYPE *leaf_pg = this->FindLeafPage(key, false);
+    Page *page = this->FindLeafPage(key, false, OpType::INSERT, transaction);
+
+    /* Current tree is empty, root_latch_ is held */
+    if(page == nullptr)
+    {
+        this->StartNewTree(key, value);
+        this->ReleaseLatchedPages(transaction, true);
+        return true;
+    }
+
+    B_PLUS_TREE_LEAF_PAGE_TYPE *leaf_pg =
+                    reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(page->GetData());
 
     /* Key already exists. Trying to insert duplicate key*/
     if(leaf_pg->Lookup(key, tmp_value, this->comparator_))
     {
-        this->buffer_pool_manager_->UnpinPage(leaf_pg->GetPageId(),false);
+        this->ReleaseLatchedPages(transaction, false);
         return false;
     }
 
@@ -174,7 +180,7 @@ bool BPLUSTREE_TYPE::InsertIntoLeaf(const KeyType &key, const ValueType &value,
         this->buffer_pool_manager_->UnpinPage(sib_leaf_pg->GetPageId(), true);
     }
 
-    this->buffer_pool_manager_->UnpinPage(leaf_pg->GetPageId(), true);
+    this->ReleaseLatchedPages(transaction, true);
     return true; 
 }
 
@@ -191,15 +197,19 @@ template <typename N> N *BPLUSTREE_TYPE::Split(N *node)
     page_id_t pg_id;
     page_id_t parent_pg_id = node->GetParentPageId();
 
-    N *bptree_pg = (N *) this->buffer_pool_manager_->NewPage(pg_id);
-		assert(pg_id != INVALID_PAGE_ID);
+    Page *page = this->buffer_pool_manager_->NewPage(pg_id, segment_id_);
 
-    if(bptree_pg == nullptr){ 
+    if(page == nullptr){ 
 				std::cout<<"Out of Memory\n";
         throw "Out of memory!";
 		}
+		assert(pg_id != INVALID_PAGE_ID);
 
-    bptree_pg->Init(pg_id, parent_pg_id);
+    N *bptree_pg = (N *)page->GetData();
+
+    bptree_pg->Init(pg_id, parent_pg_id,
+                    this->buffer_pool_manager_->GetPageSize(),
+                    this->comparator_.GetKeySize());
     node->MoveHalfTo(bptree_pg, this->buffer_pool_manager_);
 
 /*    if(node->GetPageType == LEAF_PAGE)
@@ -231,9 +241,10 @@ B_PLUS_TREE_INTERNAL_PG_PGID* BPLUSTREE_TYPE::GetNewRoot()
     BufferPoolManager *bpm = this->buffer_pool_manager_;
 
     B_PLUS_TREE_INTERNAL_PG_PGID *new_root_pg = 
-													(B_PLUS_TREE_INTERNAL_PG_PGID *)bpm->NewPage(root_pgid);
+							(B_PLUS_TREE_INTERNAL_PG_PGID *)bpm->NewPage(root_pgid, segment_id_)->GetData();
 		assert(root_pgid != INVALID_PAGE_ID);
-    new_root_pg->Init(root_pgid, NO_PARENT);
+    new_root_pg->Init(root_pgid, NO_PARENT, bpm->GetPageSize(),
+                      this->comparator_.GetKeySize());
     this->root_page_id_ = root_pgid;
     this->UpdateRootPageId(false);
 
@@ -256,6 +267,67 @@ void BPLUSTREE_TYPE::AdjustNextPageId(BPlusTreePage *new_pg,
 		}
 } 
 
+/*
+ * Key prefix of the children lo_index up to (not including) hi_index of
+ * parent: the key columns parent's keys lo_index and hi_index agree on. A
+ * range open to the left or right only gets parent's own prefix.
+ * @return  prefix size, key is set to a key of the range
+ */
+INDEX_TEMPLATE_ARGUMENTS
+int BPLUSTREE_TYPE::RangePrefixSize(B_PLUS_TREE_INTERNAL_PG_PGID *parent,
+                                    int lo_index, int hi_index, KeyType &key)
+{
+    if(parent->GetSize() < 2)
+        return 0;
+
+    key = parent->KeyAt(parent->GetSize()-1);
+    if(lo_index < 1 || hi_index >= parent->GetSize())
+        return parent->GetPrefixSize();
+
+    key = parent->KeyAt(lo_index);
+    return this->comparator_.PrefixSize(key, parent->KeyAt(hi_index));
+}
+
+/*
+ * After a split the key ranges of the two halves are narrower, so their keys
+ * may share a longer prefix. Prefixes only grow here, which never takes room
+ * away from a page.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::GrowKeyPrefix(BPlusTreePage *node,
+                                   B_PLUS_TREE_INTERNAL_PG_PGID *parent_pg)
+{
+    KeyType key;
+    int index = parent_pg->ValueIndex(node->GetPageId());
+    if(index == INVALID_INDEX)
+        return;
+
+    int prefix_size = this->RangePrefixSize(parent_pg, index, index+1, key);
+    if(prefix_size <= node->GetPrefixSize())
+        return;
+
+    if(node->IsLeafPage())
+        ((B_PLUS_TREE_LEAF_PAGE_TYPE *)node)->SetKeyPrefix(key, prefix_size);
+    else
+        ((B_PLUS_TREE_INTERNAL_PG_PGID *)node)->SetKeyPrefix(key, prefix_size);
+}
+
+/*
+ * Before node takes keys over from the sibling next to it (children lo_index
+ * and lo_index+1 of parent), cut its prefix down to what both ranges share
+ */
+INDEX_TEMPLATE_ARGUMENTS
+template <typename N>
+void BPLUSTREE_TYPE::ShrinkKeyPrefix(N *node,
+                                     B_PLUS_TREE_INTERNAL_PG_PGID *parent,
+                                     int lo_index)
+{
+    KeyType key;
+    int prefix_size = this->RangePrefixSize(parent, lo_index, lo_index+2, key);
+    if(prefix_size < node->GetPrefixSize())
+        node->SetKeyPrefix(key, prefix_size);
+}
+
 /*
  * Insert key & value pair into internal page after split
  * @param   old_node      input page from split() method
@@ -287,13 +359,15 @@ void BPLUSTREE_TYPE::InsertIntoParent(BPlusTreePage *old_node,
     else	
      	parent_pg = 
       	 (B_PLUS_TREE_INTERNAL_PG_PGID *)this->buffer_pool_manager_->FetchPage
-                                                (old_node->GetParentPageId());
+                                    (old_node->GetParentPageId())->GetData();
 	
     /* Enough space left in parent */
     if(parent_pg->GetSize() < parent_pg->GetMaxSize())
     {
         parent_pg->InsertNodeAfter(old_node->GetPageId(), key, 
                                          new_node->GetPageId());
+        this->GrowKeyPrefix(old_node, parent_pg);
+        this->GrowKeyPrefix(new_node, parent_pg);
     }
     else /* Not enough space left. Split required */
     {
@@ -320,6 +394,17 @@ void BPLUSTREE_TYPE::InsertIntoParent(BPlusTreePage *old_node,
 						new_node->SetParentPageId(parent_pg->GetPageId());
 						//this->AdjustNextPageId(new_node, parent_pg);
         }
+
+        if(new_node->GetParentPageId() == sib_pg->GetPageId())
+        {
+            this->GrowKeyPrefix(old_node, sib_pg);
+            this->GrowKeyPrefix(new_node, sib_pg);
+        }
+        else
+        {
+            this->GrowKeyPrefix(old_node, parent_pg);
+            this->GrowKeyPrefix(new_node, parent_pg);
+        }
         
         if(parent_pg->IsRootPage())
         {
@@ -347,6 +432,373 @@ void BPLUSTREE_TYPE::InsertIntoParent(BPlusTreePage *old_node,
 
 
 
+/*****************************************************************************
+ * BULK LOAD
+ *****************************************************************************/
+/*
+ * Build an empty tree bottom-up instead of inserting pair by pair:
+ * (1) sort the input, in runs of run_size pairs spilled to temp files and
+ *     merged if it does not fit in one
+ * (2) spread the sorted pairs evenly over as many leaves as it takes to fill
+ *     them to about fill_factor, linked left to right
+ * (3) build each internal level the same way out of the first keys of the
+ *     level below, until one page, the root, is left
+ * (4) from the root down, give each page the key prefix of its fences in
+ *     its parent; pages are sized for the prefix every key of their level
+ *     shares
+ * Pages come out of the tree's segment one after the other, so a scan of
+ * the leaf chain is sequential on disk. root_latch_ is held throughout; if
+ * the load fails, the pages built so far are deleted.
+ * @return: false if the tree is not empty
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::BulkLoad(const std::function<bool(MappingType &)> &next,
+                              double fill_factor, size_t run_size)
+{
+    BufferPoolManager *bpm = this->buffer_pool_manager_;
+
+    this->root_latch_.WLock();
+    if(!this->IsEmpty())
+    {
+        this->root_latch_.WUnlock();
+        return false;
+    }
+
+    std::vector<MappingType> run;
+    std::vector<std::FILE *> runs;
+    std::FILE *sorted = nullptr;
+    /* each level is kept as (first key, page id) per page */
+    std::vector<std::pair<KeyType, page_id_t>> level;
+    /* pages built so far, given back if the load fails, and the one pinned */
+    std::vector<page_id_t> pages;
+    page_id_t pinned_id = INVALID_PAGE_ID;
+    try
+    {
+        /* (1) sort */
+        MappingType pair;
+        while(next(pair))
+        {
+            run.push_back(pair);
+            if(run.size() >= run_size)
+                runs.push_back(this->SpillRun(run));
+        }
+
+        size_t count;
+        if(runs.empty())
+        {
+            this->SortRun(run);
+            count = run.size();
+        }
+        else
+        {
+            if(!run.empty())
+                runs.push_back(this->SpillRun(run));
+            sorted = this->MergeRuns(runs, count);
+        }
+
+        if(count == 0)
+        {
+            this->root_latch_.WUnlock();
+            return true;
+        }
+
+        /* all leaf keys share the prefix of the first and the last one */
+        KeyType first_key, last_key;
+        if(sorted == nullptr)
+        {
+            first_key = run.front().first;
+            last_key = run.back().first;
+        }
+        else
+        {
+            if(std::fread(&pair, sizeof(pair), 1, sorted) != 1)
+                throw Exception(EXCEPTION_TYPE_INDEX, "bulk load run is short");
+            first_key = pair.first;
+            if(std::fseek(sorted, -(long)sizeof(pair), SEEK_END) != 0 ||
+               std::fread(&pair, sizeof(pair), 1, sorted) != 1)
+                throw Exception(EXCEPTION_TYPE_INDEX, "bulk load run is short");
+            last_key = pair.first;
+            std::rewind(sorted);
+        }
+
+        /* (2) leaves */
+        B_PLUS_TREE_LEAF_PAGE_TYPE *prev_leaf = nullptr;
+        int leaf_count = 0;
+        size_t read = 0;
+
+        for(int i = 0; i == 0 || i < leaf_count; i++)
+        {
+            page_id_t pg_id;
+            Page *page = bpm->NewPage(pg_id, segment_id_);
+            if(page == nullptr)
+                throw Exception(EXCEPTION_TYPE_INDEX, "all pages are pinned");
+            pages.push_back(pg_id);
+            B_PLUS_TREE_LEAF_PAGE_TYPE *leaf_pg =
+                        (B_PLUS_TREE_LEAF_PAGE_TYPE *)page->GetData();
+            leaf_pg->Init(pg_id, INVALID_PAGE_ID, bpm->GetPageSize(),
+                          this->comparator_.GetKeySize());
+            if(prev_leaf != nullptr)
+            {
+                prev_leaf->SetNextPageId(pg_id);
+                bpm->UnpinPage(prev_leaf->GetPageId(), true);
+            }
+            prev_leaf = leaf_pg;
+            pinned_id = pg_id;
+            if(i == 0)
+                leaf_count = this->BulkLoadPageCount(
+                    count, leaf_pg->GetMaxSize(),
+                    leaf_pg->GetMaxSizeFor(
+                        this->comparator_.PrefixSize(first_key, last_key)),
+                    fill_factor);
+
+            size_t size = count / leaf_count + (i < (int)(count % leaf_count));
+            for(size_t j = 0; j < size; j++, read++)
+            {
+                if(sorted != nullptr)
+                {
+                    if(std::fread(&pair, sizeof(pair), 1, sorted) != 1)
+                        throw Exception(EXCEPTION_TYPE_INDEX,
+                                        "bulk load run is short");
+                }
+                else
+                    pair = run[read];
+                /* sorted input, always goes to the end */
+                leaf_pg->Insert(pair.first, pair.second, this->comparator_);
+            }
+            level.emplace_back(leaf_pg->KeyAt(0), pg_id);
+        }
+        bpm->UnpinPage(prev_leaf->GetPageId(), true);
+        pinned_id = INVALID_PAGE_ID;
+        run.clear();
+        if(sorted != nullptr)
+        {
+            std::fclose(sorted);
+            sorted = nullptr;
+        }
+
+        /* (3) internal levels */
+        while(level.size() > 1)
+        {
+            std::vector<std::pair<KeyType, page_id_t>> upper;
+            int node_count = 0;
+            size_t child = 0;
+
+            for(int i = 0; i == 0 || i < node_count; i++)
+            {
+                page_id_t pg_id;
+                Page *page = bpm->NewPage(pg_id, segment_id_);
+                if(page == nullptr)
+                    throw Exception(EXCEPTION_TYPE_INDEX,
+                                    "all pages are pinned");
+                pages.push_back(pg_id);
+                pinned_id = pg_id;
+                B_PLUS_TREE_INTERNAL_PG_PGID *int_pg =
+                            (B_PLUS_TREE_INTERNAL_PG_PGID *)page->GetData();
+                int_pg->Init(pg_id, INVALID_PAGE_ID, bpm->GetPageSize(),
+                             this->comparator_.GetKeySize());
+                if(i == 0)
+                    node_count = this->BulkLoadPageCount(
+                        level.size(), int_pg->GetMaxSize(),
+                        int_pg->GetMaxSizeFor(this->comparator_.PrefixSize(
+                            level.front().first, level.back().first)),
+                        fill_factor);
+
+                size_t size = level.size() / node_count +
+                              (i < (int)(level.size() % node_count));
+                for(size_t j = 0; j < size; j++, child++)
+                    int_pg->Append(level[child].first, level[child].second,
+                                   bpm);
+                upper.emplace_back(level[child - size].first, pg_id);
+                bpm->UnpinPage(pg_id, true);
+                pinned_id = INVALID_PAGE_ID;
+            }
+            level.swap(upper);
+        }
+
+        /* (4) prefixes, a parent's is set before its children's: the
+         * internal pages were built after their children */
+        for(size_t i = pages.size(); i-- > (size_t)leaf_count; )
+        {
+            Page *page = bpm->FetchPage(pages[i]);
+            if(page == nullptr)
+                throw Exception(EXCEPTION_TYPE_INDEX, "all pages are pinned");
+            pinned_id = pages[i];
+            this->SetChildKeyPrefixes(
+                (B_PLUS_TREE_INTERNAL_PG_PGID *)page->GetData());
+            bpm->UnpinPage(pages[i], false);
+            pinned_id = INVALID_PAGE_ID;
+        }
+    }
+    catch(...)
+    {
+        for(std::FILE *file : runs)
+            if(file != nullptr)
+                std::fclose(file);
+        if(sorted != nullptr)
+            std::fclose(sorted);
+        if(pinned_id != INVALID_PAGE_ID)
+            bpm->UnpinPage(pinned_id, false);
+        for(page_id_t pg_id : pages)
+            bpm->DeletePage(pg_id);
+        this->root_latch_.WUnlock();
+        throw;
+    }
+
+    this->root_page_id_ = level[0].second;
+    this->UpdateRootPageId(true);
+    this->root_latch_.WUnlock();
+    return true;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::SortRun(std::vector<MappingType> &run)
+{
+    std::stable_sort(run.begin(), run.end(),
+                     [this](const MappingType &a, const MappingType &b) {
+                         return this->comparator_(a.first, b.first) < 0;
+                     });
+    run.erase(std::unique(run.begin(), run.end(),
+                          [this](const MappingType &a, const MappingType &b) {
+                              return this->comparator_(a.first, b.first) == 0;
+                          }),
+              run.end());
+}
+
+/*
+ * The run is written out sorted and the file rewound for MergeRuns(), the
+ * run itself is cleared
+ */
+INDEX_TEMPLATE_ARGUMENTS
+std::FILE *BPLUSTREE_TYPE::SpillRun(std::vector<MappingType> &run)
+{
+    this->SortRun(run);
+
+    std::FILE *file = std::tmpfile();
+    if(file == nullptr ||
+       std::fwrite(run.data(), sizeof(MappingType), run.size(), file) !=
+           run.size())
+    {
+        if(file != nullptr)
+            std::fclose(file);
+        throw Exception(EXCEPTION_TYPE_INDEX, "can't spill bulk load run");
+    }
+    std::rewind(file);
+    run.clear();
+    return file;
+}
+
+/*
+ * k-way merge of the spilled runs through a heap of their smallest pairs.
+ * Runs are closed (and their slots in runs cleared) as they are used up; a
+ * key already written out, which came from an earlier run, wins.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+std::FILE *BPLUSTREE_TYPE::MergeRuns(std::vector<std::FILE *> &runs,
+                                     size_t &count)
+{
+    typedef std::pair<MappingType, size_t> HeadType;
+    auto greater = [this](const HeadType &a, const HeadType &b) {
+        int cmp = this->comparator_(a.first.first, b.first.first);
+        return cmp > 0 || (cmp == 0 && a.second > b.second);
+    };
+    std::priority_queue<HeadType, std::vector<HeadType>, decltype(greater)>
+        heads(greater);
+
+    std::FILE *out = std::tmpfile();
+    if(out == nullptr)
+        throw Exception(EXCEPTION_TYPE_INDEX, "can't merge bulk load runs");
+
+    HeadType head;
+    for(size_t i = 0; i < runs.size(); i++)
+    {
+        head.second = i;
+        if(std::fread(&head.first, sizeof(MappingType), 1, runs[i]) == 1)
+            heads.push(head);
+    }
+
+    count = 0;
+    MappingType last;
+    while(!heads.empty())
+    {
+        head = heads.top();
+        heads.pop();
+        if(count == 0 || this->comparator_(last.first, head.first.first) != 0)
+        {
+            if(std::fwrite(&head.first, sizeof(MappingType), 1, out) != 1)
+            {
+                std::fclose(out);
+                throw Exception(EXCEPTION_TYPE_INDEX,
+                                "can't merge bulk load runs");
+            }
+            last = head.first;
+            count++;
+        }
+        size_t i = head.second;
+        if(std::fread(&head.first, sizeof(MappingType), 1, runs[i]) == 1)
+            heads.push(head);
+        else
+        {
+            std::fclose(runs[i]);
+            runs[i] = nullptr;
+        }
+    }
+
+    runs.clear();
+    std::rewind(out);
+    return out;
+}
+
+/*
+ * As many pages as it takes to fill them to about fill_factor of
+ * prefixed_max_size, but never so few that one overflows nor so many that
+ * one is less than half full. A page may end up with a shorter prefix than
+ * its level shares (the first and last child of a page only get the
+ * page's), so it must fit max_size, the capacity without one.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+int BPLUSTREE_TYPE::BulkLoadPageCount(size_t count, int max_size,
+                                      int prefixed_max_size,
+                                      double fill_factor)
+{
+    int per_page = (int)(prefixed_max_size * fill_factor);
+    per_page = std::max(per_page, max_size / 2);
+    per_page = std::max(std::min(per_page, max_size), 1);
+
+    size_t pages = std::max<size_t>(count / per_page, 1);
+    if((count + pages - 1) / pages > (size_t)max_size)
+        pages = (count + max_size - 1) / max_size;
+    return (int)pages;
+}
+
+/*
+ * Grow the key prefix of each child of parent to the one its fences in
+ * parent share; parent's own prefix must be final
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::SetChildKeyPrefixes(B_PLUS_TREE_INTERNAL_PG_PGID *parent)
+{
+    BufferPoolManager *bpm = this->buffer_pool_manager_;
+    KeyType key;
+
+    for(int i = 0; i < parent->GetSize(); i++)
+    {
+        page_id_t child_id = parent->ValueAt(i);
+        Page *page = bpm->FetchPage(child_id);
+        if(page == nullptr)
+            throw Exception(EXCEPTION_TYPE_INDEX, "all pages are pinned");
+        BPlusTreePage *node = (BPlusTreePage *)page->GetData();
+        int prefix_size = this->RangePrefixSize(parent, i, i+1, key);
+        bool grown = prefix_size > node->GetPrefixSize();
+        if(grown && node->IsLeafPage())
+            ((B_PLUS_TREE_LEAF_PAGE_TYPE *)node)->SetKeyPrefix(key,
+                                                               prefix_size);
+        else if(grown)
+            ((B_PLUS_TREE_INTERNAL_PG_PGID *)node)->SetKeyPrefix(key,
+                                                                 prefix_size);
+        bpm->UnpinPage(child_id, grown);
+    }
+}
+
 /*****************************************************************************
  * REMOVE
  *****************************************************************************/
@@ -360,39 +812,43 @@ void BPLUSTREE_TYPE::InsertIntoParent(BPlusTreePage *old_node,
 INDEX_TEMPLATE_ARGUMENTS
 void BPLUSTREE_TYPE::Remove(const KeyType &key, Transaction *transaction) 
 {
-    if(this->IsEmpty())
-        return;
-    
-    B_PLUS_TREE_LEAF_PAGE_TYPE *leaf_pg = this->FindLeafPage(key, false);
+    std::unique_ptr<Transaction> local_transaction;
+    if(transaction == nullptr)
+    {
+        local_transaction.reset(new Transaction(INVALID_TXN_ID));
+        transaction = local_transaction.get();
+    }
 
-		if(leaf_pg == nullptr) return;
+    Page *page = this->FindLeafPage(key, false, OpType::DELETE, transaction);
+    if(page == nullptr)
+    {
+        this->ReleaseLatchedPages(transaction, false);
+        return;
+    }
 
-    leaf_pg->RemoveAndDeleteRecord(key, this->comparator_);	
+    B_PLUS_TREE_LEAF_PAGE_TYPE *leaf_pg =
+                    reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(page->GetData());
+    int old_size = leaf_pg->GetSize();
 
-    /*if(leaf_pg->GetSize() < leaf_pg->GetMinSize())
+    /* Key not found, nothing changed */
+    if(leaf_pg->RemoveAndDeleteRecord(key, this->comparator_) == old_size)
     {
-        if(this->CoalesceOrRedistribute(leaf_pg, transaction))
-        {*/
-            /* Unlikely to hit this condition, as the deletion is already
-             * taken care of in the CoalesceOrRedistribute()*/
-           /* this->buffer_pool_manager_->UnpinPage(leaf_pg->GetPageId(), true);
-            this->buffer_pool_manager_->DeletePage(leaf_pg->GetPageId());
-						return; 
-        }
-    }*/
+        this->ReleaseLatchedPages(transaction, false);
+        return;
+    }
 
-   	if(leaf_pg->GetSize() < leaf_pg->GetMinSize() && 
-			 this->CoalesceOrRedistribute(leaf_pg, transaction))
-		{
-				return;
-		}		
-    this->buffer_pool_manager_->UnpinPage(leaf_pg->GetPageId(), true);
+   	if(leaf_pg->GetSize() < leaf_pg->GetMinSize())
+        this->CoalesceOrRedistribute(leaf_pg, transaction);
+
+    this->ReleaseLatchedPages(transaction, true);
 }
 
 /*
  * User needs to first find the sibling of input page. If sibling's size + input
  * page's size > page's max size, then redistribute. Otherwise, merge.
  * Using template N to represent either internal page or leaf page.
+ * The node, its parent and (once CheckMergeSibbling latched them) its
+ * siblings are all write latched in the transaction's page set.
  * @return: true means target leaf page should be deleted, false means no
  * deletion happens
  */
@@ -401,80 +857,62 @@ template <typename N>
 bool BPLUSTREE_TYPE::CoalesceOrRedistribute(N *node, Transaction *transaction)
 {
 		bool result = false;
-		bool parent_deleted = false;
     B_PLUS_TREE_INTERNAL_PG_PGID *parent; 
 
     if(node->IsRootPage())
-    {
-				if(node->IsLeafPage()) 
-				{
-					if(node->GetSize() < 1)
-					{
-							this->buffer_pool_manager_->UnpinPage(node->GetPageId(), true);
-							this->buffer_pool_manager_->DeletePage(node->GetPageId());
-							return true;
-					}
-					return false;
-				}				
-
-
-				if(node->GetSize() > 1)
-					return false;
-
-
-				return AdjustRoot(node);
-    }  
+				return this->AdjustRoot(node, transaction);
 
 		parent = (B_PLUS_TREE_INTERNAL_PG_PGID *)this->buffer_pool_manager_->
-																				FetchPage(node->GetParentPageId());
+																	FetchPage(node->GetParentPageId())->GetData();
 
     /* Check posibility of Coalescing */
     int rd_sib_idx = -1; //Sibbling index when redistributing
     int parent_index = parent->ValueIndex(node->GetPageId());
 
+    /* A merged page only keeps the prefix both key ranges share */
+    KeyType key;
+    int lmax_size = node->GetMaxSizeFor(this->RangePrefixSize(parent,
+                                        parent_index-1, parent_index+1, key));
+    int rmax_size = node->GetMaxSizeFor(this->RangePrefixSize(parent,
+                                        parent_index, parent_index+2, key));
+
     int sib_index = this->CheckMergeSibbling(parent_index, parent, 
                                              node->GetSize(), 
-                                             node->GetMaxSize(), 
-                                             rd_sib_idx);
+                                             lmax_size, rmax_size,
+                                             rd_sib_idx, transaction);
 
     if(sib_index != INVALID_INDEX)
     {
        N *sib_pg = (N *)this->buffer_pool_manager_->FetchPage
-                                            (parent->ValueAt(sib_index));
+                                    (parent->ValueAt(sib_index))->GetData();
 			
        if(sib_index < parent_index)
 			 {
-          parent_deleted = this->Coalesce(sib_pg, node, parent, 
-																					parent_index, transaction);
-					this->buffer_pool_manager_->UnpinPage(sib_pg->GetPageId(), true);
+          this->Coalesce(sib_pg, node, parent, parent_index, transaction);
 					result = true;
 			 }
        else
 			 { 
-          parent_deleted = this->Coalesce(node, sib_pg, parent, 
-																					sib_index, transaction);
+          this->Coalesce(node, sib_pg, parent, sib_index, transaction);
 			 		result = false; 
 			 }
+    	 this->buffer_pool_manager_->UnpinPage(sib_pg->GetPageId(), true);
     }
     else 
     {
        N *sib_pg = (N *)this->buffer_pool_manager_->FetchPage
-                                          (parent->ValueAt(rd_sib_idx));
+                                    (parent->ValueAt(rd_sib_idx))->GetData();
+       this->ShrinkKeyPrefix(node, parent, std::min(rd_sib_idx, parent_index));
        if(rd_sib_idx < parent_index)
           this->Redistribute(sib_pg, node, 0);
        else 
           this->Redistribute(sib_pg, node, 1);
 
     	 this->buffer_pool_manager_->UnpinPage(sib_pg->GetPageId(), true);
-			 result = false; //Need to Unpin
+			 result = false;
     }
-    
-	
-		if(!parent_deleted) 
-		{		
-				this->buffer_pool_manager_->UnpinPage(parent->GetPageId(), true);
-		}
 	
+		this->buffer_pool_manager_->UnpinPage(parent->GetPageId(), true);
     return result;
 }
 
@@ -501,12 +939,13 @@ bool BPLUSTREE_TYPE::Coalesce(N *&neighbor_node, N *&node,
      *   Node          - Donor
      *   parent        - parent of donor & recepient
      *   index         - index of donor in parent node
-     *   transaction   - not used
+     *   transaction   - holds the latches, the donor is deleted once they
+     *                   are released
      */
+    this->ShrinkKeyPrefix(neighbor_node, parent, index-1);
     node->MoveAllTo(neighbor_node, index, this->buffer_pool_manager_);
 
-    this->buffer_pool_manager_->UnpinPage(node->GetPageId(), true);
-    this->buffer_pool_manager_->DeletePage(node->GetPageId());
+    transaction->AddIntoDeletedPageSet(node->GetPageId());
 
     parent->Remove(index);
 
@@ -552,38 +991,51 @@ void BPLUSTREE_TYPE::Redistribute(N *neighbor_node, N *node, int index)
  * happend
  */
 INDEX_TEMPLATE_ARGUMENTS
-bool BPLUSTREE_TYPE::AdjustRoot(BPlusTreePage *old_root_node) 
+bool BPLUSTREE_TYPE::AdjustRoot(BPlusTreePage *old_root_node,
+                                Transaction *transaction) 
 {
-		if(old_root_node->GetSize() == 1)
+		if(old_root_node->IsLeafPage())
+		{
+				/* case 2: the tree is empty now */
+				if(old_root_node->GetSize() > 0)
+						return false;
+				this->root_page_id_ = INVALID_PAGE_ID;
+		}
+		else
 		{
+				/* case 1: the only child left becomes the root */
+				if(old_root_node->GetSize() > 1)
+						return false;
 				BPlusTreePage *new_root_pg;
     		this->root_page_id_ = 
                ((B_PLUS_TREE_INTERNAL_PG_PGID *)old_root_node)->ValueAt(0);
 				new_root_pg = (BPlusTreePage*)this->buffer_pool_manager_->
-																			FetchPage(this->root_page_id_);
+																FetchPage(this->root_page_id_)->GetData();
 				new_root_pg->SetParentPageId(INVALID_PAGE_ID);	
+				/* it took over its sibling's range, open on both sides */
+				assert(new_root_pg->GetPrefixSize() == 0);
 				this->buffer_pool_manager_->UnpinPage(new_root_pg->GetPageId(),
 																							true);
 		}
-		else
-		{
-				this->root_page_id_ = INVALID_PAGE_ID;
-		}
-		
-	
-    this->buffer_pool_manager_->UnpinPage(old_root_node->GetPageId(),true);
-    this->buffer_pool_manager_->DeletePage(old_root_node->GetPageId());
+
+    transaction->AddIntoDeletedPageSet(old_root_node->GetPageId());
     this->UpdateRootPageId(false);
 
-    return true; //No need to delete. As the node is already deleted.
+    return true;
 }
 
 
+/*
+ * Pick the sibling to merge with (returned) or, if none fits, the one to
+ * borrow from (redistribute_idx). Both neighbors are write latched first and
+ * stay latched in the transaction's page set.
+ */
 INDEX_TEMPLATE_ARGUMENTS
 int BPLUSTREE_TYPE::CheckMergeSibbling(int parent_idx, 
                                        B_PLUS_TREE_INTERNAL_PG_PGID *parent,
-                                       int cur_node_size, int node_max_size, 
-                                       int &redistribute_idx)
+                                       int cur_node_size, int lmax_size,
+                                       int rmax_size, int &redistribute_idx,
+                                       Transaction *transaction)
 {
     int lnode_size = 0;
     int rnode_size = 0;
@@ -594,27 +1046,25 @@ int BPLUSTREE_TYPE::CheckMergeSibbling(int parent_idx,
    
     if(lidx >= 0)
     {
-       BPlusTreePage *bt_pg = 
-          (BPlusTreePage *)this->buffer_pool_manager_->FetchPage
-                                              (parent->ValueAt(lidx));
-       lnode_size = bt_pg->GetSize();
-       this->buffer_pool_manager_->UnpinPage(bt_pg->GetPageId(), false);
+       Page *page = this->buffer_pool_manager_->FetchPage(parent->ValueAt(lidx));
+       page->WLatch();
+       transaction->AddIntoPageSet(page);
+       lnode_size = ((BPlusTreePage *)page->GetData())->GetSize();
     }
 
     if(ridx >= 0)
     { 
-       BPlusTreePage *bt_pg = 
-          (BPlusTreePage *)this->buffer_pool_manager_->FetchPage
-                                            (parent->ValueAt(ridx)); 
-       rnode_size = bt_pg->GetSize();
-       this->buffer_pool_manager_->UnpinPage(bt_pg->GetPageId(), false);
+       Page *page = this->buffer_pool_manager_->FetchPage(parent->ValueAt(ridx));
+       page->WLatch();
+       transaction->AddIntoPageSet(page);
+       rnode_size = ((BPlusTreePage *)page->GetData())->GetSize();
     }
 
 
     if(lidx < 0) 
     {
         redistribute_idx = ridx;
-        if(rnode_size+cur_node_size <= node_max_size)
+        if(rnode_size+cur_node_size <= rmax_size)
             return ridx;
         return INVALID_INDEX;
     }
@@ -622,7 +1072,7 @@ int BPLUSTREE_TYPE::CheckMergeSibbling(int parent_idx,
     if(ridx < 0)
     {
         redistribute_idx = lidx;
-        if(lnode_size+cur_node_size <= node_max_size)
+        if(lnode_size+cur_node_size <= lmax_size)
             return lidx;
         return INVALID_INDEX;
     }
@@ -631,32 +1081,16 @@ int BPLUSTREE_TYPE::CheckMergeSibbling(int parent_idx,
     if(lnode_size <= rnode_size)
     {
         redistribute_idx = ridx;
-        if(lnode_size+cur_node_size <= node_max_size)
+        if(lnode_size+cur_node_size <= lmax_size)
             return lidx;
     }
     else
     {
         redistribute_idx = lidx;
-        if(rnode_size+cur_node_size <= node_max_size)
+        if(rnode_size+cur_node_size <= rmax_size)
             return ridx;
     }
 
-
-    /*if(right_child_size == 0 && left_child_size == 0) 
-        return INVALID_INDEX;
-
-
-    if(left_child_size < right_child_size)
-    {
-        if(left_child_size+node_size <= node_max_size)
-            return left_index;
-    }
-    else
-    {
-        if(right_child_size+node_size <= node_max_size)
-            return right_index;
-    }*/
-
     return INVALID_INDEX;
 }
 
@@ -671,11 +1105,9 @@ int BPLUSTREE_TYPE::CheckMergeSibbling(int parent_idx,
 INDEX_TEMPLATE_ARGUMENTS
 INDEXITERATOR_TYPE BPLUSTREE_TYPE::Begin() 
 { 
-    KeyType key;
-    B_PLUS_TREE_LEAF_PAGE_TYPE *leaf_pg = this->FindLeafPage(key, true);
-		page_id_t pg_id = leaf_pg->GetPageId();
-		this->buffer_pool_manager_->UnpinPage(pg_id, false);
-    return INDEXITERATOR_TYPE(this->buffer_pool_manager_, pg_id);
+    KeyType key{};
+    Page *page = this->FindLeafPage(key, true);
+    return INDEXITERATOR_TYPE(this->buffer_pool_manager_, page, 0);
 }
 
 /*
@@ -686,10 +1118,63 @@ INDEXITERATOR_TYPE BPLUSTREE_TYPE::Begin()
 INDEX_TEMPLATE_ARGUMENTS
 INDEXITERATOR_TYPE BPLUSTREE_TYPE::Begin(const KeyType &key) 
 {
-    B_PLUS_TREE_LEAF_PAGE_TYPE *leaf_pg = this->FindLeafPage(key, false);
-		page_id_t pg_id = leaf_pg->GetPageId();
-		this->buffer_pool_manager_->UnpinPage(pg_id, false);
-    return INDEXITERATOR_TYPE(this->buffer_pool_manager_, pg_id);
+    Page *page = this->FindLeafPage(key, false);
+    if(page == nullptr)
+        return INDEXITERATOR_TYPE(this->buffer_pool_manager_, nullptr, 0);
+
+    B_PLUS_TREE_LEAF_PAGE_TYPE *leaf_pg =
+                    reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(page->GetData());
+    /* every key of the leaf is smaller, start at the next one */
+    int index = leaf_pg->KeyIndex(key, this->comparator_);
+    if(index == INVALID_INDEX)
+        index = leaf_pg->GetSize();
+    return INDEXITERATOR_TYPE(this->buffer_pool_manager_, page, index);
+}
+
+/*
+ * Range scan along the leaf chain, starting at the leaf low is in
+ * @return : number of values handed to callback
+ */
+INDEX_TEMPLATE_ARGUMENTS
+size_t BPLUSTREE_TYPE::ScanRange(const KeyType *low, bool low_inclusive,
+                                 const KeyType *high, bool high_inclusive,
+                                 size_t limit,
+                                 const std::function<bool(
+                                     const std::vector<ValueType> &)> &callback)
+{
+    std::vector<ValueType> batch;
+    size_t count = 0;
+    bool more = true;
+
+    batch.reserve(RANGE_SCAN_BATCH_SIZE);
+    INDEXITERATOR_TYPE iterator =
+                (low == nullptr) ? this->Begin() : this->Begin(*low);
+    for(; !iterator.isEnd() && (limit == 0 || count < limit); ++iterator)
+    {
+        const MappingType &pair = *iterator;
+        if(low != nullptr && !low_inclusive &&
+           this->comparator_(pair.first, *low) == 0)
+            continue;
+        if(high != nullptr)
+        {
+            int cmp = this->comparator_(pair.first, *high);
+            if(cmp > 0 || (cmp == 0 && !high_inclusive))
+                break;
+        }
+
+        batch.push_back(pair.second);
+        count++;
+        if(batch.size() == RANGE_SCAN_BATCH_SIZE)
+        {
+            more = callback(batch);
+            batch.clear();
+            if(!more)
+                break;
+        }
+    }
+    if(more && !batch.empty())
+        callback(batch);
+    return count;
 }
 
 /*****************************************************************************
@@ -697,34 +1182,223 @@ INDEXITERATOR_TYPE BPLUSTREE_TYPE::Begin(const KeyType &key)
  *****************************************************************************/
 /*
  * Find leaf page containing particular key, if leftMost flag == true, find
- * the left most leaf page
+ * the left most leaf page.
+ * Latch crabbing: the next page is latched before the one above it is let
+ * go. A reader never holds more than two latches; a writer keeps the
+ * ancestors latched until it reaches a page that is safe for its operation.
+ * Writers try the optimistic descent first, most of them never change more
+ * than the leaf.
  */
 INDEX_TEMPLATE_ARGUMENTS
-B_PLUS_TREE_LEAF_PAGE_TYPE *BPLUSTREE_TYPE::FindLeafPage(const KeyType &key,
-                                                         bool leftMost) 
+Page *BPLUSTREE_TYPE::FindLeafPage(const KeyType &key, bool leftMost,
+                                   OpType op, Transaction *transaction) 
 {   
-    BPlusTreePage *page_ptr = 
-        (BPlusTreePage*)this->buffer_pool_manager_->FetchPage
-                                                      (this->root_page_id_);
-    page_id_t pg_id;
+    BufferPoolManager *bpm = this->buffer_pool_manager_;
+    Page *page;
 
+    if(op != OpType::READ)
+    {
+        page = this->FindLeafPageOptimistic(key, leftMost, op, transaction);
+        if(page != nullptr)
+            return page;
+    }
+
+    if(op == OpType::READ)
+    {
+        this->root_latch_.RLock();
+        if(this->IsEmpty())
+        {
+            this->root_latch_.RUnlock();
+            return nullptr;
+        }
+        page = bpm->FetchPage(this->root_page_id_);
+        if(page == nullptr)
+        {
+            this->root_latch_.RUnlock();
+            throw Exception(EXCEPTION_TYPE_INDEX, "all pages are pinned");
+        }
+        page->RLatch();
+        this->root_latch_.RUnlock();
+    }
+    else
+    {
+        this->root_latch_.WLock();
+        transaction->AddIntoPageSet(nullptr);
+        if(this->IsEmpty())
+            return nullptr;
+        page = bpm->FetchPage(this->root_page_id_);
+        if(page == nullptr)
+        {
+            this->ReleaseLatchedPages(transaction, false);
+            throw Exception(EXCEPTION_TYPE_INDEX, "all pages are pinned");
+        }
+        page->WLatch();
+        if(this->IsSafe((BPlusTreePage *)page->GetData(), op))
+            this->ReleaseLatchedPages(transaction, false);
+        transaction->AddIntoPageSet(page);
+    }
+
+    BPlusTreePage *page_ptr = (BPlusTreePage *)page->GetData();
     while(!page_ptr->IsLeafPage())
     {
         B_PLUS_TREE_INTERNAL_PG_PGID *int_pg_ptr = 
                       (B_PLUS_TREE_INTERNAL_PG_PGID *)page_ptr;
+        page_id_t pg_id;
 
         if(leftMost)
             pg_id = int_pg_ptr->ValueAt(0);
         else
             pg_id = int_pg_ptr->Lookup(key, this->comparator_);
 
-        this->buffer_pool_manager_->UnpinPage(page_ptr->GetPageId(), false);
+        Page *child = bpm->FetchPage(pg_id);
+        if(child == nullptr)
+        {
+            if(op == OpType::READ)
+            {
+                page->RUnlatch();
+                bpm->UnpinPage(page->GetPageId(), false);
+            }
+            else
+                this->ReleaseLatchedPages(transaction, false);
+            throw Exception(EXCEPTION_TYPE_INDEX, "all pages are pinned");
+        }
 
-        page_ptr = 
-            (BPlusTreePage *)this->buffer_pool_manager_->FetchPage(pg_id);
+        if(op == OpType::READ)
+        {
+            child->RLatch();
+            page->RUnlatch();
+            bpm->UnpinPage(page->GetPageId(), false);
+        }
+        else
+        {
+            child->WLatch();
+            if(this->IsSafe((BPlusTreePage *)child->GetData(), op))
+                this->ReleaseLatchedPages(transaction, false);
+            transaction->AddIntoPageSet(child);
+        }
+        page = child;
+        page_ptr = (BPlusTreePage *)page->GetData();
     }
     
-    return ((B_PLUS_TREE_LEAF_PAGE_TYPE *)page_ptr);
+    return page;
+}
+
+/*
+ * Like a lookup, except that the leaf is write latched. The tree above the
+ * leaf can only change under a write latch of the leaf's parent (or of
+ * root_latch_ for a root leaf), which the read latch held while latching the
+ * leaf keeps out; so a safe leaf is all the insert/delete needs. Otherwise
+ * the leaf is let go again and the caller starts over pessimistically.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+Page *BPLUSTREE_TYPE::FindLeafPageOptimistic(const KeyType &key,
+                                             bool leftMost, OpType op,
+                                             Transaction *transaction)
+{
+    BufferPoolManager *bpm = this->buffer_pool_manager_;
+
+    this->root_latch_.RLock();
+    if(this->IsEmpty())
+    {
+        this->root_latch_.RUnlock();
+        return nullptr;
+    }
+    Page *page = bpm->FetchPage(this->root_page_id_);
+    if(page == nullptr)
+    {
+        this->root_latch_.RUnlock();
+        throw Exception(EXCEPTION_TYPE_INDEX, "all pages are pinned");
+    }
+
+    /* A page stays a leaf or an internal page as long as it is in the tree */
+    BPlusTreePage *page_ptr = (BPlusTreePage *)page->GetData();
+    if(page_ptr->IsLeafPage())
+        page->WLatch();
+    else
+        page->RLatch();
+    this->root_latch_.RUnlock();
+
+    while(!page_ptr->IsLeafPage())
+    {
+        B_PLUS_TREE_INTERNAL_PG_PGID *int_pg_ptr = 
+                      (B_PLUS_TREE_INTERNAL_PG_PGID *)page_ptr;
+        page_id_t pg_id;
+
+        if(leftMost)
+            pg_id = int_pg_ptr->ValueAt(0);
+        else
+            pg_id = int_pg_ptr->Lookup(key, this->comparator_);
+
+        Page *child = bpm->FetchPage(pg_id);
+        if(child == nullptr)
+        {
+            page->RUnlatch();
+            bpm->UnpinPage(page->GetPageId(), false);
+            throw Exception(EXCEPTION_TYPE_INDEX, "all pages are pinned");
+        }
+
+        BPlusTreePage *child_ptr = (BPlusTreePage *)child->GetData();
+        if(child_ptr->IsLeafPage())
+            child->WLatch();
+        else
+            child->RLatch();
+        page->RUnlatch();
+        bpm->UnpinPage(page->GetPageId(), false);
+
+        page = child;
+        page_ptr = child_ptr;
+    }
+
+    if(!this->IsSafe(page_ptr, op))
+    {
+        page->WUnlatch();
+        bpm->UnpinPage(page->GetPageId(), false);
+        return nullptr;
+    }
+
+    transaction->AddIntoPageSet(page);
+    return page;
+}
+
+/*
+ * Safe for an insert: one more entry does not split the page. Safe for a
+ * delete: one entry less does not make it underflow (and a root does not
+ * have to be replaced).
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::IsSafe(BPlusTreePage *node, OpType op)
+{
+    if(op == OpType::INSERT)
+        return node->GetSize() < node->GetMaxSize();
+    if(node->IsRootPage())
+        return node->GetSize() > (node->IsLeafPage() ? 1 : 2);
+    return node->GetSize() > node->GetMinSize();
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::ReleaseLatchedPages(Transaction *transaction,
+                                         bool is_dirty)
+{
+    auto page_set = transaction->GetPageSet();
+    for(Page *page : *page_set)
+    {
+        if(page == nullptr)
+        {
+            this->root_latch_.WUnlock();
+            continue;
+        }
+        page->WUnlatch();
+        this->buffer_pool_manager_->UnpinPage(page->GetPageId(), is_dirty);
+    }
+    page_set->clear();
+
+    /* Nobody can reach these anymore, and no pin of ours is left. An
+     * iterator may still pin one on its way along the leaves, the buffer
+     * pool then deletes it when that pin is dropped */
+    auto deleted_page_set = transaction->GetDeletedPageSet();
+    for(page_id_t page_id : *deleted_page_set)
+        this->buffer_pool_manager_->DeletePage(page_id);
+    deleted_page_set->clear();
 }
 
 /*
@@ -740,12 +1414,15 @@ void BPLUSTREE_TYPE::UpdateRootPageId(int insert_record)
 {
  	 	HeaderPage *header_page = static_cast<HeaderPage *>(
       		buffer_pool_manager_->FetchPage(HEADER_PAGE_ID));
+    // shared by all indexes, which change their roots independently
+    header_page->WLatch();
   	if (insert_record)
     	// create a new record<index_name + root_page_id> in header_page
     	header_page->InsertRecord(index_name_, root_page_id_);
   	else
     	// update root_page_id in header_page
     	header_page->UpdateRecord(index_name_, root_page_id_);
+    header_page->WUnlatch();
  
 	 	buffer_pool_manager_->UnpinPage(HEADER_PAGE_ID, true);
 }
@@ -757,6 +1434,7 @@ void BPLUSTREE_TYPE::UpdateRootPageId(int insert_record)
 INDEX_TEMPLATE_ARGUMENTS
 std::string BPLUSTREE_TYPE::ToString(bool verbose) 
 {	
+		Page *page;
 		BPlusTreePage *pg; 
 		std::queue<page_id_t> pg_q;
 		std::queue<page_id_t> pin_cnt_q;
@@ -770,7 +1448,8 @@ std::string BPLUSTREE_TYPE::ToString(bool verbose)
 		while(!pg_q.empty())
 		{
 			page_id_t pg_id = pg_q.front();
-			pg = (BPlusTreePage *)this->buffer_pool_manager_->FetchPage(pg_id);
+			page = this->buffer_pool_manager_->FetchPage(pg_id);
+			pg = (BPlusTreePage *)page->GetData();
 			
 			pg_q.pop();
 
@@ -784,7 +1463,7 @@ std::string BPLUSTREE_TYPE::ToString(bool verbose)
 					next_level++;
 				}
 			} 
-				std::cout<<"[PgId:"<<pg->GetPageId()<<", PC:"<<((Page *)pg)->GetPinCount()<<", MinSz:"<<pg->GetMinSize()<<"]:";
+				std::cout<<"[PgId:"<<pg->GetPageId()<<", PC:"<<page->GetPinCount()<<", MinSz:"<<pg->GetMinSize()<<"]:";
 
 			for(int x=0; x<pg->GetSize(); x++) 
 			{
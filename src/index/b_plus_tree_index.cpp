@@ -2,7 +2,9 @@
  * b_plus_tree_index.cpp
  */
 
+#include "common/exception.h"
 #include "index/b_plus_tree_index.h"
+#include "table/table_heap.h"
 
 namespace cmudb {
 /*
@@ -45,6 +47,48 @@ void BPLUSTREE_INDEX_TYPE::ScanKey(const Tuple &key, std::vector<RID> &result,
 
   container_.GetValue(index_key, result, transaction);
 }
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_INDEX_TYPE::ScanRange(
+    const Tuple *low, bool low_inclusive, const Tuple *high,
+    bool high_inclusive, size_t limit,
+    const std::function<bool(const std::vector<RID> &)> &callback,
+    Transaction *transaction) {
+  // construct scan bounds
+  KeyType low_key, high_key;
+  if (low != nullptr)
+    low_key.SetFromKey(*low);
+  if (high != nullptr)
+    high_key.SetFromKey(*high);
+
+  container_.ScanRange(low == nullptr ? nullptr : &low_key, low_inclusive,
+                       high == nullptr ? nullptr : &high_key, high_inclusive,
+                       limit, callback);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_INDEX_TYPE::BulkLoad(TableHeap *table_heap,
+                                    Schema *tuple_schema,
+                                    Transaction *transaction) {
+  auto itr = table_heap->begin(transaction);
+  auto end = table_heap->end();
+  bool loaded = container_.BulkLoad([&](MappingType &pair) {
+    if (itr == end)
+      return false;
+    // construct index key out of the tuple's key columns
+    std::vector<Value> key_values;
+    for (auto &i : GetKeyAttrs())
+      key_values.push_back(itr->GetValue(tuple_schema, i));
+    Tuple key(key_values, GetKeySchema());
+    pair.first.SetFromKey(key);
+    pair.second = itr->GetRid();
+    ++itr;
+    return true;
+  });
+  if (!loaded)
+    throw Exception(EXCEPTION_TYPE_INDEX, "can't bulk load, index not empty");
+}
+
 template class BPlusTreeIndex<GenericKey<4>, RID, GenericComparator<4>>;
 template class BPlusTreeIndex<GenericKey<8>, RID, GenericComparator<8>>;
 template class BPlusTreeIndex<GenericKey<16>, RID, GenericComparator<16>>;
@@ -3,6 +3,7 @@
  */
 #include <cassert>
 
+#include "common/exception.h"
 #include "index/index_iterator.h"
 
 namespace cmudb {
@@ -12,18 +13,21 @@ namespace cmudb {
  * set your own input parameters
  */
 INDEX_TEMPLATE_ARGUMENTS
-//INDEXITERATOR_TYPE::IndexIterator(BufferPoolManager *bpm,
-//																	B_PLUS_TREE_LEAF_PAGE_TYPE *current_pg) 
-INDEXITERATOR_TYPE::IndexIterator(BufferPoolManager *bpm, page_id_t page_id) 
+INDEXITERATOR_TYPE::IndexIterator(BufferPoolManager *bpm, Page *leaf,
+                                  int index) 
+		: read_ahead(bpm)
 {
-		B_PLUS_TREE_LEAF_PAGE_TYPE *leaf_pg; 
 		this->buffer_pool_manager = bpm;
-		this->current_page_id = page_id;
+		this->current_page_id = INVALID_PAGE_ID;
+		this->current_index = INVALID_INDEX;
+		if(leaf == nullptr)
+				return;
 
-		leaf_pg = (B_PLUS_TREE_LEAF_PAGE_TYPE *)this->buffer_pool_manager->FetchPage
-																													(this->current_page_id);
-		this->current_index = (leaf_pg->GetSize())?0:INVALID_INDEX;
-		this->buffer_pool_manager->UnpinPage(leaf_pg->GetPageId(), false);
+		this->current_page_id = leaf->GetPageId();
+		this->current_index = index;
+		this->read_ahead.Access(this->current_page_id);
+		this->leaf_guard = ReadPageGuard(bpm, leaf);
+		this->SkipToValidEntry();
 }
 
 INDEX_TEMPLATE_ARGUMENTS
@@ -42,12 +46,10 @@ bool INDEXITERATOR_TYPE::isEnd()
 INDEX_TEMPLATE_ARGUMENTS
 const MappingType& INDEXITERATOR_TYPE::operator*()
 {
-		B_PLUS_TREE_LEAF_PAGE_TYPE *leaf_pg; 
-		leaf_pg = (B_PLUS_TREE_LEAF_PAGE_TYPE *)this->buffer_pool_manager->FetchPage
-																											(this->current_page_id);
-		auto *item = &leaf_pg->GetItem(this->current_index); 
-		this->buffer_pool_manager->UnpinPage(leaf_pg->GetPageId(),false);
-		return *item;
+		//The leaf stays pinned and latched while the iterator points into it
+		this->item = this->leaf_guard.template As<B_PLUS_TREE_LEAF_PAGE_TYPE>()
+																							->GetItem(this->current_index);
+		return this->item;
 }
 
 
@@ -55,31 +57,49 @@ const MappingType& INDEXITERATOR_TYPE::operator*()
 INDEX_TEMPLATE_ARGUMENTS
 INDEXITERATOR_TYPE& INDEXITERATOR_TYPE::operator++()
 {
-	B_PLUS_TREE_LEAF_PAGE_TYPE *leaf_pg;
-
-	if(this->current_page_id == INVALID_PAGE_ID)
+	if(this->current_page_id == INVALID_PAGE_ID || !this->leaf_guard.IsValid())
 		return *this;	
  
-	leaf_pg = (B_PLUS_TREE_LEAF_PAGE_TYPE *)this->buffer_pool_manager->FetchPage
-																												(this->current_page_id);
-	if(this->current_index < leaf_pg->GetSize()-1)
-	{
-			this->current_index++;
-	}
-	else if(leaf_pg->GetNextPageId() != INVALID_PAGE_ID)
+	this->current_index++;
+	this->SkipToValidEntry();
+	return *this;
+}
+
+/*
+ * Leaves are latched left to right while writers merging leaves latch right
+ * to left, so the next leaf is only waited for after letting go of this one.
+ * Entries a concurrent merge moves into a leaf already passed are missed.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void INDEXITERATOR_TYPE::SkipToValidEntry()
+{
+	B_PLUS_TREE_LEAF_PAGE_TYPE *leaf_pg =
+			this->leaf_guard.template As<B_PLUS_TREE_LEAF_PAGE_TYPE>();
+
+	while(this->current_index >= leaf_pg->GetSize())
 	{
 			page_id_t next_pg_id = leaf_pg->GetNextPageId();
+			if(next_pg_id == INVALID_PAGE_ID)
+			{
+					this->current_page_id = INVALID_PAGE_ID;
+					this->current_index = INVALID_INDEX;
+					this->leaf_guard.Drop();
+					return;
+			}
+			Page *next_pg = this->buffer_pool_manager->FetchPage(next_pg_id);
+			if(next_pg == nullptr)
+					throw Exception(EXCEPTION_TYPE_INDEX, "all pages are pinned");
+			if(!next_pg->TryRLatch())
+			{
+					this->leaf_guard.Drop();
+					next_pg->RLatch();
+			}
 			this->current_index = 0;
 			this->current_page_id = next_pg_id;
+			this->read_ahead.Access(next_pg_id);
+			this->leaf_guard = ReadPageGuard(this->buffer_pool_manager, next_pg);
+			leaf_pg = this->leaf_guard.template As<B_PLUS_TREE_LEAF_PAGE_TYPE>();
 	}
-	else
-	{
-		//this->buffer_pool_manager->UnpinPage(leaf_pg->GetPageId(), false);
-			this->current_page_id = INVALID_PAGE_ID;
-			this->current_index = INVALID_INDEX;
-	}
-	this->buffer_pool_manager->UnpinPage(leaf_pg->GetPageId(), false);
-	return *this;
 }
 
 template class IndexIterator<GenericKey<4>, RID, GenericComparator<4>>;
@@ -1,6 +1,7 @@
 /**
  * b_plus_tree_internal_page.cpp
  */
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 
@@ -18,16 +19,34 @@ namespace cmudb {
  */
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::Init(page_id_t page_id,
-                                          page_id_t parent_id) 
+                                          page_id_t parent_id,
+                                          size_t page_size,
+                                          int key_size)
 {
-  int max_size = 0;
   this->SetPageType(IndexPageType::INTERNAL_PAGE);
   this->SetSize(0);
   this->SetPageId(page_id);
   this->SetParentPageId(parent_id);
 
-  max_size = (PAGE_SIZE - this->GetHeaderSize())/sizeof(MappingType);
-  this->SetMaxSize(max_size);
+  this->InitKeyLayout(page_size, std::min<int>(key_size, sizeof(KeyType)),
+                      sizeof(ValueType));
+}
+
+/*
+ * Helper methods for the key prefix, only changed once the pairs fit
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::SetKeyPrefix(const KeyType &key,
+                                                  int prefix_size)
+{
+  this->SetPrefixSize(reinterpret_cast<const char *>(&key), prefix_size,
+                      sizeof(ValueType));
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+int B_PLUS_TREE_INTERNAL_PAGE_TYPE::GetMaxSizeFor(int prefix_size) const
+{
+  return this->MaxSizeFor(prefix_size, sizeof(ValueType));
 }
 
 
@@ -37,13 +56,14 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::Init(page_id_t page_id,
  */
 INDEX_TEMPLATE_ARGUMENTS
 KeyType B_PLUS_TREE_INTERNAL_PAGE_TYPE::KeyAt(int index) const {
-  return this->array[index].first;
+  return this->template ReadKey<KeyType>(
+      this->ItemData(index, sizeof(ValueType)));
 }
 
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::SetKeyAt(int index, const KeyType &key) 
 {
-  this->array[index].first = key;  
+  this->WriteKey(this->ItemData(index, sizeof(ValueType)), key);
 }
 
 /*
@@ -55,7 +75,7 @@ int B_PLUS_TREE_INTERNAL_PAGE_TYPE::ValueIndex(const ValueType &value) const
 {
   for(int i=0;i<this->GetSize();i++)
   {
-    if(this->array[i].second == value)
+    if(this->ValueAt(i) == value)
 		{
       return i;
 		}
@@ -70,7 +90,33 @@ int B_PLUS_TREE_INTERNAL_PAGE_TYPE::ValueIndex(const ValueType &value) const
 INDEX_TEMPLATE_ARGUMENTS
 ValueType B_PLUS_TREE_INTERNAL_PAGE_TYPE::ValueAt(int index) const 
 { 
-  return this->array[index].second;
+  return this->template ReadValue<ValueType>(
+      this->ItemData(index, sizeof(ValueType)));
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::SetValueAt(int index,
+                                                const ValueType &value)
+{
+  this->WriteValue(this->ItemData(index, sizeof(ValueType)), value);
+}
+
+/*
+ * Helper methods to get/set the key & value pair associated with input
+ * "index"(a.k.a array offset)
+ */
+INDEX_TEMPLATE_ARGUMENTS
+MappingType B_PLUS_TREE_INTERNAL_PAGE_TYPE::GetItem(int index) const
+{
+  return std::make_pair(this->KeyAt(index), this->ValueAt(index));
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::SetItem(int index, const KeyType &key,
+                                             const ValueType &value)
+{
+  this->SetKeyAt(index, key);
+  this->SetValueAt(index, value);
 }
 
 /*****************************************************************************
@@ -132,9 +178,8 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::PopulateNewRoot(
     const ValueType &old_value, const KeyType &new_key,
     const ValueType &new_value) 
 {
-    this->array[0].second = old_value;
-    this->array[1].first  = new_key;
-    this->array[1].second = new_value;
+    this->SetValueAt(0, old_value);
+    this->SetItem(1, new_key, new_value);
 	this->IncreaseSize(2);
 }
   
@@ -154,13 +199,9 @@ int B_PLUS_TREE_INTERNAL_PAGE_TYPE::InsertNodeAfter(
   if(idx == INVALID_INDEX) 
       return this->GetSize();
 
-  for(int i=this->GetSize()-1; i>=idx; i--)
-	{
-    this->array[i+1] = this->array[i];
-	}  
+  this->MoveItems(idx+2, idx+1, this->GetSize()-idx-1, sizeof(ValueType));
 
-  this->array[idx+1].first = new_key;
-  this->array[idx+1].second = new_value;
+  this->SetItem(idx+1, new_key, new_value);
   this->IncreaseSize(1);
   return this->GetSize();
 }
@@ -175,13 +216,15 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::UpdateChildParentPageId(
 		page_id_t child_pg_id, BufferPoolManager *bpm,
 														 page_id_t parent_pg_id)
 {
-		BPlusTreePage *child_pg = (BPlusTreePage *)bpm->FetchPage(child_pg_id);
+		BPlusTreePage *child_pg = 
+						(BPlusTreePage *)bpm->FetchPage(child_pg_id)->GetData();
 		child_pg->SetParentPageId(parent_pg_id);		
 		bpm->UnpinPage(child_pg_id, true);
 }
 
 /*
- * Remove half of key & value pairs from this page to "recipient" page
+ * Remove half of key & value pairs from this page to "recipient" page, which
+ * starts out with this page's key prefix
  */
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveHalfTo(
@@ -190,9 +233,11 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveHalfTo(
 {
     int move_size = this->GetSize()>>1;
 
+		recipient->SetKeyPrefix(this->KeyAt(this->GetSize()-1),
+		                        this->GetPrefixSize());
 		recipient->IncreaseSize(move_size);
 
-    recipient->CopyHalfFrom(this->array, this->GetSize() - move_size, 
+    recipient->CopyHalfFrom(this, this->GetSize() - move_size, 
 																									buffer_pool_manager);
 
 		this->DecreaseSize(move_size);
@@ -202,16 +247,17 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveHalfTo(
 
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::CopyHalfFrom(
-    MappingType *items, int size, BufferPoolManager *buffer_pool_manager) 
+    BPlusTreeInternalPage *donor, int size,
+    BufferPoolManager *buffer_pool_manager) 
 {
     int start_idx = size;
  
     for(int i=0;i<this->GetSize();i++) 
     {
 				//BPlusTreePage *child_pg;
-        this->array[i] = items[start_idx];
+        this->SetItem(i, donor->KeyAt(start_idx), donor->ValueAt(start_idx));
 
-				this->UpdateChildParentPageId(this->array[i].second, 
+				this->UpdateChildParentPageId(this->ValueAt(i), 
 																								buffer_pool_manager, 
 																								this->GetPageId());
 							
@@ -237,14 +283,23 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::CopyHalfFrom(
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::Remove(int index) 
 {
-    for(int i=index;i<this->GetSize()-1;i++)
-		{
-        this->array[i].first  = this->array[i+1].first;
-        this->array[i].second = this->array[i+1].second;
-		}
+    this->MoveItems(index, index+1, this->GetSize()-index-1,
+                    sizeof(ValueType));
     this->DecreaseSize(1);
 }
 
+/*
+ * Add a child after the last one and point its parent page id here; the
+ * caller makes sure the page has room and the key is the largest
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::Append(
+    const KeyType &key, const ValueType &value,
+    BufferPoolManager *buffer_pool_manager)
+{
+    this->CopyLastFrom(std::make_pair(key, value), buffer_pool_manager);
+}
+
 /*
  * Remove the only key & value pair in internal page and return the value
  * NOTE: only call this method within AdjustRoot()(in b_plus_tree.cpp)
@@ -269,24 +324,25 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveAllTo(
 {
     BPlusTreeInternalPage *parent = 
         (BPlusTreeInternalPage *)buffer_pool_manager->FetchPage
-                                                    (this->GetParentPageId());
+                                        (this->GetParentPageId())->GetData();
 
-    this->array[0].first = parent->array[index_in_parent].first;
-    recipient->CopyAllFrom(this->array, this->GetSize(), buffer_pool_manager);
+    this->SetKeyAt(0, parent->KeyAt(index_in_parent));
+    recipient->CopyAllFrom(this, this->GetSize(), buffer_pool_manager);
 
     buffer_pool_manager->UnpinPage(this->GetParentPageId(), true);
 }
 
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::CopyAllFrom(
-    MappingType *items, int size, BufferPoolManager *buffer_pool_manager) 
+    BPlusTreeInternalPage *donor, int size,
+    BufferPoolManager *buffer_pool_manager) 
 {
     int start_idx = this->GetSize(); 
     
     for(int i=0;i<size;i++) 
     {
-      this->array[start_idx] = items[i];     
-			this->UpdateChildParentPageId(this->array[start_idx].second, 
+      this->SetItem(start_idx, donor->KeyAt(i), donor->ValueAt(i));     
+			this->UpdateChildParentPageId(this->ValueAt(start_idx), 
 																								buffer_pool_manager, 
 																								this->GetPageId());
     	start_idx++;
@@ -311,20 +367,20 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveFirstToEndOf(
     
     B_PLUS_TREE_INTERNAL_PG_PGID *parent = 
         (B_PLUS_TREE_INTERNAL_PG_PGID *)buffer_pool_manager->FetchPage
-                                               (this->GetParentPageId());
+                                        (this->GetParentPageId())->GetData();
 
     int index_in_parent = parent->ValueIndex(this->GetPageId());
     
-    this->array[0].first = parent->array[index_in_parent].first;
+    this->SetKeyAt(0, parent->KeyAt(index_in_parent));
 
     for(int i=0;i<move_size;i++)
-        recipient->CopyLastFrom(this->array[i], buffer_pool_manager);
+        recipient->CopyLastFrom(this->GetItem(i), buffer_pool_manager);
   
-    for(int i=0;i<move_size;i++)
-        this->array[i] = this->array[i+move_size];
+    this->MoveItems(0, move_size, this->GetSize()-move_size,
+                    sizeof(ValueType));
     this->DecreaseSize(move_size);
 
-    parent->array[index_in_parent].first = this->array[0].first;
+    parent->SetKeyAt(index_in_parent, this->KeyAt(0));
     buffer_pool_manager->UnpinPage(parent->GetPageId(), true);
 
   /*this->array[0].first = this->array[1].first;
@@ -353,9 +409,9 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::CopyLastFrom(
 
     buffer_pool_manager->UnpinPage(this->GetParentPageId(), true);*/
 
-    this->array[this->GetSize()] = pair;
+    this->SetItem(this->GetSize(), pair.first, pair.second);
 		
-		this->UpdateChildParentPageId(this->array[this->GetSize()].second, 
+		this->UpdateChildParentPageId(pair.second, 
 																								buffer_pool_manager, 
 																								this->GetPageId());
     this->IncreaseSize(1);
@@ -374,19 +430,19 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveLastToFrontOf(
     
     B_PLUS_TREE_INTERNAL_PG_PGID *parent =
         (B_PLUS_TREE_INTERNAL_PG_PGID *)buffer_pool_manager->FetchPage
-                                               (this->GetParentPageId());
+                                        (this->GetParentPageId())->GetData();
 
     int index_in_parent = parent->ValueIndex(recipient->GetPageId());
 
-    recipient->array[0].first = parent->array[index_in_parent].first;
-    for(int i=recipient->GetSize()-1;i>=0; i--)
-        recipient->array[i+move_size] = recipient->array[i]; 
+    recipient->SetKeyAt(0, parent->KeyAt(index_in_parent));
+    recipient->MoveItems(move_size, 0, recipient->GetSize(),
+                         sizeof(ValueType));
     
     for(int i=this->GetSize()-move_size,j=0; i<this->GetSize(); i++,j++)
-        recipient->CopyFirstFrom(this->array[i], j, buffer_pool_manager);
+        recipient->CopyFirstFrom(this->GetItem(i), j, buffer_pool_manager);
     this->DecreaseSize(move_size);
 
-    parent->array[index_in_parent].first = recipient->array[0].first;
+    parent->SetKeyAt(index_in_parent, recipient->KeyAt(0));
 
     buffer_pool_manager->UnpinPage(parent->GetPageId(), true);
 
@@ -406,9 +462,9 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::CopyFirstFrom(
     const MappingType &pair, int insert_index,
     BufferPoolManager *buffer_pool_manager) 
 {
-    this->array[insert_index] = pair;
+    this->SetItem(insert_index, pair.first, pair.second);
 
-		this->UpdateChildParentPageId(this->array[insert_index].second, 
+		this->UpdateChildParentPageId(pair.second, 
 																								buffer_pool_manager, 
 																								this->GetPageId());
 		this->IncreaseSize(1);
@@ -431,7 +487,7 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::QueueUpChildren(
     BufferPoolManager *buffer_pool_manager) {
   for (int i = 0; i < GetSize(); i++) 
   {
-    auto *page = buffer_pool_manager->FetchPage(array[i].second);
+    auto *page = buffer_pool_manager->FetchPage(ValueAt(i));
     if (page == nullptr)
       throw Exception(EXCEPTION_TYPE_INDEX,
                       "all page are pinned while printing");
@@ -461,9 +517,9 @@ std::string B_PLUS_TREE_INTERNAL_PAGE_TYPE::ToString(bool verbose) const {
     } else {
       os << " ";
     }
-    os << std::dec << array[entry].first.ToString();
+    os << std::dec << KeyAt(entry).ToString();
     if (verbose) {
-      os << "(" << array[entry].second << ")";
+      os << "(" << ValueAt(entry) << ")";
     }
     ++entry;
   }
@@ -2,6 +2,7 @@
  * b_plus_tree_leaf_page.cpp
  */
 
+#include <algorithm>
 #include <sstream>
 
 #include "common/exception.h"
@@ -20,17 +21,17 @@ namespace cmudb {
  * next page id and set max size
  */
 INDEX_TEMPLATE_ARGUMENTS
-void B_PLUS_TREE_LEAF_PAGE_TYPE::Init(page_id_t page_id, page_id_t parent_id) 
+void B_PLUS_TREE_LEAF_PAGE_TYPE::Init(page_id_t page_id, page_id_t parent_id,
+                                      size_t page_size, int key_size)
 {
-  int max_size = 0;
   this->SetPageType(IndexPageType::LEAF_PAGE);
   this->SetSize(0);
   this->SetPageId(page_id);
   this->SetParentPageId(parent_id);
 	this->SetNextPageId(INVALID_PAGE_ID);
 
-  max_size = (PAGE_SIZE-this->GetHeaderSize())/sizeof(MappingType);
-  this->SetMaxSize(max_size); 
+  this->InitKeyLayout(page_size, std::min<int>(key_size, sizeof(KeyType)),
+                      sizeof(ValueType));
 }
 
 /**
@@ -48,8 +49,25 @@ void B_PLUS_TREE_LEAF_PAGE_TYPE::SetNextPageId(page_id_t next_page_id)
   this->next_page_id_ = next_page_id;
 }
 
+/*
+ * Helper methods for the key prefix, only changed once the pairs fit
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::SetKeyPrefix(const KeyType &key,
+                                              int prefix_size)
+{
+  this->SetPrefixSize(reinterpret_cast<const char *>(&key), prefix_size,
+                      sizeof(ValueType));
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+int B_PLUS_TREE_LEAF_PAGE_TYPE::GetMaxSizeFor(int prefix_size) const
+{
+  return this->MaxSizeFor(prefix_size, sizeof(ValueType));
+}
+
 /**
- * Helper method to find the first index i so that array[i].first >= key
+ * Helper method to find the first index i so that KeyAt(i) >= key
  * NOTE: This method is only used when generating index iterator
  */
 INDEX_TEMPLATE_ARGUMENTS
@@ -63,7 +81,7 @@ int B_PLUS_TREE_LEAF_PAGE_TYPE::KeyIndex(
 
   while(sidx < eidx) {
     mid = (sidx+eidx)/2;
-    cmp_result = comparator(this->array[mid].first, key);
+    cmp_result = comparator(this->KeyAt(mid), key);
     if(cmp_result == 0)
       return mid;
     else if(cmp_result < 0)
@@ -73,7 +91,7 @@ int B_PLUS_TREE_LEAF_PAGE_TYPE::KeyIndex(
   }
 
   if(sidx == eidx &&
-      (comparator(this->array[sidx].first,key)>=0))
+      (comparator(this->KeyAt(sidx),key)>=0))
     return sidx;
     
   return INVALID_INDEX;
@@ -86,7 +104,15 @@ int B_PLUS_TREE_LEAF_PAGE_TYPE::KeyIndex(
 INDEX_TEMPLATE_ARGUMENTS
 KeyType B_PLUS_TREE_LEAF_PAGE_TYPE::KeyAt(int index) const 
 {
-  return array[index].first;
+  return this->template ReadKey<KeyType>(
+      this->ItemData(index, sizeof(ValueType)));
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+ValueType B_PLUS_TREE_LEAF_PAGE_TYPE::ValueAt(int index) const 
+{
+  return this->template ReadValue<ValueType>(
+      this->ItemData(index, sizeof(ValueType)));
 }
 
 /*
@@ -94,9 +120,18 @@ KeyType B_PLUS_TREE_LEAF_PAGE_TYPE::KeyAt(int index) const
  * "index"(a.k.a array offset)
  */
 INDEX_TEMPLATE_ARGUMENTS
-const MappingType &B_PLUS_TREE_LEAF_PAGE_TYPE::GetItem(int index) 
+MappingType B_PLUS_TREE_LEAF_PAGE_TYPE::GetItem(int index) const
 {
-  return array[index];
+  return std::make_pair(this->KeyAt(index), this->ValueAt(index));
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::SetItem(int index, const KeyType &key,
+                                         const ValueType &value)
+{
+  char *item = this->ItemData(index, sizeof(ValueType));
+  this->WriteKey(item, key);
+  this->WriteValue(item, value);
 }
 
 /*****************************************************************************
@@ -116,15 +151,10 @@ int B_PLUS_TREE_LEAF_PAGE_TYPE::Insert(const KeyType &key,
       key_index = this->GetSize();
     
     /*Assuming that there is enough space in the leaf page*/
-    int idx = this->GetSize()-1;
-    while(idx >= key_index) 
-    {
-        this->array[idx+1] = this->array[idx];
-        idx--; 
-    }
+    this->MoveItems(key_index+1, key_index, this->GetSize()-key_index,
+                    sizeof(ValueType));
 
-    this->array[key_index].first = key;
-    this->array[key_index].second = value;
+    this->SetItem(key_index, key, value);
     this->IncreaseSize(1);
 
     return this->GetSize();
@@ -135,7 +165,8 @@ int B_PLUS_TREE_LEAF_PAGE_TYPE::Insert(const KeyType &key,
  *****************************************************************************/
 
 /*
- *  Remove half of key & value pairs from this page to "recipient" page
+ *  Remove half of key & value pairs from this page to "recipient" page, which
+ *  starts out with this page's key prefix
  */
 
 INDEX_TEMPLATE_ARGUMENTS
@@ -145,21 +176,24 @@ void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveHalfTo(
 {
     int move_size = this->GetSize()>>1;
 
+		recipient->SetKeyPrefix(this->KeyAt(this->GetSize()-1),
+		                        this->GetPrefixSize());
 		recipient->IncreaseSize(move_size);
 
-    recipient->CopyHalfFrom(this->array, this->GetSize()-move_size);
+    recipient->CopyHalfFrom(this, this->GetSize()-move_size);
     
     this->DecreaseSize(move_size);
 }
 
 INDEX_TEMPLATE_ARGUMENTS
-void B_PLUS_TREE_LEAF_PAGE_TYPE::CopyHalfFrom(MappingType *items, int size) 
+void B_PLUS_TREE_LEAF_PAGE_TYPE::CopyHalfFrom(BPlusTreeLeafPage *donor,
+                                              int size) 
 {
    int start_idx = size;
 
    for(int i=0; i<this->GetSize(); i++)
    {
-      this->array[i] = items[start_idx];
+      this->SetItem(i, donor->KeyAt(start_idx), donor->ValueAt(start_idx));
 	  start_idx++;
    }
 }
@@ -186,11 +220,11 @@ bool B_PLUS_TREE_LEAF_PAGE_TYPE::Lookup(const KeyType &key, ValueType &value,
       mid = (sidx+eidx)>>1;
 
   
-      cmp_result = comparator(this->array[mid].first, key);
+      cmp_result = comparator(this->KeyAt(mid), key);
 
       if(cmp_result == 0) //Key Match Case 
       {
-        value = this->array[mid].second;
+        value = this->ValueAt(mid);
         return true;
       }
       else if(cmp_result < 0)
@@ -218,11 +252,11 @@ int B_PLUS_TREE_LEAF_PAGE_TYPE::RemoveAndDeleteRecord(
     int key_index = this->KeyIndex(key, comparator);
  
     //Key not found. Return immediately.
-    if(comparator(this->array[key_index].first, key) == 0)
+    if(key_index != INVALID_INDEX &&
+       comparator(this->KeyAt(key_index), key) == 0)
     {
-        for(int i=key_index;i<this->GetSize()-1;i++){
-           this->array[i] = this->array[i+1];
-				}
+        this->MoveItems(key_index, key_index+1,
+                        this->GetSize()-key_index-1, sizeof(ValueType));
         this->DecreaseSize(1);
     }
 
@@ -240,19 +274,20 @@ INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveAllTo(BPlusTreeLeafPage *recipient,
                                            int, BufferPoolManager *) 
 {
-    recipient->CopyAllFrom(this->array, this->GetSize());
+    recipient->CopyAllFrom(this, this->GetSize());
     recipient->SetNextPageId(this->next_page_id_);
     this->SetSize(0);
 }
 
 
 INDEX_TEMPLATE_ARGUMENTS
-void B_PLUS_TREE_LEAF_PAGE_TYPE::CopyAllFrom(MappingType *items, int size)
+void B_PLUS_TREE_LEAF_PAGE_TYPE::CopyAllFrom(BPlusTreeLeafPage *donor,
+                                             int size)
 {
     int start_idx = this->GetSize();
 
     for(int i=0;i<size;i++) 
-        this->array[start_idx++] = items[i]; 
+        this->SetItem(start_idx++, donor->KeyAt(i), donor->ValueAt(i)); 
 
     this->IncreaseSize(size);
 }
@@ -272,22 +307,20 @@ void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveFirstToEndOf(BPlusTreeLeafPage *recipient,
 
     B_PLUS_TREE_INTERNAL_PG_PGID *parent = 
         (B_PLUS_TREE_INTERNAL_PG_PGID *)buffer_pool_manager->FetchPage
-                                                   (this->GetParentPageId());
+                                        (this->GetParentPageId())->GetData();
 
     int index_in_parent = parent->ValueIndex(this->GetPageId());
 
     for(int i=0;i<move_size;i++)
 		{
-        recipient->CopyLastFrom(this->array[i]);
+        recipient->CopyLastFrom(this->GetItem(i));
 		}
 
-    for(int i=0;i<this->GetSize()-move_size;i++)
-		{
-        this->array[i] = this->array[i+move_size];
-		}
+    this->MoveItems(0, move_size, this->GetSize()-move_size,
+                    sizeof(ValueType));
 	  this->DecreaseSize(move_size);
 
-    parent->SetKeyAt(index_in_parent, this->array[0].first);
+    parent->SetKeyAt(index_in_parent, this->KeyAt(0));
 
     buffer_pool_manager->UnpinPage(parent->GetPageId(), true);
 }
@@ -295,8 +328,7 @@ void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveFirstToEndOf(BPlusTreeLeafPage *recipient,
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_LEAF_PAGE_TYPE::CopyLastFrom(const MappingType &item) 
 {
-    this->array[this->GetSize()].first = item.first;
-    this->array[this->GetSize()].second = item.second;
+    this->SetItem(this->GetSize(), item.first, item.second);
     this->IncreaseSize(1);
 }
 
@@ -314,19 +346,19 @@ void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveLastToFrontOf(
     
     B_PLUS_TREE_INTERNAL_PG_PGID *parent = 
         (B_PLUS_TREE_INTERNAL_PG_PGID *)buffer_pool_manager->FetchPage
-                                                  (this->GetParentPageId());
+                                        (this->GetParentPageId())->GetData();
     int index_in_parent = parent->ValueIndex(recipient->GetPageId());
 
-    for(int i = recipient->GetSize()-1; i >= 0; i--)
-        recipient->array[i+move_size] = recipient->array[i];
+    recipient->MoveItems(move_size, 0, recipient->GetSize(),
+                         sizeof(ValueType));
     recipient->IncreaseSize(move_size);
 
     for(int i=this->GetSize()-move_size, j=0; i<this->GetSize(); i++,j++)
-        recipient->CopyFirstFrom(this->array[i], j, buffer_pool_manager);
+        recipient->CopyFirstFrom(this->GetItem(i), j, buffer_pool_manager);
     this->DecreaseSize(move_size);
 
 
-    parent->SetKeyAt(index_in_parent, recipient->array[0].first);
+    parent->SetKeyAt(index_in_parent, recipient->KeyAt(0));
 
     //parent->array[index_in_parent].first = recipient->array[0].first;
 
@@ -342,7 +374,7 @@ void B_PLUS_TREE_LEAF_PAGE_TYPE::CopyFirstFrom(
     const MappingType &item, int insert_index,
     BufferPoolManager *buffer_pool_manager) 
 {
-    this->array[insert_index] = item;
+    this->SetItem(insert_index, item.first, item.second);
     /*BPlusTreeInternalPage *parent = 
         buffer_pool_manager->FetchPage(this->GetParentPageId());
     
@@ -74,14 +74,15 @@ void BPlusTreePage::SetMaxSize(int size)
 
 /*
  * Helper method to get min page size
- * Generally, min page size == max page size / 2
+ * Generally, min page size == max page size / 2, taken without a key prefix
+ * so that any two pages of the same level can refill each other
  */
 int BPlusTreePage::GetMinSize() const 
 {
   if(this->IsRootPage()) 
        return 2;
 
-  return max_size_/2; 
+  return min_size_; 
 }
 
 /*
@@ -113,9 +114,107 @@ void BPlusTreePage::SetPageId(page_id_t page_id)
 int BPlusTreePage::GetHeaderSize() const
 {
   if(this->page_type_ == IndexPageType::LEAF_PAGE) 
-      return 24; //24 bytes - Check out header format
+      return 32; //32 bytes - Check out header format
   else 
-      return 20; //20 bytes
+      return 28; //28 bytes
+}
+
+/*
+ * Helper methods for the compressed keys, see the header format
+ */
+int BPlusTreePage::GetKeySize() const
+{
+  return this->key_size_;
+}
+
+int BPlusTreePage::GetPrefixSize() const
+{
+  return this->prefix_size_;
+}
+
+void BPlusTreePage::InitKeyLayout(size_t page_size, int key_size,
+                                  int value_size)
+{
+  this->data_size_ = page_size - PAGE_CHECKSUM_SIZE - this->GetHeaderSize();
+  this->key_size_ = key_size;
+  this->prefix_size_ = 0;
+  this->max_size_ = this->MaxSizeFor(0, value_size);
+  this->min_size_ = this->max_size_/2;
+}
+
+int BPlusTreePage::MaxSizeFor(int prefix_size, int value_size) const
+{
+  return (this->data_size_ - prefix_size) /
+         (this->key_size_ - prefix_size + value_size);
+}
+
+/*
+ * The caller makes sure the pairs still fit with the new prefix. Items move
+ * towards the front of the page when they get shorter and towards its end
+ * when they get longer, so each pass goes the way that does not overwrite
+ * an item not moved yet.
+ */
+void BPlusTreePage::SetPrefixSize(const char *key, int prefix_size,
+                                  int value_size)
+{
+  int old_prefix_size = this->prefix_size_;
+  int old_item_size = this->key_size_ - old_prefix_size + value_size;
+  int item_size = this->key_size_ - prefix_size + value_size;
+  char *old_items = this->GetPrefix() + old_prefix_size;
+  char *items = this->GetPrefix() + prefix_size;
+
+  if(prefix_size > old_prefix_size)
+  {
+      int drop_size = prefix_size - old_prefix_size;
+      for(int i=0; i<this->size_; i++)
+          memmove(items + i*item_size, old_items + i*old_item_size + drop_size,
+                  item_size);
+      memcpy(old_items, key + old_prefix_size, drop_size);
+  }
+  else if(prefix_size < old_prefix_size)
+  {
+      int add_size = old_prefix_size - prefix_size;
+      std::string added(items, add_size);
+      for(int i=this->size_-1; i>=0; i--)
+      {
+          memmove(items + i*item_size + add_size, old_items + i*old_item_size,
+                  old_item_size);
+          memcpy(items + i*item_size, added.data(), add_size);
+      }
+  }
+
+  this->prefix_size_ = prefix_size;
+  this->max_size_ = this->MaxSizeFor(prefix_size, value_size);
+}
+
+const char *BPlusTreePage::GetPrefix() const
+{
+  return reinterpret_cast<const char *>(this) + this->GetHeaderSize();
+}
+
+char *BPlusTreePage::GetPrefix()
+{
+  return reinterpret_cast<char *>(this) + this->GetHeaderSize();
+}
+
+const char *BPlusTreePage::ItemData(int index, int value_size) const
+{
+  return this->GetPrefix() + this->prefix_size_ +
+         index*(this->key_size_ - this->prefix_size_ + value_size);
+}
+
+char *BPlusTreePage::ItemData(int index, int value_size)
+{
+  return this->GetPrefix() + this->prefix_size_ +
+         index*(this->key_size_ - this->prefix_size_ + value_size);
+}
+
+void BPlusTreePage::MoveItems(int to, int from, int count, int value_size)
+{
+  if(count <= 0)
+      return;
+  memmove(this->ItemData(to, value_size), this->ItemData(from, value_size),
+          count*(this->key_size_ - this->prefix_size_ + value_size));
 }
 
 } // namespace cmudb
@@ -14,27 +14,33 @@ TableHeap::TableHeap(BufferPoolManager *buffer_pool_manager,
                      LockManager *lock_manager, LogManager *log_manager,
                      page_id_t first_page_id)
     : buffer_pool_manager_(buffer_pool_manager), lock_manager_(lock_manager),
-      log_manager_(log_manager), first_page_id_(first_page_id) {}
+      log_manager_(log_manager), first_page_id_(first_page_id),
+      segment_id_(buffer_pool_manager->CreateSegment()) {}
 
 // create table
 TableHeap::TableHeap(BufferPoolManager *buffer_pool_manager,
                      LockManager *lock_manager, LogManager *log_manager,
                      Transaction *txn)
     : buffer_pool_manager_(buffer_pool_manager), lock_manager_(lock_manager),
-      log_manager_(log_manager) {
-  auto first_page =
-      static_cast<TablePage *>(buffer_pool_manager_->NewPage(first_page_id_));
+      log_manager_(log_manager),
+      segment_id_(buffer_pool_manager->CreateSegment()) {
+  auto first_page = static_cast<TablePage *>(
+      buffer_pool_manager_->NewPage(first_page_id_, segment_id_));
   assert(first_page != nullptr); // todo: abort table creation?
   first_page->WLatch();
   LOG_DEBUG("new table page created %d", first_page_id_);
 
-  first_page->Init(first_page_id_, PAGE_SIZE, INVALID_LSN, log_manager_, txn);
+  first_page->Init(first_page_id_,
+                   buffer_pool_manager_->GetPageSize() - PAGE_CHECKSUM_SIZE,
+                   INVALID_LSN, log_manager_, txn);
   first_page->WUnlatch();
   buffer_pool_manager_->UnpinPage(first_page_id_, true);
 }
 
 bool TableHeap::InsertTuple(const Tuple &tuple, RID &rid, Transaction *txn) {
-  if (tuple.size_ + 32 > PAGE_SIZE) { // larger than one page size
+  size_t page_data_size =
+      buffer_pool_manager_->GetPageSize() - PAGE_CHECKSUM_SIZE;
+  if (tuple.size_ + 32 > static_cast<int>(page_data_size)) { // larger than one page size
     txn->SetState(TransactionState::ABORTED);
     return false;
   }
@@ -58,8 +64,8 @@ bool TableHeap::InsertTuple(const Tuple &tuple, RID &rid, Transaction *txn) {
           buffer_pool_manager_->FetchPage(next_page_id));
       cur_page->WLatch();
     } else { // create new page
-      auto new_page =
-          static_cast<TablePage *>(buffer_pool_manager_->NewPage(next_page_id));
+      auto new_page = static_cast<TablePage *>(
+          buffer_pool_manager_->NewPage(next_page_id, segment_id_));
       if (new_page == nullptr) {
         cur_page->WUnlatch();
         buffer_pool_manager_->UnpinPage(cur_page->GetPageId(), false);
@@ -70,8 +76,9 @@ bool TableHeap::InsertTuple(const Tuple &tuple, RID &rid, Transaction *txn) {
       // std::cout << "new table page " << next_page_id << " created" <<
       // std::endl;
       cur_page->SetNextPageId(next_page_id);
-      new_page->Init(next_page_id, PAGE_SIZE, cur_page->GetPageId(),
-                     log_manager_, txn);
+      new_page->Init(next_page_id,
+                     buffer_pool_manager_->GetPageSize() - PAGE_CHECKSUM_SIZE,
+                     cur_page->GetPageId(), log_manager_, txn);
       cur_page->WUnlatch();
       buffer_pool_manager_->UnpinPage(cur_page->GetPageId(), true);
       cur_page = new_page;
@@ -85,73 +92,62 @@ bool TableHeap::InsertTuple(const Tuple &tuple, RID &rid, Transaction *txn) {
 
 bool TableHeap::MarkDelete(const RID &rid, Transaction *txn) {
   // todo: remove empty page
-  auto page = reinterpret_cast<TablePage *>(
-      buffer_pool_manager_->FetchPage(rid.GetPageId()));
-  if (page == nullptr) {
+  WritePageGuard page_guard =
+      buffer_pool_manager_->FetchPageWrite(rid.GetPageId());
+  if (!page_guard.IsValid()) {
     txn->SetState(TransactionState::ABORTED);
     return false;
   }
-  page->WLatch();
-  page->MarkDelete(rid, txn, lock_manager_, log_manager_);
-  page->WUnlatch();
-  buffer_pool_manager_->UnpinPage(page->GetPageId(), true);
+  page_guard.AsMut<TablePage>()->MarkDelete(rid, txn, lock_manager_,
+                                            log_manager_);
+  page_guard.Drop();
   txn->GetWriteSet()->emplace_back(rid, WType::DELETE, Tuple{}, this);
   return true;
 }
 
 bool TableHeap::UpdateTuple(const Tuple &tuple, const RID &rid,
                             Transaction *txn) {
-  auto page = reinterpret_cast<TablePage *>(
-      buffer_pool_manager_->FetchPage(rid.GetPageId()));
-  if (page == nullptr) {
+  WritePageGuard page_guard =
+      buffer_pool_manager_->FetchPageWrite(rid.GetPageId());
+  if (!page_guard.IsValid()) {
     txn->SetState(TransactionState::ABORTED);
     return false;
   }
   Tuple old_tuple;
-  page->WLatch();
-  bool is_updated = page->UpdateTuple(tuple, old_tuple, rid, txn, lock_manager_,
-                                      log_manager_);
-  page->WUnlatch();
-  buffer_pool_manager_->UnpinPage(page->GetPageId(), is_updated);
+  bool is_updated = page_guard.As<TablePage>()->UpdateTuple(
+      tuple, old_tuple, rid, txn, lock_manager_, log_manager_);
+  if (is_updated)
+    page_guard.SetDirty();
+  page_guard.Drop();
   if (is_updated && txn->GetState() != TransactionState::ABORTED)
     txn->GetWriteSet()->emplace_back(rid, WType::UPDATE, old_tuple, this);
   return is_updated;
 }
 
 void TableHeap::ApplyDelete(const RID &rid, Transaction *txn) {
-  auto page = reinterpret_cast<TablePage *>(
-      buffer_pool_manager_->FetchPage(rid.GetPageId()));
-  assert(page != nullptr);
-  page->WLatch();
-  page->ApplyDelete(rid, txn, log_manager_);
+  WritePageGuard page_guard =
+      buffer_pool_manager_->FetchPageWrite(rid.GetPageId());
+  assert(page_guard.IsValid());
+  page_guard.AsMut<TablePage>()->ApplyDelete(rid, txn, log_manager_);
   lock_manager_->Unlock(txn, rid);
-  page->WUnlatch();
-  buffer_pool_manager_->UnpinPage(page->GetPageId(), true);
 }
 
 void TableHeap::RollbackDelete(const RID &rid, Transaction *txn) {
-  auto page = reinterpret_cast<TablePage *>(
-      buffer_pool_manager_->FetchPage(rid.GetPageId()));
-  assert(page != nullptr);
-  page->WLatch();
-  page->RollbackDelete(rid, txn, log_manager_);
-  page->WUnlatch();
-  buffer_pool_manager_->UnpinPage(page->GetPageId(), true);
+  WritePageGuard page_guard =
+      buffer_pool_manager_->FetchPageWrite(rid.GetPageId());
+  assert(page_guard.IsValid());
+  page_guard.AsMut<TablePage>()->RollbackDelete(rid, txn, log_manager_);
 }
 
 // called by tuple iterator
 bool TableHeap::GetTuple(const RID &rid, Tuple &tuple, Transaction *txn) {
-  auto page = static_cast<TablePage *>(
-      buffer_pool_manager_->FetchPage(rid.GetPageId()));
-  if (page == nullptr) {
+  ReadPageGuard page_guard =
+      buffer_pool_manager_->FetchPageRead(rid.GetPageId());
+  if (!page_guard.IsValid()) {
     txn->SetState(TransactionState::ABORTED);
     return false;
   }
-  page->RLatch();
-  bool res = page->GetTuple(rid, tuple, txn, lock_manager_);
-  page->RUnlatch();
-  buffer_pool_manager_->UnpinPage(rid.GetPageId(), false);
-  return res;
+  return page_guard.As<TablePage>()->GetTuple(rid, tuple, txn, lock_manager_);
 }
 
 bool TableHeap::DeleteTableHeap() {
@@ -160,15 +156,14 @@ bool TableHeap::DeleteTableHeap() {
 }
 
 TableIterator TableHeap::begin(Transaction *txn) {
-  auto page =
-      static_cast<TablePage *>(buffer_pool_manager_->FetchPage(first_page_id_));
-  page->RLatch();
   RID rid;
-  // if failed (no tuple), rid will be the result of default
-  // constructor, which means eof
-  page->GetFirstTupleRid(rid);
-  page->RUnlatch();
-  buffer_pool_manager_->UnpinPage(first_page_id_, false);
+  {
+    ReadPageGuard page_guard =
+        buffer_pool_manager_->FetchPageRead(first_page_id_);
+    // if failed (no tuple), rid will be the result of default
+    // constructor, which means eof
+    page_guard.As<TablePage>()->GetFirstTupleRid(rid);
+  }
   return TableIterator(this, rid, txn);
 }
 
@@ -9,8 +9,10 @@
 namespace cmudb {
 
 TableIterator::TableIterator(TableHeap *table_heap, RID rid, Transaction *txn)
-    : table_heap_(table_heap), tuple_(new Tuple(rid)), txn_(txn) {
+    : table_heap_(table_heap), tuple_(new Tuple(rid)), txn_(txn),
+      read_ahead_(table_heap->buffer_pool_manager_) {
   if (rid.GetPageId() != INVALID_PAGE_ID) {
+    read_ahead_.Access(rid.GetPageId());
     table_heap_->GetTuple(tuple_->rid_, *tuple_, txn_);
   }
 };
@@ -27,21 +29,19 @@ Tuple *TableIterator::operator->() {
 
 TableIterator &TableIterator::operator++() {
   BufferPoolManager *buffer_pool_manager = table_heap_->buffer_pool_manager_;
-  auto cur_page = static_cast<TablePage *>(
-      buffer_pool_manager->FetchPage(tuple_->rid_.GetPageId()));
-  cur_page->RLatch();
-  assert(cur_page != nullptr); // all pages are pinned
+  ReadPageGuard cur_guard =
+      buffer_pool_manager->FetchPageRead(tuple_->rid_.GetPageId());
+  assert(cur_guard.IsValid()); // all pages are pinned
+  auto cur_page = cur_guard.As<TablePage>();
 
   RID next_tuple_rid;
   if (!cur_page->GetNextTupleRid(tuple_->rid_,
                                  next_tuple_rid)) { // end of this page
     while (cur_page->GetNextPageId() != INVALID_PAGE_ID) {
-      auto next_page = static_cast<TablePage *>(
-          buffer_pool_manager->FetchPage(cur_page->GetNextPageId()));
-      cur_page->RUnlatch();
-      buffer_pool_manager->UnpinPage(cur_page->GetPageId(), false);
-      cur_page = next_page;
-      cur_page->RLatch();
+      read_ahead_.Access(cur_page->GetNextPageId());
+      // latch the next page, then release this one
+      cur_guard = buffer_pool_manager->FetchPageRead(cur_page->GetNextPageId());
+      cur_page = cur_guard.As<TablePage>();
       if (cur_page->GetFirstTupleRid(next_tuple_rid))
         break;
     }
@@ -51,9 +51,7 @@ TableIterator &TableIterator::operator++() {
   if (*this != table_heap_->end()) {
     table_heap_->GetTuple(tuple_->rid_, *tuple_, txn_);
   }
-  // release until copy the tuple
-  cur_page->RUnlatch();
-  buffer_pool_manager->UnpinPage(cur_page->GetPageId(), false);
+  // cur_guard releases the page once the tuple is copied
   return *this;
 }
 
@@ -2,8 +2,10 @@
  * virtual_table.cpp
  */
 #include <algorithm>
+#include <cmath>
 #include <cstring>
 #include <iostream>
+#include <memory>
 #include <sys/stat.h>
 #include <vector>
 
@@ -25,12 +27,20 @@ int VtabCreate(sqlite3 *db, void *pAux, int argc, const char *const *argv,
   LockManager *lock_manager = storage_engine_->lock_manager_;
   LogManager *log_manager = storage_engine_->log_manager_;
 
-  // fetch header page from buffer pool
-  HeaderPage *header_page =
-      static_cast<HeaderPage *>(buffer_pool_manager->FetchPage(HEADER_PAGE_ID));
-
   // the first three parameter:(1) module name (2) database name (3)table name
   assert(argc >= 4);
+  // the table outlived the sqlite schema that declared it: connect to it,
+  // which builds an index it did not have over its tuples
+  {
+    ReadPageGuard header_guard =
+        buffer_pool_manager->FetchPageRead(HEADER_PAGE_ID);
+    page_id_t table_root_id;
+    if (header_guard.As<HeaderPage>()->GetRootId(std::string(argv[2]),
+                                                 table_root_id)) {
+      header_guard.Drop();
+      return VtabConnect(db, pAux, argc, argv, ppVtab, pzErr);
+    }
+  }
   // parse arg[3](string that defines table schema)
   std::string schema_string(argv[3]);
   schema_string = schema_string.substr(1, (schema_string.size() - 2));
@@ -51,8 +61,12 @@ int VtabCreate(sqlite3 *db, void *pAux, int argc, const char *const *argv,
                                          lock_manager, log_manager, index);
 
   // insert table root page info into header page
-  header_page->InsertRecord(std::string(argv[2]), table->GetFirstPageId());
-  buffer_pool_manager->UnpinPage(HEADER_PAGE_ID, true);
+  {
+    WritePageGuard header_guard =
+        buffer_pool_manager->FetchPageWrite(HEADER_PAGE_ID);
+    header_guard.AsMut<HeaderPage>()->InsertRecord(std::string(argv[2]),
+                                                   table->GetFirstPageId());
+  }
 
   // register virtual table within sqlite system
   schema_string = "CREATE TABLE X(" + schema_string + ");";
@@ -76,41 +90,56 @@ int VtabConnect(sqlite3 *db, void *pAux, int argc, const char *const *argv,
   LockManager *lock_manager = storage_engine_->lock_manager_;
   LogManager *log_manager = storage_engine_->log_manager_;
 
-  // Retrieve table root page info from header page
-  HeaderPage *header_page =
-      static_cast<HeaderPage *>(buffer_pool_manager->FetchPage(HEADER_PAGE_ID));
-  page_id_t table_root_id;
-  header_page->GetRootId(std::string(argv[2]), table_root_id);
   // parse arg[4](string that defines table index)
-  Index *index = nullptr;
+  IndexMetadata *index_metadata = nullptr;
   if (argc > 4) {
     std::string index_string(argv[4]);
     index_string = index_string.substr(1, (index_string.size() - 2));
-    // create index object, allocate memory space
-    IndexMetadata *index_metadata =
+    index_metadata =
         ParseIndexStatement(index_string, std::string(argv[2]), schema);
-    // Retrieve index root page info from header page
-    page_id_t index_root_id;
-    header_page->GetRootId(index_metadata->GetName(), index_root_id);
-    index = ConstructIndex(index_metadata, buffer_pool_manager, index_root_id);
   }
+
+  // Retrieve table and index root page info from header page
+  page_id_t table_root_id;
+  page_id_t index_root_id = INVALID_PAGE_ID;
+  bool index_exists = false;
+  {
+    ReadPageGuard header_guard =
+        buffer_pool_manager->FetchPageRead(HEADER_PAGE_ID);
+    HeaderPage *header_page = header_guard.As<HeaderPage>();
+    header_page->GetRootId(std::string(argv[2]), table_root_id);
+    if (index_metadata != nullptr)
+      index_exists =
+          header_page->GetRootId(index_metadata->GetName(), index_root_id);
+  }
+
+  // create index object, allocate memory space
+  Index *index = nullptr;
+  if (index_metadata != nullptr)
+    index = ConstructIndex(index_metadata, buffer_pool_manager, index_root_id);
   VirtualTable *table =
       new VirtualTable(schema, buffer_pool_manager, lock_manager, log_manager,
                        index, table_root_id);
+  // index declared over a table that already has tuples, build it bottom-up
+  if (index != nullptr && !index_exists) {
+    Transaction *txn = storage_engine_->transaction_manager_->Begin();
+    index->BulkLoad(table->GetTableHeap(), schema, txn);
+    storage_engine_->transaction_manager_->Commit(txn);
+  }
 
   // register virtual table within sqlite system
   schema_string = "CREATE TABLE X(" + schema_string + ");";
   assert(sqlite3_declare_vtab(db, schema_string.c_str()) == SQLITE_OK);
 
   *ppVtab = reinterpret_cast<sqlite3_vtab *>(table);
-  buffer_pool_manager->UnpinPage(HEADER_PAGE_ID, false);
   return SQLITE_OK;
 }
 
 /*
  * we only support
- * (1) equlity check. e.g select * from foo where a = 1
- * (2) indexed column == predicated column
+ * (1) equlity check on every indexed column. e.g select * from foo where a = 1
+ * (2) range check on a single column index, with <, <=, >, >= or BETWEEN.
+ *     e.g select * from foo where a > 1 and a <= 10
  */
 int VtabBestIndex(sqlite3_vtab *tab, sqlite3_index_info *pIdxInfo) {
   // LOG_DEBUG("VtabBestIndex");
@@ -120,31 +149,77 @@ int VtabBestIndex(sqlite3_vtab *tab, sqlite3_index_info *pIdxInfo) {
   const std::vector<int> key_attrs = table->GetIndex()->GetKeyAttrs();
   // make sure indexed column == predicate column
   // e.g select * from foo where a = 1 and b =2; indexed column must be {a,b}
-  if (pIdxInfo->nConstraint != (int)(key_attrs.size()))
-    return SQLITE_OK;
+  if (pIdxInfo->nConstraint == (int)(key_attrs.size())) {
+    int counter = 0;
+    bool is_index_scan = true;
+    for (int i = 0; i < pIdxInfo->nConstraint; i++) {
+      if (pIdxInfo->aConstraint[i].usable == 0)
+        continue;
+      int item = pIdxInfo->aConstraint[i].iColumn;
+      // if predicate column is part of indexed column
+      if (std::find(key_attrs.begin(), key_attrs.end(), item) !=
+          key_attrs.end()) {
+        // equlity check
+        if (pIdxInfo->aConstraint[i].op != SQLITE_INDEX_CONSTRAINT_EQ) {
+          is_index_scan = false;
+          break;
+        }
+        pIdxInfo->aConstraintUsage[i].argvIndex = (i + 1);
+        counter++;
+      }
+    }
 
-  int counter = 0;
-  bool is_index_scan = true;
+    if (counter == (int)key_attrs.size() && is_index_scan) {
+      pIdxInfo->idxNum = INDEX_SCAN_KEY;
+      pIdxInfo->estimatedCost = 1;
+      return SQLITE_OK;
+    }
+    for (int i = 0; i < pIdxInfo->nConstraint; i++)
+      pIdxInfo->aConstraintUsage[i].argvIndex = 0;
+  }
+
+  // range scan, BETWEEN reaches here as a >= and a <= constraint
+  if (key_attrs.size() != 1)
+    return SQLITE_OK;
+  int low = -1, high = -1;
+  int idx_num = INDEX_SCAN_RANGE;
   for (int i = 0; i < pIdxInfo->nConstraint; i++) {
-    if (pIdxInfo->aConstraint[i].usable == 0)
+    if (pIdxInfo->aConstraint[i].usable == 0 ||
+        pIdxInfo->aConstraint[i].iColumn != key_attrs[0])
       continue;
-    int item = pIdxInfo->aConstraint[i].iColumn;
-    // if predicate column is part of indexed column
-    if (std::find(key_attrs.begin(), key_attrs.end(), item) !=
-        key_attrs.end()) {
-      // equlity check
-      if (pIdxInfo->aConstraint[i].op != SQLITE_INDEX_CONSTRAINT_EQ) {
-        is_index_scan = false;
-        break;
+    switch (pIdxInfo->aConstraint[i].op) {
+    case SQLITE_INDEX_CONSTRAINT_GT:
+    case SQLITE_INDEX_CONSTRAINT_GE:
+      if (low == -1) {
+        low = i;
+        idx_num |= INDEX_SCAN_LOW;
+        if (pIdxInfo->aConstraint[i].op == SQLITE_INDEX_CONSTRAINT_GE)
+          idx_num |= INDEX_SCAN_LOW_INCLUSIVE;
       }
-      pIdxInfo->aConstraintUsage[i].argvIndex = (i + 1);
-      counter++;
+      break;
+    case SQLITE_INDEX_CONSTRAINT_LT:
+    case SQLITE_INDEX_CONSTRAINT_LE:
+      if (high == -1) {
+        high = i;
+        idx_num |= INDEX_SCAN_HIGH;
+        if (pIdxInfo->aConstraint[i].op == SQLITE_INDEX_CONSTRAINT_LE)
+          idx_num |= INDEX_SCAN_HIGH_INCLUSIVE;
+      }
+      break;
+    default:
+      break;
     }
   }
+  if (low == -1 && high == -1)
+    return SQLITE_OK;
 
-  if (counter == (int)key_attrs.size() && is_index_scan) {
-    pIdxInfo->idxNum = 1;
-  }
+  // low bound (if any) comes first in argv, then the high bound
+  if (low != -1)
+    pIdxInfo->aConstraintUsage[low].argvIndex = 1;
+  if (high != -1)
+    pIdxInfo->aConstraintUsage[high].argvIndex = (low != -1) ? 2 : 1;
+  pIdxInfo->idxNum = idx_num;
+  pIdxInfo->estimatedCost = (low != -1 && high != -1) ? 10 : 100;
   return SQLITE_OK;
 }
 
@@ -153,6 +228,8 @@ int VtabDisconnect(sqlite3_vtab *pVtab) {
   delete virtual_table;
   // delete all the global managers
   delete storage_engine_;
+  // the stats table outlives the tables, it must not reach a deleted engine
+  storage_engine_ = nullptr;
   return SQLITE_OK;
 }
 
@@ -178,6 +255,98 @@ int VtabClose(sqlite3_vtab_cursor *cur) {
   return SQLITE_OK;
 }
 
+/*
+ * Key of one bound of a range scan on the (single) key column. The bound
+ * is not just cast to the column type, it keeps the meaning SQLite gives
+ * the comparison: a fractional bound on an integer column is rounded to
+ * the next integer inside the range and made inclusive, a bound past the
+ * column's range is clamped, and a bound of another type is dropped (the
+ * scan is unbounded on that side). SQLite checks every row it gets against
+ * the constraint again, so a wider scan is still correct, a narrower one
+ * is not. nullptr for a dropped bound.
+ */
+static Tuple *ConstructBound(Schema *key_schema, sqlite3_value *value,
+                             bool is_low, bool &inclusive) {
+  TypeId type = key_schema->GetType(0);
+  Value v(TypeId::INVALID);
+  switch (type) {
+  case TypeId::BOOLEAN:
+  case TypeId::TINYINT:
+  case TypeId::SMALLINT:
+  case TypeId::INTEGER:
+  case TypeId::BIGINT: {
+    // the lowest value of each type stands for NULL
+    int64_t min = INT64_MIN + 1, max = INT64_MAX;
+    if (type == TypeId::INTEGER) {
+      min = INT32_MIN + 1;
+      max = INT32_MAX;
+    } else if (type == TypeId::SMALLINT) {
+      min = INT16_MIN + 1;
+      max = INT16_MAX;
+    } else if (type != TypeId::BIGINT) {
+      min = INT8_MIN + 1;
+      max = INT8_MAX;
+    }
+    // long double holds every int64_t exactly
+    long double bound;
+    int value_type = sqlite3_value_numeric_type(value);
+    if (value_type == SQLITE_INTEGER) {
+      bound = sqlite3_value_int64(value);
+    } else if (value_type == SQLITE_FLOAT) {
+      double d = sqlite3_value_double(value);
+      if (std::isnan(d))
+        return nullptr;
+      bound = is_low ? std::ceil(static_cast<long double>(d))
+                     : std::floor(static_cast<long double>(d));
+      if (bound != d)
+        inclusive = true;
+    } else {
+      return nullptr;
+    }
+    if (bound < min) {
+      if (is_low)
+        return nullptr;
+      bound = min;
+      inclusive = false;
+    } else if (bound > max) {
+      if (!is_low)
+        return nullptr;
+      bound = max;
+      inclusive = false;
+    }
+    int64_t key = static_cast<int64_t>(bound);
+    if (type == TypeId::BIGINT)
+      v = Value(type, key);
+    else
+      v = Value(type, static_cast<int32_t>(key));
+    break;
+  }
+  case TypeId::DECIMAL: {
+    int value_type = sqlite3_value_numeric_type(value);
+    if (value_type != SQLITE_INTEGER && value_type != SQLITE_FLOAT)
+      return nullptr;
+    double d = sqlite3_value_double(value);
+    if (std::isnan(d))
+      return nullptr;
+    // a large integer may round to a double on the wrong side of it
+    if (value_type == SQLITE_INTEGER &&
+        static_cast<long double>(d) != sqlite3_value_int64(value))
+      inclusive = true;
+    v = Value(type, d);
+    break;
+  }
+  case TypeId::VARCHAR:
+    if (sqlite3_value_type(value) != SQLITE_TEXT)
+      return nullptr;
+    v = Value(type, std::string(reinterpret_cast<const char *>(
+                        sqlite3_value_text(value))));
+    break;
+  default:
+    return nullptr;
+  }
+  return new Tuple(std::vector<Value>{v}, key_schema);
+}
+
 /*
 ** This method is called to "rewind" the cursor object back
 ** to the first row of output. This method is always called at least
@@ -190,12 +359,24 @@ int VtabFilter(sqlite3_vtab_cursor *pVtabCursor, int idxNum, const char *idxStr,
   Cursor *cursor = reinterpret_cast<Cursor *>(pVtabCursor);
   Schema *key_schema;
   // if indexed scan
-  if (idxNum == 1) {
+  if (idxNum == INDEX_SCAN_KEY) {
     cursor->SetScanFlag(true);
     // Construct the tuple for point query
     key_schema = cursor->GetKeySchema();
     Tuple scan_tuple = ConstructTuple(key_schema, argv);
     cursor->ScanKey(scan_tuple);
+  } else if (idxNum & INDEX_SCAN_RANGE) {
+    cursor->SetScanFlag(true);
+    // Construct the tuples for the bounds of the range query
+    key_schema = cursor->GetKeySchema();
+    std::unique_ptr<Tuple> low, high;
+    bool low_inclusive = idxNum & INDEX_SCAN_LOW_INCLUSIVE;
+    bool high_inclusive = idxNum & INDEX_SCAN_HIGH_INCLUSIVE;
+    if (idxNum & INDEX_SCAN_LOW)
+      low.reset(ConstructBound(key_schema, *argv++, true, low_inclusive));
+    if (idxNum & INDEX_SCAN_HIGH)
+      high.reset(ConstructBound(key_schema, *argv, false, high_inclusive));
+    cursor->ScanRange(low.get(), low_inclusive, high.get(), high_inclusive);
   }
   return SQLITE_OK;
 }
@@ -322,6 +503,146 @@ int VtabCommit(sqlite3_vtab *pVTab) {
   return SQLITE_OK;
 }
 
+/*
+** disk_stats: read only, eponymous table of the I/O the storage engine did,
+** one row per kind of operation, e.g.
+**   SELECT op, count, p99_ns FROM disk_stats;
+** It shares the storage engine with the vtable tables but does not own it.
+*/
+struct StatsCursor {
+  sqlite3_vtab_cursor base;
+  DiskStats stats;
+  int row;
+};
+
+static const char *stats_ops[] = {"page_read", "page_write", "log_write",
+                                  "sync"};
+static const int STATS_ROWS = 4;
+
+static int StatsConnect(sqlite3 *db, void *pAux, int argc,
+                        const char *const *argv, sqlite3_vtab **ppVtab,
+                        char **pzErr) {
+  int rc = sqlite3_declare_vtab(
+      db, "CREATE TABLE x(op TEXT, count INTEGER, bytes INTEGER, "
+          "total_ns INTEGER, p50_ns INTEGER, p99_ns INTEGER, max_ns INTEGER)");
+  if (rc != SQLITE_OK)
+    return rc;
+  sqlite3_vtab *vtab = new sqlite3_vtab();
+  *ppVtab = vtab;
+  return SQLITE_OK;
+}
+
+static int StatsBestIndex(sqlite3_vtab *tab, sqlite3_index_info *pIdxInfo) {
+  pIdxInfo->estimatedCost = STATS_ROWS;
+  return SQLITE_OK;
+}
+
+static int StatsDisconnect(sqlite3_vtab *pVtab) {
+  delete pVtab;
+  return SQLITE_OK;
+}
+
+static int StatsOpen(sqlite3_vtab *pVtab, sqlite3_vtab_cursor **ppCursor) {
+  StatsCursor *cursor = new StatsCursor();
+  *ppCursor = &cursor->base;
+  return SQLITE_OK;
+}
+
+static int StatsClose(sqlite3_vtab_cursor *cur) {
+  delete reinterpret_cast<StatsCursor *>(cur);
+  return SQLITE_OK;
+}
+
+// every scan reads a fresh snapshot of the counters
+static int StatsFilter(sqlite3_vtab_cursor *pVtabCursor, int idxNum,
+                       const char *idxStr, int argc, sqlite3_value **argv) {
+  StatsCursor *cursor = reinterpret_cast<StatsCursor *>(pVtabCursor);
+  if (storage_engine_ == nullptr) {
+    pVtabCursor->pVtab->zErrMsg =
+        sqlite3_mprintf("the storage engine has been shut down");
+    return SQLITE_ERROR;
+  }
+  cursor->stats = storage_engine_->disk_manager_->GetStats();
+  cursor->row = 0;
+  return SQLITE_OK;
+}
+
+static int StatsNext(sqlite3_vtab_cursor *cur) {
+  reinterpret_cast<StatsCursor *>(cur)->row++;
+  return SQLITE_OK;
+}
+
+static int StatsEof(sqlite3_vtab_cursor *cur) {
+  return reinterpret_cast<StatsCursor *>(cur)->row >= STATS_ROWS;
+}
+
+static int StatsColumn(sqlite3_vtab_cursor *cur, sqlite3_context *ctx,
+                       int i) {
+  StatsCursor *cursor = reinterpret_cast<StatsCursor *>(cur);
+  const DiskStats::Op *ops[STATS_ROWS] = {
+      &cursor->stats.page_reads, &cursor->stats.page_writes,
+      &cursor->stats.log_writes, &cursor->stats.syncs};
+  const DiskStats::Op &op = *ops[cursor->row];
+  switch (i) {
+  case 0:
+    sqlite3_result_text(ctx, stats_ops[cursor->row], -1, SQLITE_STATIC);
+    break;
+  case 1:
+    sqlite3_result_int64(ctx, (sqlite3_int64)op.count);
+    break;
+  case 2:
+    sqlite3_result_int64(ctx, (sqlite3_int64)op.bytes);
+    break;
+  case 3:
+    sqlite3_result_int64(ctx, (sqlite3_int64)op.total_ns);
+    break;
+  case 4:
+    sqlite3_result_int64(ctx, (sqlite3_int64)op.p50_ns);
+    break;
+  case 5:
+    sqlite3_result_int64(ctx, (sqlite3_int64)op.p99_ns);
+    break;
+  case 6:
+    sqlite3_result_int64(ctx, (sqlite3_int64)op.max_ns);
+    break;
+  default:
+    return SQLITE_ERROR;
+  }
+  return SQLITE_OK;
+}
+
+static int StatsRowid(sqlite3_vtab_cursor *cur, sqlite3_int64 *pRowid) {
+  *pRowid = reinterpret_cast<StatsCursor *>(cur)->row;
+  return SQLITE_OK;
+}
+
+// no xCreate: the table exists in every schema as is
+sqlite3_module DiskStatsModule = {
+    0,               /* iVersion */
+    0,               /* xCreate */
+    StatsConnect,    /* xConnect */
+    StatsBestIndex,  /* xBestIndex */
+    StatsDisconnect, /* xDisconnect */
+    StatsDisconnect, /* xDestroy */
+    StatsOpen,       /* xOpen - open a cursor */
+    StatsClose,      /* xClose - close a cursor */
+    StatsFilter,     /* xFilter - configure scan constraints */
+    StatsNext,       /* xNext - advance a cursor */
+    StatsEof,        /* xEof - check for end of scan */
+    StatsColumn,     /* xColumn - read data */
+    StatsRowid,      /* xRowid - read data */
+    0,               /* xUpdate */
+    0,               /* xBegin */
+    0,               /* xSync */
+    0,               /* xCommit */
+    0,               /* xRollback */
+    0,               /* xFindMethod */
+    0,               /* xRename */
+    0,               /* xSavepoint */
+    0,               /* xRelease */
+    0,               /* xRollbackTo */
+};
+
 sqlite3_module VtableModule = {
     0,              /* iVersion */
     VtabCreate,     /* xCreate */
@@ -372,6 +693,8 @@ __declspec(dllexport)
   }
 
   int rc = sqlite3_create_module(db, "vtable", &VtableModule, nullptr);
+  if (rc == SQLITE_OK)
+    rc = sqlite3_create_module(db, "disk_stats", &DiskStatsModule, nullptr);
   return rc;
 }
 
@@ -2,9 +2,15 @@
  * buffer_pool_manager_test.cpp
  */
 
+#include <chrono>
 #include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
 
 #include "buffer/buffer_pool_manager.h"
+#include "buffer/read_ahead.h"
+#include "common/exception.h"
 #include "gtest/gtest.h"
 
 namespace cmudb {
@@ -48,4 +54,414 @@ TEST(BufferPoolManagerTest, SampleTest) {
   remove("test.db");
 }
 
+// more pages than frames: fetches keep missing and evicting dirty pages while
+// other threads hit the same pages
+TEST(BufferPoolManagerTest, ConcurrentFetchTest) {
+  const int num_pages = 40;
+  const int num_threads = 8;
+  page_id_t temp_page_id;
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  {
+    BufferPoolManager bpm(10, disk_manager);
+    for (int i = 0; i < num_pages; ++i) {
+      Page *page = bpm.NewPage(temp_page_id);
+      ASSERT_NE(nullptr, page);
+      snprintf(page->GetData(), 16, "%d", temp_page_id);
+      EXPECT_EQ(true, bpm.UnpinPage(temp_page_id, true));
+    }
+
+    std::vector<std::thread> threads;
+    for (int tid = 0; tid < num_threads; tid++) {
+      threads.push_back(std::thread([&bpm, tid]() {
+        for (int i = 0; i < 200; i++) {
+          page_id_t page_id = (i * 7 + tid) % num_pages;
+          Page *page = bpm.FetchPage(page_id);
+          if (page == nullptr)
+            continue;
+          EXPECT_EQ(page_id, atoi(page->GetData()));
+          bpm.UnpinPage(page_id, i % 2 == 0);
+        }
+      }));
+    }
+    for (auto &thread : threads)
+      thread.join();
+  }
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+}
+
+/*
+ * Lock-free hits on hot pages race with a thread that keeps evicting frames
+ * by cycling through cold pages. Every fetch must return the right content
+ * and no pin may leak.
+ */
+TEST(BufferPoolManagerTest, HitWhileEvictingTest) {
+  const int num_hot = 4;
+  const int num_cold = 32;
+  const int num_threads = 4;
+  page_id_t temp_page_id;
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  {
+    BufferPoolManager bpm(8, disk_manager);
+    for (int i = 0; i < num_hot + num_cold; ++i) {
+      Page *page = bpm.NewPage(temp_page_id);
+      ASSERT_NE(nullptr, page);
+      snprintf(page->GetData(), 16, "%d", temp_page_id);
+      EXPECT_EQ(true, bpm.UnpinPage(temp_page_id, true));
+    }
+
+    std::vector<std::thread> threads;
+    threads.push_back(std::thread([&bpm]() {
+      for (int i = 0; i < 2000; i++) {
+        page_id_t page_id = num_hot + i % num_cold;
+        Page *page = bpm.FetchPage(page_id);
+        if (page == nullptr)
+          continue;
+        EXPECT_EQ(page_id, atoi(page->GetData()));
+        bpm.UnpinPage(page_id, false);
+      }
+    }));
+    for (int tid = 0; tid < num_threads; tid++) {
+      threads.push_back(std::thread([&bpm, tid]() {
+        for (int i = 0; i < 5000; i++) {
+          page_id_t page_id = (i + tid) % num_hot;
+          Page *page = bpm.FetchPage(page_id);
+          if (page == nullptr)
+            continue;
+          EXPECT_EQ(page_id, atoi(page->GetData()));
+          bpm.UnpinPage(page_id, false);
+        }
+      }));
+    }
+    for (auto &thread : threads)
+      thread.join();
+
+    // every pin was released: the whole pool can be recycled
+    for (int i = 0; i < 8; ++i) {
+      EXPECT_NE(nullptr, bpm.NewPage(temp_page_id));
+    }
+  }
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+}
+
+/*
+ * Dirty pages above the high watermark are written back by the background
+ * flusher, in page id order, down to the low watermark.
+ */
+TEST(BufferPoolManagerTest, BackgroundFlushTest) {
+  const int pool_size = 10;
+  page_id_t temp_page_id;
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  {
+    BufferPoolManager bpm(pool_size, disk_manager);
+    // keep the flusher idle until the whole pool is dirty
+    bpm.SetDirtyWatermarks(1.0, 1.0);
+    for (int i = 0; i < pool_size; ++i) {
+      Page *page = bpm.NewPage(temp_page_id);
+      ASSERT_NE(nullptr, page);
+      snprintf(page->GetData(), 16, "%d", temp_page_id);
+      EXPECT_EQ(true, bpm.UnpinPage(temp_page_id, true));
+    }
+    EXPECT_EQ(1.0, bpm.GetDirtyRatio());
+    bpm.SetDirtyWatermarks(0.2, 0.5);
+
+    // pages count as clean once taken into a batch, and as flushed once the
+    // batch is on disk
+    for (int i = 0; i < 100 && (bpm.GetDirtyRatio() > 0.2 ||
+                                bpm.GetFlushedPageCount() < 8);
+         ++i)
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_LE(bpm.GetDirtyRatio(), 0.2);
+    EXPECT_EQ(8u, bpm.GetFlushedPageCount());
+    // written back as one batch, synced once
+    EXPECT_EQ(1u, disk_manager->GetNumSyncs());
+
+    // the lowest page ids went first and are on disk
+    char data[PAGE_SIZE];
+    for (int i = 0; i < 8; ++i) {
+      disk_manager->ReadPage(i, data);
+      EXPECT_EQ(i, atoi(data));
+    }
+  }
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+}
+
+TEST(BufferPoolManagerTest, PrefetchTest) {
+  const int pool_size = 10;
+  page_id_t temp_page_id;
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  {
+    BufferPoolManager bpm(pool_size, disk_manager);
+    // pages 0..9 get evicted and written back, 10..19 stay resident
+    for (int i = 0; i < 2 * pool_size; ++i) {
+      Page *page = bpm.NewPage(temp_page_id);
+      ASSERT_NE(nullptr, page);
+      snprintf(page->GetData(), 16, "%d", temp_page_id);
+      EXPECT_EQ(true, bpm.UnpinPage(temp_page_id, true));
+    }
+
+    EXPECT_EQ(false, bpm.PrefetchPage(19));
+    EXPECT_EQ(false, bpm.PrefetchPage(2 * pool_size));
+    EXPECT_EQ(true, bpm.PrefetchPage(0));
+    EXPECT_EQ(false, bpm.PrefetchPage(0));
+
+    // stepping from page 1 to page 2 starts reading 3..6 ahead
+    ReadAhead read_ahead(&bpm, 4);
+    read_ahead.Access(1);
+    read_ahead.Access(2);
+    for (page_id_t page_id = 3; page_id < 7; ++page_id)
+      EXPECT_EQ(false, bpm.PrefetchPage(page_id));
+    EXPECT_EQ(true, bpm.PrefetchPage(7));
+
+    for (page_id_t page_id = 0; page_id < 8; ++page_id) {
+      Page *page = bpm.FetchPage(page_id);
+      ASSERT_NE(nullptr, page);
+      EXPECT_EQ(page_id, atoi(page->GetData()));
+      EXPECT_EQ(1, page->GetPinCount());
+      EXPECT_EQ(true, bpm.UnpinPage(page_id, false));
+    }
+  }
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+}
+
+// a page deleted while pinned is freed by its last unpin
+TEST(BufferPoolManagerTest, DeletePinnedPageTest) {
+  page_id_t temp_page_id;
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  {
+    BufferPoolManager bpm(4, disk_manager);
+    for (int i = 0; i < 3; ++i)
+      ASSERT_NE(nullptr, bpm.NewPage(temp_page_id));
+    size_t free_pages = disk_manager->GetFreePageCount();
+
+    Page *page = bpm.FetchPage(1);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ(false, bpm.DeletePage(1));
+    EXPECT_EQ(true, bpm.UnpinPage(1, false));
+    EXPECT_EQ(free_pages, disk_manager->GetFreePageCount());
+    EXPECT_EQ(true, bpm.UnpinPage(1, true));
+    EXPECT_EQ(free_pages + 1, disk_manager->GetFreePageCount());
+
+    // the id is handed out again
+    ASSERT_NE(nullptr, bpm.NewPage(temp_page_id));
+    EXPECT_EQ(1, temp_page_id);
+    EXPECT_EQ(true, bpm.UnpinPage(0, false));
+    EXPECT_EQ(true, bpm.UnpinPage(1, false));
+    EXPECT_EQ(true, bpm.UnpinPage(2, false));
+  }
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
+}
+
+// a page failing its checksum is reported to every fetch and does not keep
+// its frame
+TEST(BufferPoolManagerTest, CorruptPageTest) {
+  page_id_t temp_page_id;
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  {
+    BufferPoolManager bpm(2, disk_manager);
+    for (int i = 0; i < 2; ++i) {
+      Page *page = bpm.NewPage(temp_page_id);
+      ASSERT_NE(nullptr, page);
+      snprintf(page->GetData(), 16, "%d", temp_page_id);
+      EXPECT_EQ(true, bpm.UnpinPage(temp_page_id, true));
+    }
+  }
+
+  FILE *file = fopen("test.db", "r+b");
+  ASSERT_NE(nullptr, file);
+  fseek(file, DB_FILE_HEADER_SIZE + 1, SEEK_SET);
+  fputc('!', file);
+  fclose(file);
+
+  {
+    BufferPoolManager bpm(2, disk_manager);
+    EXPECT_THROW(bpm.FetchPage(0), PageCorruptionException);
+    EXPECT_THROW(bpm.FetchPage(0), PageCorruptionException);
+    // both frames are still there for good pages
+    Page *page = bpm.FetchPage(1);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ(1, atoi(page->GetData()));
+    EXPECT_NE(nullptr, bpm.NewPage(temp_page_id));
+    EXPECT_EQ(true, bpm.UnpinPage(1, false));
+    EXPECT_EQ(true, bpm.UnpinPage(temp_page_id, false));
+
+    // a read-ahead of the page drops it quietly
+    EXPECT_EQ(true, bpm.PrefetchPage(0));
+    EXPECT_THROW(bpm.FetchPage(0), PageCorruptionException);
+  }
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
+}
+
+// a write back that fails is reported to the fetch that evicted the page,
+// and neither page is left waiting for it
+TEST(BufferPoolManagerTest, WriteBackErrorTest) {
+  page_id_t temp_page_id;
+
+  {
+    DiskManager disk_manager("test.db");
+    BufferPoolManager bpm(3, &disk_manager);
+    for (int i = 0; i < 3; ++i) {
+      Page *page = bpm.NewPage(temp_page_id);
+      ASSERT_NE(nullptr, page);
+      snprintf(page->GetData(), 16, "%d", temp_page_id);
+      EXPECT_EQ(true, bpm.UnpinPage(temp_page_id, true));
+    }
+  }
+
+  // page writes of a read only disk manager throw
+  DiskManager disk_manager("test.db", PAGE_SIZE, true);
+  {
+    BufferPoolManager bpm(1, &disk_manager);
+    bpm.SetDirtyWatermarks(1.0, 1.0);
+    ASSERT_NE(nullptr, bpm.FetchPage(0));
+    EXPECT_EQ(true, bpm.UnpinPage(0, true));
+    EXPECT_THROW(bpm.FetchPage(1), Exception);
+
+    Page *page = bpm.FetchPage(1);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ(1, atoi(page->GetData()));
+    EXPECT_EQ(true, bpm.UnpinPage(1, false));
+    page = bpm.FetchPage(0);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ(0, atoi(page->GetData()));
+
+    // the read-ahead thread gives the frame up as well
+    EXPECT_EQ(true, bpm.UnpinPage(0, true));
+    EXPECT_EQ(true, bpm.PrefetchPage(2));
+  }
+  {
+    BufferPoolManager bpm(1, &disk_manager);
+    Page *page = bpm.FetchPage(2);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ(2, atoi(page->GetData()));
+    EXPECT_EQ(true, bpm.UnpinPage(2, false));
+  }
+  remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
+}
+
+// batch writes fail while fail_writes is set
+class FailingDiskManager : public DiskManager {
+public:
+  FailingDiskManager(const std::string &db_file)
+      : DiskManager(db_file), fail_writes(false), failed_batches(0) {}
+
+  void WritePages(
+      std::vector<std::pair<page_id_t, const char *>> &pages) override {
+    if (fail_writes && !pages.empty()) {
+      failed_batches++;
+      throw Exception(EXCEPTION_TYPE_IO, "I/O error while writing");
+    }
+    DiskManager::WritePages(pages);
+  }
+
+  std::atomic<bool> fail_writes;
+  std::atomic<int> failed_batches;
+};
+
+// a batch the flusher fails to write stays dirty, its pages are not left
+// latched, and a later round writes it back
+TEST(BufferPoolManagerTest, FlushErrorTest) {
+  const int pool_size = 4;
+  page_id_t temp_page_id;
+
+  FailingDiskManager *disk_manager = new FailingDiskManager("test.db");
+  {
+    BufferPoolManager bpm(pool_size, disk_manager);
+    bpm.SetDirtyWatermarks(1.0, 1.0);
+    for (int i = 0; i < pool_size; ++i) {
+      ASSERT_NE(nullptr, bpm.NewPage(temp_page_id));
+      EXPECT_EQ(true, bpm.UnpinPage(temp_page_id, true));
+    }
+    disk_manager->fail_writes = true;
+    bpm.SetDirtyWatermarks(0.0, 0.5);
+    for (int i = 0; i < 100 && disk_manager->failed_batches == 0; ++i)
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    ASSERT_LT(0, disk_manager->failed_batches);
+    EXPECT_EQ(0u, bpm.GetFlushedPageCount());
+    for (int i = 0; i < pool_size; ++i) {
+      WritePageGuard guard = bpm.FetchPageWrite(i);
+      ASSERT_TRUE(guard.IsValid());
+    }
+
+    disk_manager->fail_writes = false;
+    for (int i = 0; i < 100 &&
+                    bpm.GetFlushedPageCount() < static_cast<uint64_t>(pool_size);
+         ++i)
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(static_cast<uint64_t>(pool_size), bpm.GetFlushedPageCount());
+    EXPECT_EQ(0.0, bpm.GetDirtyRatio());
+  }
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
+}
+
+// FlushPage writes a dirty page back without holding up its readers, and
+// leaves it dirty if the write fails
+TEST(BufferPoolManagerTest, FlushPageTest) {
+  page_id_t temp_page_id;
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  {
+    BufferPoolManager bpm(2, disk_manager);
+    bpm.SetDirtyWatermarks(1.0, 1.0);
+    Page *page = bpm.NewPage(temp_page_id);
+    ASSERT_NE(nullptr, page);
+    strcpy(page->GetData(), "flushed");
+    EXPECT_EQ(true, bpm.UnpinPage(temp_page_id, true));
+    page->RLatch();
+    EXPECT_EQ(true, bpm.FlushPage(temp_page_id));
+    page->RUnlatch();
+    EXPECT_EQ(0.0, bpm.GetDirtyRatio());
+    // clean, or not in the pool
+    EXPECT_EQ(false, bpm.FlushPage(temp_page_id));
+    EXPECT_EQ(false, bpm.FlushPage(temp_page_id + 1));
+
+    char data[PAGE_SIZE];
+    disk_manager->ReadPage(temp_page_id, data);
+    EXPECT_STREQ("flushed", data);
+  }
+  delete disk_manager;
+
+  DiskManager read_only_disk_manager("test.db", PAGE_SIZE, true);
+  {
+    BufferPoolManager bpm(2, &read_only_disk_manager);
+    bpm.SetDirtyWatermarks(1.0, 1.0);
+    ASSERT_NE(nullptr, bpm.FetchPage(0));
+    EXPECT_EQ(true, bpm.UnpinPage(0, true));
+    EXPECT_THROW(bpm.FlushPage(0), Exception);
+    EXPECT_EQ(0.5, bpm.GetDirtyRatio());
+    // drop the page the way an eviction does when its write back fails,
+    // the pool would try to flush it on the way out otherwise
+    ASSERT_NE(nullptr, bpm.FetchPage(1));
+    EXPECT_THROW(bpm.FetchPage(2), Exception);
+    EXPECT_EQ(true, bpm.UnpinPage(1, false));
+  }
+  remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
+}
+
 } // namespace cmudb
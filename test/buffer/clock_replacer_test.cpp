@@ -0,0 +1,83 @@
+/**
+ * clock_replacer_test.cpp
+ */
+
+#include <cstdio>
+
+#include "buffer/buffer_pool_manager.h"
+#include "buffer/clock_replacer.h"
+#include "gtest/gtest.h"
+
+namespace cmudb {
+
+TEST(ClockReplacerTest, SampleTest) {
+  ClockReplacer<int> clock_replacer(7);
+
+  // push element into replacer
+  clock_replacer.Insert(1);
+  clock_replacer.Insert(2);
+  clock_replacer.Insert(3);
+  clock_replacer.Insert(4);
+  clock_replacer.Insert(5);
+  clock_replacer.Insert(6);
+  clock_replacer.Insert(1);
+  EXPECT_EQ(6, clock_replacer.Size());
+
+  // first sweep clears every reference bit, victims follow the hand
+  int value;
+  EXPECT_EQ(true, clock_replacer.Victim(value));
+  EXPECT_EQ(1, value);
+  EXPECT_EQ(true, clock_replacer.Victim(value));
+  EXPECT_EQ(2, value);
+
+  // a re-inserted frame gets a second chance
+  clock_replacer.Insert(3);
+  EXPECT_EQ(true, clock_replacer.Victim(value));
+  EXPECT_EQ(4, value);
+
+  // remove element from replacer
+  EXPECT_EQ(false, clock_replacer.Erase(4));
+  EXPECT_EQ(true, clock_replacer.Erase(6));
+  EXPECT_EQ(2, clock_replacer.Size());
+
+  EXPECT_EQ(true, clock_replacer.Victim(value));
+  EXPECT_EQ(5, value);
+  EXPECT_EQ(true, clock_replacer.Victim(value));
+  EXPECT_EQ(3, value);
+  EXPECT_EQ(false, clock_replacer.Victim(value));
+  EXPECT_EQ(0, clock_replacer.Size());
+}
+
+TEST(ClockReplacerTest, BufferPoolTest) {
+  page_id_t temp_page_id;
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  {
+    BufferPoolManager bpm(10, disk_manager, nullptr, ReplacerType::CLOCK);
+
+    auto page_zero = bpm.NewPage(temp_page_id);
+    ASSERT_NE(nullptr, page_zero);
+    strcpy(page_zero->GetData(), "Hello");
+    for (int i = 1; i < 10; ++i) {
+      EXPECT_NE(nullptr, bpm.NewPage(temp_page_id));
+    }
+    EXPECT_EQ(nullptr, bpm.NewPage(temp_page_id));
+    for (int i = 0; i < 5; ++i) {
+      EXPECT_EQ(true, bpm.UnpinPage(i, true));
+    }
+    for (int i = 0; i < 5; ++i) {
+      EXPECT_NE(nullptr, bpm.NewPage(temp_page_id));
+    }
+    EXPECT_EQ(nullptr, bpm.NewPage(temp_page_id));
+
+    EXPECT_EQ(true, bpm.UnpinPage(temp_page_id, false));
+    page_zero = bpm.FetchPage(0);
+    ASSERT_NE(nullptr, page_zero);
+    EXPECT_EQ(0, strcmp(page_zero->GetData(), "Hello"));
+  }
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+}
+
+} // namespace cmudb
@@ -0,0 +1,89 @@
+/**
+ * frame_arena_test.cpp
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "buffer/buffer_pool_manager.h"
+#include "buffer/frame_arena.h"
+#include "gtest/gtest.h"
+
+namespace cmudb {
+
+TEST(FrameArenaTest, LayoutTest) {
+  const size_t frame_count = 16;
+  FrameArena arena(frame_count);
+  EXPECT_EQ(frame_count, arena.GetFrameCount());
+  EXPECT_EQ(true, arena.IsNumaApplied());
+
+  Page *pages = arena.GetPages();
+  ASSERT_NE(nullptr, pages);
+  // frames are consecutive in the data mapping, which starts page aligned
+  EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(pages[0].GetData()) % 4096);
+  for (size_t i = 0; i < frame_count; ++i) {
+    EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(&pages[i]) % CACHELINE_SIZE);
+    EXPECT_EQ(pages[0].GetData() + i * PAGE_SIZE, pages[i].GetData());
+    EXPECT_EQ(INVALID_PAGE_ID, pages[i].GetPageId());
+    EXPECT_EQ(0, pages[i].GetPinCount());
+    for (size_t j = 0; j < PAGE_SIZE; ++j)
+      ASSERT_EQ(0, pages[i].GetData()[j]);
+  }
+  // bookkeeping lives apart from the page data
+  EXPECT_EQ(true, reinterpret_cast<char *>(pages + frame_count) <=
+                          pages[0].GetData() ||
+                      pages[frame_count - 1].GetData() + PAGE_SIZE <=
+                          reinterpret_cast<char *>(pages));
+
+  FrameArena empty(0);
+  EXPECT_EQ(nullptr, empty.GetPages());
+}
+
+TEST(FrameArenaTest, NumaTest) {
+  EXPECT_LE(1, FrameArena::GetNumaNodeCount());
+
+  // the policy is a hint: the frames work whether the kernel took it or not
+  for (NumaPolicy policy : {NumaPolicy::INTERLEAVE, NumaPolicy::BIND}) {
+    FrameArena arena(8, policy, 0);
+    Page *pages = arena.GetPages();
+    for (size_t i = 0; i < 8; ++i)
+      snprintf(pages[i].GetData(), PAGE_SIZE, "frame %zu", i);
+    EXPECT_EQ(0, strcmp("frame 7", pages[7].GetData()));
+  }
+
+  // binding to a node that does not exist is refused
+  FrameArena arena(8, NumaPolicy::BIND, FrameArena::GetNumaNodeCount());
+  EXPECT_EQ(false, arena.IsNumaApplied());
+}
+
+TEST(FrameArenaTest, BufferPoolTest) {
+  page_id_t page_id;
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  {
+    BufferPoolManager bpm(4, disk_manager, nullptr, ReplacerType::LRU,
+                          NumaPolicy::INTERLEAVE);
+    for (int i = 0; i < 8; ++i) {
+      Page *page = bpm.NewPage(page_id);
+      ASSERT_NE(nullptr, page);
+      EXPECT_EQ(i, page_id);
+      snprintf(page->GetData(), PAGE_SIZE, "page %d", i);
+      EXPECT_EQ(true, bpm.UnpinPage(page_id, true));
+    }
+    // the first pages were evicted through the arena frames
+    for (int i = 0; i < 8; ++i) {
+      char expected[PAGE_SIZE];
+      snprintf(expected, PAGE_SIZE, "page %d", i);
+      Page *page = bpm.FetchPage(i);
+      ASSERT_NE(nullptr, page);
+      EXPECT_EQ(0, strcmp(expected, page->GetData()));
+      EXPECT_EQ(true, bpm.UnpinPage(i, false));
+    }
+  }
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+}
+
+} // namespace cmudb
@@ -0,0 +1,93 @@
+/**
+ * lru_k_replacer_test.cpp
+ */
+
+#include <cstdio>
+
+#include "buffer/buffer_pool_manager.h"
+#include "buffer/lru_k_replacer.h"
+#include "gtest/gtest.h"
+
+namespace cmudb {
+
+TEST(LRUKReplacerTest, SampleTest) {
+  LRUKReplacer<int> lru_k_replacer(7, 2);
+
+  // frames 1..5 accessed once, frame 1 and 2 accessed a second time
+  for (int i = 1; i <= 5; ++i)
+    lru_k_replacer.RecordAccess(i);
+  lru_k_replacer.RecordAccess(2);
+  lru_k_replacer.RecordAccess(1);
+  for (int i = 1; i <= 6; ++i)
+    lru_k_replacer.Insert(i);
+  // frame 6 was never accessed
+  EXPECT_EQ(6, lru_k_replacer.Size());
+
+  // infinite distance first, oldest access first
+  int value;
+  EXPECT_EQ(true, lru_k_replacer.Victim(value));
+  EXPECT_EQ(6, value);
+  EXPECT_EQ(true, lru_k_replacer.Victim(value));
+  EXPECT_EQ(3, value);
+  EXPECT_EQ(true, lru_k_replacer.Victim(value));
+  EXPECT_EQ(4, value);
+
+  // remove element from replacer, history survives pinning
+  EXPECT_EQ(false, lru_k_replacer.Erase(4));
+  EXPECT_EQ(true, lru_k_replacer.Erase(5));
+  EXPECT_EQ(2, lru_k_replacer.Size());
+  lru_k_replacer.RecordAccess(5);
+  lru_k_replacer.Insert(5);
+
+  // frame 1's second to last access is older than frame 2's
+  EXPECT_EQ(true, lru_k_replacer.Victim(value));
+  EXPECT_EQ(1, value);
+  EXPECT_EQ(true, lru_k_replacer.Victim(value));
+  EXPECT_EQ(2, value);
+  EXPECT_EQ(true, lru_k_replacer.Victim(value));
+  EXPECT_EQ(5, value);
+  EXPECT_EQ(false, lru_k_replacer.Victim(value));
+}
+
+// a sequential scan must not push out pages accessed repeatedly
+TEST(LRUKReplacerTest, ScanResistanceTest) {
+  page_id_t temp_page_id;
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  {
+    BufferPoolManager bpm(10, disk_manager, nullptr, ReplacerType::LRU_K);
+
+    // two hot pages, fetched twice. The second change is made in memory
+    // only (page is clean), it is lost if the page gets evicted
+    for (int i = 0; i < 2; ++i) {
+      Page *page = bpm.NewPage(temp_page_id);
+      ASSERT_NE(nullptr, page);
+      strcpy(page->GetData(), "on disk");
+      bpm.UnpinPage(temp_page_id, true);
+      EXPECT_EQ(true, bpm.FlushPage(temp_page_id));
+      page = bpm.FetchPage(temp_page_id);
+      ASSERT_NE(nullptr, page);
+      strcpy(page->GetData(), "in memory");
+      bpm.UnpinPage(temp_page_id, false);
+    }
+
+    // scan through many more pages than frames
+    for (int i = 0; i < 30; ++i) {
+      ASSERT_NE(nullptr, bpm.NewPage(temp_page_id));
+      bpm.UnpinPage(temp_page_id, true);
+    }
+
+    // the hot pages were never evicted
+    for (int i = 0; i < 2; ++i) {
+      Page *page = bpm.FetchPage(i);
+      ASSERT_NE(nullptr, page);
+      EXPECT_EQ(0, strcmp(page->GetData(), "in memory"));
+      bpm.UnpinPage(i, false);
+    }
+  }
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+}
+
+} // namespace cmudb
@@ -0,0 +1,191 @@
+/**
+ * mmap_buffer_pool_manager_test.cpp
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "buffer/mmap_buffer_pool_manager.h"
+#include "common/exception.h"
+#include "index/b_plus_tree.h"
+#include "page/header_page.h"
+#include "vtable/virtual_table.h"
+#include "gtest/gtest.h"
+
+namespace cmudb {
+
+static void CleanUp() {
+  remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
+}
+
+TEST(MmapBufferPoolManagerTest, ReadOnlyTest) {
+  const size_t page_size = 8192;
+  std::vector<char> data(page_size, 0);
+  {
+    DiskManager disk_manager("test.db", page_size);
+    for (page_id_t page_id = 0; page_id < 3; page_id++) {
+      disk_manager.AllocatePage();
+      snprintf(data.data(), page_size, "page %d", page_id);
+      disk_manager.WritePage(page_id, data.data());
+    }
+  }
+
+  MmapDiskManager disk_manager("test.db");
+  ASSERT_TRUE(disk_manager.IsMapped());
+  EXPECT_EQ(page_size, disk_manager.GetPageSize());
+  EXPECT_EQ(3, disk_manager.GetPageCount());
+  EXPECT_THROW(disk_manager.WritePage(0, data.data()), Exception);
+
+  // a regular buffer pool on top of it still copies
+  std::vector<char> buf(page_size);
+  disk_manager.ReadPage(1, buf.data());
+  EXPECT_EQ(0, strcmp("page 1", buf.data()));
+
+  MmapBufferPoolManager bpm(&disk_manager);
+  Page *page = bpm.FetchPage(2);
+  ASSERT_NE(nullptr, page);
+  // no copy: the page is the mapping
+  EXPECT_EQ(disk_manager.GetMapping() + 2 * page_size, page->GetData());
+  EXPECT_EQ(0, strcmp("page 2", page->GetData()));
+  EXPECT_EQ(page, bpm.FetchPage(2));
+  EXPECT_EQ(2, page->GetPinCount());
+  EXPECT_TRUE(bpm.UnpinPage(2, false));
+  EXPECT_TRUE(bpm.UnpinPage(2, true));
+  EXPECT_FALSE(bpm.UnpinPage(2, false));
+
+  EXPECT_EQ(nullptr, bpm.FetchPage(3));
+  page_id_t page_id;
+  EXPECT_EQ(nullptr, bpm.NewPage(page_id));
+  EXPECT_FALSE(bpm.DeletePage(1));
+  bpm.PrefetchRange(0, 8);
+
+  CleanUp();
+}
+
+TEST(MmapBufferPoolManagerTest, CorruptPageTest) {
+  {
+    DiskManager disk_manager("test.db");
+    char data[PAGE_SIZE] = {0};
+    disk_manager.WritePage(0, data);
+    disk_manager.WritePage(1, data);
+  }
+  FILE *file = fopen("test.db", "r+b");
+  ASSERT_NE(nullptr, file);
+  fseek(file, DB_FILE_HEADER_SIZE + PAGE_SIZE + 3, SEEK_SET);
+  fputc('!', file);
+  fclose(file);
+
+  MmapDiskManager disk_manager("test.db");
+  MmapBufferPoolManager bpm(&disk_manager);
+  ASSERT_NE(nullptr, bpm.FetchPage(0));
+  EXPECT_THROW(bpm.FetchPage(1), PageCorruptionException);
+  EXPECT_FALSE(bpm.UnpinPage(1, false));
+
+  CleanUp();
+}
+
+TEST(MmapBufferPoolManagerTest, BPlusTreeTest) {
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
+  GenericKey<8> index_key;
+  RID rid;
+  const int64_t scale = 5000;
+
+  {
+    DiskManager disk_manager("test.db", 4096);
+    BufferPoolManager bpm(50, &disk_manager);
+    BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", &bpm,
+                                                             comparator);
+    page_id_t page_id;
+    bpm.NewPage(page_id);
+    for (int64_t key = 1; key <= scale; key++) {
+      rid.Set((int32_t)(key >> 32), key & 0xFFFFFFFF);
+      index_key.SetFromInteger(key);
+      tree.Insert(index_key, rid);
+    }
+    bpm.UnpinPage(HEADER_PAGE_ID, true);
+  }
+
+  // lookups and a scan of the index, straight out of the mapping
+  MmapDiskManager disk_manager("test.db");
+  MmapBufferPoolManager bpm(&disk_manager);
+  auto header_page = static_cast<HeaderPage *>(bpm.FetchPage(HEADER_PAGE_ID));
+  page_id_t root_page_id;
+  ASSERT_TRUE(header_page->GetRootId("foo_pk", root_page_id));
+  bpm.UnpinPage(HEADER_PAGE_ID, false);
+
+  BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree(
+      "foo_pk", &bpm, comparator, root_page_id);
+  std::vector<RID> rids;
+  for (int64_t key = 1; key <= scale; key++) {
+    rids.clear();
+    index_key.SetFromInteger(key);
+    tree.GetValue(index_key, rids);
+    ASSERT_EQ(rids.size(), 1);
+    EXPECT_EQ(rids[0].GetSlotNum(), key);
+  }
+  int64_t count = 0;
+  index_key.SetFromInteger(1);
+  for (auto iterator = tree.Begin(index_key); iterator.isEnd() == false;
+       ++iterator)
+    count++;
+  EXPECT_EQ(scale, count);
+
+  delete key_schema;
+  CleanUp();
+}
+
+/*
+ * Fetch every page of a file through a regular buffer pool smaller than
+ * the file and through the mmap pool. Not run by default:
+ * ./mmap_buffer_pool_manager_test --gtest_also_run_disabled_tests
+ */
+TEST(MmapBufferPoolManagerTest, DISABLED_FetchBenchmark) {
+  const size_t page_size = 4096;
+  const page_id_t num_pages = 16384;
+  const int rounds = 10;
+  {
+    DiskManager disk_manager("test.db", page_size);
+    std::vector<char> data(page_size, 0);
+    for (page_id_t page_id = 0; page_id < num_pages; page_id++)
+      disk_manager.WritePage(page_id, data.data());
+  }
+
+  auto run = [&](const char *name, BufferPoolManager *bpm) {
+    auto start = std::chrono::steady_clock::now();
+    uint64_t sum = 0;
+    for (int round = 0; round < rounds; round++) {
+      for (page_id_t page_id = 0; page_id < num_pages; page_id++) {
+        Page *page = bpm->FetchPage(page_id);
+        sum += page->GetData()[0];
+        bpm->UnpinPage(page_id, false);
+      }
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    std::cout << name << " : "
+              << static_cast<uint64_t>(rounds * num_pages / elapsed.count())
+              << " fetches per sec" << std::endl;
+    EXPECT_EQ(0u, sum);
+  };
+
+  {
+    DiskManager disk_manager("test.db");
+    BufferPoolManager bpm(num_pages / 4, &disk_manager);
+    run("buffer pool", &bpm);
+  }
+  {
+    MmapDiskManager disk_manager("test.db");
+    MmapBufferPoolManager bpm(&disk_manager);
+    run("mmap", &bpm);
+  }
+
+  CleanUp();
+}
+
+} // namespace cmudb
@@ -0,0 +1,64 @@
+/**
+ * page_guard_test.cpp
+ */
+
+#include <cstdio>
+#include <cstring>
+
+#include "buffer/buffer_pool_manager.h"
+#include "gtest/gtest.h"
+
+namespace cmudb {
+
+TEST(PageGuardTest, SampleTest) {
+  page_id_t page_id;
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  {
+    BufferPoolManager bpm(2, disk_manager);
+    Page *page = bpm.NewPage(page_id);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ(true, bpm.UnpinPage(page_id, false));
+
+    {
+      ReadPageGuard guard = bpm.FetchPageRead(page_id);
+      ASSERT_EQ(true, guard.IsValid());
+      EXPECT_EQ(page_id, guard.GetPageId());
+      EXPECT_EQ(1, page->GetPinCount());
+
+      // moving hands the pin over, it is released once
+      ReadPageGuard moved(std::move(guard));
+      EXPECT_EQ(false, guard.IsValid());
+      EXPECT_EQ(1, page->GetPinCount());
+      ReadPageGuard other = bpm.FetchPageRead(page_id);
+      EXPECT_EQ(2, page->GetPinCount());
+      other = std::move(moved);
+      EXPECT_EQ(1, page->GetPinCount());
+    }
+    EXPECT_EQ(0, page->GetPinCount());
+
+    {
+      WritePageGuard guard = bpm.FetchPageWrite(page_id);
+      strcpy(guard.GetDataMut(), "Hello");
+      guard.Drop();
+      EXPECT_EQ(0, page->GetPinCount());
+      guard.Drop();
+      EXPECT_EQ(0, page->GetPinCount());
+    }
+
+    // the write guard unpinned the page dirty: it survives eviction
+    page_id_t temp_page_id;
+    for (int i = 0; i < 2; ++i) {
+      ASSERT_NE(nullptr, bpm.NewPage(temp_page_id));
+      EXPECT_EQ(true, bpm.UnpinPage(temp_page_id, false));
+    }
+    ReadPageGuard guard = bpm.FetchPageRead(page_id);
+    ASSERT_EQ(true, guard.IsValid());
+    EXPECT_EQ(0, strcmp(guard.GetData(), "Hello"));
+  }
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+}
+
+} // namespace cmudb
@@ -0,0 +1,180 @@
+/**
+ * parallel_buffer_pool_manager_test.cpp
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "buffer/parallel_buffer_pool_manager.h"
+#include "gtest/gtest.h"
+
+namespace cmudb {
+
+TEST(ParallelBufferPoolManagerTest, SampleTest) {
+  page_id_t temp_page_id;
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  {
+    // 2 instances of 5 frames each
+    ParallelBufferPoolManager bpm(2, 5, disk_manager);
+    EXPECT_EQ(10, bpm.GetPoolSize());
+
+    auto page_zero = bpm.NewPage(temp_page_id);
+    ASSERT_NE(nullptr, page_zero);
+    EXPECT_EQ(0, temp_page_id);
+    strcpy(page_zero->GetData(), "Hello");
+
+    // page ids alternate between the two instances
+    for (int i = 1; i < 10; ++i) {
+      EXPECT_NE(nullptr, bpm.NewPage(temp_page_id));
+      EXPECT_EQ(i, temp_page_id);
+    }
+    // all the pages are pinned, the buffer pool is full
+    for (int i = 10; i < 15; ++i) {
+      EXPECT_EQ(nullptr, bpm.NewPage(temp_page_id));
+    }
+    // unpin pages 0..3: two frames free up in each instance
+    for (int i = 0; i < 4; ++i) {
+      EXPECT_EQ(true, bpm.UnpinPage(i, true));
+    }
+    for (int i = 0; i < 4; ++i) {
+      EXPECT_NE(nullptr, bpm.NewPage(temp_page_id));
+    }
+    EXPECT_EQ(nullptr, bpm.NewPage(temp_page_id));
+
+    // page zero was evicted and written back, release one frame to refetch it
+    EXPECT_EQ(true, bpm.UnpinPage(temp_page_id - 1, false));
+    EXPECT_EQ(true, bpm.UnpinPage(temp_page_id - 2, false));
+    page_zero = bpm.FetchPage(0);
+    ASSERT_NE(nullptr, page_zero);
+    EXPECT_EQ(0, strcmp(page_zero->GetData(), "Hello"));
+    EXPECT_EQ(true, bpm.UnpinPage(0, false));
+    EXPECT_EQ(false, bpm.UnpinPage(0, false));
+  }
+
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+}
+
+// a full instance sends NewPage on to the next page id
+TEST(ParallelBufferPoolManagerTest, NewPageRetryTest) {
+  page_id_t temp_page_id;
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  {
+    ParallelBufferPoolManager bpm(2, 1, disk_manager);
+    EXPECT_NE(nullptr, bpm.NewPage(temp_page_id));
+    EXPECT_EQ(0, temp_page_id);
+    EXPECT_NE(nullptr, bpm.NewPage(temp_page_id));
+    EXPECT_EQ(1, temp_page_id);
+    // page 0 keeps the first instance full, page 2 would go there
+    EXPECT_EQ(true, bpm.UnpinPage(1, false));
+    EXPECT_NE(nullptr, bpm.NewPage(temp_page_id));
+    EXPECT_EQ(3, temp_page_id);
+    // now both are, the ids tried are handed back
+    EXPECT_EQ(nullptr, bpm.NewPage(temp_page_id));
+    EXPECT_EQ(true, bpm.UnpinPage(0, false));
+    EXPECT_NE(nullptr, bpm.NewPage(temp_page_id));
+    EXPECT_EQ(2, temp_page_id);
+  }
+
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
+}
+
+TEST(ParallelBufferPoolManagerTest, ConcurrentTest) {
+  const int num_threads = 8;
+  const int pages_per_thread = 20;
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  {
+    ParallelBufferPoolManager bpm(4, 10, disk_manager);
+    std::vector<std::thread> threads;
+    for (int tid = 0; tid < num_threads; tid++) {
+      threads.push_back(std::thread([&bpm, tid]() {
+        std::vector<page_id_t> page_ids;
+        page_id_t page_id;
+        for (int i = 0; i < pages_per_thread; i++) {
+          Page *page = bpm.NewPage(page_id);
+          if (page == nullptr)
+            continue;
+          snprintf(page->GetData(), 16, "%d", page_id);
+          page_ids.push_back(page_id);
+          bpm.UnpinPage(page_id, true);
+        }
+        for (auto id : page_ids) {
+          Page *page = bpm.FetchPage(id);
+          if (page == nullptr)
+            continue;
+          EXPECT_EQ(id, atoi(page->GetData()));
+          bpm.UnpinPage(id, false);
+        }
+      }));
+    }
+    for (auto &thread : threads)
+      thread.join();
+  }
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+}
+
+/*
+ * Throughput of resident page fetch/unpin pairs from 1 to 32 threads, single
+ * latch pool vs. a pool split into 16 instances. Not run by default:
+ * ./parallel_buffer_pool_manager_test --gtest_also_run_disabled_tests
+ */
+TEST(ParallelBufferPoolManagerTest, DISABLED_ScalingBenchmark) {
+  const int num_pages = 256;
+  const int ops_per_thread = 200000;
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  for (size_t num_instances : {1, 16}) {
+    ParallelBufferPoolManager bpm(num_instances, num_pages / num_instances,
+                                  disk_manager);
+    std::vector<page_id_t> page_ids;
+    page_id_t page_id;
+    for (int i = 0; i < num_pages; i++) {
+      if (bpm.NewPage(page_id) != nullptr) {
+        page_ids.push_back(page_id);
+        bpm.UnpinPage(page_id, false);
+      }
+    }
+
+    for (int num_threads = 1; num_threads <= 32; num_threads *= 2) {
+      std::vector<std::thread> threads;
+      auto start = std::chrono::steady_clock::now();
+      for (int tid = 0; tid < num_threads; tid++) {
+        threads.push_back(std::thread([&bpm, &page_ids, tid]() {
+          uint64_t seed = tid + 1;
+          for (int i = 0; i < ops_per_thread; i++) {
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            page_id_t id = page_ids[(seed >> 33) % page_ids.size()];
+            if (bpm.FetchPage(id) != nullptr)
+              bpm.UnpinPage(id, false);
+          }
+        }));
+      }
+      for (auto &thread : threads)
+        thread.join();
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      std::cout << "instances " << num_instances << " threads " << num_threads
+                << " : "
+                << static_cast<uint64_t>(num_threads * ops_per_thread /
+                                         elapsed.count())
+                << " fetch/unpin per sec" << std::endl;
+    }
+  }
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+}
+
+} // namespace cmudb
@@ -0,0 +1,64 @@
+/**
+ * crc32c_test.cpp
+ */
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "common/crc32c.h"
+#include "gtest/gtest.h"
+
+namespace cmudb {
+
+TEST(Crc32cTest, KnownValueTest) {
+  std::cout << "crc32 instruction "
+            << (Crc32cIsHardware() ? "used" : "not used") << std::endl;
+  EXPECT_EQ(0u, Crc32c("", 0));
+  EXPECT_EQ(0xe3069283u, Crc32c("123456789", 9));
+
+  // 32 bytes of zeros / of 0xff (RFC 3720, B.4)
+  char data[32];
+  memset(data, 0, sizeof(data));
+  EXPECT_EQ(0x8a9136aau, Crc32c(data, sizeof(data)));
+  memset(data, 0xff, sizeof(data));
+  EXPECT_EQ(0x62a8ab43u, Crc32c(data, sizeof(data)));
+
+  // any alignment and any tail length
+  std::vector<char> buffer(64);
+  for (size_t i = 0; i < buffer.size(); i++)
+    buffer[i] = static_cast<char>(i * 7);
+  for (size_t offset = 0; offset < 8; offset++) {
+    std::vector<char> copy(buffer.begin(), buffer.end() - offset);
+    std::vector<char> shifted(offset, 0);
+    shifted.insert(shifted.end(), copy.begin(), copy.end());
+    EXPECT_EQ(Crc32c(copy.data(), copy.size()),
+              Crc32c(shifted.data() + offset, copy.size()));
+  }
+}
+
+/*
+ * Checksum throughput over 4K pages. Not run by default:
+ * ./crc32c_test --gtest_also_run_disabled_tests
+ */
+TEST(Crc32cTest, DISABLED_ThroughputBenchmark) {
+  const size_t page_size = 4096;
+  const size_t num_pages = 256;
+  const int rounds = 256;
+  std::vector<char> pages(page_size * num_pages, 'x');
+
+  uint32_t sum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int round = 0; round < rounds; round++)
+    for (size_t i = 0; i < num_pages; i++)
+      sum += Crc32c(pages.data() + i * page_size, page_size);
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::cout << (Crc32cIsHardware() ? "crc32 instruction" : "lookup table")
+            << " : "
+            << pages.size() * rounds / elapsed.count() / (1024 * 1024)
+            << " MB per sec (" << sum << ")" << std::endl;
+}
+
+} // namespace cmudb
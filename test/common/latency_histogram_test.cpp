@@ -0,0 +1,68 @@
+/**
+ * latency_histogram_test.cpp
+ */
+
+#include <thread>
+#include <vector>
+
+#include "common/latency_histogram.h"
+#include "gtest/gtest.h"
+
+namespace cmudb {
+
+TEST(LatencyHistogramTest, PercentileTest) {
+  LatencyHistogram histogram;
+  EXPECT_EQ(0u, histogram.GetCount());
+  EXPECT_EQ(0u, histogram.GetPercentile(0.5));
+
+  // small values are exact
+  for (uint64_t value = 0; value < 8; value++)
+    histogram.Record(value);
+  EXPECT_EQ(3u, histogram.GetPercentile(0.5));
+  EXPECT_EQ(7u, histogram.GetPercentile(1.0));
+  histogram.Reset();
+  EXPECT_EQ(0u, histogram.GetCount());
+  EXPECT_EQ(0u, histogram.GetMax());
+
+  // 1..100000, percentiles within an eighth of the exact value
+  uint64_t sum = 0;
+  for (uint64_t value = 1; value <= 100000; value++) {
+    histogram.Record(value);
+    sum += value;
+  }
+  EXPECT_EQ(100000u, histogram.GetCount());
+  EXPECT_EQ(sum, histogram.GetSum());
+  EXPECT_EQ(100000u, histogram.GetMax());
+  for (double p : {0.01, 0.5, 0.9, 0.99}) {
+    uint64_t exact = static_cast<uint64_t>(p * 100000);
+    uint64_t estimate = histogram.GetPercentile(p);
+    EXPECT_GE(estimate, exact);
+    EXPECT_LE(estimate, exact + exact / 8);
+  }
+  // never beyond what was recorded
+  EXPECT_EQ(100000u, histogram.GetPercentile(1.0));
+
+  // huge values still land in a bucket
+  histogram.Record(UINT64_MAX);
+  EXPECT_EQ(UINT64_MAX, histogram.GetMax());
+  EXPECT_EQ(UINT64_MAX, histogram.GetPercentile(1.0));
+}
+
+TEST(LatencyHistogramTest, ConcurrentTest) {
+  LatencyHistogram histogram;
+  const int num_threads = 4;
+  const uint64_t per_thread = 100000;
+  std::vector<std::thread> threads;
+  for (int tid = 0; tid < num_threads; tid++) {
+    threads.push_back(std::thread([&histogram, tid]() {
+      for (uint64_t i = 0; i < per_thread; i++)
+        histogram.Record(i * num_threads + tid);
+    }));
+  }
+  for (auto &thread : threads)
+    thread.join();
+  EXPECT_EQ(num_threads * per_thread, histogram.GetCount());
+  EXPECT_EQ(num_threads * per_thread - 1, histogram.GetMax());
+}
+
+} // namespace cmudb
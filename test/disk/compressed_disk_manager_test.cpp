@@ -0,0 +1,221 @@
+/**
+ * compressed_disk_manager_test.cpp
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "buffer/buffer_pool_manager.h"
+#include "common/exception.h"
+#include "disk/compressed_disk_manager.h"
+#include "logging/common.h"
+#include "table/table_heap.h"
+#include "vtable/virtual_table.h"
+#include "gtest/gtest.h"
+
+namespace cmudb {
+
+static void CleanUp() {
+  remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
+  remove("test.pim");
+}
+
+TEST(CompressedDiskManagerTest, CodecTest) {
+  const size_t size = 4096;
+  std::vector<char> page(size, 0);
+  std::vector<char> compressed(size);
+  std::vector<char> decompressed(size);
+
+  // a table page: header and slots at the front, tuples at the back
+  std::mt19937 rng(42);
+  for (size_t i = 0; i < 200; i++)
+    page[i] = static_cast<char>(rng());
+  for (size_t i = size - 1000; i < size; i++)
+    page[i] = static_cast<char>(rng());
+  size_t length = CompressedDiskManager::Compress(
+      page.data(), size, compressed.data(), compressed.size());
+  ASSERT_NE(0u, length);
+  EXPECT_LT(length, size / 2);
+  ASSERT_TRUE(CompressedDiskManager::Decompress(
+      compressed.data(), length, decompressed.data(), size));
+  EXPECT_EQ(0, memcmp(page.data(), decompressed.data(), size));
+
+  // tuples repeating the same fields compress, not only runs of a byte
+  for (size_t i = 0; i < size; i++)
+    page[i] = static_cast<char>(i % 16 < 12 ? i % 16 * 7 : (i / 16) & 0xff);
+  length = CompressedDiskManager::Compress(page.data(), size,
+                                           compressed.data(), size);
+  ASSERT_NE(0u, length);
+  EXPECT_LT(length, size / 2);
+  ASSERT_TRUE(CompressedDiskManager::Decompress(
+      compressed.data(), length, decompressed.data(), size));
+  EXPECT_EQ(0, memcmp(page.data(), decompressed.data(), size));
+
+  // random bytes do not fit in less than the page
+  for (auto &c : page)
+    c = static_cast<char>(rng());
+  EXPECT_EQ(0u, CompressedDiskManager::Compress(page.data(), size,
+                                                compressed.data(), size - 1));
+
+  // truncated input or a wrong size is caught
+  EXPECT_FALSE(CompressedDiskManager::Decompress(
+      compressed.data(), 0, decompressed.data(), size));
+  std::vector<char> zeros(size, 0);
+  length = CompressedDiskManager::Compress(zeros.data(), size,
+                                           compressed.data(), size);
+  EXPECT_FALSE(CompressedDiskManager::Decompress(
+      compressed.data(), length - 1, decompressed.data(), size));
+  EXPECT_FALSE(CompressedDiskManager::Decompress(
+      compressed.data(), length, decompressed.data(), size - 1));
+}
+
+TEST(CompressedDiskManagerTest, ReadWriteTest) {
+  const size_t page_size = 4096;
+  const int num_pages = 20;
+  std::mt19937 rng(7);
+  std::vector<std::vector<char>> pages(num_pages,
+                                       std::vector<char>(page_size, 0));
+  std::vector<char> buf(page_size);
+  {
+    CompressedDiskManager disk_manager("test.db", page_size);
+    for (int i = 0; i < num_pages; i++) {
+      snprintf(pages[i].data(), page_size, "page %d", i);
+      for (size_t j = page_size - 512; j < page_size - PAGE_CHECKSUM_SIZE; j++)
+        pages[i][j] = static_cast<char>(rng());
+      disk_manager.WritePage(i, pages[i].data());
+    }
+    // a page that does not compress is stored as it is
+    for (size_t j = 0; j < page_size; j++)
+      pages[3][j] = static_cast<char>(rng());
+    disk_manager.WritePage(3, pages[3].data());
+
+    for (int i = 0; i < num_pages; i++) {
+      disk_manager.ReadPage(i, buf.data());
+      EXPECT_EQ(0, memcmp(pages[i].data(), buf.data(),
+                          page_size - PAGE_CHECKSUM_SIZE));
+    }
+    // never written, zeros
+    disk_manager.ReadPage(num_pages, buf.data());
+    EXPECT_EQ(0, buf[0]);
+
+    EXPECT_EQ(static_cast<uint64_t>(num_pages * page_size),
+              disk_manager.GetLogicalBytes());
+    EXPECT_LT(disk_manager.GetStoredBytes(), num_pages * page_size / 3);
+  }
+
+  // the map is picked up again, and the slot page 3 left is reused
+  {
+    CompressedDiskManager disk_manager("test.db");
+    EXPECT_EQ(page_size, disk_manager.GetPageSize());
+    uint64_t stored = disk_manager.GetStoredBytes();
+    for (int i = 0; i < num_pages; i++) {
+      disk_manager.ReadPage(i, buf.data());
+      EXPECT_EQ(0, memcmp(pages[i].data(), buf.data(),
+                          page_size - PAGE_CHECKSUM_SIZE));
+    }
+    memcpy(pages[3].data(), pages[2].data(), page_size);
+    disk_manager.WritePage(3, pages[3].data());
+    disk_manager.WritePage(num_pages, pages[2].data());
+    EXPECT_LT(disk_manager.GetStoredBytes(), stored);
+    disk_manager.ReadPage(num_pages, buf.data());
+    EXPECT_EQ(0, memcmp(pages[2].data(), buf.data(),
+                        page_size - PAGE_CHECKSUM_SIZE));
+  }
+  FILE *file = fopen("test.db", "rb");
+  ASSERT_NE(nullptr, file);
+  fseek(file, 0, SEEK_END);
+  EXPECT_LT(ftell(file), static_cast<long>(num_pages * page_size / 2));
+  fclose(file);
+
+  CleanUp();
+}
+
+TEST(CompressedDiskManagerTest, FormatTest) {
+  std::vector<char> page(PAGE_SIZE, 0);
+  strcpy(page.data(), "A test string.");
+  {
+    DiskManager disk_manager("test.db");
+    disk_manager.WritePage(0, page.data());
+  }
+  // a plain database is not taken for a compressed one, nor the other way
+  EXPECT_THROW(CompressedDiskManager("test.db"), Exception);
+  CleanUp();
+  {
+    CompressedDiskManager disk_manager("test.db");
+    disk_manager.WritePage(0, page.data());
+  }
+  EXPECT_THROW(DiskManager("test.db"), Exception);
+
+  // the pages can not be found without their map
+  remove("test.pim");
+  EXPECT_THROW(CompressedDiskManager("test.db"), Exception);
+
+  CleanUp();
+}
+
+TEST(CompressedDiskManagerTest, CorruptPageTest) {
+  std::vector<char> page(PAGE_SIZE, 0);
+  {
+    CompressedDiskManager disk_manager("test.db");
+    strcpy(page.data(), "A test string.");
+    disk_manager.WritePage(0, page.data());
+  }
+  // the first byte of page 0 is a token, garble the literals after it
+  FILE *file = fopen("test.db", "r+b");
+  ASSERT_NE(nullptr, file);
+  fseek(file, DB_FILE_HEADER_SIZE + 3, SEEK_SET);
+  fputc('!', file);
+  fclose(file);
+
+  CompressedDiskManager disk_manager("test.db");
+  EXPECT_THROW(disk_manager.ReadPage(0, page.data()), PageCorruptionException);
+  DiskRequest request(false, 0, page.data());
+  disk_manager.SubmitRequests(&request, 1);
+  EXPECT_THROW(disk_manager.WaitRequest(request), PageCorruptionException);
+
+  CleanUp();
+}
+
+TEST(CompressedDiskManagerTest, TableHeapTest) {
+  Schema *schema =
+      ParseCreateStatement("a varchar, b smallint, c bigint, d bool");
+  Tuple tuple = ConstructTuple(schema);
+  Transaction *transaction = new Transaction(0);
+  CompressedDiskManager *disk_manager =
+      new CompressedDiskManager("test.db", 4096);
+  BufferPoolManager *buffer_pool_manager =
+      new BufferPoolManager(50, disk_manager);
+  LockManager *lock_manager = new LockManager(true);
+  LogManager *log_manager = new LogManager(disk_manager);
+  TableHeap *table = new TableHeap(buffer_pool_manager, lock_manager,
+                                   log_manager, transaction);
+
+  RID rid;
+  for (int i = 0; i < 5000; ++i)
+    ASSERT_TRUE(table->InsertTuple(tuple, rid, transaction));
+  buffer_pool_manager->FlushAllPages();
+  std::cout << "table heap: " << disk_manager->GetStoredBytes() << " of "
+            << disk_manager->GetLogicalBytes() << " bytes" << std::endl;
+  EXPECT_LT(disk_manager->GetStoredBytes(), disk_manager->GetLogicalBytes());
+
+  int count = 0;
+  for (auto itr = table->begin(transaction); itr != table->end(); ++itr)
+    count++;
+  EXPECT_EQ(5000, count);
+
+  delete table;
+  delete buffer_pool_manager;
+  delete log_manager;
+  delete lock_manager;
+  delete disk_manager;
+  delete transaction;
+  delete schema;
+  CleanUp();
+}
+
+} // namespace cmudb
@@ -0,0 +1,402 @@
+/**
+ * disk_manager_test.cpp
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "common/exception.h"
+#include "disk/disk_manager.h"
+#include "gtest/gtest.h"
+
+namespace cmudb {
+
+TEST(DiskManagerTest, ReadWriteTest) {
+  char buf[PAGE_SIZE] = {0};
+  char data[PAGE_SIZE] = {0};
+  strcpy(data, "A test string.");
+
+  {
+    DiskManager disk_manager("test.db");
+    // nothing written yet, the page reads back zeroed
+    memset(buf, 'x', PAGE_SIZE);
+    disk_manager.ReadPage(3, buf);
+    for (int i = 0; i < PAGE_SIZE; i++)
+      ASSERT_EQ(0, buf[i]);
+
+    disk_manager.WritePage(0, data);
+    disk_manager.ReadPage(0, buf);
+    EXPECT_EQ(0, memcmp(buf, data, PAGE_DATA_SIZE));
+
+    // pages in the hole below a written page read back zeroed too
+    disk_manager.WritePage(5, data);
+    memset(buf, 'x', PAGE_SIZE);
+    disk_manager.ReadPage(3, buf);
+    for (int i = 0; i < PAGE_SIZE; i++)
+      ASSERT_EQ(0, buf[i]);
+  }
+
+  // the file size is picked up again when the file is reopened
+  DiskManager disk_manager("test.db");
+  memset(buf, 0, PAGE_SIZE);
+  disk_manager.ReadPage(5, buf);
+  EXPECT_EQ(0, memcmp(buf, data, PAGE_DATA_SIZE));
+
+  remove("test.db");
+  remove("test.log");
+}
+
+TEST(DiskManagerTest, ConcurrentTest) {
+  const int num_threads = 8;
+  const int pages_per_thread = 100;
+
+  DiskManager disk_manager("test.db");
+  std::vector<std::thread> threads;
+  for (int tid = 0; tid < num_threads; tid++) {
+    threads.push_back(std::thread([&disk_manager, tid]() {
+      char data[PAGE_SIZE];
+      char buf[PAGE_SIZE];
+      for (int i = 0; i < pages_per_thread; i++) {
+        page_id_t page_id = i * num_threads + tid;
+        memset(data, 0, PAGE_SIZE);
+        snprintf(data, PAGE_SIZE, "page %d", page_id);
+        disk_manager.WritePage(page_id, data);
+        disk_manager.ReadPage(page_id, buf);
+        EXPECT_EQ(0, memcmp(data, buf, PAGE_DATA_SIZE));
+      }
+    }));
+  }
+  for (auto &thread : threads)
+    thread.join();
+
+  char expected[PAGE_SIZE];
+  char buf[PAGE_SIZE];
+  for (page_id_t page_id = 0; page_id < num_threads * pages_per_thread;
+       page_id++) {
+    memset(expected, 0, PAGE_SIZE);
+    snprintf(expected, PAGE_SIZE, "page %d", page_id);
+    disk_manager.ReadPage(page_id, buf);
+    // expected was never written, it has no checksum trailer
+    EXPECT_EQ(0, memcmp(expected, buf, PAGE_DATA_SIZE));
+  }
+
+  remove("test.db");
+  remove("test.log");
+}
+
+TEST(DiskManagerTest, PageReuseTest) {
+  {
+    DiskManager disk_manager("test.db");
+    for (page_id_t i = 0; i < 10; i++)
+      EXPECT_EQ(i, disk_manager.AllocatePage());
+    disk_manager.DeallocatePage(7);
+    disk_manager.DeallocatePage(3);
+    // twice is harmless, and so are pages never handed out
+    disk_manager.DeallocatePage(3);
+    disk_manager.DeallocatePage(42);
+    EXPECT_EQ(2u, disk_manager.GetFreePageCount());
+
+    // lowest freed page first, then the file grows again
+    EXPECT_EQ(3, disk_manager.AllocatePage());
+    EXPECT_EQ(7, disk_manager.AllocatePage());
+    EXPECT_EQ(10, disk_manager.AllocatePage());
+    EXPECT_EQ(0u, disk_manager.GetFreePageCount());
+
+    disk_manager.DeallocatePage(5);
+    char data[PAGE_SIZE] = {0};
+    disk_manager.WritePage(10, data);
+  }
+
+  // reopened, allocation carries on where it was
+  {
+    DiskManager disk_manager("test.db");
+    EXPECT_EQ(11, disk_manager.GetNextPageId());
+    EXPECT_EQ(1u, disk_manager.GetFreePageCount());
+    EXPECT_EQ(5, disk_manager.AllocatePage());
+    EXPECT_EQ(11, disk_manager.AllocatePage());
+  }
+
+  // the map left behind by a removed db file is not used for a new one
+  remove("test.db");
+  {
+    DiskManager disk_manager("test.db");
+    EXPECT_EQ(0, disk_manager.GetNextPageId());
+    EXPECT_EQ(0, disk_manager.AllocatePage());
+  }
+
+  remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
+}
+
+TEST(DiskManagerTest, ContiguousAllocationTest) {
+  {
+    DiskManager disk_manager("test.db");
+    EXPECT_EQ(0, disk_manager.AllocatePages(8));
+    for (page_id_t i = 2; i < 6; i++)
+      disk_manager.DeallocatePage(i);
+    disk_manager.DeallocatePage(7);
+
+    // too small a hole is skipped, a free run at the end is extended
+    EXPECT_EQ(7, disk_manager.AllocatePages(5));
+    EXPECT_EQ(12, disk_manager.GetNextPageId());
+    EXPECT_EQ(2, disk_manager.AllocatePages(3));
+    EXPECT_EQ(5, disk_manager.AllocatePage());
+    EXPECT_EQ(12, disk_manager.AllocatePage());
+    EXPECT_EQ(0u, disk_manager.GetFreePageCount());
+  }
+
+  // a db file without a map: every page in it is taken to be in use
+  remove("test.fsm");
+  {
+    DiskManager disk_manager("test.db");
+    char data[PAGE_SIZE] = {0};
+    disk_manager.WritePage(4, data);
+  }
+  remove("test.fsm");
+  {
+    DiskManager disk_manager("test.db");
+    EXPECT_EQ(5, disk_manager.GetNextPageId());
+    EXPECT_EQ(5, disk_manager.AllocatePage());
+  }
+
+  remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
+}
+
+TEST(DiskManagerTest, SegmentTest) {
+  {
+    DiskManager disk_manager("test.db");
+    EXPECT_EQ(0, disk_manager.AllocatePage());
+    segment_id_t index = disk_manager.CreateSegment();
+    segment_id_t table = disk_manager.CreateSegment();
+
+    // interleaved growth, each segment's pages stay contiguous
+    for (page_id_t i = 0; i < EXTENT_SIZE; i++) {
+      EXPECT_EQ(1 + i, disk_manager.AllocatePage(index));
+      EXPECT_EQ(1 + EXTENT_SIZE + i, disk_manager.AllocatePage(table));
+    }
+    // a full extent is followed by a new one
+    EXPECT_EQ(1 + 2 * EXTENT_SIZE, disk_manager.AllocatePage(index));
+    EXPECT_EQ(1 + 3 * EXTENT_SIZE, disk_manager.AllocatePage(table));
+    // pages outside of any segment do not break into an extent
+    EXPECT_EQ(1 + 4 * EXTENT_SIZE, disk_manager.AllocatePage());
+    EXPECT_EQ(1 + 4 * EXTENT_SIZE,
+              disk_manager.AllocatePage(INVALID_SEGMENT_ID) - 1);
+
+    // the unused rest of the extent is given back
+    disk_manager.DropSegment(index);
+    EXPECT_EQ(static_cast<size_t>(EXTENT_SIZE - 1),
+              disk_manager.GetFreePageCount());
+    EXPECT_EQ(2 + 2 * EXTENT_SIZE, disk_manager.AllocatePage());
+
+    char data[PAGE_SIZE] = {0};
+    disk_manager.WritePage(0, data);
+  }
+
+  // and so is the rest of every extent when the disk manager closes
+  DiskManager disk_manager("test.db");
+  EXPECT_EQ(static_cast<size_t>(2 * EXTENT_SIZE - 3),
+            disk_manager.GetFreePageCount());
+
+  remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
+}
+
+TEST(DiskManagerTest, WritePagesTest) {
+  const int num_pages = 20;
+  std::vector<std::vector<char>> pages(num_pages, std::vector<char>(PAGE_SIZE));
+  std::vector<std::pair<page_id_t, const char *>> batch;
+  // out of order, with a hole in the middle
+  for (page_id_t page_id = num_pages - 1; page_id >= 0; page_id--) {
+    if (page_id == 7)
+      continue;
+    snprintf(pages[page_id].data(), PAGE_SIZE, "page %d", page_id);
+    batch.emplace_back(page_id, pages[page_id].data());
+  }
+
+  DiskManager disk_manager("test.db");
+  disk_manager.WritePages(batch);
+  EXPECT_EQ(1u, disk_manager.GetNumSyncs());
+  // sorted in place
+  EXPECT_EQ(0, batch.front().first);
+  EXPECT_EQ(num_pages - 1, batch.back().first);
+
+  char buf[PAGE_SIZE];
+  for (page_id_t page_id = 0; page_id < num_pages; page_id++) {
+    disk_manager.ReadPage(page_id, buf);
+    EXPECT_EQ(0, memcmp(pages[page_id].data(), buf, PAGE_DATA_SIZE));
+  }
+
+  // nothing to write, nothing to sync
+  batch.clear();
+  disk_manager.WritePages(batch);
+  EXPECT_EQ(1u, disk_manager.GetNumSyncs());
+
+  remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
+}
+
+TEST(DiskManagerTest, ChecksumTest) {
+  char data[PAGE_SIZE] = {0};
+  char buf[PAGE_SIZE];
+  strcpy(data, "A test string.");
+
+  DiskManager disk_manager("test.db");
+  disk_manager.WritePage(0, data);
+  disk_manager.WritePage(1, data);
+  // the checksum is added on the way out, the page itself is left alone
+  for (int i = PAGE_DATA_SIZE; i < PAGE_SIZE; i++)
+    EXPECT_EQ(0, data[i]);
+  disk_manager.ReadPage(0, buf);
+  EXPECT_EQ(0, memcmp(buf, data, PAGE_DATA_SIZE));
+
+  // flip a byte of page 1 behind the disk manager's back
+  FILE *file = fopen("test.db", "r+b");
+  ASSERT_NE(nullptr, file);
+  fseek(file, DB_FILE_HEADER_SIZE + PAGE_SIZE + 3, SEEK_SET);
+  fputc('!', file);
+  fclose(file);
+  try {
+    disk_manager.ReadPage(1, buf);
+    FAIL() << "corrupted page read without error";
+  } catch (PageCorruptionException &e) {
+    EXPECT_EQ(1, e.GetPageId());
+  }
+  // same through a batch
+  DiskRequest request(false, 1, buf);
+  disk_manager.SubmitRequests(&request, 1);
+  EXPECT_THROW(disk_manager.WaitRequest(request), PageCorruptionException);
+
+  // verification off, the bytes come back as they are
+  disk_manager.SetVerifyChecksums(false);
+  disk_manager.ReadPage(1, buf);
+  EXPECT_EQ('!', buf[3]);
+  disk_manager.SetVerifyChecksums(true);
+
+  // a torn write: only the first half of page 2 made it to disk
+  disk_manager.WritePage(2, data);
+  ASSERT_EQ(0, truncate("test.db",
+                        DB_FILE_HEADER_SIZE + 2 * PAGE_SIZE + PAGE_SIZE / 2));
+  EXPECT_THROW(disk_manager.ReadPage(2, buf), PageCorruptionException);
+  DiskRequest torn_request(false, 2, buf);
+  disk_manager.SubmitRequests(&torn_request, 1);
+  EXPECT_THROW(disk_manager.WaitRequest(torn_request), Exception);
+
+  remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
+}
+
+TEST(DiskManagerTest, PageSizeTest) {
+  const size_t page_size = 8192;
+  std::vector<char> data(page_size, 0);
+  std::vector<char> buf(page_size);
+  {
+    DiskManager disk_manager("test.db", page_size);
+    EXPECT_EQ(page_size, disk_manager.GetPageSize());
+    EXPECT_EQ(page_size - PAGE_CHECKSUM_SIZE, disk_manager.GetPageDataSize());
+    for (page_id_t page_id = 0; page_id < 3; page_id++) {
+      EXPECT_EQ(page_id, disk_manager.AllocatePage());
+      snprintf(data.data(), page_size, "page %d", page_id);
+      // the end of the page, past any PAGE_SIZE boundary
+      data[page_size - PAGE_CHECKSUM_SIZE - 1] = static_cast<char>(page_id);
+      disk_manager.WritePage(page_id, data.data());
+    }
+  }
+  struct stat stat_buf;
+  ASSERT_EQ(0, stat("test.db", &stat_buf));
+  EXPECT_EQ(static_cast<off_t>(DB_FILE_HEADER_SIZE + 3 * page_size),
+            stat_buf.st_size);
+
+  // reopened with a different page size asked for, the stored one is used
+  {
+    DiskManager disk_manager("test.db", 2 * page_size);
+    EXPECT_EQ(page_size, disk_manager.GetPageSize());
+    EXPECT_EQ(3, disk_manager.GetNextPageId());
+    disk_manager.ReadPage(2, buf.data());
+    EXPECT_EQ(0, strcmp("page 2", buf.data()));
+    EXPECT_EQ(2, buf[page_size - PAGE_CHECKSUM_SIZE - 1]);
+  }
+
+  // only 4K, 8K, 16K and 32K pages
+  remove("test.db");
+  EXPECT_THROW(DiskManager("test.db", 1024), Exception);
+  EXPECT_THROW(DiskManager("test.db", 6144), Exception);
+  EXPECT_THROW(DiskManager("test.db", 2 * MAX_PAGE_SIZE), Exception);
+  {
+    DiskManager disk_manager("test.db", MAX_PAGE_SIZE);
+    EXPECT_EQ(static_cast<size_t>(MAX_PAGE_SIZE), disk_manager.GetPageSize());
+  }
+
+  // a file that is not a database is not taken for one
+  remove("test.db");
+  FILE *file = fopen("test.db", "wb");
+  ASSERT_NE(nullptr, file);
+  fputs("not a database", file);
+  fclose(file);
+  EXPECT_THROW(DiskManager("test.db"), Exception);
+  // nor without a name the log and free space map can be derived from
+  EXPECT_THROW(DiskManager("test"), Exception);
+
+  remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
+}
+
+TEST(DiskManagerTest, StatsTest) {
+  std::vector<char> data(PAGE_SIZE, 0);
+  std::vector<std::vector<char>> pages(4, std::vector<char>(PAGE_SIZE, 0));
+  {
+    DiskManager disk_manager("test.db");
+    DiskStats stats = disk_manager.GetStats();
+    EXPECT_EQ(0u, stats.page_reads.count);
+    EXPECT_EQ(0u, stats.syncs.count);
+
+    for (page_id_t page_id = 0; page_id < 3; page_id++)
+      disk_manager.WritePage(page_id, data.data());
+    // past the end of the file, no I/O
+    disk_manager.ReadPage(10, data.data());
+    disk_manager.ReadPage(1, data.data());
+    // one run of adjacent pages, one pwritev and one sync
+    std::vector<std::pair<page_id_t, const char *>> batch;
+    for (page_id_t page_id = 0; page_id < 4; page_id++)
+      batch.emplace_back(page_id + 3, pages[page_id].data());
+    disk_manager.WritePages(batch);
+    char log[100] = "log record";
+    disk_manager.WriteLog(log, sizeof(log));
+
+    stats = disk_manager.GetStats();
+    EXPECT_EQ(1u, stats.page_reads.count);
+    EXPECT_EQ(static_cast<uint64_t>(PAGE_SIZE), stats.page_reads.bytes);
+    EXPECT_EQ(4u, stats.page_writes.count);
+    EXPECT_EQ(static_cast<uint64_t>(7 * PAGE_SIZE), stats.page_writes.bytes);
+    EXPECT_EQ(1u, stats.log_writes.count);
+    EXPECT_EQ(sizeof(log), stats.log_writes.bytes);
+    EXPECT_EQ(1u, stats.syncs.count);
+    EXPECT_EQ(0u, stats.syncs.bytes);
+    EXPECT_GT(stats.syncs.total_ns, 0u);
+    EXPECT_LE(stats.page_writes.p50_ns, stats.page_writes.p99_ns);
+    EXPECT_LE(stats.page_writes.p99_ns, stats.page_writes.max_ns);
+    EXPECT_LE(stats.page_writes.max_ns, stats.page_writes.total_ns);
+
+    disk_manager.ResetStats();
+    stats = disk_manager.GetStats();
+    EXPECT_EQ(0u, stats.page_writes.count);
+    EXPECT_EQ(0u, stats.page_writes.bytes);
+    EXPECT_EQ(0u, stats.page_writes.max_ns);
+  }
+
+  remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
+}
+
+} // namespace cmudb
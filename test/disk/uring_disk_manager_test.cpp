@@ -0,0 +1,287 @@
+/**
+ * uring_disk_manager_test.cpp
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <signal.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "buffer/buffer_pool_manager.h"
+#include "common/exception.h"
+#include "disk/uring_disk_manager.h"
+#include "gtest/gtest.h"
+
+namespace cmudb {
+
+// the tests pass on the pread/pwrite fallback too, if io_uring is missing
+TEST(UringDiskManagerTest, ReadWriteTest) {
+  char buf[PAGE_SIZE] = {0};
+  char data[PAGE_SIZE] = {0};
+
+  UringDiskManager *disk_manager = new UringDiskManager("test.db");
+  std::cout << "io_uring " << (disk_manager->IsUringEnabled() ? "on" : "off")
+            << ", O_DIRECT " << (disk_manager->IsDirectIO() ? "on" : "off")
+            << std::endl;
+  strcpy(data, "A test string.");
+
+  // read beyond the end of the file gives a zeroed page
+  memset(buf, 'x', PAGE_SIZE);
+  disk_manager->ReadPage(0, buf);
+  for (int i = 0; i < PAGE_SIZE; i++)
+    ASSERT_EQ(0, buf[i]);
+
+  disk_manager->WritePage(0, data);
+  disk_manager->ReadPage(0, buf);
+  EXPECT_EQ(0, memcmp(buf, data, PAGE_DATA_SIZE));
+
+  memset(buf, 0, PAGE_SIZE);
+  disk_manager->WritePage(5, data);
+  disk_manager->ReadPage(5, buf);
+  EXPECT_EQ(0, memcmp(buf, data, PAGE_DATA_SIZE));
+  delete disk_manager;
+
+  // what was written is there for a plain DiskManager too
+  DiskManager pread_disk_manager("test.db");
+  memset(buf, 0, PAGE_SIZE);
+  pread_disk_manager.ReadPage(5, buf);
+  EXPECT_EQ(0, memcmp(buf, data, PAGE_DATA_SIZE));
+
+  remove("test.db");
+  remove("test.log");
+}
+
+TEST(UringDiskManagerTest, BatchTest) {
+  const int num_pages = 100;
+  // fewer ring slots than requests, submission has to wait for slots
+  UringDiskManager disk_manager("test.db", 8);
+
+  std::vector<std::vector<char>> pages(num_pages, std::vector<char>(PAGE_SIZE));
+  std::vector<DiskRequest> requests;
+  for (int i = 0; i < num_pages; i++) {
+    snprintf(pages[i].data(), PAGE_SIZE, "page %d", i);
+    requests.emplace_back(true, i, pages[i].data());
+  }
+  disk_manager.SubmitRequests(requests.data(), requests.size());
+  for (auto &request : requests)
+    disk_manager.WaitRequest(request);
+
+  std::vector<std::vector<char>> read(num_pages, std::vector<char>(PAGE_SIZE));
+  requests.clear();
+  // reversed, completions may come back in any order
+  for (int i = num_pages - 1; i >= 0; i--)
+    requests.emplace_back(false, i, read[i].data());
+  disk_manager.SubmitRequests(requests.data(), requests.size());
+  for (auto &request : requests) {
+    disk_manager.WaitRequest(request);
+    EXPECT_EQ(true, request.done);
+  }
+  for (int i = 0; i < num_pages; i++)
+    EXPECT_EQ(0, memcmp(pages[i].data(), read[i].data(), PAGE_DATA_SIZE));
+
+  remove("test.db");
+  remove("test.log");
+}
+
+TEST(UringDiskManagerTest, WritePagesTest) {
+  const int num_pages = 40;
+  UringDiskManager disk_manager("test.db", 8);
+
+  std::vector<std::vector<char>> pages(num_pages, std::vector<char>(PAGE_SIZE));
+  std::vector<std::pair<page_id_t, const char *>> batch;
+  // two runs, handed over out of order
+  for (int i = num_pages - 1; i >= 0; i--) {
+    page_id_t page_id = i < num_pages / 2 ? i : i + 10;
+    snprintf(pages[i].data(), PAGE_SIZE, "page %d", page_id);
+    batch.emplace_back(page_id, pages[i].data());
+  }
+  disk_manager.WritePages(batch);
+  EXPECT_EQ(1u, disk_manager.GetNumSyncs());
+
+  char buf[PAGE_SIZE];
+  for (int i = 0; i < num_pages; i++) {
+    disk_manager.ReadPage(i < num_pages / 2 ? i : i + 10, buf);
+    EXPECT_EQ(0, memcmp(pages[i].data(), buf, PAGE_DATA_SIZE));
+  }
+
+  remove("test.db");
+  remove("test.log");
+}
+
+TEST(UringDiskManagerTest, ConcurrentTest) {
+  const int num_threads = 4;
+  const int pages_per_thread = 50;
+
+  UringDiskManager disk_manager("test.db", 4);
+  std::vector<std::thread> threads;
+  for (int tid = 0; tid < num_threads; tid++) {
+    threads.push_back(std::thread([&disk_manager, tid]() {
+      char data[PAGE_SIZE];
+      char buf[PAGE_SIZE];
+      for (int i = 0; i < pages_per_thread; i++) {
+        page_id_t page_id = i * num_threads + tid;
+        memset(data, 0, PAGE_SIZE);
+        snprintf(data, PAGE_SIZE, "page %d", page_id);
+        disk_manager.WritePage(page_id, data);
+        disk_manager.ReadPage(page_id, buf);
+        EXPECT_EQ(0, memcmp(data, buf, PAGE_DATA_SIZE));
+      }
+    }));
+  }
+  for (auto &thread : threads)
+    thread.join();
+
+  remove("test.db");
+  remove("test.log");
+}
+
+// a write cut short by the file size limit fails instead of passing
+TEST(UringDiskManagerTest, ShortWriteTest) {
+  char data[PAGE_SIZE] = {0};
+  UringDiskManager disk_manager("test.db");
+  disk_manager.WritePage(0, data);
+
+  if (disk_manager.IsUringEnabled()) {
+    struct rlimit old_limit;
+    getrlimit(RLIMIT_FSIZE, &old_limit);
+    struct rlimit limit = old_limit;
+    limit.rlim_cur = DB_FILE_HEADER_SIZE + PAGE_SIZE + PAGE_SIZE / 2;
+    signal(SIGXFSZ, SIG_IGN);
+    setrlimit(RLIMIT_FSIZE, &limit);
+    EXPECT_THROW(disk_manager.WritePage(1, data), Exception);
+    setrlimit(RLIMIT_FSIZE, &old_limit);
+    signal(SIGXFSZ, SIG_DFL);
+    // the page can be written again once there is room
+    disk_manager.WritePage(1, data);
+  }
+
+  remove("test.db");
+  remove("test.log");
+}
+
+// a page the file ends inside of is a torn write and fails, a page past
+// the end was never written and reads back as zeros
+TEST(UringDiskManagerTest, TornPageTest) {
+  char data[PAGE_SIZE] = {0};
+  char buf[PAGE_SIZE];
+  strcpy(data, "A test string.");
+
+  UringDiskManager disk_manager("test.db");
+  disk_manager.WritePage(0, data);
+  disk_manager.WritePage(1, data);
+  ASSERT_EQ(0, truncate("test.db",
+                        DB_FILE_HEADER_SIZE + PAGE_SIZE + PAGE_SIZE / 2));
+  EXPECT_THROW(disk_manager.ReadPage(1, buf), Exception);
+  memset(buf, 'x', PAGE_SIZE);
+  disk_manager.ReadPage(2, buf);
+  for (int i = 0; i < PAGE_SIZE; i++)
+    ASSERT_EQ(0, buf[i]);
+
+  remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
+}
+
+TEST(UringDiskManagerTest, BufferPoolTest) {
+  page_id_t page_id;
+
+  UringDiskManager *disk_manager = new UringDiskManager("test.db");
+  {
+    BufferPoolManager bpm(4, disk_manager);
+    for (int i = 0; i < 12; i++) {
+      Page *page = bpm.NewPage(page_id);
+      ASSERT_NE(nullptr, page);
+      snprintf(page->GetData(), PAGE_SIZE, "page %d", page_id);
+      bpm.UnpinPage(page_id, true);
+    }
+    // prefetched reads go through one batch
+    bpm.PrefetchRange(0, 4);
+    for (int i = 0; i < 12; i++) {
+      char expected[PAGE_SIZE];
+      snprintf(expected, PAGE_SIZE, "page %d", i);
+      Page *page = bpm.FetchPage(i);
+      ASSERT_NE(nullptr, page);
+      EXPECT_EQ(0, strcmp(expected, page->GetData()));
+      bpm.UnpinPage(i, false);
+    }
+  }
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+}
+
+/*
+ * Random page read IOPS of the pread disk manager against io_uring, one
+ * synchronous read at a time and in batches of 32. Not run by default:
+ * ./uring_disk_manager_test --gtest_also_run_disabled_tests
+ */
+TEST(UringDiskManagerTest, DISABLED_RandomReadBenchmark) {
+  const int num_pages = 16384;
+  const int num_reads = 100000;
+  const int batch_size = 32;
+
+  {
+    DiskManager disk_manager("test.db");
+    char data[PAGE_SIZE] = {0};
+    for (int i = 0; i < num_pages; i++)
+      disk_manager.WritePage(i, data);
+  }
+
+  auto report = [](const char *name, double seconds) {
+    std::cout << name << " : "
+              << static_cast<uint64_t>(num_reads / seconds) << " reads per sec"
+              << std::endl;
+  };
+  std::vector<char> buffers(batch_size * PAGE_SIZE + DIRECT_IO_ALIGNMENT);
+  char *aligned = buffers.data() +
+                  (DIRECT_IO_ALIGNMENT -
+                   reinterpret_cast<uintptr_t>(buffers.data()) %
+                       DIRECT_IO_ALIGNMENT);
+
+  std::unique_ptr<DiskManager> pread_disk_manager(new DiskManager("test.db"));
+  std::unique_ptr<DiskManager> uring_disk_manager(
+      new UringDiskManager("test.db"));
+  for (auto *disk_manager :
+       {pread_disk_manager.get(), uring_disk_manager.get()}) {
+    const char *name =
+        disk_manager == pread_disk_manager.get() ? "pread" : "io_uring";
+    uint64_t seed = 1;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < num_reads; i++) {
+      seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+      disk_manager->ReadPage((seed >> 33) % num_pages, aligned);
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    report(name, elapsed.count());
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < num_reads; i += batch_size) {
+      std::vector<DiskRequest> requests;
+      for (int j = 0; j < batch_size; j++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        requests.emplace_back(false, (seed >> 33) % num_pages,
+                              aligned + j * PAGE_SIZE);
+      }
+      disk_manager->SubmitRequests(requests.data(), requests.size());
+      for (auto &request : requests)
+        disk_manager->WaitRequest(request);
+    }
+    elapsed = std::chrono::steady_clock::now() - start;
+    report(disk_manager == pread_disk_manager.get() ? "pread batch of 32"
+                                                    : "io_uring batch of 32",
+           elapsed.count());
+  }
+
+  remove("test.db");
+  remove("test.log");
+}
+
+} // namespace cmudb
@@ -0,0 +1,96 @@
+/**
+ * lock_free_hash_table_test.cpp
+ */
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "hash/lock_free_hash_table.h"
+#include "gtest/gtest.h"
+
+namespace cmudb {
+
+TEST(LockFreeHashTableTest, SampleTest) {
+  LockFreeHashTable<int> test(10);
+  EXPECT_EQ(32, test.GetCapacity());
+
+  // insert several key/value pairs
+  for (int i = 0; i < 10; i++)
+    test.Insert(i * 32, i); // same home slot, one probe chain
+
+  // find test
+  int result;
+  for (int i = 0; i < 10; i++) {
+    EXPECT_EQ(true, test.Find(i * 32, result));
+    EXPECT_EQ(i, result);
+  }
+  EXPECT_EQ(false, test.Find(10, result));
+
+  // overwrite
+  test.Insert(64, 7);
+  EXPECT_EQ(true, test.Find(64, result));
+  EXPECT_EQ(7, result);
+
+  // delete test, keys further down the chain stay reachable
+  EXPECT_EQ(true, test.Remove(0));
+  EXPECT_EQ(true, test.Remove(96));
+  EXPECT_EQ(false, test.Remove(96));
+  EXPECT_EQ(false, test.Find(0, result));
+  EXPECT_EQ(true, test.Find(288, result));
+  EXPECT_EQ(9, result);
+
+  // tombstones are reused
+  test.Insert(1000, 3);
+  EXPECT_EQ(true, test.Find(1000, result));
+  EXPECT_EQ(3, result);
+
+  // remove everything, then churn far more keys than the capacity
+  for (int i = 1; i < 10; i++)
+    test.Remove(i * 32);
+  test.Remove(1000);
+  for (int i = 0; i < 1000; i++) {
+    test.Insert(i, i % 10);
+    if (i >= 10) {
+      EXPECT_EQ(true, test.Remove(i - 10));
+    }
+  }
+  for (int i = 990; i < 1000; i++) {
+    EXPECT_EQ(true, test.Find(i, result));
+    EXPECT_EQ(i % 10, result);
+  }
+}
+
+// readers never block and never miss a key that stays in the table while a
+// writer churns other keys
+TEST(LockFreeHashTableTest, ConcurrentReadTest) {
+  LockFreeHashTable<int> test(64);
+  for (int i = 0; i < 32; i++)
+    test.Insert(i, i);
+
+  std::atomic<bool> done(false);
+  std::vector<std::thread> readers;
+  for (int tid = 0; tid < 4; tid++) {
+    readers.push_back(std::thread([&test, &done]() {
+      int result;
+      while (!done) {
+        for (int i = 0; i < 32; i++) {
+          EXPECT_EQ(true, test.Find(i, result));
+          EXPECT_EQ(i, result);
+        }
+      }
+    }));
+  }
+
+  for (int round = 0; round < 2000; round++) {
+    for (int i = 32; i < 64; i++)
+      test.Insert(i + round * 64, i);
+    for (int i = 32; i < 64; i++)
+      test.Remove(i + round * 64);
+  }
+  done = true;
+  for (auto &reader : readers)
+    reader.join();
+}
+
+} // namespace cmudb
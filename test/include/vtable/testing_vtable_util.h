@@ -7,6 +7,7 @@
 #include <cstdio>
 #include <iostream>
 #include <string>
+#include <vector>
 
 #include "sqlite/sqlite3.h"
 #include "gtest/gtest.h"
@@ -38,4 +39,26 @@ bool ExecSQL(sqlite3 *db, std::string sql) {
   return true;
 }
 
+// For collecting result rows, each column as text
+int QueryCallback(void *data, int argc, char **argv, char **azColName) {
+  auto *rows = reinterpret_cast<std::vector<std::vector<std::string>> *>(data);
+  rows->emplace_back();
+  for (int i = 0; i < argc; i++)
+    rows->back().push_back(argv[i] ? argv[i] : "NULL");
+  return 0;
+}
+
+bool QuerySQL(sqlite3 *db, std::string sql,
+              std::vector<std::vector<std::string>> &rows) {
+  char *zErrMsg = 0;
+  rows.clear();
+  int rc = sqlite3_exec(db, sql.c_str(), QueryCallback, &rows, &zErrMsg);
+  if (rc != SQLITE_OK) {
+    std::cerr << "SQL error: " + std::string(zErrMsg) << std::endl;
+    sqlite3_free(zErrMsg);
+    return false;
+  }
+  return true;
+}
+
 } // namespace cmudb
\ No newline at end of file
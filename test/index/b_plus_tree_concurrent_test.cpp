@@ -100,6 +100,20 @@ void DeleteHelperSplit(
   delete transaction;
 }
 
+// helper function to look up keys that are never removed
+void LookupHelper(BPlusTree<GenericKey<8>, RID, GenericComparator<8>> &tree,
+                  const std::vector<int64_t> &keys,
+                  __attribute__((unused)) uint64_t thread_itr = 0) {
+  GenericKey<8> index_key;
+  std::vector<RID> rids;
+  for (auto key : keys) {
+    rids.clear();
+    index_key.SetFromInteger(key);
+    tree.GetValue(index_key, rids);
+    EXPECT_EQ(rids.size(), 1);
+  }
+}
+
 TEST(BPlusTreeConcurrentTest, InsertTest1) {
   // create KeyComparator and index schema
   Schema *key_schema = ParseCreateStatement("a bigint");
@@ -108,49 +122,51 @@ TEST(BPlusTreeConcurrentTest, InsertTest1) {
   DiskManager *disk_manager = new DiskManager("test.db");
   BufferPoolManager *bpm = new BufferPoolManager(50, disk_manager);
   // create b+ tree
-  BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm,
-                                                           comparator);
-  // create and fetch header_page
-  page_id_t page_id;
-  auto header_page = bpm->NewPage(page_id);
-  (void)header_page;
-  // keys to Insert
-  std::vector<int64_t> keys;
-  int64_t scale_factor = 100;
-  for (int64_t key = 1; key < scale_factor; key++) {
-    keys.push_back(key);
-  }
-  LaunchParallelTest(2, InsertHelper, std::ref(tree), keys);
+  {
+    BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm,
+                                                             comparator);
+    // create and fetch header_page
+    page_id_t page_id;
+    auto header_page = bpm->NewPage(page_id);
+    (void)header_page;
+    // keys to Insert
+    std::vector<int64_t> keys;
+    int64_t scale_factor = 100;
+    for (int64_t key = 1; key < scale_factor; key++) {
+      keys.push_back(key);
+    }
+    LaunchParallelTest(2, InsertHelper, std::ref(tree), keys);
 
-  std::vector<RID> rids;
-  GenericKey<8> index_key;
-  for (auto key : keys) {
-    rids.clear();
-    index_key.SetFromInteger(key);
-    tree.GetValue(index_key, rids);
-    EXPECT_EQ(rids.size(), 1);
+    std::vector<RID> rids;
+    GenericKey<8> index_key;
+    for (auto key : keys) {
+      rids.clear();
+      index_key.SetFromInteger(key);
+      tree.GetValue(index_key, rids);
+      EXPECT_EQ(rids.size(), 1);
 
-    int64_t value = key & 0xFFFFFFFF;
-    EXPECT_EQ(rids[0].GetSlotNum(), value);
-  }
+      int64_t value = key & 0xFFFFFFFF;
+      EXPECT_EQ(rids[0].GetSlotNum(), value);
+    }
 
-  int64_t start_key = 1;
-  int64_t current_key = start_key;
-  index_key.SetFromInteger(start_key);
-  for (auto iterator = tree.Begin(index_key); iterator.isEnd() == false;
-       ++iterator) {
-    auto location = (*iterator).second;
-    EXPECT_EQ(location.GetPageId(), 0);
-    EXPECT_EQ(location.GetSlotNum(), current_key);
-    current_key = current_key + 1;
-  }
+    int64_t start_key = 1;
+    int64_t current_key = start_key;
+    index_key.SetFromInteger(start_key);
+    for (auto iterator = tree.Begin(index_key); iterator.isEnd() == false;
+         ++iterator) {
+      auto location = (*iterator).second;
+      EXPECT_EQ(location.GetPageId(), 0);
+      EXPECT_EQ(location.GetSlotNum(), current_key);
+      current_key = current_key + 1;
+    }
 
-  EXPECT_EQ(current_key, keys.size() + 1);
+    EXPECT_EQ(current_key, keys.size() + 1);
 
-  bpm->UnpinPage(HEADER_PAGE_ID, true);
+    bpm->UnpinPage(HEADER_PAGE_ID, true);
 
-  delete disk_manager;
+  }
   delete bpm;
+  delete disk_manager;
   remove("test.db");
   remove("test.log");
 }
@@ -162,49 +178,51 @@ TEST(BPlusTreeConcurrentTest, InsertTest2) {
   DiskManager *disk_manager = new DiskManager("test.db");
   BufferPoolManager *bpm = new BufferPoolManager(50, disk_manager);
   // create b+ tree
-  BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm,
-                                                           comparator);
-  // create and fetch header_page
-  page_id_t page_id;
-  auto header_page = bpm->NewPage(page_id);
-  (void)header_page;
-  // keys to Insert
-  std::vector<int64_t> keys;
-  int64_t scale_factor = 100;
-  for (int64_t key = 1; key < scale_factor; key++) {
-    keys.push_back(key);
-  }
-  LaunchParallelTest(2, InsertHelperSplit, std::ref(tree), keys, 2);
+  {
+    BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm,
+                                                             comparator);
+    // create and fetch header_page
+    page_id_t page_id;
+    auto header_page = bpm->NewPage(page_id);
+    (void)header_page;
+    // keys to Insert
+    std::vector<int64_t> keys;
+    int64_t scale_factor = 100;
+    for (int64_t key = 1; key < scale_factor; key++) {
+      keys.push_back(key);
+    }
+    LaunchParallelTest(2, InsertHelperSplit, std::ref(tree), keys, 2);
 
-  std::vector<RID> rids;
-  GenericKey<8> index_key;
-  for (auto key : keys) {
-    rids.clear();
-    index_key.SetFromInteger(key);
-    tree.GetValue(index_key, rids);
-    EXPECT_EQ(rids.size(), 1);
+    std::vector<RID> rids;
+    GenericKey<8> index_key;
+    for (auto key : keys) {
+      rids.clear();
+      index_key.SetFromInteger(key);
+      tree.GetValue(index_key, rids);
+      EXPECT_EQ(rids.size(), 1);
 
-    int64_t value = key & 0xFFFFFFFF;
-    EXPECT_EQ(rids[0].GetSlotNum(), value);
-  }
+      int64_t value = key & 0xFFFFFFFF;
+      EXPECT_EQ(rids[0].GetSlotNum(), value);
+    }
 
-  int64_t start_key = 1;
-  int64_t current_key = start_key;
-  index_key.SetFromInteger(start_key);
-  for (auto iterator = tree.Begin(index_key); iterator.isEnd() == false;
-       ++iterator) {
-    auto location = (*iterator).second;
-    EXPECT_EQ(location.GetPageId(), 0);
-    EXPECT_EQ(location.GetSlotNum(), current_key);
-    current_key = current_key + 1;
-  }
+    int64_t start_key = 1;
+    int64_t current_key = start_key;
+    index_key.SetFromInteger(start_key);
+    for (auto iterator = tree.Begin(index_key); iterator.isEnd() == false;
+         ++iterator) {
+      auto location = (*iterator).second;
+      EXPECT_EQ(location.GetPageId(), 0);
+      EXPECT_EQ(location.GetSlotNum(), current_key);
+      current_key = current_key + 1;
+    }
 
-  EXPECT_EQ(current_key, keys.size() + 1);
+    EXPECT_EQ(current_key, keys.size() + 1);
 
-  bpm->UnpinPage(HEADER_PAGE_ID, true);
+    bpm->UnpinPage(HEADER_PAGE_ID, true);
 
-  delete disk_manager;
+  }
   delete bpm;
+  delete disk_manager;
   remove("test.db");
   remove("test.log");
 }
@@ -217,40 +235,42 @@ TEST(BPlusTreeConcurrentTest, DeleteTest1) {
   DiskManager *disk_manager = new DiskManager("test.db");
   BufferPoolManager *bpm = new BufferPoolManager(50, disk_manager);
   // create b+ tree
-  BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm,
-                                                           comparator);
-  GenericKey<8> index_key;
-  RID rid;
-  // create and fetch header_page
-  page_id_t page_id;
-  auto header_page = bpm->NewPage(page_id);
-  (void)header_page;
-  // sequential insert
-  std::vector<int64_t> keys = {1, 2, 3, 4, 5};
-  InsertHelper(tree, keys);
-
-  std::vector<int64_t> remove_keys = {1, 5, 3, 4};
-  LaunchParallelTest(2, DeleteHelper, std::ref(tree), remove_keys);
-
-  int64_t start_key = 2;
-  int64_t current_key = start_key;
-  int64_t size = 0;
-  index_key.SetFromInteger(start_key);
-  for (auto iterator = tree.Begin(index_key); iterator.isEnd() == false;
-       ++iterator) {
-    auto location = (*iterator).second;
-    EXPECT_EQ(location.GetPageId(), 0);
-    EXPECT_EQ(location.GetSlotNum(), current_key);
-    current_key = current_key + 1;
-    size = size + 1;
-  }
+  {
+    BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm,
+                                                             comparator);
+    GenericKey<8> index_key;
+    RID rid;
+    // create and fetch header_page
+    page_id_t page_id;
+    auto header_page = bpm->NewPage(page_id);
+    (void)header_page;
+    // sequential insert
+    std::vector<int64_t> keys = {1, 2, 3, 4, 5};
+    InsertHelper(tree, keys);
+
+    std::vector<int64_t> remove_keys = {1, 5, 3, 4};
+    LaunchParallelTest(2, DeleteHelper, std::ref(tree), remove_keys);
+
+    int64_t start_key = 2;
+    int64_t current_key = start_key;
+    int64_t size = 0;
+    index_key.SetFromInteger(start_key);
+    for (auto iterator = tree.Begin(index_key); iterator.isEnd() == false;
+         ++iterator) {
+      auto location = (*iterator).second;
+      EXPECT_EQ(location.GetPageId(), 0);
+      EXPECT_EQ(location.GetSlotNum(), current_key);
+      current_key = current_key + 1;
+      size = size + 1;
+    }
 
-  EXPECT_EQ(size, 1);
+    EXPECT_EQ(size, 1);
 
-  bpm->UnpinPage(HEADER_PAGE_ID, true);
+    bpm->UnpinPage(HEADER_PAGE_ID, true);
 
-  delete disk_manager;
+  }
   delete bpm;
+  delete disk_manager;
   remove("test.db");
   remove("test.log");
 }
@@ -263,40 +283,42 @@ TEST(BPlusTreeConcurrentTest, DeleteTest2) {
   DiskManager *disk_manager = new DiskManager("test.db");
   BufferPoolManager *bpm = new BufferPoolManager(50, disk_manager);
   // create b+ tree
-  BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm,
-                                                           comparator);
-  GenericKey<8> index_key;
-  RID rid;
-  // create and fetch header_page
-  page_id_t page_id;
-  auto header_page = bpm->NewPage(page_id);
-  (void)header_page;
-
-  // sequential insert
-  std::vector<int64_t> keys = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
-  InsertHelper(tree, keys);
-
-  std::vector<int64_t> remove_keys = {1, 4, 3, 2, 5, 6};
-  LaunchParallelTest(2, DeleteHelperSplit, std::ref(tree), remove_keys, 2);
-
-  int64_t start_key = 7;
-  int64_t current_key = start_key;
-  int64_t size = 0;
-  index_key.SetFromInteger(start_key);
-  for (auto iterator = tree.Begin(index_key); iterator.isEnd() == false;
-       ++iterator) {
-    auto location = (*iterator).second;
-    EXPECT_EQ(location.GetPageId(), 0);
-    EXPECT_EQ(location.GetSlotNum(), current_key);
-    current_key = current_key + 1;
-    size = size + 1;
-  }
+  {
+    BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm,
+                                                             comparator);
+    GenericKey<8> index_key;
+    RID rid;
+    // create and fetch header_page
+    page_id_t page_id;
+    auto header_page = bpm->NewPage(page_id);
+    (void)header_page;
+
+    // sequential insert
+    std::vector<int64_t> keys = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    InsertHelper(tree, keys);
+
+    std::vector<int64_t> remove_keys = {1, 4, 3, 2, 5, 6};
+    LaunchParallelTest(2, DeleteHelperSplit, std::ref(tree), remove_keys, 2);
+
+    int64_t start_key = 7;
+    int64_t current_key = start_key;
+    int64_t size = 0;
+    index_key.SetFromInteger(start_key);
+    for (auto iterator = tree.Begin(index_key); iterator.isEnd() == false;
+         ++iterator) {
+      auto location = (*iterator).second;
+      EXPECT_EQ(location.GetPageId(), 0);
+      EXPECT_EQ(location.GetSlotNum(), current_key);
+      current_key = current_key + 1;
+      size = size + 1;
+    }
 
-  EXPECT_EQ(size, 4);
+    EXPECT_EQ(size, 4);
 
-  bpm->UnpinPage(HEADER_PAGE_ID, true);
-  delete disk_manager;
+    bpm->UnpinPage(HEADER_PAGE_ID, true);
+  }
   delete bpm;
+  delete disk_manager;
   remove("test.db");
   remove("test.log");
 }
@@ -309,41 +331,108 @@ TEST(BPlusTreeConcurrentTest, MixTest) {
   DiskManager *disk_manager = new DiskManager("test.db");
   BufferPoolManager *bpm = new BufferPoolManager(50, disk_manager);
   // create b+ tree
-  BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm,
-                                                           comparator);
-  GenericKey<8> index_key;
-  RID rid;
+  {
+    BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm,
+                                                             comparator);
+    GenericKey<8> index_key;
+    RID rid;
+
+    // create and fetch header_page
+    page_id_t page_id;
+    auto header_page = bpm->NewPage(page_id);
+    (void)header_page;
+    // first, populate index
+    std::vector<int64_t> keys = {1, 2, 3, 4, 5};
+    InsertHelper(tree, keys);
+
+    // concurrent insert
+    keys.clear();
+    for (int i = 6; i <= 10; i++)
+      keys.push_back(i);
+    LaunchParallelTest(1, InsertHelper, std::ref(tree), keys);
+    // concurrent delete
+    std::vector<int64_t> remove_keys = {1, 4, 3, 5, 6};
+    LaunchParallelTest(1, DeleteHelper, std::ref(tree), remove_keys);
+
+    int64_t start_key = 2;
+    int64_t size = 0;
+    index_key.SetFromInteger(start_key);
+    for (auto iterator = tree.Begin(index_key); iterator.isEnd() == false;
+         ++iterator) {
+      size = size + 1;
+    }
+
+    EXPECT_EQ(size, 5);
 
-  // create and fetch header_page
-  page_id_t page_id;
-  auto header_page = bpm->NewPage(page_id);
-  (void)header_page;
-  // first, populate index
-  std::vector<int64_t> keys = {1, 2, 3, 4, 5};
-  InsertHelper(tree, keys);
-
-  // concurrent insert
-  keys.clear();
-  for (int i = 6; i <= 10; i++)
-    keys.push_back(i);
-  LaunchParallelTest(1, InsertHelper, std::ref(tree), keys);
-  // concurrent delete
-  std::vector<int64_t> remove_keys = {1, 4, 3, 5, 6};
-  LaunchParallelTest(1, DeleteHelper, std::ref(tree), remove_keys);
-
-  int64_t start_key = 2;
-  int64_t size = 0;
-  index_key.SetFromInteger(start_key);
-  for (auto iterator = tree.Begin(index_key); iterator.isEnd() == false;
-       ++iterator) {
-    size = size + 1;
+    bpm->UnpinPage(HEADER_PAGE_ID, true);
   }
+  delete bpm;
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+}
 
-  EXPECT_EQ(size, 5);
+TEST(BPlusTreeConcurrentTest, MixTest2) {
+  // create KeyComparator and index schema
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
 
-  bpm->UnpinPage(HEADER_PAGE_ID, true);
-  delete disk_manager;
+  DiskManager *disk_manager = new DiskManager("test.db");
+  // eight writers and readers each keep a root to leaf path pinned
+  BufferPoolManager *bpm = new BufferPoolManager(500, disk_manager);
+  // create b+ tree
+  {
+    BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm,
+                                                             comparator);
+
+    // create and fetch header_page
+    page_id_t page_id;
+    auto header_page = bpm->NewPage(page_id);
+    (void)header_page;
+    // first, populate index with the even keys, they stay
+    std::vector<int64_t> keys;
+    std::vector<int64_t> odd_keys;
+    int64_t scale_factor = 2000;
+    for (int64_t key = 1; key < scale_factor; key++) {
+      if (key % 2 == 0)
+        keys.push_back(key);
+      else
+        odd_keys.push_back(key);
+    }
+    InsertHelper(tree, keys);
+
+    // splits and merges race with lookups of the even keys
+    std::vector<std::thread> thread_group;
+    for (uint64_t thread_itr = 0; thread_itr < 4; ++thread_itr) {
+      thread_group.push_back(std::thread(InsertHelperSplit, std::ref(tree),
+                                         odd_keys, 4, thread_itr));
+      thread_group.push_back(
+          std::thread(LookupHelper, std::ref(tree), keys, thread_itr));
+    }
+    for (auto &thread : thread_group)
+      thread.join();
+    thread_group.clear();
+    for (uint64_t thread_itr = 0; thread_itr < 4; ++thread_itr) {
+      thread_group.push_back(std::thread(DeleteHelperSplit, std::ref(tree),
+                                         odd_keys, 4, thread_itr));
+      thread_group.push_back(
+          std::thread(LookupHelper, std::ref(tree), keys, thread_itr));
+    }
+    for (auto &thread : thread_group)
+      thread.join();
+
+    int64_t current_key = 2;
+    for (auto iterator = tree.Begin(); iterator.isEnd() == false; ++iterator) {
+      EXPECT_EQ((*iterator).second.GetSlotNum(), current_key);
+      current_key = current_key + 2;
+    }
+
+    EXPECT_EQ(current_key, scale_factor);
+
+    bpm->UnpinPage(HEADER_PAGE_ID, true);
+  }
   delete bpm;
+  delete disk_manager;
   remove("test.db");
   remove("test.log");
 }
@@ -52,68 +52,70 @@ TEST(BptTreeTest, UnitTest) {
   page_id_t page_id;
   auto header_page = bpm->NewPage(page_id);
   (void)header_page;
-  // create b+ tree
-  BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm,
-                                                           comparator);
   // create transaction
   Transaction *transaction = new Transaction(0);
-  while (!quit) {
-    std::cout << "> ";
-    std::cin >> instruction;
-    switch (instruction) {
-    case 'd':
-      std::cin >> filename;
-      tree.RemoveFromFile(filename, transaction);
-      std::cout << tree.ToString(verbose) << '\n';
-      break;
-    case 'a':
-      std::cin >> key;
-      index_key.SetFromInteger(key);
-      tree.Remove(index_key, transaction);
-      std::cout << tree.ToString(verbose) << '\n';
-      break;
-    case 'i':
-      std::cin >> key;
-      rid.Set((int32_t)(key >> 32), (int)(key & 0xFFFFFFFF));
-      index_key.SetFromInteger(key);
-      tree.Insert(index_key, rid, transaction);
-      std::cout << tree.ToString(verbose) << '\n';
-      break;
-    case 'f':
-      std::cin >> filename;
-      tree.InsertFromFile(filename, transaction);
-      std::cout << tree.ToString(verbose) << '\n';
-      break;
-    case 'q':
-      quit = true;
-      break;
-    case 'r':
-      std::cin >> key;
-      index_key.SetFromInteger(key);
-      for (auto iterator = tree.Begin(index_key); iterator.isEnd() == false;
-           ++iterator)
-        std::cout << "key is " << (*iterator).first << " value is "
-                  << (*iterator).second << '\n';
+  // create b+ tree
+  {
+    BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm,
+                                                             comparator);
+    while (!quit) {
+      std::cout << "> ";
+      std::cin >> instruction;
+      switch (instruction) {
+      case 'd':
+        std::cin >> filename;
+        tree.RemoveFromFile(filename, transaction);
+        std::cout << tree.ToString(verbose) << '\n';
+        break;
+      case 'a':
+        std::cin >> key;
+        index_key.SetFromInteger(key);
+        tree.Remove(index_key, transaction);
+        std::cout << tree.ToString(verbose) << '\n';
+        break;
+      case 'i':
+        std::cin >> key;
+        rid.Set((int32_t)(key >> 32), (int)(key & 0xFFFFFFFF));
+        index_key.SetFromInteger(key);
+        tree.Insert(index_key, rid, transaction);
+        std::cout << tree.ToString(verbose) << '\n';
+        break;
+      case 'f':
+        std::cin >> filename;
+        tree.InsertFromFile(filename, transaction);
+        std::cout << tree.ToString(verbose) << '\n';
+        break;
+      case 'q':
+        quit = true;
+        break;
+      case 'r':
+        std::cin >> key;
+        index_key.SetFromInteger(key);
+        for (auto iterator = tree.Begin(index_key); iterator.isEnd() == false;
+             ++iterator)
+          std::cout << "key is " << (*iterator).first << " value is "
+                    << (*iterator).second << '\n';
 
-      break;
-    case 'v':
-      verbose = !verbose;
-      tree.ToString(verbose);
-      break;
-    // case 'x':
-    //   tree.destroyTree();
-    //   tree.print();
-    //   break;
-    case '?':
-      std::cout << usageMessage();
-      break;
-    default:
-      std::cin.ignore(256, '\n');
-      std::cout << usageMessage();
-      break;
+        break;
+      case 'v':
+        verbose = !verbose;
+        tree.ToString(verbose);
+        break;
+      // case 'x':
+      //   tree.destroyTree();
+      //   tree.print();
+      //   break;
+      case '?':
+        std::cout << usageMessage();
+        break;
+      default:
+        std::cin.ignore(256, '\n');
+        std::cout << usageMessage();
+        break;
+      }
     }
+    bpm->UnpinPage(HEADER_PAGE_ID, true);
   }
-  bpm->UnpinPage(HEADER_PAGE_ID, true);
   delete bpm;
   delete transaction;
   delete disk_manager;
@@ -5,6 +5,7 @@
 #include <algorithm>
 #include <cstdio>
 #include <iostream>
+#include <random>
 #include <sstream>
 
 #include "buffer/buffer_pool_manager.h"
@@ -23,54 +24,56 @@ TEST(BPlusTreeTests, InsertTest1) {
   DiskManager *disk_manager = new DiskManager("test.db");
   BufferPoolManager *bpm = new BufferPoolManager(50, disk_manager);
   // create b+ tree
-  BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm,
-                                                           comparator);
-  GenericKey<8> index_key;
-  RID rid;
-  // create transaction
-  Transaction *transaction = new Transaction(0);
-
-  // create and fetch header_page
-  page_id_t page_id;
-  auto header_page = bpm->NewPage(page_id);
-  (void)header_page;
-
-  std::vector<int64_t> keys = {1, 2, 3, 4, 5};
-  for (auto key : keys) {
-    int64_t value = key & 0xFFFFFFFF;
-    rid.Set((int32_t)(key >> 32), value);
-    index_key.SetFromInteger(key);
-    tree.Insert(index_key, rid, transaction);
+  {
+    BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm,
+                                                             comparator);
+    GenericKey<8> index_key;
+    RID rid;
+    // create transaction
+    Transaction *transaction = new Transaction(0);
+
+    // create and fetch header_page
+    page_id_t page_id;
+    auto header_page = bpm->NewPage(page_id);
+    (void)header_page;
+
+    std::vector<int64_t> keys = {1, 2, 3, 4, 5};
+    for (auto key : keys) {
+      int64_t value = key & 0xFFFFFFFF;
+      rid.Set((int32_t)(key >> 32), value);
+      index_key.SetFromInteger(key);
+      tree.Insert(index_key, rid, transaction);
+    }
+
+    std::vector<RID> rids;
+    for (auto key : keys) {
+      rids.clear();
+      index_key.SetFromInteger(key);
+      tree.GetValue(index_key, rids);
+      EXPECT_EQ(rids.size(), 1);
+
+      int64_t value = key & 0xFFFFFFFF;
+      EXPECT_EQ(rids[0].GetSlotNum(), value);
+    }
+
+    int64_t start_key = 1;
+    int64_t current_key = start_key;
+    index_key.SetFromInteger(start_key);
+    for (auto iterator = tree.Begin(index_key); iterator.isEnd() == false;
+         ++iterator) {
+      auto location = (*iterator).second;
+      EXPECT_EQ(location.GetPageId(), 0);
+      EXPECT_EQ(location.GetSlotNum(), current_key);
+      current_key = current_key + 1;
+    }
+
+    EXPECT_EQ(current_key, keys.size() + 1);
+
+    bpm->UnpinPage(HEADER_PAGE_ID, true);
+    delete transaction;
   }
-
-  std::vector<RID> rids;
-  for (auto key : keys) {
-    rids.clear();
-    index_key.SetFromInteger(key);
-    tree.GetValue(index_key, rids);
-    EXPECT_EQ(rids.size(), 1);
-
-    int64_t value = key & 0xFFFFFFFF;
-    EXPECT_EQ(rids[0].GetSlotNum(), value);
-  }
-
-  int64_t start_key = 1;
-  int64_t current_key = start_key;
-  index_key.SetFromInteger(start_key);
-  for (auto iterator = tree.Begin(index_key); iterator.isEnd() == false;
-       ++iterator) {
-    auto location = (*iterator).second;
-    EXPECT_EQ(location.GetPageId(), 0);
-    EXPECT_EQ(location.GetSlotNum(), current_key);
-    current_key = current_key + 1;
-  }
-
-  EXPECT_EQ(current_key, keys.size() + 1);
-
-  bpm->UnpinPage(HEADER_PAGE_ID, true);
-  delete transaction;
-  delete disk_manager;
   delete bpm;
+  delete disk_manager;
   remove("test.db");
   remove("test.log");
 }
@@ -83,65 +86,67 @@ TEST(BPlusTreeTests, InsertTest2) {
   DiskManager *disk_manager = new DiskManager("test.db");
   BufferPoolManager *bpm = new BufferPoolManager(50, disk_manager);
   // create b+ tree
-  BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm,
-                                                           comparator);
-  GenericKey<8> index_key;
-  RID rid;
-  // create transaction
-  Transaction *transaction = new Transaction(0);
-
-  // create and fetch header_page
-  page_id_t page_id;
-  auto header_page = bpm->NewPage(page_id);
-  (void)header_page;
-
-  std::vector<int64_t> keys = {5, 4, 3, 2, 1};
-  for (auto key : keys) {
-    int64_t value = key & 0xFFFFFFFF;
-    rid.Set((int32_t)(key >> 32), value);
-    index_key.SetFromInteger(key);
-    tree.Insert(index_key, rid, transaction);
+  {
+    BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm,
+                                                             comparator);
+    GenericKey<8> index_key;
+    RID rid;
+    // create transaction
+    Transaction *transaction = new Transaction(0);
+
+    // create and fetch header_page
+    page_id_t page_id;
+    auto header_page = bpm->NewPage(page_id);
+    (void)header_page;
+
+    std::vector<int64_t> keys = {5, 4, 3, 2, 1};
+    for (auto key : keys) {
+      int64_t value = key & 0xFFFFFFFF;
+      rid.Set((int32_t)(key >> 32), value);
+      index_key.SetFromInteger(key);
+      tree.Insert(index_key, rid, transaction);
+    }
+
+    std::vector<RID> rids;
+    for (auto key : keys) {
+      rids.clear();
+      index_key.SetFromInteger(key);
+      tree.GetValue(index_key, rids);
+      EXPECT_EQ(rids.size(), 1);
+
+      int64_t value = key & 0xFFFFFFFF;
+      EXPECT_EQ(rids[0].GetSlotNum(), value);
+    }
+
+    int64_t start_key = 1;
+    int64_t current_key = start_key;
+    index_key.SetFromInteger(start_key);
+    for (auto iterator = tree.Begin(index_key); iterator.isEnd() == false;
+         ++iterator) {
+      auto location = (*iterator).second;
+      EXPECT_EQ(location.GetPageId(), 0);
+      EXPECT_EQ(location.GetSlotNum(), current_key);
+      current_key = current_key + 1;
+    }
+
+    EXPECT_EQ(current_key, keys.size() + 1);
+
+    start_key = 3;
+    current_key = start_key;
+    index_key.SetFromInteger(start_key);
+    for (auto iterator = tree.Begin(index_key); iterator.isEnd() == false;
+         ++iterator) {
+      auto location = (*iterator).second;
+      EXPECT_EQ(location.GetPageId(), 0);
+      EXPECT_EQ(location.GetSlotNum(), current_key);
+      current_key = current_key + 1;
+    }
+
+    bpm->UnpinPage(HEADER_PAGE_ID, true);
+    delete transaction;
   }
-
-  std::vector<RID> rids;
-  for (auto key : keys) {
-    rids.clear();
-    index_key.SetFromInteger(key);
-    tree.GetValue(index_key, rids);
-    EXPECT_EQ(rids.size(), 1);
-
-    int64_t value = key & 0xFFFFFFFF;
-    EXPECT_EQ(rids[0].GetSlotNum(), value);
-  }
-
-  int64_t start_key = 1;
-  int64_t current_key = start_key;
-  index_key.SetFromInteger(start_key);
-  for (auto iterator = tree.Begin(index_key); iterator.isEnd() == false;
-       ++iterator) {
-    auto location = (*iterator).second;
-    EXPECT_EQ(location.GetPageId(), 0);
-    EXPECT_EQ(location.GetSlotNum(), current_key);
-    current_key = current_key + 1;
-  }
-
-  EXPECT_EQ(current_key, keys.size() + 1);
-
-  start_key = 3;
-  current_key = start_key;
-  index_key.SetFromInteger(start_key);
-  for (auto iterator = tree.Begin(index_key); iterator.isEnd() == false;
-       ++iterator) {
-    auto location = (*iterator).second;
-    EXPECT_EQ(location.GetPageId(), 0);
-    EXPECT_EQ(location.GetSlotNum(), current_key);
-    current_key = current_key + 1;
-  }
-
-  bpm->UnpinPage(HEADER_PAGE_ID, true);
-  delete transaction;
-  delete disk_manager;
   delete bpm;
+  delete disk_manager;
   remove("test.db");
   remove("test.log");
 }
@@ -155,75 +160,77 @@ TEST(BPlusTreeTests, DeleteTest1) {
   DiskManager *disk_manager = new DiskManager("test.db");
   BufferPoolManager *bpm = new BufferPoolManager(50, disk_manager);
   // create b+ tree
-  BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm,
-                                                           comparator);
-  GenericKey<8> index_key;
-  RID rid;
-  // create transaction
-  Transaction *transaction = new Transaction(0);
-
-  // create and fetch header_page
-  page_id_t page_id;
-  auto header_page = bpm->NewPage(page_id);
-  (void)header_page;
-
-  std::vector<int64_t> keys = {1, 2, 3, 4, 5};
-  for (auto key : keys) {
-    int64_t value = key & 0xFFFFFFFF;
-    rid.Set((int32_t)(key >> 32), value);
-    index_key.SetFromInteger(key);
-    tree.Insert(index_key, rid, transaction);
-  }
-
-  std::vector<RID> rids;
-  for (auto key : keys) {
-    rids.clear();
-    index_key.SetFromInteger(key);
-    tree.GetValue(index_key, rids);
-    EXPECT_EQ(rids.size(), 1);
-
-    int64_t value = key & 0xFFFFFFFF;
-    EXPECT_EQ(rids[0].GetSlotNum(), value);
-  }
-
-  int64_t start_key = 1;
-  int64_t current_key = start_key;
-  index_key.SetFromInteger(start_key);
-  for (auto iterator = tree.Begin(index_key); iterator.isEnd() == false;
-       ++iterator) {
-    auto location = (*iterator).second;
-    EXPECT_EQ(location.GetPageId(), 0);
-    EXPECT_EQ(location.GetSlotNum(), current_key);
-    current_key = current_key + 1;
-  }
-
-  EXPECT_EQ(current_key, keys.size() + 1);
-
-  std::vector<int64_t> remove_keys = {1, 5};
-  for (auto key : remove_keys) {
-    index_key.SetFromInteger(key);
-    tree.Remove(index_key, transaction);
+  {
+    BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm,
+                                                             comparator);
+    GenericKey<8> index_key;
+    RID rid;
+    // create transaction
+    Transaction *transaction = new Transaction(0);
+
+    // create and fetch header_page
+    page_id_t page_id;
+    auto header_page = bpm->NewPage(page_id);
+    (void)header_page;
+
+    std::vector<int64_t> keys = {1, 2, 3, 4, 5};
+    for (auto key : keys) {
+      int64_t value = key & 0xFFFFFFFF;
+      rid.Set((int32_t)(key >> 32), value);
+      index_key.SetFromInteger(key);
+      tree.Insert(index_key, rid, transaction);
+    }
+
+    std::vector<RID> rids;
+    for (auto key : keys) {
+      rids.clear();
+      index_key.SetFromInteger(key);
+      tree.GetValue(index_key, rids);
+      EXPECT_EQ(rids.size(), 1);
+
+      int64_t value = key & 0xFFFFFFFF;
+      EXPECT_EQ(rids[0].GetSlotNum(), value);
+    }
+
+    int64_t start_key = 1;
+    int64_t current_key = start_key;
+    index_key.SetFromInteger(start_key);
+    for (auto iterator = tree.Begin(index_key); iterator.isEnd() == false;
+         ++iterator) {
+      auto location = (*iterator).second;
+      EXPECT_EQ(location.GetPageId(), 0);
+      EXPECT_EQ(location.GetSlotNum(), current_key);
+      current_key = current_key + 1;
+    }
+
+    EXPECT_EQ(current_key, keys.size() + 1);
+
+    std::vector<int64_t> remove_keys = {1, 5};
+    for (auto key : remove_keys) {
+      index_key.SetFromInteger(key);
+      tree.Remove(index_key, transaction);
+    }
+
+    start_key = 2;
+    current_key = start_key;
+    int64_t size = 0;
+    index_key.SetFromInteger(start_key);
+    for (auto iterator = tree.Begin(index_key); iterator.isEnd() == false;
+         ++iterator) {
+      auto location = (*iterator).second;
+      EXPECT_EQ(location.GetPageId(), 0);
+      EXPECT_EQ(location.GetSlotNum(), current_key);
+      current_key = current_key + 1;
+      size = size + 1;
+    }
+
+    EXPECT_EQ(size, 3);
+
+    bpm->UnpinPage(HEADER_PAGE_ID, true);
+    delete transaction;
   }
-
-  start_key = 2;
-  current_key = start_key;
-  int64_t size = 0;
-  index_key.SetFromInteger(start_key);
-  for (auto iterator = tree.Begin(index_key); iterator.isEnd() == false;
-       ++iterator) {
-    auto location = (*iterator).second;
-    EXPECT_EQ(location.GetPageId(), 0);
-    EXPECT_EQ(location.GetSlotNum(), current_key);
-    current_key = current_key + 1;
-    size = size + 1;
-  }
-
-  EXPECT_EQ(size, 3);
-
-  bpm->UnpinPage(HEADER_PAGE_ID, true);
-  delete transaction;
-  delete disk_manager;
   delete bpm;
+  delete disk_manager;
   remove("test.db");
   remove("test.log");
 }
@@ -236,158 +243,622 @@ TEST(BPlusTreeTests, DeleteTest2) {
   DiskManager *disk_manager = new DiskManager("test.db");
   BufferPoolManager *bpm = new BufferPoolManager(50, disk_manager);
   // create b+ tree
-  BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm,
-                                                           comparator);
-  GenericKey<8> index_key;
-  RID rid;
-  // create transaction
-  Transaction *transaction = new Transaction(0);
-
-  // create and fetch header_page
-  page_id_t page_id;
-  auto header_page = bpm->NewPage(page_id);
-  (void)header_page;
-
-  std::vector<int64_t> keys = {1, 2, 3, 4, 5};
-  for (auto key : keys) {
-    int64_t value = key & 0xFFFFFFFF;
-    rid.Set((int32_t)(key >> 32), value);
-    index_key.SetFromInteger(key);
-    tree.Insert(index_key, rid, transaction);
+  {
+    BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm,
+                                                             comparator);
+    GenericKey<8> index_key;
+    RID rid;
+    // create transaction
+    Transaction *transaction = new Transaction(0);
+
+    // create and fetch header_page
+    page_id_t page_id;
+    auto header_page = bpm->NewPage(page_id);
+    (void)header_page;
+
+    std::vector<int64_t> keys = {1, 2, 3, 4, 5};
+    for (auto key : keys) {
+      int64_t value = key & 0xFFFFFFFF;
+      rid.Set((int32_t)(key >> 32), value);
+      index_key.SetFromInteger(key);
+      tree.Insert(index_key, rid, transaction);
+    }
+
+    std::vector<RID> rids;
+    for (auto key : keys) {
+      rids.clear();
+      index_key.SetFromInteger(key);
+      tree.GetValue(index_key, rids);
+      EXPECT_EQ(rids.size(), 1);
+
+      int64_t value = key & 0xFFFFFFFF;
+      EXPECT_EQ(rids[0].GetSlotNum(), value);
+    }
+
+    int64_t start_key = 1;
+    int64_t current_key = start_key;
+    index_key.SetFromInteger(start_key);
+    for (auto iterator = tree.Begin(index_key); iterator.isEnd() == false;
+         ++iterator) {
+      auto location = (*iterator).second;
+      EXPECT_EQ(location.GetPageId(), 0);
+      EXPECT_EQ(location.GetSlotNum(), current_key);
+      current_key = current_key + 1;
+    }
+
+    EXPECT_EQ(current_key, keys.size() + 1);
+
+    std::vector<int64_t> remove_keys = {1, 5, 3, 4};
+    for (auto key : remove_keys) {
+      index_key.SetFromInteger(key);
+      tree.Remove(index_key, transaction);
+    }
+
+    start_key = 2;
+    current_key = start_key;
+    int64_t size = 0;
+    index_key.SetFromInteger(start_key);
+    for (auto iterator = tree.Begin(index_key); iterator.isEnd() == false;
+         ++iterator) {
+      auto location = (*iterator).second;
+      EXPECT_EQ(location.GetPageId(), 0);
+      EXPECT_EQ(location.GetSlotNum(), current_key);
+      current_key = current_key + 1;
+      size = size + 1;
+    }
+
+    EXPECT_EQ(size, 1);
+
+    bpm->UnpinPage(HEADER_PAGE_ID, true);
+    delete transaction;
   }
+  delete bpm;
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+}
 
-  std::vector<RID> rids;
-  for (auto key : keys) {
-    rids.clear();
-    index_key.SetFromInteger(key);
-    tree.GetValue(index_key, rids);
-    EXPECT_EQ(rids.size(), 1);
+TEST(BPlusTreeTests, ScaleTest) {
+  // create KeyComparator and index schema
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
 
-    int64_t value = key & 0xFFFFFFFF;
-    EXPECT_EQ(rids[0].GetSlotNum(), value);
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManager(30, disk_manager);
+  // create b+ tree
+  {
+    BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm,
+                                                             comparator);
+    GenericKey<8> index_key;
+    RID rid;
+    // create transaction
+    Transaction *transaction = new Transaction(0);
+    // create and fetch header_page
+    page_id_t page_id;
+    auto header_page = bpm->NewPage(page_id);
+    (void)header_page;
+
+    int64_t scale = 10000;
+    std::vector<int64_t> keys;
+    for (int64_t key = 1; key < scale; key++) {
+      keys.push_back(key);
+    }
+
+    for (auto key : keys) {
+      int64_t value = key & 0xFFFFFFFF;
+      rid.Set((int32_t)(key >> 32), value);
+      index_key.SetFromInteger(key);
+      tree.Insert(index_key, rid, transaction);
+    }
+    std::vector<RID> rids;
+    for (auto key : keys) {
+      rids.clear();
+      index_key.SetFromInteger(key);
+      tree.GetValue(index_key, rids);
+      EXPECT_EQ(rids.size(), 1);
+
+      int64_t value = key & 0xFFFFFFFF;
+      EXPECT_EQ(rids[0].GetSlotNum(), value);
+    }
+
+    int64_t start_key = 1;
+    int64_t current_key = start_key;
+    index_key.SetFromInteger(start_key);
+    for (auto iterator = tree.Begin(index_key); iterator.isEnd() == false;
+         ++iterator) {
+      current_key = current_key + 1;
+    }
+    EXPECT_EQ(current_key, keys.size() + 1);
+
+    int64_t remove_scale = 9900;
+    std::vector<int64_t> remove_keys;
+    for (int64_t key = 1; key < remove_scale; key++) {
+      remove_keys.push_back(key);
+    }
+    // std::random_shuffle(remove_keys.begin(), remove_keys.end());
+    for (auto key : remove_keys) {
+      index_key.SetFromInteger(key);
+      tree.Remove(index_key, transaction);
+    }
+
+    start_key = 9900;
+    current_key = start_key;
+    int64_t size = 0;
+    index_key.SetFromInteger(start_key);
+    for (auto iterator = tree.Begin(index_key); iterator.isEnd() == false;
+         ++iterator) {
+      current_key = current_key + 1;
+      size = size + 1;
+    }
+
+    EXPECT_EQ(size, 100);
+
+    bpm->UnpinPage(HEADER_PAGE_ID, true);
+    delete transaction;
   }
+  delete bpm;
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+}
+TEST(BPlusTreeTests, PageSizeTest) {
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
 
-  int64_t start_key = 1;
-  int64_t current_key = start_key;
-  index_key.SetFromInteger(start_key);
-  for (auto iterator = tree.Begin(index_key); iterator.isEnd() == false;
-       ++iterator) {
-    auto location = (*iterator).second;
-    EXPECT_EQ(location.GetPageId(), 0);
-    EXPECT_EQ(location.GetSlotNum(), current_key);
-    current_key = current_key + 1;
+  // the node sizes follow the page size of the database
+  DiskManager *disk_manager = new DiskManager("test.db", 16384);
+  BufferPoolManager *bpm = new BufferPoolManager(10, disk_manager);
+  EXPECT_EQ(16384u, bpm->GetPageSize());
+  {
+    BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm,
+                                                             comparator);
+    GenericKey<8> index_key;
+    RID rid;
+    Transaction *transaction = new Transaction(0);
+    page_id_t page_id;
+    auto header_page = bpm->NewPage(page_id);
+    (void)header_page;
+
+    int64_t scale = 10000;
+    for (int64_t key = 1; key < scale; key++) {
+      rid.Set((int32_t)(key >> 32), key & 0xFFFFFFFF);
+      index_key.SetFromInteger(key);
+      tree.Insert(index_key, rid, transaction);
+    }
+    // a fan-out near a thousand: the tree fits in the first extent
+    EXPECT_LE(disk_manager->GetNextPageId(), 1 + EXTENT_SIZE);
+
+    std::vector<RID> rids;
+    for (int64_t key = 1; key < scale; key++) {
+      rids.clear();
+      index_key.SetFromInteger(key);
+      tree.GetValue(index_key, rids);
+      ASSERT_EQ(rids.size(), 1);
+      EXPECT_EQ(rids[0].GetSlotNum(), key);
+    }
+
+    bpm->UnpinPage(HEADER_PAGE_ID, true);
+    delete transaction;
   }
+  delete bpm;
+  delete disk_manager;
+  delete key_schema;
+  remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
+}
 
-  EXPECT_EQ(current_key, keys.size() + 1);
+TEST(BPlusTreeTests, BulkLoadTest) {
+  // create KeyComparator and index schema
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
 
-  std::vector<int64_t> remove_keys = {1, 5, 3, 4};
-  for (auto key : remove_keys) {
-    index_key.SetFromInteger(key);
-    tree.Remove(index_key, transaction);
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManager(30, disk_manager);
+  // create b+ tree
+  {
+    BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm,
+                                                             comparator);
+    GenericKey<8> index_key;
+    RID rid;
+    // create transaction
+    Transaction *transaction = new Transaction(0);
+    // create and fetch header_page
+    page_id_t page_id;
+    auto header_page = bpm->NewPage(page_id);
+    (void)header_page;
+
+    int64_t scale = 5000;
+    std::vector<std::pair<GenericKey<8>, RID>> pairs;
+    for (int64_t key = 1; key < scale; key++) {
+      index_key.SetFromInteger(key);
+      rid.Set(0, key);
+      pairs.emplace_back(index_key, rid);
+    }
+    std::random_shuffle(pairs.begin(), pairs.end());
+    // duplicates after the first occurrence are dropped
+    for (int64_t key = 1; key < 100; key++) {
+      index_key.SetFromInteger(key);
+      rid.Set(1, key);
+      pairs.emplace_back(index_key, rid);
+    }
+
+    // small runs so the input is sorted externally
+    EXPECT_TRUE(tree.BulkLoad(pairs.begin(), pairs.end(), 0.9, 512));
+    EXPECT_FALSE(tree.BulkLoad(pairs.begin(), pairs.end()));
+
+    std::vector<RID> rids;
+    for (int64_t key = 1; key < scale; key++) {
+      rids.clear();
+      index_key.SetFromInteger(key);
+      tree.GetValue(index_key, rids);
+      EXPECT_EQ(rids.size(), 1);
+      EXPECT_EQ(rids[0].GetPageId(), 0);
+      EXPECT_EQ(rids[0].GetSlotNum(), key);
+    }
+
+    int64_t current_key = 1;
+    index_key.SetFromInteger(current_key);
+    for (auto iterator = tree.Begin(index_key); iterator.isEnd() == false;
+         ++iterator) {
+      EXPECT_EQ((*iterator).second.GetSlotNum(), current_key);
+      current_key = current_key + 1;
+    }
+    EXPECT_EQ(current_key, scale);
+
+    // the loaded tree takes inserts and removes as usual
+    for (int64_t key = scale; key < scale + 100; key++) {
+      index_key.SetFromInteger(key);
+      rid.Set(0, key);
+      EXPECT_TRUE(tree.Insert(index_key, rid, transaction));
+    }
+    for (int64_t key = 1; key < 100; key++) {
+      index_key.SetFromInteger(key);
+      tree.Remove(index_key, transaction);
+    }
+
+    int64_t size = 0;
+    current_key = 100;
+    index_key.SetFromInteger(1);
+    for (auto iterator = tree.Begin(index_key); iterator.isEnd() == false;
+         ++iterator) {
+      EXPECT_EQ((*iterator).second.GetSlotNum(), current_key);
+      current_key = current_key + 1;
+      size = size + 1;
+    }
+    EXPECT_EQ(size, scale);
+
+    bpm->UnpinPage(HEADER_PAGE_ID, true);
+    delete transaction;
+    delete key_schema;
   }
+  delete bpm;
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+}
 
-  start_key = 2;
-  current_key = start_key;
-  int64_t size = 0;
-  index_key.SetFromInteger(start_key);
-  for (auto iterator = tree.Begin(index_key); iterator.isEnd() == false;
-       ++iterator) {
-    auto location = (*iterator).second;
-    EXPECT_EQ(location.GetPageId(), 0);
-    EXPECT_EQ(location.GetSlotNum(), current_key);
-    current_key = current_key + 1;
-    size = size + 1;
-  }
+// a load that runs out of frames gives back the pages it built
+TEST(BPlusTreeTests, BulkLoadFailureTest) {
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
 
-  EXPECT_EQ(size, 1);
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManager(3, disk_manager);
+  {
+    BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm,
+                                                             comparator);
+    GenericKey<8> index_key;
+    RID rid;
+    page_id_t page_id;
+    auto header_page = bpm->NewPage(page_id);
+    (void)header_page;
+
+    std::vector<std::pair<GenericKey<8>, RID>> pairs;
+    for (int64_t key = 1; key < 5000; key++) {
+      index_key.SetFromInteger(key);
+      rid.Set(0, key);
+      pairs.emplace_back(index_key, rid);
+    }
+
+    // one free frame: the second leaf does not get one
+    page_id_t pinned_page_id;
+    ASSERT_NE(nullptr, bpm->NewPage(pinned_page_id));
+    EXPECT_THROW(tree.BulkLoad(pairs.begin(), pairs.end()), Exception);
+    EXPECT_TRUE(tree.IsEmpty());
+    bpm->UnpinPage(pinned_page_id, false);
+
+    // nothing was left pinned
+    EXPECT_TRUE(tree.BulkLoad(pairs.begin(), pairs.end()));
+    std::vector<RID> rids;
+    index_key.SetFromInteger(4999);
+    tree.GetValue(index_key, rids);
+    ASSERT_EQ(rids.size(), 1);
+    EXPECT_EQ(rids[0].GetSlotNum(), 4999);
 
-  bpm->UnpinPage(HEADER_PAGE_ID, true);
-  delete transaction;
-  delete disk_manager;
+    bpm->UnpinPage(HEADER_PAGE_ID, true);
+    delete key_schema;
+  }
   delete bpm;
+  delete disk_manager;
   remove("test.db");
   remove("test.log");
+  remove("test.fsm");
 }
 
-TEST(BPlusTreeTests, ScaleTest) {
+TEST(BPlusTreeTests, RangeScanTest) {
   // create KeyComparator and index schema
   Schema *key_schema = ParseCreateStatement("a bigint");
   GenericComparator<8> comparator(key_schema);
 
   DiskManager *disk_manager = new DiskManager("test.db");
-  BufferPoolManager *bpm = new BufferPoolManager(30, disk_manager);
+  BufferPoolManager *bpm = new BufferPoolManager(100, disk_manager);
   // create b+ tree
-  BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm,
-                                                           comparator);
-  GenericKey<8> index_key;
-  RID rid;
-  // create transaction
-  Transaction *transaction = new Transaction(0);
-  // create and fetch header_page
-  page_id_t page_id;
-  auto header_page = bpm->NewPage(page_id);
-  (void)header_page;
-
-  int64_t scale = 10000;
-  std::vector<int64_t> keys;
-  for (int64_t key = 1; key < scale; key++) {
-    keys.push_back(key);
-  }
+  {
+    BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm,
+                                                             comparator);
+    GenericKey<8> index_key;
+    RID rid;
+    // create transaction
+    Transaction *transaction = new Transaction(0);
+    // create and fetch header_page
+    page_id_t page_id;
+    auto header_page = bpm->NewPage(page_id);
+    (void)header_page;
+
+    // even keys only
+    int64_t scale = 1000;
+    for (int64_t key = 2; key <= scale; key += 2) {
+      rid.Set(0, key);
+      index_key.SetFromInteger(key);
+      tree.Insert(index_key, rid, transaction);
+    }
+
+    std::vector<RID> rids;
+    int batches = 0;
+    auto collect = [&](const std::vector<RID> &batch) {
+      EXPECT_LE(batch.size(), RANGE_SCAN_BATCH_SIZE);
+      rids.insert(rids.end(), batch.begin(), batch.end());
+      batches++;
+      return true;
+    };
+    GenericKey<8> low, high;
+
+    // [100, 300]
+    low.SetFromInteger(100);
+    high.SetFromInteger(300);
+    EXPECT_EQ(tree.ScanRange(&low, true, &high, true, 0, collect), 101);
+    EXPECT_EQ(rids.size(), 101);
+    EXPECT_EQ(rids.front().GetSlotNum(), 100);
+    EXPECT_EQ(rids.back().GetSlotNum(), 300);
+    for (size_t i = 1; i < rids.size(); i++)
+      EXPECT_EQ(rids[i].GetSlotNum(), rids[i - 1].GetSlotNum() + 2);
+    EXPECT_EQ(batches,
+              (101 + RANGE_SCAN_BATCH_SIZE - 1) / RANGE_SCAN_BATCH_SIZE);
+
+    // (100, 300)
+    rids.clear();
+    tree.ScanRange(&low, false, &high, false, 0, collect);
+    EXPECT_EQ(rids.size(), 99);
+    EXPECT_EQ(rids.front().GetSlotNum(), 102);
+    EXPECT_EQ(rids.back().GetSlotNum(), 298);
 
-  for (auto key : keys) {
-    int64_t value = key & 0xFFFFFFFF;
-    rid.Set((int32_t)(key >> 32), value);
-    index_key.SetFromInteger(key);
-    tree.Insert(index_key, rid, transaction);
-  }
-  std::vector<RID> rids;
-  for (auto key : keys) {
+    // bounds that fall between keys: [99, 301)
     rids.clear();
-    index_key.SetFromInteger(key);
-    tree.GetValue(index_key, rids);
-    EXPECT_EQ(rids.size(), 1);
+    low.SetFromInteger(99);
+    high.SetFromInteger(301);
+    tree.ScanRange(&low, false, &high, false, 0, collect);
+    EXPECT_EQ(rids.size(), 101);
 
-    int64_t value = key & 0xFFFFFFFF;
-    EXPECT_EQ(rids[0].GetSlotNum(), value);
-  }
+    // open bounds
+    rids.clear();
+    tree.ScanRange(nullptr, false, &high, true, 0, collect);
+    EXPECT_EQ(rids.size(), 150);
+    EXPECT_EQ(rids.front().GetSlotNum(), 2);
+    rids.clear();
+    tree.ScanRange(&low, true, nullptr, false, 0, collect);
+    EXPECT_EQ(rids.size(), 451);
+    EXPECT_EQ(rids.back().GetSlotNum(), scale);
+    rids.clear();
+    tree.ScanRange(nullptr, false, nullptr, false, 0, collect);
+    EXPECT_EQ(rids.size(), scale / 2);
 
-  int64_t start_key = 1;
-  int64_t current_key = start_key;
-  index_key.SetFromInteger(start_key);
-  for (auto iterator = tree.Begin(index_key); iterator.isEnd() == false;
-       ++iterator) {
-    current_key = current_key + 1;
+    // limit, and a callback that stops the scan
+    rids.clear();
+    EXPECT_EQ(tree.ScanRange(&low, true, nullptr, false, 10, collect), 10);
+    EXPECT_EQ(rids.size(), 10);
+    EXPECT_EQ(rids.back().GetSlotNum(), 118);
+    rids.clear();
+    batches = 0;
+    tree.ScanRange(nullptr, false, nullptr, false, 0,
+                   [&](const std::vector<RID> &batch) {
+                     rids.insert(rids.end(), batch.begin(), batch.end());
+                     return ++batches < 2;
+                   });
+    EXPECT_EQ(rids.size(), 2 * RANGE_SCAN_BATCH_SIZE);
+
+    // empty range
+    rids.clear();
+    low.SetFromInteger(300);
+    high.SetFromInteger(100);
+    EXPECT_EQ(tree.ScanRange(&low, true, &high, true, 0, collect), 0);
+    EXPECT_EQ(rids.size(), 0);
+
+    bpm->UnpinPage(HEADER_PAGE_ID, true);
+    delete transaction;
+    delete key_schema;
   }
-  EXPECT_EQ(current_key, keys.size() + 1);
+  delete bpm;
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+}
 
-  int64_t remove_scale = 9900;
-  std::vector<int64_t> remove_keys;
-  for (int64_t key = 1; key < remove_scale; key++) {
-    remove_keys.push_back(key);
-  }
-  // std::random_shuffle(remove_keys.begin(), remove_keys.end());
-  for (auto key : remove_keys) {
-    index_key.SetFromInteger(key);
-    tree.Remove(index_key, transaction);
-  }
 
-  start_key = 9900;
-  current_key = start_key;
-  int64_t size = 0;
-  index_key.SetFromInteger(start_key);
-  for (auto iterator = tree.Begin(index_key); iterator.isEnd() == false;
-       ++iterator) {
-    current_key = current_key + 1;
-    size = size + 1;
+TEST(BPlusTreeTests, KeyPrefixTest) {
+  // two column key, the key type leaves 16 bytes of padding
+  Schema *key_schema = ParseCreateStatement("a bigint, b bigint");
+  GenericComparator<32> comparator(key_schema);
+  EXPECT_EQ(comparator.GetKeySize(), 16);
+
+  auto set_key = [](GenericKey<32> &key, int64_t a, int64_t b) {
+    memset(key.data, 0, sizeof(key.data));
+    memcpy(key.data, &a, sizeof(a));
+    memcpy(key.data + sizeof(a), &b, sizeof(b));
+  };
+  GenericKey<32> lhs, rhs;
+  set_key(lhs, 1, 1);
+  set_key(rhs, 1, 2);
+  EXPECT_EQ(comparator.PrefixSize(lhs, rhs), 8);
+  EXPECT_EQ(comparator.PrefixSize(lhs, lhs), 16);
+  set_key(rhs, 2, 1);
+  EXPECT_EQ(comparator.PrefixSize(lhs, rhs), 0);
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManager(100, disk_manager);
+  {
+    BPlusTree<GenericKey<32>, RID, GenericComparator<32>> tree("foo_pk", bpm,
+                                                               comparator);
+    GenericKey<32> index_key;
+    RID rid;
+    Transaction *transaction = new Transaction(0);
+    page_id_t page_id;
+    auto header_page = bpm->NewPage(page_id);
+    (void)header_page;
+
+    // insert in a random order so that most leaves split between two keys
+    int64_t a_count = 8, b_count = 5000;
+    int64_t scale = a_count * b_count;
+    std::vector<int64_t> keys(scale);
+    for (int64_t i = 0; i < scale; i++)
+      keys[i] = i;
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(42));
+    for (auto key : keys) {
+      int64_t a = key / b_count, b = key % b_count;
+      rid.Set((int32_t)a, (uint32_t)b);
+      set_key(index_key, a, b);
+      tree.Insert(index_key, rid, transaction);
+    }
+    // pages below a single "a" keep it once: 253 instead of 169 pairs (101
+    // with the padding) fit a leaf, and the tree fits in 4 extents instead of 6
+    EXPECT_LE(disk_manager->GetNextPageId(), 1 + 4 * EXTENT_SIZE);
+
+    // drop the odd b's and all of a == 3, merging and redistributing leaves
+    // across different a's
+    for (int64_t a = 0; a < a_count; a++) {
+      for (int64_t b = 0; b < b_count; b++) {
+        if (a != 3 && b % 2 == 0)
+          continue;
+        set_key(index_key, a, b);
+        tree.Remove(index_key, transaction);
+      }
+    }
+
+    std::vector<RID> rids;
+    for (int64_t a = 0; a < a_count; a++) {
+      for (int64_t b = 0; b < b_count; b++) {
+        rids.clear();
+        set_key(index_key, a, b);
+        tree.GetValue(index_key, rids);
+        if (a == 3 || b % 2 == 1) {
+          EXPECT_EQ(rids.size(), 0);
+          continue;
+        }
+        ASSERT_EQ(rids.size(), 1);
+        EXPECT_EQ(rids[0].GetPageId(), a);
+        EXPECT_EQ(rids[0].GetSlotNum(), b);
+      }
+    }
+
+    int64_t count = 0;
+    int64_t prev = -1;
+    for (auto iterator = tree.Begin(); iterator.isEnd() == false; ++iterator) {
+      int64_t a = (*iterator).second.GetPageId();
+      int64_t b = (*iterator).second.GetSlotNum();
+      set_key(index_key, a, b);
+      EXPECT_EQ(comparator((*iterator).first, index_key), 0);
+      EXPECT_LT(prev, a * b_count + b);
+      prev = a * b_count + b;
+      count++;
+    }
+    EXPECT_EQ(count, (a_count - 1) * b_count / 2);
+
+    bpm->UnpinPage(HEADER_PAGE_ID, true);
+    delete transaction;
   }
+  delete bpm;
+  delete disk_manager;
+  delete key_schema;
+  remove("test.db");
+  remove("test.log");
+  remove("test.fsm");
+}
 
-  EXPECT_EQ(size, 100);
+// a bulk load gives its pages the prefix of their key range
+TEST(BPlusTreeTests, BulkLoadKeyPrefixTest) {
+  Schema *key_schema = ParseCreateStatement("a bigint, b bigint");
+  GenericComparator<32> comparator(key_schema);
+  auto set_key = [](GenericKey<32> &key, int64_t a, int64_t b) {
+    memset(key.data, 0, sizeof(key.data));
+    memcpy(key.data, &a, sizeof(a));
+    memcpy(key.data + sizeof(a), &b, sizeof(b));
+  };
 
-  bpm->UnpinPage(HEADER_PAGE_ID, true);
-  delete transaction;
-  delete disk_manager;
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManager(100, disk_manager);
+  {
+    BPlusTree<GenericKey<32>, RID, GenericComparator<32>> tree("foo_pk", bpm,
+                                                               comparator);
+    GenericKey<32> index_key;
+    RID rid;
+    Transaction *transaction = new Transaction(0);
+    page_id_t page_id;
+    auto header_page = bpm->NewPage(page_id);
+    (void)header_page;
+
+    // every key has a == 1, the even b's are loaded, the odd ones inserted
+    int64_t scale = 40000;
+    std::vector<std::pair<GenericKey<32>, RID>> pairs;
+    for (int64_t b = 0; b < scale; b += 2) {
+      set_key(index_key, 1, b);
+      rid.Set(1, (uint32_t)b);
+      pairs.emplace_back(index_key, rid);
+    }
+    EXPECT_TRUE(tree.BulkLoad(pairs.begin(), pairs.end(), 0.5));
+    // half of the 253 pairs a leaf holds with "a" kept once, not of 169
+    EXPECT_LE(disk_manager->GetNextPageId(), 1 + 3 * EXTENT_SIZE);
+
+    set_key(index_key, 1, scale / 2);
+    Page *leaf = tree.FindLeafPage(index_key);
+    ASSERT_NE(nullptr, leaf);
+    EXPECT_EQ(8, reinterpret_cast<BPlusTreePage *>(leaf->GetData())
+                     ->GetPrefixSize());
+    leaf->RUnlatch();
+    bpm->UnpinPage(leaf->GetPageId(), false);
+
+    for (int64_t b = 1; b < scale; b += 2) {
+      set_key(index_key, 1, b);
+      rid.Set(1, (uint32_t)b);
+      EXPECT_TRUE(tree.Insert(index_key, rid, transaction));
+    }
+    int64_t count = 0;
+    for (auto iterator = tree.Begin(); iterator.isEnd() == false; ++iterator) {
+      set_key(index_key, 1, count);
+      EXPECT_EQ(comparator((*iterator).first, index_key), 0);
+      EXPECT_EQ((*iterator).second.GetSlotNum(), count);
+      count++;
+    }
+    EXPECT_EQ(count, scale);
+
+    bpm->UnpinPage(HEADER_PAGE_ID, true);
+    delete transaction;
+  }
   delete bpm;
+  delete disk_manager;
+  delete key_schema;
   remove("test.db");
   remove("test.log");
+  remove("test.fsm");
 }
+
 } // namespace cmudb
@@ -44,4 +44,132 @@ TEST(VtableTest, CreateTest) {
   remove("vtable.db");
   return;
 }
+
+// An index declared for a table that already has tuples is built over them
+TEST(VtableTest, IndexExistingTableTest) {
+  std::string db_file = "sqlite.db";
+  remove(db_file.c_str());
+  remove("vtable.db");
+  sqlite3 *db;
+  char *zErrMsg = 0;
+  ASSERT_EQ(SQLITE_OK, sqlite3_open(db_file.c_str(), &db));
+  ASSERT_EQ(SQLITE_OK, sqlite3_enable_load_extension(db, 1));
+  ASSERT_EQ(SQLITE_OK, sqlite3_load_extension(db, "libvtable", 0, &zErrMsg));
+
+  EXPECT_TRUE(
+      ExecSQL(db, "CREATE VIRTUAL TABLE foo2 USING vtable ('a INT, b int')"));
+  for (int i = 0; i < 100; i++)
+    EXPECT_TRUE(ExecSQL(db, "INSERT INTO foo2 VALUES(" + std::to_string(i) +
+                                ", " + std::to_string(i * 10) + ")"));
+  ASSERT_EQ(SQLITE_OK, sqlite3_close(db));
+
+  // a new sqlite schema over the same tables, this time with an index
+  remove(db_file.c_str());
+  ASSERT_EQ(SQLITE_OK, sqlite3_open(db_file.c_str(), &db));
+  ASSERT_EQ(SQLITE_OK, sqlite3_enable_load_extension(db, 1));
+  ASSERT_EQ(SQLITE_OK, sqlite3_load_extension(db, "libvtable", 0, &zErrMsg));
+  EXPECT_TRUE(ExecSQL(db, "CREATE VIRTUAL TABLE foo2 USING vtable ('a INT, "
+                          "b int', 'foo2_pk a')"));
+
+  std::vector<std::vector<std::string>> rows;
+  EXPECT_TRUE(QuerySQL(db, "SELECT a, b FROM foo2 WHERE a = 42", rows));
+  EXPECT_EQ((std::vector<std::vector<std::string>>{{"42", "420"}}), rows);
+  EXPECT_TRUE(QuerySQL(db, "SELECT count(*) FROM foo2", rows));
+  EXPECT_EQ((std::vector<std::vector<std::string>>{{"100"}}), rows);
+  EXPECT_TRUE(ExecSQL(db, "DROP TABLE foo2"));
+  EXPECT_EQ(SQLITE_OK, sqlite3_close(db));
+
+  remove(db_file.c_str());
+  remove("vtable.db");
+}
+
+// Range predicates on the indexed column go through an index range scan
+TEST(VtableTest, RangeScanTest) {
+  std::string db_file = "sqlite.db";
+  remove(db_file.c_str());
+  remove("vtable.db");
+  sqlite3 *db;
+  char *zErrMsg = 0;
+  ASSERT_EQ(SQLITE_OK, sqlite3_open(db_file.c_str(), &db));
+  ASSERT_EQ(SQLITE_OK, sqlite3_enable_load_extension(db, 1));
+  ASSERT_EQ(SQLITE_OK, sqlite3_load_extension(db, "libvtable", 0, &zErrMsg));
+
+  EXPECT_TRUE(ExecSQL(db, "CREATE VIRTUAL TABLE foo3 USING vtable ('a INT, "
+                          "b int', 'foo3_pk a')"));
+  for (int i = 1; i <= 5; i++)
+    EXPECT_TRUE(ExecSQL(db, "INSERT INTO foo3 VALUES(" + std::to_string(i) +
+                                ", " + std::to_string(i * 10) + ")"));
+
+  typedef std::vector<std::vector<std::string>> Rows;
+  Rows rows;
+  // a real bound on an integer column
+  EXPECT_TRUE(QuerySQL(db, "SELECT a, b FROM foo3 WHERE a > 1.5", rows));
+  EXPECT_EQ((Rows{{"2", "20"}, {"3", "30"}, {"4", "40"}, {"5", "50"}}), rows);
+  EXPECT_TRUE(
+      QuerySQL(db, "SELECT a FROM foo3 WHERE a BETWEEN 2 AND 4", rows));
+  EXPECT_EQ((Rows{{"2"}, {"3"}, {"4"}}), rows);
+  EXPECT_TRUE(QuerySQL(db, "SELECT a FROM foo3 WHERE a >= 2 AND a < 4", rows));
+  EXPECT_EQ((Rows{{"2"}, {"3"}}), rows);
+  // a bound out of the range of an INTEGER column
+  EXPECT_TRUE(QuerySQL(db, "SELECT a FROM foo3 WHERE a < 1e12", rows));
+  EXPECT_EQ((Rows{{"1"}, {"2"}, {"3"}, {"4"}, {"5"}}), rows);
+  EXPECT_TRUE(QuerySQL(db, "SELECT a FROM foo3 WHERE a > -1e12", rows));
+  EXPECT_EQ(5u, rows.size());
+  // text sorts after every number in SQLite
+  EXPECT_TRUE(QuerySQL(db, "SELECT a FROM foo3 WHERE a > 'x'", rows));
+  EXPECT_TRUE(rows.empty());
+  EXPECT_TRUE(QuerySQL(db, "SELECT a FROM foo3 WHERE a < 'x'", rows));
+  EXPECT_EQ(5u, rows.size());
+
+  EXPECT_TRUE(ExecSQL(db, "DROP TABLE foo3"));
+  EXPECT_EQ(SQLITE_OK, sqlite3_close(db));
+
+  remove(db_file.c_str());
+  remove("vtable.db");
+}
+// disk_stats reports the I/O of the storage engine while it runs
+TEST(VtableTest, DiskStatsTest) {
+  std::string db_file = "sqlite.db";
+  remove(db_file.c_str());
+  remove("vtable.db");
+  sqlite3 *db;
+  char *zErrMsg = 0;
+  ASSERT_EQ(SQLITE_OK, sqlite3_open(db_file.c_str(), &db));
+  ASSERT_EQ(SQLITE_OK, sqlite3_enable_load_extension(db, 1));
+  ASSERT_EQ(SQLITE_OK, sqlite3_load_extension(db, "libvtable", 0, &zErrMsg));
+  EXPECT_TRUE(
+      ExecSQL(db, "CREATE VIRTUAL TABLE foo4 USING vtable ('a INT, b int')"));
+  for (int i = 0; i < 10; i++)
+    EXPECT_TRUE(ExecSQL(db, "INSERT INTO foo4 VALUES(" + std::to_string(i) +
+                                ", " + std::to_string(i) + ")"));
+  // closing writes the pages back, reopening reads them in again
+  ASSERT_EQ(SQLITE_OK, sqlite3_close(db));
+  ASSERT_EQ(SQLITE_OK, sqlite3_open(db_file.c_str(), &db));
+  ASSERT_EQ(SQLITE_OK, sqlite3_enable_load_extension(db, 1));
+  ASSERT_EQ(SQLITE_OK, sqlite3_load_extension(db, "libvtable", 0, &zErrMsg));
+
+  typedef std::vector<std::vector<std::string>> Rows;
+  Rows rows;
+  EXPECT_TRUE(QuerySQL(db, "SELECT count(*) FROM foo4", rows));
+  EXPECT_EQ((Rows{{"10"}}), rows);
+  EXPECT_TRUE(QuerySQL(db, "SELECT op, count FROM disk_stats", rows));
+  ASSERT_EQ(4u, rows.size());
+  EXPECT_EQ("page_read", rows[0][0]);
+  EXPECT_LT(0, std::stoll(rows[0][1]));
+  EXPECT_EQ("page_write", rows[1][0]);
+  EXPECT_EQ("log_write", rows[2][0]);
+  EXPECT_EQ("sync", rows[3][0]);
+
+  // dropping the table shuts the storage engine down
+  EXPECT_TRUE(ExecSQL(db, "DROP TABLE foo4"));
+  EXPECT_EQ(SQLITE_ERROR, sqlite3_exec(db, "SELECT * FROM disk_stats",
+                                       nullptr, nullptr, &zErrMsg));
+  ASSERT_NE(nullptr, zErrMsg);
+  EXPECT_STREQ("the storage engine has been shut down", zErrMsg);
+  sqlite3_free(zErrMsg);
+  EXPECT_EQ(SQLITE_OK, sqlite3_close(db));
+
+  remove(db_file.c_str());
+  remove("vtable.db");
+}
 } // namespace cmudb